@@ -1,10 +1,14 @@
 from flask import Flask, render_template, request, jsonify
+import io
 import os
 import subprocess
+import json
+import tarfile
 import tempfile
-import shutil
 import zipfile
 
+import engine_client
+
 app = Flask(__name__)
 
 # Config paths
@@ -30,70 +34,108 @@ def analyze():
     if not uploaded_files:
         return jsonify({"error": "No files selected"}), 400
 
-    temp_dir = tempfile.mkdtemp(dir=UPLOAD_DIR)
-
+    archive_path = None
     try:
-        # Save uploaded files
-        for uploaded in uploaded_files:
-            filename = uploaded.filename.replace("\\", "/")
-            ext = os.path.splitext(filename)[1].lower()
-
-            if ext not in [".c", ".zip"]:
-                continue
-
-            file_path = os.path.join(temp_dir, os.path.basename(filename))
-            uploaded.save(file_path)
-
-            if ext == ".zip":
-                with zipfile.ZipFile(file_path, "r") as zip_ref:
-                    zip_ref.extractall(temp_dir)
-
-        if not any(f.endswith(".c") for f in os.listdir(temp_dir)):
-            raise Exception("No .c files found in upload or zip.")
-
-        result = subprocess.run(
-            [EXE_PATH, temp_dir],
-            capture_output=True,
-            text=True,
-            timeout=60
-        )
-
-        output = result.stdout
-        if not output.strip():
-            raise Exception("No output from plagiarism_detector.exe")
-
-        summary = parse_output_to_json(output)
+        # The engine reads .c members straight out of the archive, so
+        # nothing is extracted to disk
+        payload, suffix = pack_upload(uploaded_files)
+
+        try:
+            with tempfile.NamedTemporaryFile(dir=UPLOAD_DIR, suffix=suffix, delete=False) as archive:
+                archive.write(payload)
+                archive_path = archive.name
+            summary = daemon_reply_to_json(engine_client.analyze_archive(archive_path))
+        except engine_client.EngineUnavailable:
+            # No daemon running: fall back to one engine process per
+            # request, with the archive on its stdin
+            summary = run_engine_subprocess(payload)
         return jsonify(summary)
 
     except Exception as e:
         return jsonify({"error": str(e)}), 500
     finally:
-        shutil.rmtree(temp_dir, ignore_errors=True)
+        if archive_path:
+            os.remove(archive_path)
+
+
+def pack_upload(uploaded_files):
+    """Returns (archive bytes, suffix) for the engine.
+
+    A lone .zip is passed through untouched; anything else is repacked as
+    an uncompressed tar of the .c files and the .c members of any zips.
+    """
+    saved = []
+    for uploaded in uploaded_files:
+        filename = uploaded.filename.replace("\\", "/")
+        ext = os.path.splitext(filename)[1].lower()
+        if ext in [".c", ".zip"]:
+            saved.append((os.path.basename(filename), ext, uploaded.read()))
+
+    if len(saved) == 1 and saved[0][1] == ".zip":
+        payload = saved[0][2]
+        with zipfile.ZipFile(io.BytesIO(payload)) as zip_ref:
+            if not any(name.endswith(".c") for name in zip_ref.namelist()):
+                raise Exception("No .c files found in upload or zip.")
+        return payload, ".zip"
+
+    members = []
+    for name, ext, data in saved:
+        if ext == ".c":
+            members.append((name, data))
+            continue
+        with zipfile.ZipFile(io.BytesIO(data)) as zip_ref:
+            for info in zip_ref.infolist():
+                if info.filename.endswith(".c") and not info.is_dir():
+                    members.append((info.filename, zip_ref.read(info)))
 
+    if not members:
+        raise Exception("No .c files found in upload or zip.")
 
-def parse_output_to_json(text):
-    """Parses plagiarism_detector output to clean JSON."""
-    data = {"comparisons": []}
-    current = {}
+    buffer = io.BytesIO()
+    with tarfile.open(fileobj=buffer, mode="w") as tar:
+        for name, data in members:
+            info = tarfile.TarInfo(name)
+            info.size = len(data)
+            tar.addfile(info, io.BytesIO(data))
+    return buffer.getvalue(), ".tar"
 
-    for line in text.splitlines():
-        line = line.strip()
-        if not line:
-            continue
-        if "Comparing:" in line:
-            current = {"files": [], "metrics": {}}
-        elif line.startswith("File 1:"):
-            current["files"].append(line.split(":", 1)[1].strip())
-        elif line.startswith("File 2:"):
-            current["files"].append(line.split(":", 1)[1].strip())
-        elif "OVERALL SCORE" in line:
-            current["metrics"]["Overall"] = float(line.split(":")[1].strip().replace("%", ""))
-        elif "VERDICT" in line:
-            current["metrics"]["Verdict"] = line.split(":", 1)[1].strip()
-            data["comparisons"].append(current)
+
+def daemon_reply_to_json(reply):
+    """Maps the engine daemon's reply onto the shape the frontend renders."""
+    data = {"comparisons": []}
+    for cmp in reply.get("comparisons", []):
+        data["comparisons"].append({
+            "files": [cmp["file1"], cmp["file2"]],
+            "nodes": [cmp["nodes1"], cmp["nodes2"]],
+            "metrics": {
+                "AST": round(cmp["ast"] * 100, 2),
+                "CFG": round(cmp["cfg"] * 100, 2),
+                "DAG": round(cmp["dag"] * 100, 2),
+                "Winnowing": round(cmp["winnow"] * 100, 2),
+                "Overall": round(cmp["overall"] * 100, 2),
+                "Verdict": cmp["verdict"],
+            },
+        })
     return data
 
 
+def run_engine_subprocess(payload):
+    result = subprocess.run(
+        [EXE_PATH, "--format", "jsonl", "-"],
+        input=payload,
+        capture_output=True,
+        timeout=60
+    )
+
+    output = result.stdout.decode("utf-8", errors="replace")
+    if not output.strip():
+        raise Exception("No output from plagiarism_detector.exe")
+
+    # One JSON record per pair, same fields as a daemon comparison
+    records = [json.loads(line) for line in output.splitlines() if line.strip()]
+    return daemon_reply_to_json({"comparisons": records})
+
+
 if __name__ == "__main__":
     print("🚀 Running Plagiarism Detector UI at http://127.0.0.1:5000")
     app.run(debug=True)
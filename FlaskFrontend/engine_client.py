@@ -0,0 +1,66 @@
+"""Client for the long-lived C engine started with `plagiarism_detector.exe --daemon <socket>`.
+
+Messages in both directions are a 4-byte big-endian length followed by JSON.
+"""
+import json
+import os
+import socket
+import struct
+
+DEFAULT_SOCKET = os.environ.get("PD_ENGINE_SOCKET", "/tmp/plagiarism_detector.sock")
+
+
+class EngineUnavailable(Exception):
+    """The daemon is not running or cannot be reached."""
+
+
+def _recv_exact(sock, length):
+    chunks = []
+    while length > 0:
+        chunk = sock.recv(min(length, 1 << 20))
+        if not chunk:
+            raise EngineUnavailable("Engine closed the connection")
+        chunks.append(chunk)
+        length -= len(chunk)
+    return b"".join(chunks)
+
+
+def request(payload, socket_path=DEFAULT_SOCKET, timeout=60):
+    """Sends one request and returns the decoded JSON reply."""
+    if not hasattr(socket, "AF_UNIX"):
+        raise EngineUnavailable("Unix domain sockets are not supported here")
+
+    body = json.dumps(payload).encode("utf-8")
+    try:
+        with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as sock:
+            sock.settimeout(timeout)
+            sock.connect(socket_path)
+            sock.sendall(struct.pack(">I", len(body)) + body)
+            (length,) = struct.unpack(">I", _recv_exact(sock, 4))
+            reply = json.loads(_recv_exact(sock, length).decode("utf-8"))
+    except (OSError, socket.timeout) as e:
+        raise EngineUnavailable(str(e))
+
+    if not reply.get("ok"):
+        raise RuntimeError(reply.get("error", "Engine error"))
+    return reply
+
+
+def analyze_directory(path, ext=None, recursive=True, **kwargs):
+    """Compares every pair of .c files under path.
+
+    ext takes the engine's --ext spelling (".c,.h"); recursive=False stays
+    in the top folder, like --no-recurse.
+    """
+    payload = {"op": "analyze", "dir": os.path.abspath(path), "recursive": recursive}
+    if ext:
+        payload["ext"] = ext
+    return request(payload, **kwargs)
+
+
+def analyze_archive(path, ext=None, **kwargs):
+    """Compares every pair of .c members of a .zip or .tar, read in memory."""
+    payload = {"op": "analyze", "archive": os.path.abspath(path)}
+    if ext:
+        payload["ext"] = ext
+    return request(payload, **kwargs)
@@ -1,9 +0,0 @@
-#include <stdio.h>
-
-int main() {
-    int a = 10;
-    int b = 20;
-    int sum = a + b;
-    printf("Sum: %d\n", sum);
-    return 0;
-}
\ No newline at end of file
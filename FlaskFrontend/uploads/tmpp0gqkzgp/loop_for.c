@@ -1,10 +0,0 @@
-#include <stdio.h>
-
-int main() {
-    int sum = 0;
-    for(int i = 0; i < 10; i++) {
-        sum = sum + i;
-    }
-    printf("Sum: %d\n", sum);
-    return 0;
-}
\ No newline at end of file
@@ -1,9 +0,0 @@
-#include <stdio.h>
-
-int main() {
-        int x = 10;
-        int y = 20;
-        int result = x + y;
-        printf("Result: %d\n", result);
-        return 0;
-}
\ No newline at end of file
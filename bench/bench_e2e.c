@@ -0,0 +1,217 @@
+/*
+ * End-to-end throughput of directory mode on generated corpora:
+ *
+ *   cd bench
+ *   gcc -std=c99 -O2 -pthread -I../src -o bench_e2e bench_e2e.c synth.c \
+ *       ../src/directory_handler.c ../src/file_handler.c ../src/ingest.c ../src/lexer.c ../src/symbol.c ../src/scan.c \
+ *       ../src/parser.c ../src/arena.c ../src/ast.c ../src/normalizer.c ../src/cfg.c \
+ *       ../src/dag.c ../src/detector.c ../src/winnow.c ../src/utils.c \
+ *       ../src/log.c ../src/profile.c ../src/thread_pool.c ../src/function_cache.c
+ *   ./bench_e2e [--sizes 100,1000,10000] [--threads N] [--max-pairs P]
+ *               [--io-depth D] [--work-dir DIR] [--out bench_e2e.json]
+ *
+ * For each size a corpus is written to <work-dir>/files_<size>, then walked,
+ * read and analysed through ingest_directory on the same threads as
+ * directory mode (files/sec), and pairs are
+ * compared on the work-stealing pool (pairs/sec). Beyond --max-pairs an
+ * evenly spaced sample of the i < j pairs is compared and the all-pairs
+ * time is extrapolated from it.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "synth.h"
+#include "directory_handler.h"
+#include "ingest.h"
+#include "detector.h"
+#include "thread_pool.h"
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <time.h>
+#endif
+
+#define MAX_SIZES 16
+
+static double now_seconds(void) {
+#ifdef _WIN32
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+#endif
+}
+
+typedef struct {
+    FileArtifact **artifacts;
+    int capacity;
+} Ingest;
+
+// Same slot growth and per-file work as directory mode in main.c
+static int reserve_artifacts(void *ctx, int count) {
+    Ingest *state = ctx;
+    if (count <= state->capacity) return 1;
+    int capacity = state->capacity ? state->capacity : INGEST_DISCOVERY_BATCH;
+    while (capacity < count) capacity *= 2;
+    FileArtifact **grown = realloc(state->artifacts, sizeof(FileArtifact*) * capacity);
+    if (!grown) return 0;
+    memset(grown + state->capacity, 0, sizeof(FileArtifact*) * (capacity - state->capacity));
+    state->artifacts = grown;
+    state->capacity = capacity;
+    return 1;
+}
+
+static void build_file_artifact(void *ctx, int index, const char *data, size_t length, int worker) {
+    Ingest *state = ctx;
+    (void)worker;
+    state->artifacts[index] = build_artifact(data, length);
+}
+
+typedef struct {
+    FileArtifact **artifacts;
+    int file_count;
+    long long total_pairs;
+    long long sampled_pairs;
+    volatile double *scores;
+} PairSample;
+
+// Maps sample index k to the pair with linear index k * total / sampled, so
+// the sample spreads over the whole i < j triangle
+static void pair_at(long long index, int n, int *first, int *second) {
+    int i = 0;
+    long long row = n - 1;
+    while (index >= row) {
+        index -= row;
+        i++;
+        row--;
+    }
+    *first = i;
+    *second = i + 1 + (int)index;
+}
+
+static void compare_chunk(void *ctx, int begin, int end, int worker) {
+    PairSample *job = ctx;
+    (void)worker;
+    for (int k = begin; k < end; k++) {
+        long long index = (long long)((double)k * job->total_pairs / job->sampled_pairs);
+        int i, j;
+        pair_at(index, job->file_count, &i, &j);
+        if (!job->artifacts[i] || !job->artifacts[j]) continue;
+        PlagiarismResult r = compare_artifacts(job->artifacts[i], job->artifacts[j]);
+        job->scores[k] = r.overall_score;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int sizes[MAX_SIZES] = {100, 1000, 10000};
+    int size_count = 3;
+    int thread_count = 1;
+    int io_depth = INGEST_DEFAULT_DEPTH;
+    long long max_pairs = 200000;
+    const char *work_dir = "e2e_corpus";
+    const char *out_path = "bench_e2e.json";
+    SynthShape shape = {1, 60, 2, 3};
+    
+    for (int a = 1; a < argc; a++) {
+        if (strcmp(argv[a], "--sizes") == 0 && a + 1 < argc) {
+            size_count = 0;
+            char *spec = argv[++a];
+            for (char *p = strtok(spec, ","); p && size_count < MAX_SIZES; p = strtok(NULL, ",")) {
+                if (atoi(p) > 1) sizes[size_count++] = atoi(p);
+            }
+        } else if (strcmp(argv[a], "--threads") == 0 && a + 1 < argc) {
+            thread_count = atoi(argv[++a]);
+            if (thread_count < 1) thread_count = 1;
+        } else if (strcmp(argv[a], "--max-pairs") == 0 && a + 1 < argc) {
+            max_pairs = atoll(argv[++a]);
+            if (max_pairs < 1) max_pairs = 1;
+        } else if (strcmp(argv[a], "--io-depth") == 0 && a + 1 < argc) {
+            io_depth = atoi(argv[++a]);
+            if (io_depth < 0) io_depth = 0;
+        } else if (strcmp(argv[a], "--statements") == 0 && a + 1 < argc) {
+            shape.statements = atoi(argv[++a]);
+        } else if (strcmp(argv[a], "--work-dir") == 0 && a + 1 < argc) {
+            work_dir = argv[++a];
+        } else if (strcmp(argv[a], "--out") == 0 && a + 1 < argc) {
+            out_path = argv[++a];
+        } else {
+            printf("Usage: %s [--sizes 100,1000,10000] [--threads N] [--max-pairs P]\n", argv[0]);
+            printf("          [--io-depth D] [--statements S] [--work-dir DIR] [--out results.json]\n");
+            return 1;
+        }
+    }
+    
+    FILE *out = fopen(out_path, "w");
+    if (!out) {
+        printf("[ERROR] Cannot write: %s\n", out_path);
+        return 1;
+    }
+    
+    if (!synth_make_directory(work_dir)) return 1;
+    fprintf(out, "{\"engine_version\":%d,\"threads\":%d,\"statements\":%d,\"results\":[",
+            ENGINE_VERSION, thread_count, shape.statements);
+    printf("%8s %10s %12s %12s %12s %12s %14s\n", "files", "MB", "files/sec",
+           "pairs", "sampled", "pairs/sec", "all_pairs_s");
+    
+    for (int z = 0; z < size_count; z++) {
+        char dir[4096];
+        snprintf(dir, sizeof(dir), "%s/files_%d", work_dir, sizes[z]);
+        if (synth_write_corpus(dir, sizes[z], &shape, 0.2, 1000u + (unsigned int)sizes[z]) < 0) {
+            continue;
+        }
+        
+        ExtensionFilter filter = {{{0}}, 0};
+        Ingest state = {NULL, 0};
+        FileList *list = createFileList();
+        IngestStats io = {0, 0, 0, 0.0, "threads"};
+        double t0 = now_seconds();
+        if (list) {
+            ingest_directory(dir, &filter, 0, list, io_depth, thread_count,
+                             reserve_artifacts, build_file_artifact, &state, &io);
+        }
+        double ingest_seconds = now_seconds() - t0;
+        int n = list && list->count <= state.capacity ? list->count : 0;
+        
+        long long total_pairs = (long long)n * (n - 1) / 2;
+        long long sampled = total_pairs < max_pairs ? total_pairs : max_pairs;
+        double *scores = calloc(sampled > 0 ? sampled : 1, sizeof(double));
+        PairSample job = {state.artifacts, n, total_pairs, sampled, scores};
+        
+        int chunk_count = 0;
+        TaskChunk *chunks = split_into_chunks(NULL, (int)sampled, thread_count * 8, &chunk_count);
+        t0 = now_seconds();
+        run_work_stealing(chunks, chunk_count, thread_count, compare_chunk, &job);
+        double compare_seconds = now_seconds() - t0;
+        
+        double files_per_second = ingest_seconds > 0 ? n / ingest_seconds : 0.0;
+        double pairs_per_second = compare_seconds > 0 ? sampled / compare_seconds : 0.0;
+        double all_pairs_seconds = pairs_per_second > 0 ? total_pairs / pairs_per_second : 0.0;
+        
+        printf("%8d %10.2f %12.1f %12lld %12lld %12.1f %14.1f\n", n, io.bytes / 1048576.0,
+               files_per_second, total_pairs, sampled, pairs_per_second, all_pairs_seconds);
+        fprintf(out, "%s\n{\"files\":%d,\"bytes\":%lld,\"backend\":\"%s\",\"ingest_seconds\":%.4f,\"files_per_second\":%.1f,"
+                     "\"total_pairs\":%lld,\"sampled_pairs\":%lld,\"compare_seconds\":%.4f,"
+                     "\"pairs_per_second\":%.1f,\"all_pairs_seconds\":%.1f}",
+                z == 0 ? "" : ",", n, io.bytes, io.backend, ingest_seconds, files_per_second,
+                total_pairs, sampled, compare_seconds, pairs_per_second, all_pairs_seconds);
+        
+        free(chunks);
+        free(scores);
+        for (int i = 0; i < n; i++) free_artifact(state.artifacts[i]);
+        free(state.artifacts);
+        freeFileList(list);
+    }
+    
+    fprintf(out, "\n]}\n");
+    fclose(out);
+    printf("\nResults written to %s\n", out_path);
+    return 0;
+}
@@ -0,0 +1,356 @@
+/*
+ * Per-stage microbenchmarks for the detection pipeline.
+ *
+ * Each stage runs on synthetic programs of growing size. The output is the
+ * median and p99 time per call plus heap allocations per call, printed as a
+ * table and written to a JSON file for diffing between commits:
+ *
+ *   cd bench
+ *   gcc -std=c99 -O2 -pthread -I../src -DBENCH_COUNT_ALLOCS \
+ *       -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc \
+ *       -o bench_stages bench_stages.c synth.c ../src/lexer.c ../src/symbol.c ../src/scan.c ../src/parser.c \
+ *       ../src/arena.c ../src/ast.c ../src/normalizer.c ../src/cfg.c ../src/dag.c \
+ *       ../src/detector.c ../src/winnow.c ../src/utils.c ../src/log.c ../src/profile.c \
+ *       ../src/thread_pool.c ../src/function_cache.c
+ *   ./bench_stages [--out bench_stages.json] [--min-time-ms 200]
+ *
+ * Without -DBENCH_COUNT_ALLOCS and the --wrap flags (e.g. non-GNU linkers)
+ * allocations per call are reported as -1.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "synth.h"
+#include "lexer.h"
+#include "parser.h"
+#include "normalizer.h"
+#include "cfg.h"
+#include "dag.h"
+#include "winnow.h"
+#include "detector.h"
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <time.h>
+#endif
+
+#define MAX_SAMPLES 100000
+#define MIN_SAMPLES 15
+
+static unsigned long long alloc_count = 0;
+
+#ifdef BENCH_COUNT_ALLOCS
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size) {
+    alloc_count++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+    alloc_count++;
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    alloc_count++;
+    return __real_realloc(ptr, size);
+}
+#endif
+
+static double now_ns(void) {
+#ifdef _WIN32
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart * 1e9 / (double)frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+#endif
+}
+
+// Everything a stage needs, built once per size so each stage only times
+// its own work
+typedef struct {
+    char *code1;
+    char *code2;
+    size_t length1;
+    size_t length2;
+    TokenList *tokens;
+    Arena arena;          // trees and graphs built once in prepare_input
+    Arena scratch;        // reset by every timed stage that builds
+    ASTNode *ast;
+    FlatAST *norm1;
+    FlatAST *norm2;
+    CFGSummaryNode *cfg1;
+    CFGSummaryNode *cfg2;
+    DAGSummaryNode *dag1;
+    DAGSummaryNode *dag2;
+    int cfg_count1, cfg_count2;
+    int dag_count1, dag_count2;
+    Fingerprints *fp1;
+    Fingerprints *fp2;
+} StageInput;
+
+// Results are folded into a sink so the compiler cannot drop the calls
+static volatile double sink;
+
+static void run_tokenize(StageInput *in) {
+    TokenList *tokens = tokenize(in->code1, in->length1);
+    sink += tokens ? tokens->count : 0;
+    free_tokens(tokens);
+}
+
+// Stages that build reset the scratch arena first, as build_artifact
+// does per file, so allocations per call show the steady state
+static void run_parse(StageInput *in) {
+    arena_reset(&in->scratch);
+    int too_deep;
+    ASTNode *ast = parse(in->tokens, &in->scratch, PARSE_DEFAULT_MAX_DEPTH, &too_deep);
+    sink += ast ? ast->child_count : 0;
+}
+
+static void run_normalize(StageInput *in) {
+    arena_reset(&in->scratch);
+    FlatAST *normalized = normalize_ast(in->ast, &in->scratch, &in->scratch);
+    sink += normalized ? normalized->count : 0;
+}
+
+static void run_ast_similarity(StageInput *in) {
+    sink += calculate_ast_similarity(in->norm1, in->norm2);
+}
+
+// Top-level statements of a normalized tree, each viewed as a tree of
+// its own as build_artifact analyzes them; NULL if allocation failed
+static FlatAST* statement_trees(const FlatAST *ast, Arena *arena, int *count) {
+    *count = flat_child_count(ast, 0);
+    FlatAST *trees = arena_alloc(arena, sizeof(FlatAST) * (*count + 1));
+    if (!trees) return NULL;
+    int k = 0;
+    for (int c = 1; c < ast->count; c += ast->nodes[c].size) {
+        trees[k++] = (FlatAST){ast->nodes + c, ast->hashes + c, (int)ast->nodes[c].size};
+    }
+    return trees;
+}
+
+// A file's CFG and DAG summaries, built a statement at a time and joined
+// the way build_artifact does
+static CFGSummaryNode* build_cfg_summary(const FlatAST *ast, Arena *arena, int *node_count) {
+    int count;
+    FlatAST *trees = statement_trees(ast, arena, &count);
+    CFGFragment *fragments = arena_alloc(arena, sizeof(CFGFragment) * (count + 1));
+    if (!trees || !fragments) return NULL;
+    for (int k = 0; k < count; k++) {
+        if (!build_cfg_fragment(&trees[k], arena, &fragments[k])) return NULL;
+    }
+    return join_cfg_fragments(fragments, count, arena, node_count);
+}
+
+static DAGSummaryNode* build_dag_summary(const FlatAST *ast, Arena *arena, int *node_count) {
+    int count;
+    FlatAST *trees = statement_trees(ast, arena, &count);
+    DAGFragment *fragments = arena_alloc(arena, sizeof(DAGFragment) * (count + 1));
+    if (!trees || !fragments) return NULL;
+    for (int k = 0; k < count; k++) {
+        if (!build_dag_fragment(&trees[k], arena, &fragments[k])) return NULL;
+    }
+    return join_dag_fragments(fragments, count, arena, node_count);
+}
+
+static void run_build_cfg(StageInput *in) {
+    arena_reset(&in->scratch);
+    int node_count = 0;
+    build_cfg_summary(in->norm1, &in->scratch, &node_count);
+    sink += node_count;
+}
+
+static void run_compare_cfg(StageInput *in) {
+    sink += compare_cfg_summary(in->cfg1, in->cfg_count1, in->cfg2, in->cfg_count2);
+}
+
+static void run_build_dag(StageInput *in) {
+    arena_reset(&in->scratch);
+    int node_count = 0;
+    build_dag_summary(in->norm1, &in->scratch, &node_count);
+    sink += node_count;
+}
+
+static void run_compare_dag(StageInput *in) {
+    sink += compare_dag_summary(in->dag1, in->dag_count1, in->dag2, in->dag_count2);
+}
+
+static void run_winnow(StageInput *in) {
+    Fingerprints *fp = winnow_tokens(in->tokens);
+    sink += fp ? fp->count : 0;
+    free_fingerprints(fp);
+}
+
+static void run_compare_fingerprints(StageInput *in) {
+    sink += compare_fingerprints(in->fp1, in->fp2);
+}
+
+typedef struct {
+    const char *name;
+    void (*run)(StageInput *in);
+} Stage;
+
+static const Stage stages[] = {
+    {"tokenize", run_tokenize},
+    {"parse", run_parse},
+    {"normalize_ast", run_normalize},
+    {"calculate_ast_similarity", run_ast_similarity},
+    {"build_cfg_fragment", run_build_cfg},
+    {"compare_cfg_summary", run_compare_cfg},
+    {"build_dag_fragment", run_build_dag},
+    {"compare_dag_summary", run_compare_dag},
+    {"winnow_tokens", run_winnow},
+    {"compare_fingerprints", run_compare_fingerprints},
+};
+
+static const int sizes[] = {8, 32, 128, 512, 2048};
+
+static int prepare_input(StageInput *in, int statements) {
+    memset(in, 0, sizeof(*in));
+    SynthShape shape1 = {1u + (unsigned int)statements, statements, 1 + statements / 64, 4};
+    SynthShape shape2 = {7919u + (unsigned int)statements, statements, 1 + statements / 64, 4};
+    in->code1 = synth_program(&shape1);
+    in->code2 = synth_program(&shape2);
+    if (!in->code1 || !in->code2) return 0;
+    in->length1 = strlen(in->code1);
+    in->length2 = strlen(in->code2);
+    
+    int too_deep;
+    TokenList *tokens2 = tokenize(in->code2, in->length2);
+    ASTNode *ast2 = parse(tokens2, &in->arena, PARSE_DEFAULT_MAX_DEPTH, &too_deep);
+    in->tokens = tokenize(in->code1, in->length1);
+    in->ast = parse(in->tokens, &in->arena, PARSE_DEFAULT_MAX_DEPTH, &too_deep);
+    in->norm1 = normalize_ast(in->ast, &in->arena, &in->scratch);
+    in->norm2 = normalize_ast(ast2, &in->arena, &in->scratch);
+    in->fp1 = winnow_tokens(in->tokens);
+    in->fp2 = winnow_tokens(tokens2);
+    free_tokens(tokens2);
+    if (!in->norm1 || !in->norm2) return 0;
+    
+    in->cfg1 = build_cfg_summary(in->norm1, &in->arena, &in->cfg_count1);
+    in->cfg2 = build_cfg_summary(in->norm2, &in->arena, &in->cfg_count2);
+    in->dag1 = build_dag_summary(in->norm1, &in->arena, &in->dag_count1);
+    in->dag2 = build_dag_summary(in->norm2, &in->arena, &in->dag_count2);
+    return in->cfg1 && in->cfg2 && in->dag1 && in->dag2;
+}
+
+static void release_input(StageInput *in) {
+    free(in->code1);
+    free(in->code2);
+    free_tokens(in->tokens);
+    arena_release(&in->arena);
+    arena_release(&in->scratch);
+    free_fingerprints(in->fp1);
+    free_fingerprints(in->fp2);
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+typedef struct {
+    int samples;
+    double median_ns;
+    double p99_ns;
+    double allocs_per_call;
+} StageTiming;
+
+static StageTiming time_stage(const Stage *stage, StageInput *in, double min_time_ns,
+                              double *samples) {
+    StageTiming timing = {0, 0.0, 0.0, -1.0};
+    
+    // Warm up caches and the allocator before measuring
+    stage->run(in);
+    
+    unsigned long long allocs_before = alloc_count;
+    double started = now_ns();
+    int n = 0;
+    while (n < MAX_SAMPLES && (n < MIN_SAMPLES || now_ns() - started < min_time_ns)) {
+        double t0 = now_ns();
+        stage->run(in);
+        samples[n++] = now_ns() - t0;
+    }
+    unsigned long long allocs = alloc_count - allocs_before;
+    
+    qsort(samples, n, sizeof(double), compare_doubles);
+    timing.samples = n;
+    timing.median_ns = samples[n / 2];
+    timing.p99_ns = samples[(int)((n - 1) * 0.99)];
+#ifdef BENCH_COUNT_ALLOCS
+    timing.allocs_per_call = (double)allocs / n;
+#else
+    (void)allocs;
+#endif
+    return timing;
+}
+
+int main(int argc, char *argv[]) {
+    const char *out_path = "bench_stages.json";
+    double min_time_ms = 200.0;
+    
+    for (int a = 1; a < argc; a++) {
+        if (strcmp(argv[a], "--out") == 0 && a + 1 < argc) {
+            out_path = argv[++a];
+        } else if (strcmp(argv[a], "--min-time-ms") == 0 && a + 1 < argc) {
+            min_time_ms = atof(argv[++a]);
+        } else {
+            printf("Usage: %s [--out results.json] [--min-time-ms MS]\n", argv[0]);
+            return 1;
+        }
+    }
+    
+    FILE *out = fopen(out_path, "w");
+    double *samples = malloc(sizeof(double) * MAX_SAMPLES);
+    if (!out || !samples) {
+        printf("[ERROR] Cannot write: %s\n", out_path);
+        return 1;
+    }
+    
+    fprintf(out, "{\"engine_version\":%d,\"min_time_ms\":%.0f,\"results\":[", ENGINE_VERSION, min_time_ms);
+    printf("%-26s %6s %7s %9s %12s %12s %10s\n",
+           "stage", "stmts", "nodes", "samples", "median_us", "p99_us", "allocs");
+    
+    int first = 1;
+    int stage_count = (int)(sizeof(stages) / sizeof(stages[0]));
+    int size_count = (int)(sizeof(sizes) / sizeof(sizes[0]));
+    for (int z = 0; z < size_count; z++) {
+        StageInput in;
+        if (!prepare_input(&in, sizes[z])) {
+            printf("[ERROR] Could not build inputs for %d statements\n", sizes[z]);
+            release_input(&in);
+            continue;
+        }
+        int nodes = in.norm1->count;
+        
+        for (int st = 0; st < stage_count; st++) {
+            StageTiming t = time_stage(&stages[st], &in, min_time_ms * 1e6, samples);
+            printf("%-26s %6d %7d %9d %12.2f %12.2f %10.1f\n", stages[st].name, sizes[z], nodes,
+                   t.samples, t.median_ns / 1000.0, t.p99_ns / 1000.0, t.allocs_per_call);
+            fprintf(out, "%s\n{\"stage\":\"%s\",\"statements\":%d,\"nodes\":%d,\"bytes\":%zu,"
+                         "\"samples\":%d,\"median_ns\":%.0f,\"p99_ns\":%.0f,\"allocs_per_call\":%.2f}",
+                    first ? "" : ",", stages[st].name, sizes[z], nodes, strlen(in.code1),
+                    t.samples, t.median_ns, t.p99_ns, t.allocs_per_call);
+            first = 0;
+        }
+        release_input(&in);
+    }
+    
+    fprintf(out, "\n]}\n");
+    fclose(out);
+    free(samples);
+    printf("\nResults written to %s\n", out_path);
+    return 0;
+}
@@ -0,0 +1,388 @@
+#include "synth.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+
+#ifdef _WIN32
+    #include <direct.h>
+    #define make_directory(path) _mkdir(path)
+#else
+    #include <sys/stat.h>
+    #define make_directory(path) mkdir(path, 0755)
+#endif
+
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+    int failed;
+} SynthBuf;
+
+typedef struct {
+    SynthBuf *out;
+    unsigned int rng;        // structure: identical for every variant of a shape
+    unsigned int style_rng;  // spelling: names and orderings
+    const SynthStyle *style;
+    int budget;
+    int var_count;
+    int *var_map;
+    const char *var_prefix;
+    const char *loop_prefix;
+    int loop_count;
+    int max_depth;
+} SynthState;
+
+static const char *var_prefixes[] = {"x", "val", "tmp", "acc", "cnt", "res", "data", "item"};
+static const char *loop_prefixes[] = {"j", "k", "idx", "it", "pos"};
+
+static unsigned int xorshift(unsigned int *state) {
+    // xorshift32; never seeded with 0
+    unsigned int x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+static int pick(SynthState *s, int n) {
+    return (int)(xorshift(&s->rng) % (unsigned int)n);
+}
+
+static int pick_style(SynthState *s, int n) {
+    return (int)(xorshift(&s->style_rng) % (unsigned int)n);
+}
+
+static void shuffle(SynthState *s, int *items, int count) {
+    for (int i = count - 1; i > 0; i--) {
+        int j = pick_style(s, i + 1);
+        int t = items[i];
+        items[i] = items[j];
+        items[j] = t;
+    }
+}
+
+static void buf_append(SynthBuf *buf, const char *text, size_t n) {
+    if (buf->failed) return;
+    
+    if (buf->length + n + 1 > buf->capacity) {
+        size_t capacity = buf->capacity ? buf->capacity * 2 : 4096;
+        while (capacity < buf->length + n + 1) capacity *= 2;
+        char *data = realloc(buf->data, capacity);
+        if (!data) {
+            buf->failed = 1;
+            return;
+        }
+        buf->data = data;
+        buf->capacity = capacity;
+    }
+    memcpy(buf->data + buf->length, text, n);
+    buf->length += n;
+    buf->data[buf->length] = '\0';
+}
+
+static void emit(SynthState *s, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    char line[256];
+    int n = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (n < 0) return;
+    if ((size_t)n >= sizeof(line)) n = sizeof(line) - 1;
+    buf_append(s->out, line, (size_t)n);
+}
+
+static void indent(SynthState *s, int depth) {
+    for (int i = 0; i <= depth; i++) emit(s, "    ");
+}
+
+static void emit_var(SynthState *s, int v) {
+    emit(s, "%s%d", s->var_prefix, s->var_map[v]);
+}
+
+static void emit_expression(SynthState *s) {
+    static const char *ops[] = {"+", "-", "*", "+", "-"};
+    int terms = 1 + pick(s, 3);
+    for (int t = 0; t < terms; t++) {
+        if (t > 0) emit(s, " %s ", ops[pick(s, 5)]);
+        if (pick(s, 3) == 0) emit(s, "%d", 1 + pick(s, 50));
+        else emit_var(s, pick(s, s->var_count));
+    }
+}
+
+static void emit_block(SynthState *s, int depth, int statements);
+
+static void emit_if(SynthState *s, int depth) {
+    int var = pick(s, s->var_count);
+    int limit = pick(s, 100);
+    indent(s, depth);
+    emit(s, "if (");
+    emit_var(s, var);
+    emit(s, " < %d) {\n", limit);
+    emit_block(s, depth + 1, 1 + pick(s, 3));
+    if (pick(s, 2)) {
+        indent(s, depth);
+        emit(s, "} else {\n");
+        emit_block(s, depth + 1, 1 + pick(s, 2));
+    }
+    indent(s, depth);
+    emit(s, "}\n");
+}
+
+static void emit_loop(SynthState *s, int depth) {
+    int loop = s->loop_count++;
+    int bound = 2 + pick(s, 20);
+    int body = 1 + pick(s, 3);
+    const char *i = s->loop_prefix;
+    
+    if (s->style && s->style->loop_swap) {
+        indent(s, depth);
+        emit(s, "int %s%d = 0;\n", i, loop);
+        indent(s, depth);
+        emit(s, "while (%s%d < %d) {\n", i, loop, bound);
+        emit_block(s, depth + 1, body);
+        indent(s, depth + 1);
+        emit(s, "%s%d = %s%d + 1;\n", i, loop, i, loop);
+    } else {
+        indent(s, depth);
+        emit(s, "for (int %s%d = 0; %s%d < %d; %s%d++) {\n", i, loop, i, loop, bound, i, loop);
+        emit_block(s, depth + 1, body);
+    }
+    indent(s, depth);
+    emit(s, "}\n");
+}
+
+static void emit_switch(SynthState *s, int depth) {
+    int cases = 2 + pick(s, 3);
+    int var = pick(s, s->var_count);
+    
+    if (s->style && s->style->switch_swap) {
+        for (int c = 0; c < cases; c++) {
+            indent(s, depth);
+            emit(s, c == 0 ? "if (" : "} else if (");
+            emit_var(s, var);
+            emit(s, " == %d) {\n", c);
+            emit_block(s, depth + 1, 1);
+        }
+        indent(s, depth);
+        emit(s, "}\n");
+        return;
+    }
+    
+    indent(s, depth);
+    emit(s, "switch (");
+    emit_var(s, var);
+    emit(s, ") {\n");
+    for (int c = 0; c < cases; c++) {
+        indent(s, depth);
+        emit(s, "case %d:\n", c);
+        emit_block(s, depth + 1, 1);
+        indent(s, depth + 1);
+        emit(s, "break;\n");
+    }
+    indent(s, depth);
+    emit(s, "}\n");
+}
+
+static void emit_statement(SynthState *s, int depth) {
+    int roll = pick(s, 20);
+    int nested = depth < s->max_depth && s->budget > 2;
+    s->budget--;
+    
+    if (nested && roll < 3) {
+        emit_if(s, depth);
+    } else if (nested && roll < 5) {
+        emit_loop(s, depth);
+    } else if (nested && roll < 6) {
+        emit_switch(s, depth);
+    } else {
+        indent(s, depth);
+        emit_var(s, pick(s, s->var_count));
+        emit(s, " = ");
+        emit_expression(s);
+        emit(s, ";\n");
+    }
+}
+
+static void emit_block(SynthState *s, int depth, int statements) {
+    for (int i = 0; i < statements && s->budget > 0; i++) {
+        emit_statement(s, depth);
+    }
+}
+
+static int emit_function(SynthState *s, int index, int statements) {
+    s->var_count = 3 + statements / 8;
+    s->budget = statements;
+    
+    int *values = malloc(sizeof(int) * s->var_count);
+    int *order = malloc(sizeof(int) * s->var_count);
+    s->var_map = malloc(sizeof(int) * s->var_count);
+    if (!values || !order || !s->var_map) {
+        free(values);
+        free(order);
+        free(s->var_map);
+        return 0;
+    }
+    
+    for (int v = 0; v < s->var_count; v++) {
+        values[v] = pick(s, 100);
+        order[v] = v;
+        s->var_map[v] = v;
+    }
+    if (s->style && s->style->rename) shuffle(s, s->var_map, s->var_count);
+    if (s->style && s->style->reorder) shuffle(s, order, s->var_count);
+    
+    emit(s, "int f%d(int n) {\n", index);
+    for (int k = 0; k < s->var_count; k++) {
+        emit(s, "    int ");
+        emit_var(s, order[k]);
+        emit(s, " = %d;\n", values[order[k]]);
+    }
+    while (s->budget > 0) {
+        emit_statement(s, 0);
+    }
+    emit(s, "    return ");
+    emit_var(s, 0);
+    emit(s, ";\n}\n\n");
+    
+    free(values);
+    free(order);
+    free(s->var_map);
+    s->var_map = NULL;
+    return 1;
+}
+
+char* synth_variant(const SynthShape *shape, const SynthStyle *style) {
+    if (!shape || shape->statements < 1) return NULL;
+    
+    SynthState s;
+    memset(&s, 0, sizeof(s));
+    s.rng = shape->seed ? shape->seed : 0x9E3779B9u;
+    s.style = style;
+    s.style_rng = (style && style->seed) ? style->seed : 0x85EBCA6Bu;
+    s.max_depth = shape->max_depth;
+    s.var_prefix = "v";
+    s.loop_prefix = "i";
+    if (style && style->rename) {
+        s.var_prefix = var_prefixes[pick_style(&s, 8)];
+        s.loop_prefix = loop_prefixes[pick_style(&s, 5)];
+    }
+    
+    int functions = shape->functions > 0 ? shape->functions : 1;
+    int per_function = shape->statements / functions;
+    if (per_function < 1) per_function = 1;
+    
+    // Functions are built into their own buffers so reordering them never
+    // touches the structure stream
+    SynthBuf *bodies = calloc(functions, sizeof(SynthBuf));
+    int *order = malloc(sizeof(int) * functions);
+    int ok = bodies && order;
+    for (int f = 0; ok && f < functions; f++) {
+        s.out = &bodies[f];
+        ok = emit_function(&s, f, per_function) && !bodies[f].failed;
+        order[f] = f;
+    }
+    if (ok && style && style->reorder) shuffle(&s, order, functions);
+    
+    SynthBuf program = {NULL, 0, 0, 0};
+    if (ok) {
+        buf_append(&program, "#include <stdio.h>\n\n", 20);
+        for (int f = 0; f < functions; f++) {
+            buf_append(&program, bodies[order[f]].data, bodies[order[f]].length);
+        }
+        ok = !program.failed;
+    }
+    
+    for (int f = 0; bodies && f < functions; f++) free(bodies[f].data);
+    free(bodies);
+    free(order);
+    
+    if (!ok) {
+        free(program.data);
+        return NULL;
+    }
+    return program.data;
+}
+
+char* synth_program(const SynthShape *shape) {
+    return synth_variant(shape, NULL);
+}
+
+int synth_make_directory(const char *directory) {
+    if (make_directory(directory) != 0 && errno != EEXIST) {
+        printf("[ERROR] Cannot create directory: %s\n", directory);
+        return 0;
+    }
+    return 1;
+}
+
+int synth_write_corpus(const char *directory, int count, const SynthShape *base,
+                       double plagiarized_ratio, unsigned int seed) {
+    if (!directory || !base || count < 1) return -1;
+    
+    if (!synth_make_directory(directory)) return -1;
+    
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/pairs.csv", directory);
+    FILE *manifest = fopen(path, "w");
+    SynthShape *shapes = malloc(sizeof(SynthShape) * count);
+    if (!manifest || !shapes) {
+        printf("[ERROR] Cannot write: %s\n", path);
+        if (manifest) fclose(manifest);
+        free(shapes);
+        return -1;
+    }
+    fprintf(manifest, "variant,original,rename,loop_swap,switch_swap,reorder\n");
+    
+    unsigned int rng = seed ? seed : 0x27D4EB2Fu;
+    int written = 0;
+    for (int i = 0; i < count; i++) {
+        SynthStyle style = {0, 0, 0, 0, 0};
+        const SynthStyle *use_style = NULL;
+        int original = -1;
+        
+        if (i > 0 && (xorshift(&rng) % 10000) < (unsigned int)(plagiarized_ratio * 10000)) {
+            original = (int)(xorshift(&rng) % (unsigned int)i);
+            shapes[i] = shapes[original];
+            style.seed = xorshift(&rng);
+            unsigned int mask = 1 + xorshift(&rng) % 15;
+            style.rename = (mask & 1) != 0;
+            style.loop_swap = (mask & 2) != 0;
+            style.switch_swap = (mask & 4) != 0;
+            style.reorder = (mask & 8) != 0;
+            use_style = &style;
+        } else {
+            // Sizes spread over [statements / 2, statements * 3 / 2]
+            shapes[i] = *base;
+            shapes[i].seed = xorshift(&rng);
+            int spread = base->statements > 1 ? base->statements : 2;
+            shapes[i].statements = spread / 2 + (int)(xorshift(&rng) % (unsigned int)spread) + 1;
+        }
+        
+        char *code = synth_variant(&shapes[i], use_style);
+        if (!code) break;
+        
+        snprintf(path, sizeof(path), "%s/sub_%05d.c", directory, i);
+        FILE *file = fopen(path, "w");
+        if (!file) {
+            printf("[ERROR] Cannot write: %s\n", path);
+            free(code);
+            break;
+        }
+        fputs(code, file);
+        fclose(file);
+        free(code);
+        written++;
+        
+        if (original >= 0) {
+            fprintf(manifest, "sub_%05d.c,sub_%05d.c,%d,%d,%d,%d\n", i, original,
+                    style.rename, style.loop_swap, style.switch_swap, style.reorder);
+        }
+    }
+    
+    fclose(manifest);
+    free(shapes);
+    return written == count ? written : -1;
+}
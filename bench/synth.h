@@ -0,0 +1,41 @@
+#ifndef SYNTH_H
+#define SYNTH_H
+
+// Synthetic C submissions for benchmarks. The same shape always produces
+// the same program, so runs are comparable across commits.
+
+typedef struct {
+    unsigned int seed;
+    int statements;   // total statements, nested ones included
+    int functions;
+    int max_depth;    // deepest if/loop/switch nesting
+} SynthShape;
+
+// Plagiarism transformations applied on top of a shape. Each one is a
+// rewrite the normalizer is meant to see through; the program structure
+// is unchanged, only its spelling.
+typedef struct {
+    unsigned int seed;   // drives names and orderings
+    int rename;          // new identifier names for variables and loop counters
+    int loop_swap;       // for loops written as while loops
+    int switch_swap;     // switch statements written as if/else-if chains
+    int reorder;         // shuffle declarations and the order of functions
+} SynthStyle;
+
+// Returns a malloc'd NUL terminated C source, or NULL on allocation failure
+char* synth_program(const SynthShape *shape);
+
+// Same program as synth_program(shape) rewritten by style (NULL = none)
+char* synth_variant(const SynthShape *shape, const SynthStyle *style);
+
+// Creates directory unless it already exists; returns 0 on failure
+int synth_make_directory(const char *directory);
+
+// Writes count submissions into directory as sub_NNNNN.c. Roughly
+// plagiarized_ratio of them are variants of an earlier file with a random
+// mix of transformations; each of those is listed in directory/pairs.csv.
+// Returns the number of files written, or -1 on error.
+int synth_write_corpus(const char *directory, int count, const SynthShape *base,
+                       double plagiarized_ratio, unsigned int seed);
+
+#endif
@@ -0,0 +1,902 @@
+#ifndef _WIN32
+    #define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "archive.h"
+#include "thread_pool.h"
+#include "log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <limits.h>
+#include <pthread.h>
+
+#ifdef _WIN32
+    #include <windows.h>
+    #include <io.h>
+    #include <fcntl.h>
+#else
+    #include <time.h>
+#endif
+
+// Member buffers are carved out of 1 MiB blocks; big members get a block
+// of their own
+#define ARENA_BLOCK (1u << 20)
+
+struct ArchiveBlock {
+    ArchiveBlock *next;
+    size_t used;
+    size_t size;
+    char data[];
+};
+
+static double now_seconds(void) {
+#ifdef _WIN32
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+#endif
+}
+
+static char* arena_alloc(Archive *archive, size_t size) {
+    ArchiveBlock *head = archive->blocks;
+    if (head && head->size - head->used >= size) {
+        char *p = head->data + head->used;
+        head->used += size;
+        return p;
+    }
+
+    size_t block_size = size > ARENA_BLOCK / 4 ? size : ARENA_BLOCK;
+    ArchiveBlock *block = malloc(sizeof(ArchiveBlock) + block_size);
+    if (!block) return NULL;
+    block->used = size;
+    block->size = block_size;
+
+    // A dedicated block goes behind the head so the head keeps filling
+    if (head && block_size == size) {
+        block->next = head->next;
+        head->next = block;
+    } else {
+        block->next = head;
+        archive->blocks = block;
+    }
+    return block->data;
+}
+
+// Like a FileView, data[length] is '\0' and length is the member's size
+static int add_member(Archive *archive, const char *name, const char *data, size_t length) {
+    if (archive->members->count >= archive->capacity) {
+        int capacity = archive->capacity ? archive->capacity * 2 : 64;
+        const char **grown_data = realloc(archive->data, sizeof(char*) * capacity);
+        if (grown_data) archive->data = grown_data;
+        size_t *grown_lengths = realloc(archive->lengths, sizeof(size_t) * capacity);
+        if (grown_lengths) archive->lengths = grown_lengths;
+        if (!grown_data || !grown_lengths) return 0;
+        archive->capacity = capacity;
+    }
+
+    int i = archive->members->count;
+    if (!appendFilePath(archive->members, name)) return 0;
+    archive->data[i] = data;
+    archive->lengths[i] = length;
+    archive->bytes += (long long)archive->lengths[i];
+    return 1;
+}
+
+// ---------------------------------------------------------------- crc32 --
+
+static uint32_t crc_table[256];
+static pthread_once_t crc_once = PTHREAD_ONCE_INIT;
+
+static void build_crc_table(void) {
+    for (uint32_t n = 0; n < 256; n++) {
+        uint32_t c = n;
+        for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        crc_table[n] = c;
+    }
+}
+
+static uint32_t crc32_of(const unsigned char *data, size_t length) {
+    uint32_t c = 0xFFFFFFFFu;
+    for (size_t i = 0; i < length; i++) c = crc_table[(c ^ data[i]) & 0xFF] ^ (c >> 8);
+    return c ^ 0xFFFFFFFFu;
+}
+
+// -------------------------------------------------------------- inflate --
+
+// Raw DEFLATE (RFC 1951) into a buffer of known size. Codes up to
+// FAST_BITS long resolve with one table lookup; longer ones walk the
+// canonical code counts bit by bit.
+#define FAST_BITS 9
+
+typedef struct {
+    unsigned short count[16];
+    unsigned short symbol[288];
+    unsigned short fast[1 << FAST_BITS];   // (symbol << 4) | length; 0 = slow path
+} Huffman;
+
+typedef struct {
+    const unsigned char *in;
+    size_t in_length;
+    size_t in_pos;
+    uint64_t bit_buffer;
+    int bit_count;
+    unsigned char *out;
+    size_t out_length;
+    size_t out_pos;
+} Inflater;
+
+static const unsigned short length_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const unsigned char length_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const unsigned short dist_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const unsigned char dist_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+static void refill(Inflater *s) {
+    while (s->bit_count <= 56 && s->in_pos < s->in_length) {
+        s->bit_buffer |= (uint64_t)s->in[s->in_pos++] << s->bit_count;
+        s->bit_count += 8;
+    }
+}
+
+// Returns -1 when the input runs out
+static int get_bits(Inflater *s, int need) {
+    if (s->bit_count < need) refill(s);
+    if (s->bit_count < need) return -1;
+    int value = (int)(s->bit_buffer & ((1u << need) - 1));
+    s->bit_buffer >>= need;
+    s->bit_count -= need;
+    return value;
+}
+
+static int build_huffman(Huffman *h, const unsigned char *lengths, int n) {
+    unsigned short offsets[16], next_code[16];
+    memset(h->count, 0, sizeof(h->count));
+    memset(h->fast, 0, sizeof(h->fast));
+    for (int i = 0; i < n; i++) h->count[lengths[i]]++;
+
+    // Over-subscribed code sets are corrupt; incomplete ones are allowed
+    // (a distance code with one or no symbols is legal)
+    int left = 1;
+    for (int len = 1; len < 16; len++) {
+        left = (left << 1) - h->count[len];
+        if (left < 0) return 0;
+    }
+
+    offsets[1] = 0;
+    next_code[1] = 0;
+    for (int len = 1; len < 15; len++) {
+        offsets[len + 1] = offsets[len] + h->count[len];
+        next_code[len + 1] = (unsigned short)((next_code[len] + h->count[len]) << 1);
+    }
+
+    for (int sym = 0; sym < n; sym++) {
+        int len = lengths[sym];
+        if (len == 0) continue;
+        h->symbol[offsets[len]++] = (unsigned short)sym;
+
+        unsigned code = next_code[len]++;
+        if (len > FAST_BITS) continue;
+        // The stream packs codes from their first bit, so index reversed
+        unsigned reversed = 0;
+        for (int b = 0; b < len; b++) reversed |= ((code >> b) & 1u) << (len - 1 - b);
+        for (unsigned idx = reversed; idx < (1u << FAST_BITS); idx += 1u << len) {
+            h->fast[idx] = (unsigned short)((sym << 4) | len);
+        }
+    }
+    return 1;
+}
+
+static int decode_symbol(Inflater *s, const Huffman *h) {
+    refill(s);
+    unsigned entry = h->fast[s->bit_buffer & ((1u << FAST_BITS) - 1)];
+    if (entry) {
+        int len = (int)(entry & 15);
+        if (len > s->bit_count) return -1;
+        s->bit_buffer >>= len;
+        s->bit_count -= len;
+        return (int)(entry >> 4);
+    }
+
+    int code = 0, first = 0, index = 0;
+    for (int len = 1; len < 16; len++) {
+        code |= (int)((s->bit_buffer >> (len - 1)) & 1);
+        int count = h->count[len];
+        if (code - count < first) {
+            if (len > s->bit_count) return -1;
+            s->bit_buffer >>= len;
+            s->bit_count -= len;
+            return h->symbol[index + (code - first)];
+        }
+        index += count;
+        first = (first + count) << 1;
+        code <<= 1;
+    }
+    return -1;
+}
+
+static int inflate_stored(Inflater *s) {
+    // Drop to a byte boundary, then hand whole buffered bytes back
+    s->bit_buffer >>= s->bit_count & 7;
+    s->bit_count -= s->bit_count & 7;
+    s->in_pos -= (size_t)(s->bit_count / 8);
+    s->bit_buffer = 0;
+    s->bit_count = 0;
+
+    if (s->in_length - s->in_pos < 4) return 0;
+    const unsigned char *p = s->in + s->in_pos;
+    unsigned length = p[0] | (p[1] << 8);
+    unsigned complement = p[2] | (p[3] << 8);
+    if (length != (~complement & 0xFFFFu)) return 0;
+    s->in_pos += 4;
+
+    if (s->in_length - s->in_pos < length || s->out_length - s->out_pos < length) return 0;
+    memcpy(s->out + s->out_pos, s->in + s->in_pos, length);
+    s->in_pos += length;
+    s->out_pos += length;
+    return 1;
+}
+
+static int inflate_codes(Inflater *s, const Huffman *lengths, const Huffman *distances) {
+    for (;;) {
+        int sym = decode_symbol(s, lengths);
+        if (sym < 0) return 0;
+        if (sym < 256) {
+            if (s->out_pos >= s->out_length) return 0;
+            s->out[s->out_pos++] = (unsigned char)sym;
+            continue;
+        }
+        if (sym == 256) return 1;
+
+        sym -= 257;
+        if (sym >= 29) return 0;
+        int extra = get_bits(s, length_extra[sym]);
+        if (extra < 0) return 0;
+        size_t length = length_base[sym] + (size_t)extra;
+
+        sym = decode_symbol(s, distances);
+        if (sym < 0 || sym >= 30) return 0;
+        extra = get_bits(s, dist_extra[sym]);
+        if (extra < 0) return 0;
+        size_t distance = dist_base[sym] + (size_t)extra;
+
+        if (distance > s->out_pos || length > s->out_length - s->out_pos) return 0;
+        // Byte by byte: the source may overlap what is being written
+        unsigned char *to = s->out + s->out_pos;
+        const unsigned char *from = to - distance;
+        for (size_t i = 0; i < length; i++) to[i] = from[i];
+        s->out_pos += length;
+    }
+}
+
+static int inflate_fixed(Inflater *s) {
+    unsigned char lengths[288 + 30];
+    int sym = 0;
+    for (; sym < 144; sym++) lengths[sym] = 8;
+    for (; sym < 256; sym++) lengths[sym] = 9;
+    for (; sym < 280; sym++) lengths[sym] = 7;
+    for (; sym < 288; sym++) lengths[sym] = 8;
+    for (; sym < 288 + 30; sym++) lengths[sym] = 5;
+
+    Huffman literal, distance;
+    build_huffman(&literal, lengths, 288);
+    build_huffman(&distance, lengths + 288, 30);
+    return inflate_codes(s, &literal, &distance);
+}
+
+static int inflate_dynamic(Inflater *s) {
+    static const unsigned char order[19] = {
+        16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+    };
+    int literal_count = get_bits(s, 5);
+    int distance_count = get_bits(s, 5);
+    int code_count = get_bits(s, 4);
+    if (literal_count < 0 || distance_count < 0 || code_count < 0) return 0;
+    literal_count += 257;
+    distance_count += 1;
+    code_count += 4;
+    if (literal_count > 286 || distance_count > 30) return 0;
+
+    unsigned char lengths[288 + 30];
+    memset(lengths, 0, sizeof(lengths));
+    for (int i = 0; i < code_count; i++) {
+        int len = get_bits(s, 3);
+        if (len < 0) return 0;
+        lengths[order[i]] = (unsigned char)len;
+    }
+
+    Huffman literal, distance;
+    if (!build_huffman(&literal, lengths, 19)) return 0;
+
+    int total = literal_count + distance_count;
+    for (int i = 0; i < total; ) {
+        int sym = decode_symbol(s, &literal);
+        if (sym < 0) return 0;
+        if (sym < 16) {
+            lengths[i++] = (unsigned char)sym;
+            continue;
+        }
+
+        int repeat, value = 0;
+        if (sym == 16) {
+            if (i == 0) return 0;
+            value = lengths[i - 1];
+            repeat = get_bits(s, 2);
+            if (repeat >= 0) repeat += 3;
+        } else if (sym == 17) {
+            repeat = get_bits(s, 3);
+            if (repeat >= 0) repeat += 3;
+        } else {
+            repeat = get_bits(s, 7);
+            if (repeat >= 0) repeat += 11;
+        }
+        if (repeat < 0 || i + repeat > total) return 0;
+        while (repeat--) lengths[i++] = (unsigned char)value;
+    }
+
+    // Every block needs an end-of-block code
+    if (lengths[256] == 0) return 0;
+    if (!build_huffman(&literal, lengths, literal_count)) return 0;
+    if (!build_huffman(&distance, lengths + literal_count, distance_count)) return 0;
+    return inflate_codes(s, &literal, &distance);
+}
+
+// Returns 1 when the stream is well formed and fills out exactly
+static int inflate_raw(const unsigned char *in, size_t in_length, unsigned char *out, size_t out_length) {
+    Inflater s = {in, in_length, 0, 0, 0, out, out_length, 0};
+    int last;
+    do {
+        last = get_bits(&s, 1);
+        int type = get_bits(&s, 2);
+        if (last < 0 || type < 0) return 0;
+
+        int ok = 0;
+        if (type == 0) ok = inflate_stored(&s);
+        else if (type == 1) ok = inflate_fixed(&s);
+        else if (type == 2) ok = inflate_dynamic(&s);
+        if (!ok) return 0;
+    } while (!last);
+    return s.out_pos == out_length;
+}
+
+// ------------------------------------------------------------------ zip --
+
+#define ZIP_LOCAL_SIG 0x04034b50u
+#define ZIP_CENTRAL_SIG 0x02014b50u
+#define ZIP_END_SIG 0x06054b50u
+
+enum { ZIP_PENDING, ZIP_OK, ZIP_BAD_DATA, ZIP_BAD_CRC };
+
+typedef struct {
+    const unsigned char *name;
+    int name_length;
+    const unsigned char *payload;
+    size_t local;          // offset of the local header
+    size_t compressed;
+    size_t size;
+    int method;
+    uint32_t crc;
+    char *out;
+    int status;
+} ZipEntry;
+
+typedef struct {
+    ZipEntry *entries;
+} ZipJob;
+
+static unsigned read16(const unsigned char *p) {
+    return (unsigned)p[0] | ((unsigned)p[1] << 8);
+}
+
+static uint32_t read32(const unsigned char *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void zip_name(const ZipEntry *entry, char *name) {
+    memcpy(name, entry->name, (size_t)entry->name_length);
+    name[entry->name_length] = '\0';
+}
+
+static void inflate_chunk(void *ctx, int begin, int end, int worker) {
+    ZipJob *job = (ZipJob*)ctx;
+    (void)worker;
+
+    for (int i = begin; i < end; i++) {
+        ZipEntry *entry = &job->entries[i];
+        unsigned char *out = (unsigned char*)entry->out;
+        int ok;
+        if (entry->method == 0) {
+            ok = entry->compressed == entry->size;
+            if (ok) memcpy(out, entry->payload, entry->size);
+        } else {
+            ok = inflate_raw(entry->payload, entry->compressed, out, entry->size);
+        }
+        out[entry->size] = '\0';
+
+        if (!ok) entry->status = ZIP_BAD_DATA;
+        else if (crc32_of(out, entry->size) != entry->crc) entry->status = ZIP_BAD_CRC;
+        else entry->status = ZIP_OK;
+    }
+}
+
+static int compare_local_offsets(const void *a, const void *b) {
+    size_t x = ((const ZipEntry*)a)->local;
+    size_t y = ((const ZipEntry*)b)->local;
+    return (x > y) - (x < y);
+}
+
+// Each member must own its local header and payload; central entries that
+// point into each other's bytes are how zip bombs multiply a small input
+static int zip_entries_overlap(const unsigned char *zip, const ZipEntry *entries, int count) {
+    ZipEntry *sorted = malloc(sizeof(ZipEntry) * (count > 0 ? count : 1));
+    if (!sorted) return 1;
+    memcpy(sorted, entries, sizeof(ZipEntry) * count);
+    qsort(sorted, count, sizeof(ZipEntry), compare_local_offsets);
+
+    int overlap = 0;
+    for (int i = 1; !overlap && i < count; i++) {
+        size_t previous_end = (size_t)(sorted[i - 1].payload - zip) + sorted[i - 1].compressed;
+        overlap = sorted[i].local < previous_end;
+    }
+    free(sorted);
+    return overlap;
+}
+
+// Sizes come from the central directory, so every output buffer is
+// allocated before any member is inflated and the members inflate in
+// parallel
+static int zip_read(Archive *archive, const unsigned char *zip, size_t length,
+                    const ExtensionFilter *filter, int thread_count) {
+    if (length < 22) return 0;
+    size_t end = length - 22;
+    for (;;) {
+        if (read32(zip + end) == ZIP_END_SIG) break;
+        if (end == 0 || length - 22 - end >= 0xFFFF) {
+            LOG_ERROR(LOG_IO, "No zip end-of-central-directory record\n");
+            return 0;
+        }
+        end--;
+    }
+
+    unsigned total = read16(zip + end + 10);
+    uint32_t directory_size = read32(zip + end + 12);
+    uint32_t directory_offset = read32(zip + end + 16);
+    if (total == 0xFFFF || directory_offset == 0xFFFFFFFFu) {
+        LOG_ERROR(LOG_IO, "ZIP64 archives are not supported\n");
+        return 0;
+    }
+    if ((size_t)directory_offset + directory_size > end) {
+        LOG_ERROR(LOG_IO, "Corrupt zip central directory\n");
+        return 0;
+    }
+
+    ZipEntry *entries = calloc(total > 0 ? total : 1, sizeof(ZipEntry));
+    double *costs = malloc(sizeof(double) * (total > 0 ? total : 1));
+    if (!entries || !costs) {
+        free(entries);
+        free(costs);
+        return 0;
+    }
+
+    char name[MAX_PATH_LENGTH];
+    int count = 0;
+    unsigned long long expanded = 0;
+    const char *fatal = NULL;
+    size_t p = directory_offset;
+    size_t directory_end = (size_t)directory_offset + directory_size;
+    for (unsigned i = 0; !fatal && i < total; i++) {
+        if (directory_end - p < 46 || read32(zip + p) != ZIP_CENTRAL_SIG) {
+            fatal = "Corrupt zip central directory";
+            break;
+        }
+        const unsigned char *header = zip + p;
+        unsigned name_length = read16(header + 28);
+        size_t next = p + 46 + name_length + read16(header + 30) + read16(header + 32);
+        if (next > directory_end) {
+            fatal = "Corrupt zip central directory";
+            break;
+        }
+        p = next;
+
+        // Directories end in '/'; long names could not be listed anyway
+        if (name_length == 0 || name_length >= MAX_PATH_LENGTH || header[46 + name_length - 1] == '/') {
+            continue;
+        }
+        ZipEntry *entry = &entries[count];
+        entry->name = header + 46;
+        entry->name_length = (int)name_length;
+        zip_name(entry, name);
+        if (!matchesExtension(name, filter)) continue;
+
+        unsigned flags = read16(header + 8);
+        entry->method = (int)read16(header + 10);
+        entry->crc = read32(header + 16);
+        uint32_t compressed = read32(header + 20);
+        uint32_t size = read32(header + 24);
+        uint32_t local = read32(header + 42);
+
+        const char *problem = NULL;
+        if (flags & 1) problem = "encrypted";
+        else if (entry->method != 0 && entry->method != 8) problem = "unsupported compression method";
+        else if (compressed == 0xFFFFFFFFu || size == 0xFFFFFFFFu || local == 0xFFFFFFFFu) problem = "ZIP64 entry";
+        else if (size > ARCHIVE_MAX_MEMBER) problem = "too large";
+        else if ((size_t)local + 30 > length || read32(zip + local) != ZIP_LOCAL_SIG) problem = "bad local header";
+        if (!problem) {
+            size_t payload = (size_t)local + 30 + read16(zip + local + 26) + read16(zip + local + 28);
+            if (payload > length || length - payload < compressed) problem = "truncated";
+            else entry->payload = zip + payload;
+        }
+        if (!problem && count >= ARCHIVE_MAX_MEMBERS) {
+            fatal = "Zip archive has too many members";
+            break;
+        }
+        if (!problem && expanded + size > ARCHIVE_MAX_TOTAL) {
+            fatal = "Zip archive expands past the total size limit";
+            break;
+        }
+        if (problem) {
+            LOG_WARN(LOG_IO, "Skipping zip member %s: %s\n", name, problem);
+            archive->skipped++;
+            continue;
+        }
+
+        entry->local = local;
+        entry->compressed = compressed;
+        entry->size = size;
+        expanded += size;
+        costs[count] = (double)size + 1.0;
+        count++;
+    }
+    if (!fatal && zip_entries_overlap(zip, entries, count)) fatal = "Zip members overlap";
+    if (fatal) {
+        LOG_ERROR(LOG_IO, "%s\n", fatal);
+        free(entries);
+        free(costs);
+        return 0;
+    }
+
+    // Output buffers wait until the whole directory has been accepted
+    int kept = 0;
+    for (int i = 0; i < count; i++) {
+        entries[i].out = arena_alloc(archive, entries[i].size + 1);
+        if (!entries[i].out) {
+            zip_name(&entries[i], name);
+            LOG_WARN(LOG_IO, "Skipping zip member %s: out of memory\n", name);
+            archive->skipped++;
+            continue;
+        }
+        costs[kept] = costs[i];
+        entries[kept++] = entries[i];
+    }
+    count = kept;
+
+    pthread_once(&crc_once, build_crc_table);
+    int chunk_count = 0;
+    TaskChunk *chunks = split_into_chunks(costs, count, thread_count * 8, &chunk_count);
+    ZipJob job = {entries};
+    run_work_stealing(chunks, chunk_count, thread_count, inflate_chunk, &job);
+    free(chunks);
+    free(costs);
+
+    int ok = 1;
+    for (int i = 0; ok && i < count; i++) {
+        zip_name(&entries[i], name);
+        if (entries[i].status == ZIP_OK) {
+            ok = add_member(archive, name, entries[i].out, entries[i].size);
+            continue;
+        }
+        LOG_WARN(LOG_IO, "Skipping zip member %s: %s\n", name,
+                 entries[i].status == ZIP_BAD_CRC ? "CRC mismatch" : "corrupt data");
+        archive->skipped++;
+    }
+    free(entries);
+    return ok;
+}
+
+// ------------------------------------------------------------------ tar --
+
+// Bytes already sniffed from the front of the stream are replayed first
+typedef struct {
+    FILE *file;
+    const unsigned char *pending;
+    size_t pending_length;
+    int seekable;
+} Stream;
+
+static size_t stream_read(Stream *s, void *buffer, size_t length) {
+    size_t got = 0;
+    if (s->pending_length > 0) {
+        got = length < s->pending_length ? length : s->pending_length;
+        memcpy(buffer, s->pending, got);
+        s->pending += got;
+        s->pending_length -= got;
+    }
+    if (got < length) got += fread((char*)buffer + got, 1, length - got, s->file);
+    return got;
+}
+
+static int stream_skip(Stream *s, unsigned long long length) {
+    if (s->pending_length == 0 && s->seekable && length <= LONG_MAX &&
+        fseek(s->file, (long)length, SEEK_CUR) == 0) {
+        return 1;
+    }
+    char scratch[16384];
+    while (length > 0) {
+        size_t step = length < sizeof(scratch) ? (size_t)length : sizeof(scratch);
+        if (stream_read(s, scratch, step) != step) return 0;
+        length -= step;
+    }
+    return 1;
+}
+
+static unsigned long long parse_octal(const unsigned char *field, int width) {
+    unsigned long long value = 0;
+    int i = 0;
+    while (i < width && field[i] == ' ') i++;
+    for (; i < width && field[i] >= '0' && field[i] <= '7'; i++) value = value * 8 + (field[i] - '0');
+    return value;
+}
+
+// GNU tar writes sizes past 8 GiB in base 256 behind a high-bit flag
+static unsigned long long tar_size(const unsigned char *header) {
+    if (!(header[124] & 0x80)) return parse_octal(header + 124, 12);
+    unsigned long long value = 0;
+    for (int i = 125; i < 136; i++) value = (value << 8) | header[i];
+    return value;
+}
+
+static int tar_checksum_ok(const unsigned char *header) {
+    unsigned long sum = 0;
+    for (int i = 0; i < 512; i++) sum += (i >= 148 && i < 156) ? ' ' : header[i];
+    return sum == parse_octal(header + 148, 8);
+}
+
+// Picks "path=" out of a pax extended header ("<len> key=value\n" records)
+static int pax_path(const char *records, size_t length, char *name) {
+    size_t p = 0;
+    while (p < length) {
+        size_t record = 0, q = p;
+        while (q < length && records[q] >= '0' && records[q] <= '9') record = record * 10 + (records[q++] - '0');
+        if (record == 0 || q >= length || records[q] != ' ' || record > length - p) return 0;
+        const char *key = records + q + 1;
+        size_t key_length = p + record - (q + 1);
+        if (key_length > 5 && memcmp(key, "path=", 5) == 0) {
+            size_t value_length = key_length - 5 - (key[key_length - 1] == '\n');
+            if (value_length == 0 || value_length >= MAX_PATH_LENGTH) return 0;
+            memcpy(name, key + 5, value_length);
+            name[value_length] = '\0';
+            return 1;
+        }
+        p += record;
+    }
+    return 0;
+}
+
+static size_t field_length(const unsigned char *field, size_t width) {
+    size_t n = 0;
+    while (n < width && field[n]) n++;
+    return n;
+}
+
+// Streams 512-byte headers so a pipe works as well as a file; only the
+// members kept are buffered
+static int tar_read(Archive *archive, Stream *s, const ExtensionFilter *filter) {
+    unsigned char header[512];
+    char name[MAX_PATH_LENGTH];
+    char long_name[MAX_PATH_LENGTH];
+    int have_long_name = 0;
+    int first = 1;
+    unsigned long long expanded = 0;
+
+    for (;;) {
+        size_t got = stream_read(s, header, sizeof(header));
+        if (got == 0 && !first) break;
+        if (got < sizeof(header)) {
+            LOG_ERROR(LOG_IO, "Truncated tar archive\n");
+            return !first;
+        }
+
+        int zero = 1;
+        for (int i = 0; zero && i < 512; i++) zero = header[i] == 0;
+        if (zero) break;
+        if (!tar_checksum_ok(header)) {
+            if (first) LOG_ERROR(LOG_IO, "Not a zip or tar archive\n");
+            else LOG_ERROR(LOG_IO, "Corrupt tar header\n");
+            return !first;
+        }
+        first = 0;
+
+        unsigned long long size = tar_size(header);
+        unsigned long long padding = (512 - size % 512) % 512;
+        char type = (char)header[156];
+
+        // GNU long names and pax headers rename the member that follows
+        if ((type == 'L' || type == 'x') && size < 65536) {
+            char *meta = malloc((size_t)size + 1);
+            if (!meta || stream_read(s, meta, (size_t)size) != size || !stream_skip(s, padding)) {
+                free(meta);
+                LOG_ERROR(LOG_IO, "Truncated tar archive\n");
+                return 1;
+            }
+            meta[size] = '\0';
+            if (type == 'L') {
+                size_t n = field_length((unsigned char*)meta, (size_t)size);
+                have_long_name = n > 0 && n < MAX_PATH_LENGTH;
+                if (have_long_name) memcpy(long_name, meta, n + 1);
+            } else {
+                have_long_name = pax_path(meta, (size_t)size, long_name);
+            }
+            free(meta);
+            continue;
+        }
+
+        if (have_long_name) {
+            memcpy(name, long_name, strlen(long_name) + 1);
+        } else {
+            int name_length = (int)field_length(header, 100);
+            int prefix_length = memcmp(header + 257, "ustar", 5) == 0 ? (int)field_length(header + 345, 155) : 0;
+            if (prefix_length > 0) {
+                snprintf(name, sizeof(name), "%.*s/%.*s", prefix_length, (const char*)header + 345,
+                         name_length, (const char*)header);
+            } else {
+                snprintf(name, sizeof(name), "%.*s", name_length, (const char*)header);
+            }
+        }
+        have_long_name = 0;
+
+        int regular = type == '0' || type == '\0' || type == '7';
+        if (!regular || !matchesExtension(name, filter)) {
+            if (!stream_skip(s, size + padding)) {
+                LOG_ERROR(LOG_IO, "Truncated tar archive\n");
+                return 1;
+            }
+            continue;
+        }
+
+        if (archive->members->count >= ARCHIVE_MAX_MEMBERS) {
+            LOG_ERROR(LOG_IO, "Tar archive has too many members\n");
+            return 0;
+        }
+        if (size <= ARCHIVE_MAX_MEMBER && expanded + size > ARCHIVE_MAX_TOTAL) {
+            LOG_ERROR(LOG_IO, "Tar archive expands past the total size limit\n");
+            return 0;
+        }
+        char *data = size <= ARCHIVE_MAX_MEMBER ? arena_alloc(archive, (size_t)size + 1) : NULL;
+        if (!data) {
+            LOG_WARN(LOG_IO, "Skipping tar member %s: %s\n", name,
+                     size > ARCHIVE_MAX_MEMBER ? "too large" : "out of memory");
+            archive->skipped++;
+            if (!stream_skip(s, size + padding)) return 1;
+            continue;
+        }
+        if (stream_read(s, data, (size_t)size) != size || !stream_skip(s, padding)) {
+            LOG_ERROR(LOG_IO, "Truncated tar archive\n");
+            archive->skipped++;
+            return 1;
+        }
+        data[size] = '\0';
+        expanded += size;
+        if (!add_member(archive, name, data, (size_t)size)) return 0;
+    }
+    return 1;
+}
+
+// ----------------------------------------------------------------- open --
+
+int archive_detect(const char *path) {
+    if (strcmp(path, "-") == 0) return 1;
+    size_t len = strlen(path);
+    if (len < 4) return 0;
+    char ext[5];
+    for (int i = 0; i < 4; i++) ext[i] = (char)tolower((unsigned char)path[len - 4 + i]);
+    ext[4] = '\0';
+    return strcmp(ext, ".zip") == 0 || strcmp(ext, ".tar") == 0;
+}
+
+// Zip needs random access to its central directory, so the whole archive
+// is buffered; the sniffed head is already in hand
+static unsigned char* read_all(FILE *in, const unsigned char *head, size_t head_length, size_t *length) {
+    size_t capacity = 1u << 20, used = head_length;
+    unsigned char *buffer = malloc(capacity);
+    if (!buffer) return NULL;
+    memcpy(buffer, head, head_length);
+
+    for (;;) {
+        if (used == capacity) {
+            unsigned char *grown = realloc(buffer, capacity * 2);
+            if (!grown) {
+                free(buffer);
+                return NULL;
+            }
+            buffer = grown;
+            capacity *= 2;
+        }
+        size_t got = fread(buffer + used, 1, capacity - used, in);
+        if (got == 0) break;
+        used += got;
+    }
+    *length = used;
+    return buffer;
+}
+
+Archive* archive_open(const char *path, const ExtensionFilter *filter, int thread_count) {
+    double start = now_seconds();
+    Archive *archive = calloc(1, sizeof(Archive));
+    if (!archive || !(archive->members = createFileList())) {
+        free(archive);
+        return NULL;
+    }
+
+    int from_stdin = strcmp(path, "-") == 0;
+    FILE *in = stdin;
+    if (from_stdin) {
+#ifdef _WIN32
+        _setmode(_fileno(stdin), _O_BINARY);
+#endif
+    } else if (!(in = fopen(path, "rb"))) {
+        LOG_ERROR(LOG_IO, "Cannot open archive: %s\n", path);
+        archive_free(archive);
+        return NULL;
+    }
+
+    unsigned char head[512];
+    size_t got = fread(head, 1, sizeof(head), in);
+    int ok;
+    if (got >= 4 && head[0] == 'P' && head[1] == 'K' && (head[2] == 3 || head[2] == 5)) {
+        size_t length = 0;
+        unsigned char *zip = read_all(in, head, got, &length);
+        archive->format = "zip";
+        ok = zip && zip_read(archive, zip, length, filter, thread_count);
+        free(zip);
+    } else if (got >= 2 && head[0] == 0x1f && head[1] == 0x8b) {
+        LOG_ERROR(LOG_IO, "Compressed tar streams are not supported; decompress first: %s\n", path);
+        ok = 0;
+    } else {
+        Stream stream = {in, head, got, !from_stdin};
+        archive->format = "tar";
+        ok = tar_read(archive, &stream, filter);
+    }
+    if (!from_stdin) fclose(in);
+
+    if (!ok) {
+        archive_free(archive);
+        return NULL;
+    }
+    archive->seconds = now_seconds() - start;
+    LOG_INFO(LOG_IO, "Read %d %s members (%lld bytes, %d skipped) in %.3f s from %s\n",
+             archive->members->count, archive->format, archive->bytes, archive->skipped,
+             archive->seconds, path);
+    return archive;
+}
+
+void archive_free(Archive *archive) {
+    if (!archive) return;
+    ArchiveBlock *block = archive->blocks;
+    while (block) {
+        ArchiveBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    freeFileList(archive->members);
+    free(archive->data);
+    free(archive->lengths);
+    free(archive);
+}
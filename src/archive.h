@@ -0,0 +1,43 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <stddef.h>
+#include "directory_handler.h"
+
+// Submissions packed as .zip or .tar are analysed straight from memory:
+// every member that passes the extension filter is inflated (or copied)
+// into an arena buffer and nothing is extracted to disk. "-" reads the
+// archive from stdin; a leading "PK" means zip, anything else is streamed
+// as tar. Zip members are stored or deflated; encrypted and ZIP64 entries
+// are skipped, and zips whose members share bytes are refused.
+
+// Larger members are skipped with a warning
+#define ARCHIVE_MAX_MEMBER (64u << 20)
+// Archives that would expand past either limit are rejected outright, so
+// a small zip cannot claim gigabytes or millions of members
+#define ARCHIVE_MAX_TOTAL (1ull << 30)
+#define ARCHIVE_MAX_MEMBERS 16384
+
+typedef struct ArchiveBlock ArchiveBlock;
+
+typedef struct {
+    FileList *members;     // member names, in archive order
+    const char **data;     // data[i][lengths[i]] is '\0', like a FileView
+    size_t *lengths;
+    int capacity;
+    int skipped;           // matching members that could not be read
+    long long bytes;
+    double seconds;
+    const char *format;    // "zip" or "tar"
+    ArchiveBlock *blocks;
+} Archive;
+
+// 1 for "-" and for paths ending in .zip or .tar
+int archive_detect(const char *path);
+
+// Reads every matching member; zip members are inflated on thread_count
+// workers. Returns NULL if the archive cannot be read at all.
+Archive* archive_open(const char *path, const ExtensionFilter *filter, int thread_count);
+void archive_free(Archive *archive);
+
+#endif
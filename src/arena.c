@@ -0,0 +1,92 @@
+#include "arena.h"
+#include <stdlib.h>
+#include <stdint.h>
+
+// Blocks start small so thousands of resident artifacts stay cheap, and
+// double up to ARENA_MAX_BLOCK as a tree grows
+#define ARENA_FIRST_BLOCK 4096
+#define ARENA_MAX_BLOCK (256 * 1024)
+#define ARENA_ALIGN 16
+
+struct ArenaBlock {
+    ArenaBlock *next;
+    size_t size;
+    size_t used;
+    char *data;
+};
+
+static size_t align_up(size_t n) {
+    return (n + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+static ArenaBlock* new_block(Arena *arena, size_t size) {
+    size_t block_size = arena->next_size ? arena->next_size : ARENA_FIRST_BLOCK;
+    if (block_size < size) block_size = align_up(size);
+    
+    ArenaBlock *block = malloc(align_up(sizeof(ArenaBlock)) + block_size);
+    if (!block) return NULL;
+    block->next = NULL;
+    block->size = block_size;
+    block->used = 0;
+    block->data = (char*)block + align_up(sizeof(ArenaBlock));
+    
+    if (arena->next_size < ARENA_MAX_BLOCK) {
+        arena->next_size = block_size * 2 < ARENA_MAX_BLOCK ? block_size * 2 : ARENA_MAX_BLOCK;
+    }
+    return block;
+}
+
+void* arena_alloc(Arena *arena, size_t size) {
+    size = align_up(size ? size : 1);
+    ArenaBlock *block = arena->current;
+    
+    // After a reset, later blocks are reused in order; one too small for
+    // this request is passed over until the next reset
+    while (block && block->size - block->used < size) {
+        if (!block->next) break;
+        block = block->next;
+        block->used = 0;
+        arena->current = block;
+    }
+    
+    if (!block || block->size - block->used < size) {
+        ArenaBlock *fresh = new_block(arena, size);
+        if (!fresh) return NULL;
+        if (block) {
+            block->next = fresh;
+        } else {
+            arena->first = fresh;
+        }
+        arena->current = block = fresh;
+    }
+    
+    void *p = block->data + block->used;
+    block->used += size;
+    return p;
+}
+
+void arena_reset(Arena *arena) {
+    arena->current = arena->first;
+    if (arena->first) arena->first->used = 0;
+}
+
+void arena_release(Arena *arena) {
+    ArenaBlock *block = arena->first;
+    while (block) {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->first = NULL;
+    arena->current = NULL;
+    arena->next_size = 0;
+}
+
+size_t arena_used(const Arena *arena) {
+    size_t used = 0;
+    for (ArenaBlock *block = arena->first; block; block = block->next) {
+        used += block->used;
+        if (block == arena->current) break;
+    }
+    return used;
+}
@@ -0,0 +1,27 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// Bump allocator for tree and graph nodes. Allocation is a pointer bump
+// inside a chain of blocks; nothing is freed individually. arena_reset
+// rewinds to the first block and keeps every block for reuse, so a
+// reset-and-rebuild cycle stops calling malloc once the blocks cover the
+// largest input. A zeroed Arena is ready to use.
+typedef struct ArenaBlock ArenaBlock;
+
+typedef struct {
+    ArenaBlock *first;
+    ArenaBlock *current;
+    size_t next_size;     // size of the next block to allocate
+} Arena;
+
+// Memory is aligned for any node type and not zeroed
+void* arena_alloc(Arena *arena, size_t size);
+void arena_reset(Arena *arena);
+void arena_release(Arena *arena);
+
+// Bytes handed out since the last reset
+size_t arena_used(const Arena *arena);
+
+#endif
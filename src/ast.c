@@ -1,81 +1,240 @@
 #include "ast.h"
+#include "log.h"
+#include "symbol.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 
-ASTNode* create_node(NodeType type, const char *value) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+ASTNode* create_node(Arena *arena, NodeType type, int symbol) {
+    ASTNode *node = arena_alloc(arena, sizeof(ASTNode));
     if (!node) return NULL;
     
     node->type = type;
-    if (value) {
-        strncpy(node->value, value, 127);
-        node->value[127] = '\0';
-    } else {
-        node->value[0] = '\0';
-    }
+    node->symbol = symbol;
     
-    node->child_capacity = 8;
-    node->children = malloc(sizeof(ASTNode*) * node->child_capacity);
-    if (!node->children) {
-        free(node);
-        return NULL;
-    }
+    // Leaves never get a child array; most inner nodes fit the first one
+    node->children = NULL;
     node->child_count = 0;
+    node->child_capacity = 0;
+    node->span = NULL;
     
     return node;
 }
 
-void add_child(ASTNode *parent, ASTNode *child) {
+void add_child(Arena *arena, ASTNode *parent, ASTNode *child) {
     if (!parent || !child) return;
     
     if (parent->child_count >= parent->child_capacity) {
-        parent->child_capacity *= 2;
-        ASTNode **new_children = realloc(parent->children, 
-                                        sizeof(ASTNode*) * parent->child_capacity);
+        // The old array stays in the arena until it is reset
+        int capacity = parent->child_capacity ? parent->child_capacity * 2 : 4;
+        ASTNode **new_children = arena_alloc(arena, sizeof(ASTNode*) * capacity);
         if (!new_children) {
-            fprintf(stderr, "Memory reallocation failed\n");
+            LOG_ERROR(LOG_PARSER, "Memory reallocation failed\n");
             return;
         }
+        if (parent->child_count > 0) {
+            memcpy(new_children, parent->children, sizeof(ASTNode*) * parent->child_count);
+        }
         parent->children = new_children;
+        parent->child_capacity = capacity;
     }
     
     parent->children[parent->child_count++] = child;
 }
 
-void free_ast(ASTNode *node) {
-    if (!node) return;
-    
-    for (int i = 0; i < node->child_count; i++) {
-        free_ast(node->children[i]);
+typedef struct {
+    void *data;
+    size_t capacity;
+} WalkBuffer;
+
+static pthread_key_t walk_key;
+static pthread_once_t walk_once = PTHREAD_ONCE_INIT;
+
+static void release_walk_buffer(void *buffer) {
+    free(((WalkBuffer*)buffer)->data);
+    free(buffer);
+}
+
+static void create_walk_key(void) {
+    pthread_key_create(&walk_key, release_walk_buffer);
+}
+
+void* walk_buffer(size_t bytes) {
+    pthread_once(&walk_once, create_walk_key);
+    WalkBuffer *buffer = pthread_getspecific(walk_key);
+    if (!buffer) {
+        buffer = calloc(1, sizeof(WalkBuffer));
+        if (!buffer) return NULL;
+        if (pthread_setspecific(walk_key, buffer) != 0) {
+            free(buffer);
+            return NULL;
+        }
     }
     
-    if (node->children) free(node->children);
-    free(node);
+    if (bytes > buffer->capacity) {
+        size_t capacity = buffer->capacity ? buffer->capacity : 4096;
+        while (capacity < bytes) capacity *= 2;
+        void *grown = realloc(buffer->data, capacity);
+        if (!grown) return NULL;
+        buffer->data = grown;
+        buffer->capacity = capacity;
+    }
+    return buffer->data;
 }
 
 int count_nodes(ASTNode *node) {
     if (!node) return 0;
     
-    int count = 1;
-    for (int i = 0; i < node->child_count; i++) {
-        count += count_nodes(node->children[i]);
+    // Pending inner nodes; each pop counts its children and pushes the
+    // ones that have children of their own, so leaves are never stacked
+    int capacity = 256;
+    ASTNode **stack = walk_buffer(sizeof(ASTNode*) * capacity);
+    if (!stack) return 0;
+    
+    int top = 0, count = 1;
+    stack[top++] = node;
+    while (top > 0) {
+        ASTNode *current = stack[--top];
+        count += current->child_count;
+        if (top + current->child_count > capacity) {
+            while (top + current->child_count > capacity) capacity *= 2;
+            stack = walk_buffer(sizeof(ASTNode*) * capacity);
+            if (!stack) return 0;
+        }
+        for (int i = 0; i < current->child_count; i++) {
+            if (current->children[i]->child_count > 0) stack[top++] = current->children[i];
+        }
     }
     return count;
 }
 
-ASTNode* clone_ast(ASTNode *node) {
-    if (!node) return NULL;
+static uint64_t mix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+static int is_commutative(int symbol) {
+    switch (symbol) {
+        case SYM_PLUS:
+        case SYM_STAR:
+        case SYM_EQ:
+        case SYM_NE:
+        case SYM_AND:
+        case SYM_OR:
+        case SYM_AMP:
+        case SYM_PIPE:
+        case SYM_CARET:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+// Children of index are already hashed. Values enter through
+// symbol_hash, which depends only on the spelling, so hashes are stable
+// across runs and can be persisted.
+static uint64_t hash_node(const FlatAST *ast, int index) {
+    FlatNode node = ast->nodes[index];
+    int end = index + (int)node.size;
+    uint64_t hash = mix64(((uint64_t)symbol_hash(FLAT_SYMBOL(node)) << 8) ^
+                          (uint64_t)FLAT_TYPE(node));
     
-    ASTNode *clone = create_node(node->type, node->value);
-    if (!clone) return NULL;
+    if (FLAT_TYPE(node) == NODE_BINOP && is_commutative(FLAT_SYMBOL(node))) {
+        // A sum of mixed hashes ignores order, and unlike XOR equal
+        // operands do not cancel out
+        uint64_t operands = 0;
+        for (int c = index + 1; c < end; c += ast->nodes[c].size) {
+            operands += mix64(ast->hashes[c]);
+        }
+        return mix64(hash ^ operands);
+    }
+    
+    for (int c = index + 1; c < end; c += ast->nodes[c].size) {
+        hash = mix64(hash ^ ast->hashes[c]);
+    }
+    return hash;
+}
+
+// One open node of the built tree while it is copied out in preorder
+typedef struct {
+    ASTNode *node;
+    int next_child;
+    int index;
+} FlattenFrame;
+
+FlatAST* flatten_ast(ASTNode *root, Arena *arena) {
+    if (!root) return NULL;
     
-    for (int i = 0; i < node->child_count; i++) {
-        ASTNode *child_clone = clone_ast(node->children[i]);
-        if (child_clone) {
-            add_child(clone, child_clone);
+    FlatAST *ast = arena_alloc(arena, sizeof(FlatAST));
+    if (!ast) return NULL;
+    
+    ast->count = count_nodes(root);
+    ast->nodes = arena_alloc(arena, sizeof(FlatNode) * ast->count);
+    ast->hashes = arena_alloc(arena, sizeof(uint64_t) * ast->count);
+    if (ast->count == 0 || !ast->nodes || !ast->hashes) return NULL;
+    
+    // A node's size and hash are known once its last child is closed;
+    // the stack never holds more frames than there are nodes
+    FlattenFrame *stack = walk_buffer(sizeof(FlattenFrame) * ast->count);
+    if (!stack) return NULL;
+    
+    int top = 0, pos = 0;
+    ast->nodes[pos].tag = (uint32_t)root->type | ((uint32_t)root->symbol << FLAT_TYPE_BITS);
+    stack[top++] = (FlattenFrame){root, 0, pos++};
+    
+    while (top > 0) {
+        FlattenFrame *frame = &stack[top - 1];
+        if (frame->next_child < frame->node->child_count) {
+            ASTNode *child = frame->node->children[frame->next_child++];
+            ast->nodes[pos].tag = (uint32_t)child->type | ((uint32_t)child->symbol << FLAT_TYPE_BITS);
+            stack[top++] = (FlattenFrame){child, 0, pos++};
+        } else {
+            ast->nodes[frame->index].size = (uint32_t)(pos - frame->index);
+            ast->hashes[frame->index] = hash_node(ast, frame->index);
+            top--;
         }
     }
+    return ast;
+}
+
+FlatAST* join_flat_asts(NodeType type, int symbol, FlatAST *const *parts, int count,
+                        Arena *arena) {
+    FlatAST *ast = arena_alloc(arena, sizeof(FlatAST));
+    if (!ast) return NULL;
+    
+    ast->count = 1;
+    for (int k = 0; k < count; k++) ast->count += parts[k]->count;
+    ast->nodes = arena_alloc(arena, sizeof(FlatNode) * ast->count);
+    ast->hashes = arena_alloc(arena, sizeof(uint64_t) * ast->count);
+    if (!ast->nodes || !ast->hashes) return NULL;
     
-    return clone;
-}
\ No newline at end of file
+    // Subtree sizes are relative, so each part is copied as it is
+    int pos = 1;
+    for (int k = 0; k < count; k++) {
+        memcpy(ast->nodes + pos, parts[k]->nodes, sizeof(FlatNode) * parts[k]->count);
+        memcpy(ast->hashes + pos, parts[k]->hashes, sizeof(uint64_t) * parts[k]->count);
+        pos += parts[k]->count;
+    }
+    ast->nodes[0].tag = (uint32_t)type | ((uint32_t)symbol << FLAT_TYPE_BITS);
+    ast->nodes[0].size = (uint32_t)ast->count;
+    ast->hashes[0] = hash_node(ast, 0);
+    return ast;
+}
+
+int flat_child_count(const FlatAST *ast, int index) {
+    int count = 0;
+    int end = index + (int)ast->nodes[index].size;
+    for (int c = index + 1; c < end; c += ast->nodes[c].size) count++;
+    return count;
+}
+
+int flat_child(const FlatAST *ast, int index, int k) {
+    int end = index + (int)ast->nodes[index].size;
+    for (int c = index + 1; c < end; c += ast->nodes[c].size) {
+        if (k-- == 0) return c;
+    }
+    return -1;
+}
@@ -1,6 +1,9 @@
 #ifndef AST_H
 #define AST_H
 
+#include <stdint.h>
+#include "arena.h"
+
 typedef enum {
     NODE_PROGRAM,
     NODE_IF,
@@ -17,21 +20,79 @@ typedef enum {
     NODE_RETURN,
     NODE_BREAK,
     NODE_CONTINUE,
-    NODE_BLOCK
+    NODE_BLOCK,
+    NODE_UNOP,          // prefix, postfix or cast; value is the operator or type
+    NODE_TERNARY,
+    NODE_CALL,          // value is the function name, or '(' for other callees
+    NODE_FUNCTION       // definition; value is its name, the child its body
 } NodeType;
 
+// Where a function definition was found, in tokens and in source bytes
+// from the start of its return type to its closing brace
+typedef struct {
+    int arity;
+    int first_token;
+    int token_count;
+    int offset;
+    int length;
+} FunctionSpan;
+
+// Tree as the parser and normalizer build it. It only lives in a scratch
+// arena until it is flattened
 typedef struct ASTNode {
     NodeType type;
-    char value[128];
+    int symbol;                  // interned value, see symbol.h
     struct ASTNode **children;
     int child_count;
     int child_capacity;
+    const FunctionSpan *span;    // NODE_FUNCTION from the parser, else NULL
 } ASTNode;
 
-ASTNode* create_node(NodeType type, const char *value);
-void add_child(ASTNode *parent, ASTNode *child);
-void free_ast(ASTNode *node);
+// Tree as it is kept for comparison: one array in preorder, 8 bytes per
+// node. The children of node i start at i + 1 and each one is skipped by
+// its subtree size, so walks are index arithmetic over a single block.
+typedef struct {
+    uint32_t tag;                // NodeType in the low 8 bits, symbol above
+    uint32_t size;               // nodes in this subtree, itself included
+} FlatNode;
+
+// hashes[i] is a Merkle hash of the subtree at i over types, values and
+// shape, so equal hashes mean identical subtrees. Operands of commutative
+// operators are hashed as a multiset: a + b and b + a hash the same.
+typedef struct {
+    FlatNode *nodes;
+    uint64_t *hashes;
+    int count;
+} FlatAST;
+
+#define FLAT_TYPE_BITS 8
+#define FLAT_TYPE(node) ((NodeType)((node).tag & ((1u << FLAT_TYPE_BITS) - 1)))
+#define FLAT_SYMBOL(node) ((int)((node).tag >> FLAT_TYPE_BITS))
+
+// Nodes and child arrays live in the arena they were created in and are
+// released with it; there is no per-node free
+ASTNode* create_node(Arena *arena, NodeType type, int symbol);
+void add_child(Arena *arena, ASTNode *parent, ASTNode *child);
 int count_nodes(ASTNode *node);
-ASTNode* clone_ast(ASTNode *node);
+
+// Memory for the explicit stacks of tree walks, so no walk recurses once
+// per nesting level. Each thread has one buffer that only grows and keeps
+// its contents when it does; a walk must not start another walk while it
+// holds it. NULL if it cannot grow to bytes.
+void* walk_buffer(size_t bytes);
+
+// Copies a built tree into arena in flat form, hashing every subtree
+// bottom-up on the way
+FlatAST* flatten_ast(ASTNode *root, Arena *arena);
+
+// Builds in arena the tree with a root of type and symbol whose children
+// are the given trees in order, hashed as flatten_ast would hash it
+FlatAST* join_flat_asts(NodeType type, int symbol, FlatAST *const *parts, int count,
+                        Arena *arena);
+
+// Number of children of node index, and the index of its k-th child
+// (or -1); both walk the sibling chain
+int flat_child_count(const FlatAST *ast, int index);
+int flat_child(const FlatAST *ast, int index, int k);
 
 #endif
\ No newline at end of file
@@ -1,38 +1,57 @@
 #include "cfg.h"
 #include "utils.h"
+#include "log.h"
 #include <stdlib.h>
+#include <string.h>
 
-static int node_id = 0;
+typedef struct CFGNode {
+    int id;
+    NodeType type;
+    struct CFGNode **successors;
+    int successor_count;
+    int successor_capacity;
+} CFGNode;
 
-static CFGNode* create_cfg_node(NodeType type) {
-    CFGNode *node = malloc(sizeof(CFGNode));
+// Graph of one statement while it is built; only its summary is kept
+typedef struct {
+    Arena *arena;         // owns the graph, its nodes and their arrays
+    CFGNode **nodes;
+    int node_count;
+    int node_capacity;
+    int next_id;
+} ControlFlowGraph;
+
+// Everything below lives in cfg->arena; outgrown arrays are copied and
+// the old ones left behind until the arena goes
+static CFGNode* create_cfg_node(ControlFlowGraph *cfg, NodeType type) {
+    CFGNode *node = arena_alloc(cfg->arena, sizeof(CFGNode));
     if (!node) return NULL;
     
-    node->id = node_id++;
+    node->id = cfg->next_id++;
     node->type = type;
-    node->successor_capacity = 8;
-    node->successors = malloc(sizeof(CFGNode*) * node->successor_capacity);
-    if (!node->successors) {
-        free(node);
-        return NULL;
-    }
+    node->successor_capacity = 0;
+    node->successors = NULL;
     node->successor_count = 0;
     return node;
 }
 
-static void add_successor(CFGNode *from, CFGNode *to) {
+static void add_successor(ControlFlowGraph *cfg, CFGNode *from, CFGNode *to) {
     if (!from || !to) return;
     
     for (int i = 0; i < from->successor_count; i++) {
         if (from->successors[i] == to) return;
     }
     
+    // Branches have two successors, straight-line nodes one
     if (from->successor_count >= from->successor_capacity) {
-        from->successor_capacity *= 2;
-        CFGNode **new_successors = realloc(from->successors,
-                                          sizeof(CFGNode*) * from->successor_capacity);
+        int capacity = from->successor_capacity ? from->successor_capacity * 2 : 2;
+        CFGNode **new_successors = arena_alloc(cfg->arena, sizeof(CFGNode*) * capacity);
         if (!new_successors) return;
+        if (from->successor_count > 0) {
+            memcpy(new_successors, from->successors, sizeof(CFGNode*) * from->successor_count);
+        }
         from->successors = new_successors;
+        from->successor_capacity = capacity;
     }
     
     from->successors[from->successor_count++] = to;
@@ -42,164 +61,266 @@ static void add_node_to_cfg(ControlFlowGraph *cfg, CFGNode *node) {
     if (!cfg || !node) return;
     
     if (cfg->node_count >= cfg->node_capacity) {
-        cfg->node_capacity *= 2;
-        CFGNode **new_nodes = realloc(cfg->nodes, 
-                                     sizeof(CFGNode*) * cfg->node_capacity);
+        int capacity = cfg->node_capacity * 2;
+        CFGNode **new_nodes = arena_alloc(cfg->arena, sizeof(CFGNode*) * capacity);
         if (!new_nodes) return;
+        memcpy(new_nodes, cfg->nodes, sizeof(CFGNode*) * cfg->node_count);
         cfg->nodes = new_nodes;
+        cfg->node_capacity = capacity;
     }
     
     cfg->nodes[cfg->node_count++] = node;
 }
 
-static CFGNode* process_node(ASTNode *node, CFGNode *current, ControlFlowGraph *cfg);
+// Statements with no nested statements become at most one node and are
+// lowered in place; only IF, WHILE, BLOCK and FUNCTION need a frame
+static int is_compound(NodeType type) {
+    return type == NODE_IF || type == NODE_WHILE || type == NODE_BLOCK ||
+           type == NODE_FUNCTION;
+}
 
-static CFGNode* process_node(ASTNode *node, CFGNode *current, ControlFlowGraph *cfg) {
-    if (!node || !current || !cfg) return current;
-    
-    switch (node->type) {
-        case NODE_ASSIGN: {
-            CFGNode *assign = create_cfg_node(NODE_ASSIGN);
-            if (!assign) return current;
-            add_successor(current, assign);
-            add_node_to_cfg(cfg, assign);
-            return assign;
-        }
+static CFGNode* lower_simple(ControlFlowGraph *cfg, NodeType type, CFGNode *current) {
+    if (type != NODE_ASSIGN && type != NODE_RETURN) return current;
+    
+    CFGNode *node = create_cfg_node(cfg, type);
+    if (!node) return current;
+    add_successor(cfg, current, node);
+    add_node_to_cfg(cfg, node);
+    return node;
+}
+
+// One compound statement being lowered. It stays on the stack while its
+// parts are processed; phase says which part comes next
+typedef struct {
+    int index;
+    int phase;
+    int next_child;       // BLOCK: next statement
+    CFGNode *current;     // node control arrives from
+    CFGNode *head;        // IF: condition, WHILE: loop node
+    CFGNode *merge;       // IF: join point
+} CFGFrame;
+
+// Lowers the statement at index, entered from current, and returns the
+// node control leaves it from. A nested compound statement is pushed as a
+// frame and its exit comes back to the parent in result; a missing or
+// simple part is lowered at once into result.
+static CFGNode* process_node(const FlatAST *ast, int index, CFGNode *current,
+                             ControlFlowGraph *cfg, CFGFrame *stack) {
+    NodeType type = FLAT_TYPE(ast->nodes[index]);
+    if (!is_compound(type)) return lower_simple(cfg, type, current);
+    
+    int top = 0;
+    CFGNode *result = current;
+    stack[top++] = (CFGFrame){index, 0, index + 1, current, NULL, NULL};
+    
+    while (top > 0) {
+        CFGFrame *f = &stack[top - 1];
+        int part = -1;
+        CFGNode *from = NULL;
         
-        case NODE_IF: {
-            CFGNode *cond = create_cfg_node(NODE_IF);
-            if (!cond) return current;
-            add_successor(current, cond);
-            add_node_to_cfg(cfg, cond);
-            
-            CFGNode *merge = create_cfg_node(NODE_BLOCK);
-            if (!merge) return current;
-            add_node_to_cfg(cfg, merge);
-            
-            CFGNode *then_end = cond;
-            if (node->child_count > 1) {
-                then_end = process_node(node->children[1], cond, cfg);
-            }
-            add_successor(then_end, merge);
-            
-            if (node->child_count > 2) {
-                CFGNode *else_end = process_node(node->children[2], cond, cfg);
-                add_successor(else_end, merge);
-            } else {
-                add_successor(cond, merge);
+        switch (FLAT_TYPE(ast->nodes[f->index])) {
+            case NODE_IF: {
+                // IF structure: child[0]=condition, child[1]=then, child[2]=else
+                if (f->phase == 0) {
+                    f->head = create_cfg_node(cfg, NODE_IF);
+                    if (!f->head) {
+                        result = f->current;
+                        top--;
+                        break;
+                    }
+                    add_successor(cfg, f->current, f->head);
+                    add_node_to_cfg(cfg, f->head);
+                    
+                    f->merge = create_cfg_node(cfg, NODE_BLOCK);
+                    if (!f->merge) {
+                        result = f->current;
+                        top--;
+                        break;
+                    }
+                    add_node_to_cfg(cfg, f->merge);
+                    
+                    f->phase = 1;
+                    part = flat_child(ast, f->index, 1);
+                    from = f->head;
+                    result = f->head;
+                } else if (f->phase == 1) {
+                    add_successor(cfg, result, f->merge);
+                    f->phase = 2;
+                    part = flat_child(ast, f->index, 2);
+                    if (part >= 0) {
+                        from = f->head;
+                    } else {
+                        add_successor(cfg, f->head, f->merge);
+                        result = f->merge;
+                        top--;
+                    }
+                } else {
+                    add_successor(cfg, result, f->merge);
+                    result = f->merge;
+                    top--;
+                }
+                break;
             }
             
-            return merge;
-        }
-        
-        case NODE_WHILE: {
-            CFGNode *loop = create_cfg_node(NODE_WHILE);
-            if (!loop) return current;
-            add_successor(current, loop);
-            add_node_to_cfg(cfg, loop);
-            
-            // WHILE structure: child[0]=condition, child[1]=body
-            CFGNode *body_end = loop;
-            if (node->child_count > 1 && node->children[1]) {
-                body_end = process_node(node->children[1], loop, cfg);
+            case NODE_WHILE: {
+                // WHILE structure: child[0]=condition, child[1]=body
+                if (f->phase == 0) {
+                    f->head = create_cfg_node(cfg, NODE_WHILE);
+                    if (!f->head) {
+                        result = f->current;
+                        top--;
+                        break;
+                    }
+                    add_successor(cfg, f->current, f->head);
+                    add_node_to_cfg(cfg, f->head);
+                    
+                    f->phase = 1;
+                    part = flat_child(ast, f->index, 1);
+                    from = f->head;
+                    result = f->head;
+                } else {
+                    // Back edge: body loops to condition
+                    add_successor(cfg, result, f->head);
+                    
+                    // Exit edge: loop exits after condition fails
+                    CFGNode *exit = create_cfg_node(cfg, NODE_BLOCK);
+                    result = f->current;
+                    if (exit) {
+                        add_successor(cfg, f->head, exit);
+                        add_node_to_cfg(cfg, exit);
+                        result = exit;
+                    }
+                    top--;
+                }
+                break;
             }
             
-            // Back edge: body loops to condition
-            add_successor(body_end, loop);
-            
-            // Exit edge: loop exits after condition fails
-            CFGNode *exit = create_cfg_node(NODE_BLOCK);
-            if (!exit) return current;
-            add_successor(loop, exit);
-            add_node_to_cfg(cfg, exit);
-            
-            return exit;
-        }
-        
-        case NODE_BLOCK: {
-            CFGNode *prev = current;
-            for (int i = 0; i < node->child_count; i++) {
-                prev = process_node(node->children[i], prev, cfg);
+            default: {
+                // BLOCK or FUNCTION: current runs along the statements;
+                // each one's exit is the next one's entry
+                int end = f->index + (int)ast->nodes[f->index].size;
+                if (f->phase == 0) {
+                    f->phase = 1;
+                } else {
+                    f->current = result;
+                }
+                while (f->next_child < end) {
+                    int child = f->next_child;
+                    f->next_child += ast->nodes[child].size;
+                    NodeType child_type = FLAT_TYPE(ast->nodes[child]);
+                    if (is_compound(child_type)) {
+                        part = child;
+                        from = f->current;
+                        break;
+                    }
+                    f->current = lower_simple(cfg, child_type, f->current);
+                }
+                if (part < 0) {
+                    result = f->current;
+                    top--;
+                }
+                break;
             }
-            return prev;
         }
         
-        case NODE_RETURN: {
-            CFGNode *ret = create_cfg_node(NODE_RETURN);
-            if (!ret) return current;
-            add_successor(current, ret);
-            add_node_to_cfg(cfg, ret);
-            return ret;
+        if (part < 0) continue;
+        NodeType part_type = FLAT_TYPE(ast->nodes[part]);
+        if (is_compound(part_type)) {
+            stack[top++] = (CFGFrame){part, 0, part + 1, from, NULL, NULL};
+        } else {
+            result = lower_simple(cfg, part_type, from);
         }
-        
-        default:
-            return current;
     }
+    
+    return result;
 }
 
-ControlFlowGraph* build_cfg(ASTNode *ast) {
-    if (!ast) return NULL;
-    
-    node_id = 0;
-    
-    ControlFlowGraph *cfg = malloc(sizeof(ControlFlowGraph));
+static ControlFlowGraph* create_cfg(Arena *arena) {
+    ControlFlowGraph *cfg = arena_alloc(arena, sizeof(ControlFlowGraph));
     if (!cfg) return NULL;
     
-    cfg->node_capacity = 100;
-    cfg->nodes = malloc(sizeof(CFGNode*) * cfg->node_capacity);
-    if (!cfg->nodes) {
-        free(cfg);
-        return NULL;
-    }
+    cfg->arena = arena;
+    cfg->node_capacity = 64;
+    cfg->nodes = arena_alloc(arena, sizeof(CFGNode*) * cfg->node_capacity);
+    if (!cfg->nodes) return NULL;
     cfg->node_count = 0;
+    cfg->next_id = 0;
+    return cfg;
+}
+
+int build_cfg_fragment(const FlatAST *ast, Arena *arena, CFGFragment *fragment) {
+    fragment->nodes = NULL;
+    fragment->count = 0;
+    fragment->exit = -1;
+    if (!ast || ast->count == 0) return 1;
     
-    CFGNode *entry = create_cfg_node(NODE_PROGRAM);
-    if (!entry) {
-        free(cfg->nodes);
-        free(cfg);
-        return NULL;
-    }
-    add_node_to_cfg(cfg, entry);
+    ControlFlowGraph *cfg = create_cfg(arena);
+    if (!cfg) return 0;
     
-    CFGNode *current = entry;
-    for (int i = 0; i < ast->child_count; i++) {
-        current = process_node(ast->children[i], current, cfg);
-    }
+    // Stands in for whatever precedes the statement and is not part of
+    // the fragment; only the statement's first node is entered from it
+    CFGNode *entry = create_cfg_node(cfg, NODE_PROGRAM);
+    CFGFrame *stack = walk_buffer(sizeof(CFGFrame) * ast->count);
+    if (!entry || !stack) return 0;
     
-    CFGNode *exit = create_cfg_node(NODE_PROGRAM);
-    if (exit) {
-        add_node_to_cfg(cfg, exit);
-        add_successor(current, exit);
-    }
+    CFGNode *exit = process_node(ast, 0, entry, cfg, stack);
+    if (cfg->node_count == 0) return 1;
     
-    return cfg;
+    fragment->nodes = arena_alloc(arena, sizeof(CFGSummaryNode) * cfg->node_count);
+    if (!fragment->nodes) return 0;
+    for (int i = 0; i < cfg->node_count; i++) {
+        fragment->nodes[i].type = cfg->nodes[i]->type;
+        fragment->nodes[i].successor_count = cfg->nodes[i]->successor_count;
+        if (cfg->nodes[i] == exit) fragment->exit = i;
+    }
+    fragment->count = cfg->node_count;
+    return 1;
 }
 
-void free_cfg(ControlFlowGraph *cfg) {
-    if (!cfg) return;
+CFGSummaryNode* join_cfg_fragments(const CFGFragment *fragments, int count,
+                                   Arena *arena, int *node_count) {
+    *node_count = 0;
+    int total = 2;
+    for (int k = 0; k < count; k++) total += fragments[k].count;
     
-    for (int i = 0; i < cfg->node_count; i++) {
-        if (cfg->nodes[i]) {
-            if (cfg->nodes[i]->successors) free(cfg->nodes[i]->successors);
-            free(cfg->nodes[i]);
-        }
+    CFGSummaryNode *nodes = arena_alloc(arena, sizeof(CFGSummaryNode) * total);
+    if (!nodes) return NULL;
+    
+    // Entry, each fragment entered from the exit of the last one that
+    // had nodes, then the program's exit
+    nodes[0].type = NODE_PROGRAM;
+    nodes[0].successor_count = 0;
+    int pos = 1, current = 0;
+    for (int k = 0; k < count; k++) {
+        const CFGFragment *f = &fragments[k];
+        if (f->count == 0) continue;
+        memcpy(nodes + pos, f->nodes, sizeof(CFGSummaryNode) * f->count);
+        nodes[current].successor_count++;
+        if (f->exit >= 0) current = pos + f->exit;
+        pos += f->count;
     }
+    nodes[pos].type = NODE_PROGRAM;
+    nodes[pos].successor_count = 0;
+    nodes[current].successor_count++;
     
-    if (cfg->nodes) free(cfg->nodes);
-    free(cfg);
+    *node_count = pos + 1;
+    return nodes;
 }
 
-double compare_cfg(ControlFlowGraph *cfg1, ControlFlowGraph *cfg2) {
-    if (!cfg1 || !cfg2 || cfg1->node_count == 0 || cfg2->node_count == 0) {
+// Nodes are compared by position: their types, then how many successors
+// each has
+double compare_cfg_summary(const CFGSummaryNode *n1, int count1,
+                           const CFGSummaryNode *n2, int count2) {
+    if (!n1 || !n2 || count1 == 0 || count2 == 0) {
         return 0.0;
     }
     
     int matches = 0;
-    int min_count = min_int(cfg1->node_count, cfg2->node_count);
-    int max_count = max_int(cfg1->node_count, cfg2->node_count);
+    int min_count = min_int(count1, count2);
+    int max_count = max_int(count1, count2);
     
     for (int i = 0; i < min_count; i++) {
-        if (cfg1->nodes[i]->type == cfg2->nodes[i]->type) {
+        if (n1[i].type == n2[i].type) {
             matches++;
         }
     }
@@ -210,10 +331,8 @@ double compare_cfg(ControlFlowGraph *cfg1, ControlFlowGraph *cfg2) {
     int total_edges = 0;
     
     for (int i = 0; i < min_count; i++) {
-        int s1 = cfg1->nodes[i]->successor_count;
-        int s2 = cfg2->nodes[i]->successor_count;
-        total_edges += max_int(s1, s2);
-        edge_matches += min_int(s1, s2);
+        total_edges += max_int(n1[i].successor_count, n2[i].successor_count);
+        edge_matches += min_int(n1[i].successor_count, n2[i].successor_count);
     }
     
     double edge_sim = (total_edges > 0) ? (double)edge_matches / total_edges : 0.0;
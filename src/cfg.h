@@ -3,22 +3,32 @@
 
 #include "ast.h"
 
-typedef struct CFGNode {
-    int id;
-    NodeType type;
-    struct CFGNode **successors;
+// The parts of a CFG node compare_cfg_summary looks at, flat for on-disk
+// storage
+typedef struct {
+    int type;
     int successor_count;
-    int successor_capacity;
-} CFGNode;
+} CFGSummaryNode;
 
+// CFG of one top-level statement in summary form: its nodes in the order
+// they are built, and the one control leaves it from (-1 if it
+// lowers to no nodes). The edge into its first node is left out.
 typedef struct {
-    CFGNode **nodes;
-    int node_count;
-    int node_capacity;
-} ControlFlowGraph;
+    CFGSummaryNode *nodes;
+    int count;
+    int exit;
+} CFGFragment;
+
+// Fragment of the statement at the root of ast; the graph and the
+// summaries go to arena. Returns 0 if allocation failed.
+int build_cfg_fragment(const FlatAST *ast, Arena *arena, CFGFragment *fragment);
 
-ControlFlowGraph* build_cfg(ASTNode *ast);
-void free_cfg(ControlFlowGraph *cfg);
-double compare_cfg(ControlFlowGraph *cfg1, ControlFlowGraph *cfg2);
+// Summaries of the CFG of a program made of these statements in order,
+// entered from a PROGRAM node and left to another, so a file's CFG can be
+// built one statement at a time
+CFGSummaryNode* join_cfg_fragments(const CFGFragment *fragments, int count,
+                                   Arena *arena, int *node_count);
+double compare_cfg_summary(const CFGSummaryNode *n1, int count1,
+                           const CFGSummaryNode *n2, int count2);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,505 @@
+#ifndef _WIN32
+    #define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "corpus.h"
+#include "utils.h"
+#include "log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#define ALIGN8(n) (((n) + 7) & ~(size_t)7)
+
+static const void* record_section(const CorpusRecord *record, uint32_t offset) {
+    return (const unsigned char*)record + offset;
+}
+
+const CorpusRecord* corpus_record(const Corpus *corpus, int index) {
+    if (!corpus || index < 0 || index >= corpus->record_count) return NULL;
+    return (const CorpusRecord*)(corpus->base + corpus->offsets[index]);
+}
+
+const char* corpus_record_path(const CorpusRecord *record) {
+    return (const char*)record_section(record, record->path_offset);
+}
+
+int corpus_record_is_stale(const CorpusRecord *record) {
+    return record->engine_version != ENGINE_VERSION;
+}
+
+int corpus_record_is_live(const CorpusRecord *record) {
+    return !(record->flags & RECORD_SUPERSEDED) && !corpus_record_is_stale(record);
+}
+
+static int write_empty_corpus(const char *path) {
+    FILE *file = fopen(path, "wb");
+    if (!file) return 0;
+    
+    CorpusHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CORPUS_MAGIC, 8);
+    header.format_version = CORPUS_FORMAT_VERSION;
+    header.byte_order = CORPUS_BYTE_ORDER;
+    header.data_end = sizeof(CorpusHeader);
+    header.engine_version = ENGINE_VERSION;
+    
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    fclose(file);
+    return ok;
+}
+
+static int map_file(Corpus *corpus) {
+#ifdef _WIN32
+    // No mmap here: read the file once into one buffer with the same layout
+    FILE *file = fopen(corpus->path, "rb");
+    if (!file) return 0;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size <= 0) {
+        fclose(file);
+        return 0;
+    }
+    corpus->base = malloc(size);
+    if (!corpus->base || fread(corpus->base, 1, size, file) != (size_t)size) {
+        free(corpus->base);
+        corpus->base = NULL;
+        fclose(file);
+        return 0;
+    }
+    fclose(file);
+    corpus->mapped_size = size;
+    corpus->mapped = 0;
+    return 1;
+#else
+    int fd = open(corpus->path, O_RDONLY);
+    if (fd < 0) return 0;
+    
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return 0;
+    }
+    
+    void *base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return 0;
+    
+    corpus->base = base;
+    corpus->mapped_size = st.st_size;
+    corpus->mapped = 1;
+    return 1;
+#endif
+}
+
+static void unmap_file(Corpus *corpus) {
+    if (!corpus->base) return;
+#ifdef _WIN32
+    free(corpus->base);
+#else
+    if (corpus->mapped) munmap(corpus->base, corpus->mapped_size);
+    else free(corpus->base);
+#endif
+    corpus->base = NULL;
+}
+
+Corpus* corpus_open(const char *path) {
+    if (!path) return NULL;
+    
+    FILE *probe = fopen(path, "rb");
+    if (probe) {
+        fclose(probe);
+    } else if (!write_empty_corpus(path)) {
+        LOG_ERROR(LOG_IO, "Cannot create corpus: %s\n", path);
+        return NULL;
+    }
+    
+    Corpus *corpus = calloc(1, sizeof(Corpus));
+    if (!corpus) return NULL;
+    corpus->path = malloc(strlen(path) + 1);
+    if (!corpus->path) {
+        free(corpus);
+        return NULL;
+    }
+    strcpy(corpus->path, path);
+    
+    if (!map_file(corpus)) {
+        LOG_ERROR(LOG_IO, "Cannot map corpus: %s\n", path);
+        corpus_close(corpus);
+        return NULL;
+    }
+    
+    const CorpusHeader *header = (const CorpusHeader*)corpus->base;
+    if (corpus->mapped_size < sizeof(CorpusHeader) ||
+        memcmp(header->magic, CORPUS_MAGIC, 8) != 0 ||
+        header->byte_order != CORPUS_BYTE_ORDER ||
+        header->format_version != CORPUS_FORMAT_VERSION ||
+        header->data_end > corpus->mapped_size) {
+        LOG_ERROR(LOG_IO, "Not a corpus file (or unsupported format): %s\n", path);
+        corpus_close(corpus);
+        return NULL;
+    }
+    
+    // Only the record offsets are collected; record contents stay in the map
+    corpus->offsets = malloc(sizeof(uint64_t) * (header->record_count > 0 ? header->record_count : 1));
+    if (!corpus->offsets) {
+        corpus_close(corpus);
+        return NULL;
+    }
+    
+    uint64_t offset = sizeof(CorpusHeader);
+    for (uint64_t i = 0; i < header->record_count; i++) {
+        if (offset + sizeof(CorpusRecord) > header->data_end) break;
+        const CorpusRecord *record = (const CorpusRecord*)(corpus->base + offset);
+        if (record->record_size < sizeof(CorpusRecord) ||
+            offset + record->record_size > header->data_end) {
+            LOG_WARN(LOG_IO, "Corpus truncated after %d records: %s\n", corpus->record_count, path);
+            break;
+        }
+        corpus->offsets[corpus->record_count++] = offset;
+        offset += record->record_size;
+    }
+    
+    return corpus;
+}
+
+void corpus_close(Corpus *corpus) {
+    if (!corpus) return;
+    unmap_file(corpus);
+    free(corpus->offsets);
+    free(corpus->path);
+    free(corpus);
+}
+
+int corpus_find_path(const Corpus *corpus, const char *path) {
+    if (!corpus || !path) return -1;
+    
+    for (int i = 0; i < corpus->record_count; i++) {
+        const CorpusRecord *record = corpus_record(corpus, i);
+        if (corpus_record_is_live(record) && strcmp(corpus_record_path(record), path) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+CorpusRecord* corpus_encode_artifact(const FileArtifact *artifact, const char *path) {
+    if (!artifact || !path) return NULL;
+    
+    int ok = artifact->status == ARTIFACT_OK;
+    uint32_t ast_count = ok ? (uint32_t)artifact->normalized->count : 0;
+    uint32_t cfg_count = ok ? (uint32_t)artifact->cfg_count : 0;
+    uint32_t dag_count = ok ? (uint32_t)artifact->dag_count : 0;
+    uint32_t fp_count = artifact->fingerprints ? (uint32_t)artifact->fingerprints->count : 0;
+    uint32_t path_length = (uint32_t)strlen(path);
+    
+    size_t size = ALIGN8(sizeof(CorpusRecord));
+    uint32_t path_offset = size;  size += ALIGN8(path_length + 1);
+    uint32_t ast_offset = size;   size += ALIGN8(sizeof(FlatASTEntry) * ast_count);
+    uint32_t cfg_offset = size;   size += ALIGN8(sizeof(CFGSummaryNode) * cfg_count);
+    uint32_t dag_offset = size;   size += ALIGN8(sizeof(DAGSummaryNode) * dag_count);
+    uint32_t fp_offset = size;    size += ALIGN8(sizeof(uint64_t) * fp_count);
+    
+    unsigned char *buffer = calloc(1, size);
+    if (!buffer) return NULL;
+    
+    CorpusRecord *record = (CorpusRecord*)buffer;
+    record->record_size = size;
+    record->content_hash = artifact->code ? content_hash64(artifact->code, artifact->code_length) : 0;
+    record->code_length = artifact->code_length;
+    record->engine_version = ENGINE_VERSION;
+    record->status = artifact->status;
+    record->total_nodes = artifact->total_nodes;
+    record->path_offset = path_offset;
+    record->path_length = path_length;
+    record->ast_offset = ast_offset;
+    record->ast_count = ast_count;
+    record->cfg_offset = cfg_offset;
+    record->cfg_count = cfg_count;
+    record->dag_offset = dag_offset;
+    record->dag_count = dag_count;
+    record->fp_offset = fp_offset;
+    record->fp_count = fp_count;
+    
+    memcpy(buffer + path_offset, path, path_length + 1);
+    
+    // Same preorder layout as the in-memory tree, minus the values
+    FlatASTEntry *ast_nodes = (FlatASTEntry*)(buffer + ast_offset);
+    for (uint32_t i = 0; i < ast_count; i++) {
+        ast_nodes[i].hash = artifact->normalized->hashes[i];
+        ast_nodes[i].type = FLAT_TYPE(artifact->normalized->nodes[i]);
+        ast_nodes[i].size = (int32_t)artifact->normalized->nodes[i].size;
+    }
+    
+    // The artifact already holds the CFG and DAG as summaries
+    if (cfg_count > 0) {
+        memcpy(buffer + cfg_offset, artifact->cfg, sizeof(CFGSummaryNode) * cfg_count);
+    }
+    if (dag_count > 0) {
+        memcpy(buffer + dag_offset, artifact->dag, sizeof(DAGSummaryNode) * dag_count);
+    }
+    
+    if (fp_count > 0) {
+        memcpy(buffer + fp_offset, artifact->fingerprints->hashes, sizeof(uint64_t) * fp_count);
+    }
+    
+    return record;
+}
+
+// tree_edit_distance from detector.c over the stored preorder arrays:
+// positionally paired subtrees come off an explicit stack, -1 marks a
+// missing side
+typedef struct {
+    int i;
+    int j;
+} EntryPair;
+
+static int flat_edit_distance(const FlatASTEntry *t1, int count1,
+                              const FlatASTEntry *t2, int count2) {
+    EntryPair *stack = walk_buffer(sizeof(EntryPair) * (count1 + count2));
+    if (!stack) return max_int(count1, count2);
+    
+    int top = 0;
+    int cost = 0;
+    stack[top++] = (EntryPair){0, 0};
+    
+    while (top > 0) {
+        EntryPair pair = stack[--top];
+        int i = pair.i, j = pair.j;
+        if (i < 0) {
+            cost += t2[j].size;
+            continue;
+        }
+        if (j < 0) {
+            cost += t1[i].size;
+            continue;
+        }
+        if (t1[i].hash == t2[j].hash) continue;
+        
+        cost += (t1[i].type == t2[j].type) ? 0 : 1;
+        
+        int c1 = i + 1, end1 = i + t1[i].size;
+        int c2 = j + 1, end2 = j + t2[j].size;
+        while (c1 < end1 || c2 < end2) {
+            int more1 = c1 < end1, more2 = c2 < end2;
+            stack[top++] = (EntryPair){more1 ? c1 : -1, more2 ? c2 : -1};
+            if (more1) c1 += t1[c1].size;
+            if (more2) c2 += t2[c2].size;
+        }
+    }
+    return cost;
+}
+
+static double flat_ast_similarity(const FlatASTEntry *t1, int count1,
+                                  const FlatASTEntry *t2, int count2) {
+    if (count1 == 0 || count2 == 0) return 0.0;
+    
+    int distance = flat_edit_distance(t1, count1, t2, count2);
+    int max_size = max_int(t1[0].size, t2[0].size);
+    
+    if (max_size == 0) return 1.0;
+    
+    return 1.0 - ((double)distance / (max_size * 1.5));
+}
+
+static double flat_fingerprint_similarity(const uint64_t *h1, int n1, const uint64_t *h2, int n2) {
+    Fingerprints fp1 = {(unsigned long long*)h1, n1};
+    Fingerprints fp2 = {(unsigned long long*)h2, n2};
+    return compare_fingerprints(&fp1, &fp2);
+}
+
+PlagiarismResult corpus_compare(const CorpusRecord *r1, const CorpusRecord *r2) {
+    PlagiarismResult result = {0};
+    strcpy(result.verdict, "Unable to analyze");
+    
+    if (!r1 || !r2) {
+        strcpy(result.verdict, "NULL input");
+        return result;
+    }
+    
+    if (r1->status == ARTIFACT_EMPTY || r2->status == ARTIFACT_EMPTY) {
+        strcpy(result.verdict, artifact_status_verdict(ARTIFACT_EMPTY));
+        return result;
+    }
+    
+    if (r1->content_hash == r2->content_hash && r1->code_length == r2->code_length) {
+        result.overall_score = 1.0;
+        result.ast_similarity = 1.0;
+        result.cfg_similarity = 1.0;
+        result.dag_similarity = 1.0;
+        result.winnow_similarity = 1.0;
+        strcpy(result.verdict, "EXACT COPY - 100% identical");
+        return result;
+    }
+    
+    if (r1->status != ARTIFACT_OK || r2->status != ARTIFACT_OK) {
+        uint32_t status = r1->status;
+        if (status == ARTIFACT_OK || (r2->status != ARTIFACT_OK && r2->status < status)) {
+            status = r2->status;
+        }
+        if (status >= ARTIFACT_TOO_SIMPLE) {
+            result.total_nodes_1 = r1->total_nodes;
+            result.total_nodes_2 = r2->total_nodes;
+        }
+        strcpy(result.verdict, artifact_status_verdict((ArtifactStatus)status));
+        return result;
+    }
+    
+    result.total_nodes_1 = r1->total_nodes;
+    result.total_nodes_2 = r2->total_nodes;
+    
+    result.ast_similarity = flat_ast_similarity(
+        record_section(r1, r1->ast_offset), r1->ast_count,
+        record_section(r2, r2->ast_offset), r2->ast_count);
+    result.winnow_similarity = flat_fingerprint_similarity(
+        record_section(r1, r1->fp_offset), r1->fp_count,
+        record_section(r2, r2->fp_offset), r2->fp_count);
+    
+    if (r1->cfg_count > 2 && r2->cfg_count > 2) {
+        result.cfg_similarity = compare_cfg_summary(
+            record_section(r1, r1->cfg_offset), r1->cfg_count,
+            record_section(r2, r2->cfg_offset), r2->cfg_count);
+    } else {
+        result.cfg_similarity = result.ast_similarity * 0.9;
+    }
+    
+    if (r1->dag_count > 0 && r2->dag_count > 0) {
+        result.dag_similarity = compare_dag_summary(
+            record_section(r1, r1->dag_offset), r1->dag_count,
+            record_section(r2, r2->dag_offset), r2->dag_count);
+    } else {
+        result.dag_similarity = result.ast_similarity * 0.85;
+    }
+    
+    finalize_result(&result);
+    return result;
+}
+
+int corpus_append(Corpus *corpus, CorpusRecord **records, int count) {
+    if (!corpus || count <= 0) return 1;
+    
+    const CorpusHeader *mapped = (const CorpusHeader*)corpus->base;
+    CorpusHeader header = *mapped;
+    
+    FILE *file = fopen(corpus->path, "r+b");
+    if (!file) {
+        LOG_ERROR(LOG_IO, "Cannot write corpus: %s\n", corpus->path);
+        return 0;
+    }
+    
+    // Records go after data_end first; the header update commits them
+    if (fseek(file, (long)header.data_end, SEEK_SET) != 0) {
+        fclose(file);
+        return 0;
+    }
+    for (int i = 0; i < count; i++) {
+        if (!records[i]) continue;
+        if (fwrite(records[i], records[i]->record_size, 1, file) != 1) {
+            LOG_ERROR(LOG_IO, "Failed writing corpus: %s\n", corpus->path);
+            fclose(file);
+            return 0;
+        }
+        header.data_end += records[i]->record_size;
+        header.record_count++;
+    }
+    fflush(file);
+    
+    header.engine_version = ENGINE_VERSION;
+    fseek(file, 0, SEEK_SET);
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    fclose(file);
+    return ok;
+}
+
+int corpus_mark_superseded(Corpus *corpus, int index) {
+    const CorpusRecord *record = corpus_record(corpus, index);
+    if (!record) return 0;
+    
+    FILE *file = fopen(corpus->path, "r+b");
+    if (!file) return 0;
+    
+    uint32_t flags = record->flags | RECORD_SUPERSEDED;
+    long at = (long)(corpus->offsets[index] + offsetof(CorpusRecord, flags));
+    int ok = fseek(file, at, SEEK_SET) == 0 && fwrite(&flags, sizeof(flags), 1, file) == 1;
+    fclose(file);
+    return ok;
+}
+
+int corpus_compact(const char *path) {
+    Corpus *corpus = corpus_open(path);
+    if (!corpus) return 0;
+    
+    size_t tmp_length = strlen(path) + 5;
+    char *tmp_path = malloc(tmp_length);
+    if (!tmp_path) {
+        corpus_close(corpus);
+        return 0;
+    }
+    snprintf(tmp_path, tmp_length, "%s.tmp", path);
+    
+    FILE *out = fopen(tmp_path, "wb");
+    if (!out) {
+        LOG_ERROR(LOG_IO, "Cannot write: %s\n", tmp_path);
+        free(tmp_path);
+        corpus_close(corpus);
+        return 0;
+    }
+    
+    CorpusHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CORPUS_MAGIC, 8);
+    header.format_version = CORPUS_FORMAT_VERSION;
+    header.byte_order = CORPUS_BYTE_ORDER;
+    header.data_end = sizeof(CorpusHeader);
+    header.engine_version = ENGINE_VERSION;
+    
+    int ok = fwrite(&header, sizeof(header), 1, out) == 1;
+    int dropped = 0;
+    for (int i = 0; ok && i < corpus->record_count; i++) {
+        const CorpusRecord *record = corpus_record(corpus, i);
+        if (!corpus_record_is_live(record)) {
+            dropped++;
+            continue;
+        }
+        ok = fwrite(record, record->record_size, 1, out) == 1;
+        header.data_end += record->record_size;
+        header.record_count++;
+    }
+    
+    if (ok) {
+        fseek(out, 0, SEEK_SET);
+        ok = fwrite(&header, sizeof(header), 1, out) == 1;
+    }
+    fclose(out);
+    corpus_close(corpus);
+    
+    if (!ok) {
+        remove(tmp_path);
+        LOG_ERROR(LOG_IO, "Compaction failed: %s\n", path);
+        free(tmp_path);
+        return 0;
+    }
+    
+#ifdef _WIN32
+    // rename() will not replace an existing file on Windows
+    remove(path);
+#endif
+    if (rename(tmp_path, path) != 0) {
+        LOG_ERROR(LOG_IO, "Compaction failed: %s\n", path);
+        free(tmp_path);
+        return 0;
+    }
+    
+    diag_printf("[OK] Compacted %s: kept %llu records, dropped %d\n",
+           path, (unsigned long long)header.record_count, dropped);
+    free(tmp_path);
+    return 1;
+}
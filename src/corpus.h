@@ -0,0 +1,89 @@
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "detector.h"
+
+// On-disk corpus of analyzed submissions.
+//
+// The file is a CorpusHeader followed by self-contained records. Every
+// record and every section inside it is 8-byte aligned and addressed by
+// offsets relative to the record start, so a mapped file is used in
+// place with no deserialization. Bytes past header.data_end (a torn
+// append) are ignored.
+
+#define CORPUS_MAGIC "PDCORPUS"
+#define CORPUS_FORMAT_VERSION 1
+#define CORPUS_BYTE_ORDER 0x01020304u
+
+#define RECORD_SUPERSEDED 0x1u
+
+typedef struct {
+    char magic[8];
+    uint32_t format_version;
+    uint32_t byte_order;
+    uint64_t record_count;
+    uint64_t data_end;
+    uint32_t engine_version;    // engine that last wrote to the file
+    uint32_t reserved[7];
+} CorpusHeader;
+
+typedef struct {
+    uint64_t record_size;
+    uint64_t content_hash;
+    uint64_t code_length;
+    uint32_t engine_version;
+    uint32_t status;            // ArtifactStatus
+    uint32_t flags;
+    int32_t total_nodes;
+    uint32_t path_offset, path_length;
+    uint32_t ast_offset, ast_count;   // FlatASTEntry[], preorder
+    uint32_t cfg_offset, cfg_count;   // CFGSummaryNode[]
+    uint32_t dag_offset, dag_count;   // DAGSummaryNode[]
+    uint32_t fp_offset, fp_count;     // uint64 winnowing fingerprints
+} CorpusRecord;
+
+// Normalized AST in preorder; size counts the node and its descendants
+// and hash is the subtree's Merkle hash (see FlatAST)
+typedef struct {
+    uint64_t hash;
+    int32_t type;
+    int32_t size;
+} FlatASTEntry;
+
+typedef struct {
+    char *path;
+    unsigned char *base;
+    size_t mapped_size;
+    int mapped;
+    uint64_t *offsets;          // record offsets from the file start
+    int record_count;
+} Corpus;
+
+// Creates an empty corpus file if path does not exist yet
+Corpus* corpus_open(const char *path);
+void corpus_close(Corpus *corpus);
+
+const CorpusRecord* corpus_record(const Corpus *corpus, int index);
+const char* corpus_record_path(const CorpusRecord *record);
+int corpus_record_is_live(const CorpusRecord *record);
+int corpus_record_is_stale(const CorpusRecord *record);
+
+// Index of the live record stored for path, or -1
+int corpus_find_path(const Corpus *corpus, const char *path);
+
+// Encodes an artifact as a record in a fresh heap buffer
+CorpusRecord* corpus_encode_artifact(const FileArtifact *artifact, const char *path);
+
+PlagiarismResult corpus_compare(const CorpusRecord *r1, const CorpusRecord *r2);
+
+// Appends records and commits them by rewriting the header; the mapping
+// is not refreshed, reopen to see the new records
+int corpus_append(Corpus *corpus, CorpusRecord **records, int count);
+int corpus_mark_superseded(Corpus *corpus, int index);
+
+// Rewrites the file keeping only live, current-engine records
+int corpus_compact(const char *path);
+
+#endif
@@ -0,0 +1,722 @@
+#ifndef _WIN32
+    #define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "daemon.h"
+#include "log.h"
+#include <stdio.h>
+
+#ifdef _WIN32
+
+int run_daemon(const char *socket_path, int thread_count) {
+    (void)socket_path;
+    (void)thread_count;
+    LOG_ERROR(LOG_MAIN, "Daemon mode needs Unix domain sockets and is not available on Windows\n");
+    return 1;
+}
+
+#else
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "detector.h"
+#include "directory_handler.h"
+#include "file_handler.h"
+#include "archive.h"
+#include "thread_pool.h"
+#include "report.h"
+#include "symbol.h"
+#include "function_cache.h"
+#include "lsh.h"
+#include "utils.h"
+
+#define CACHE_BUCKETS 1024
+#define MAX_CLIENTS 64
+
+// Pairs compared at once; their results are written out before the next
+// block is filled
+#define PAIR_BLOCK 4096
+
+// Every comparison record is longer than this, so a request with more
+// than DAEMON_MAX_MESSAGE / MIN_RECORD_BYTES pairs cannot be answered
+#define MIN_RECORD_BYTES 128
+
+typedef struct CacheEntry {
+    struct CacheEntry *next;
+    uint64_t content_hash;
+    size_t length;
+    FileArtifact *artifact;
+    int refs;
+    unsigned long long last_used;
+} CacheEntry;
+
+typedef struct {
+    pthread_mutex_t lock;
+    CacheEntry *buckets[CACHE_BUCKETS];
+    int count;
+    unsigned long long clock;
+    unsigned long long hits;
+    unsigned long long misses;
+} ArtifactCache;
+
+typedef struct {
+    ArtifactCache cache;
+    int thread_count;
+    pthread_mutex_t clients_lock;
+    pthread_cond_t clients_free;
+    int clients;
+    // Every identifier and number a submission uses is interned, so the
+    // symbol table is reset between requests once it passes
+    // DAEMON_SYMBOL_LIMIT; analyses hold the gate while they run
+    pthread_mutex_t gate_lock;
+    pthread_cond_t gate_changed;
+    int analyzing;
+    int resetting;
+} Daemon;
+
+typedef struct {
+    Daemon *daemon;
+    int fd;
+} ClientArgs;
+
+typedef struct {
+    char op[32];
+    char *dir;
+    char *archive;
+    char **files;
+    int file_count;
+    ExtensionFilter filter;   // "ext", as for --ext; count 0 means .c
+    int recursive;            // "recursive", true unless sent as false
+    int bad_filter;           // "ext" named no usable extension
+} Request;
+
+// ---------------------------------------------------------------- cache --
+
+static CacheEntry** cache_bucket(ArtifactCache *cache, uint64_t hash) {
+    return &cache->buckets[hash % CACHE_BUCKETS];
+}
+
+// Drops least-recently-used entries nobody is holding; caller holds the lock
+static void cache_evict(ArtifactCache *cache) {
+    while (cache->count > DAEMON_CACHE_ENTRIES) {
+        CacheEntry **victim = NULL;
+        for (int b = 0; b < CACHE_BUCKETS; b++) {
+            for (CacheEntry **link = &cache->buckets[b]; *link; link = &(*link)->next) {
+                if ((*link)->refs == 0 && (!victim || (*link)->last_used < (*victim)->last_used)) {
+                    victim = link;
+                }
+            }
+        }
+        if (!victim) return;
+        
+        CacheEntry *entry = *victim;
+        *victim = entry->next;
+        free_artifact(entry->artifact);
+        free(entry);
+        cache->count--;
+    }
+}
+
+static CacheEntry* cache_lookup(ArtifactCache *cache, uint64_t hash, size_t length) {
+    for (CacheEntry *e = *cache_bucket(cache, hash); e; e = e->next) {
+        if (e->content_hash == hash && e->length == length) return e;
+    }
+    return NULL;
+}
+
+// Returns a held entry for this source; release it with cache_release
+static CacheEntry* cache_acquire(ArtifactCache *cache, const char *code, size_t length) {
+    uint64_t hash = content_hash64(code, length);
+    
+    pthread_mutex_lock(&cache->lock);
+    CacheEntry *entry = cache_lookup(cache, hash, length);
+    if (entry) {
+        entry->refs++;
+        entry->last_used = ++cache->clock;
+        cache->hits++;
+        pthread_mutex_unlock(&cache->lock);
+        return entry;
+    }
+    pthread_mutex_unlock(&cache->lock);
+    
+    // Build outside the lock; if another request built the same file in
+    // the meantime, keep theirs
+    FileArtifact *artifact = build_artifact(code, length);
+    if (!artifact) return NULL;
+    
+    pthread_mutex_lock(&cache->lock);
+    entry = cache_lookup(cache, hash, length);
+    if (entry) {
+        free_artifact(artifact);
+        cache->hits++;
+    } else {
+        entry = calloc(1, sizeof(CacheEntry));
+        if (!entry) {
+            pthread_mutex_unlock(&cache->lock);
+            free_artifact(artifact);
+            return NULL;
+        }
+        entry->content_hash = hash;
+        entry->length = length;
+        entry->artifact = artifact;
+        entry->next = *cache_bucket(cache, hash);
+        *cache_bucket(cache, hash) = entry;
+        cache->count++;
+        cache->misses++;
+    }
+    entry->refs++;
+    entry->last_used = ++cache->clock;
+    cache_evict(cache);
+    pthread_mutex_unlock(&cache->lock);
+    return entry;
+}
+
+static void cache_release(ArtifactCache *cache, CacheEntry *entry) {
+    if (!entry) return;
+    pthread_mutex_lock(&cache->lock);
+    entry->refs--;
+    cache_evict(cache);
+    pthread_mutex_unlock(&cache->lock);
+}
+
+// ----------------------------------------------------------------- json --
+
+static const char* skip_ws(const char *p, const char *end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) p++;
+    return p;
+}
+
+// Parses a JSON string at p into a fresh buffer; returns the position
+// after the closing quote or NULL
+static const char* parse_json_string(const char *p, const char *end, char **out) {
+    if (p >= end || *p != '"') return NULL;
+    p++;
+    
+    char *buf = malloc(end - p + 1);
+    if (!buf) return NULL;
+    size_t n = 0;
+    
+    while (p < end && *p != '"') {
+        if (*p == '\\' && p + 1 < end) {
+            p++;
+            switch (*p) {
+                case 'n': buf[n++] = '\n'; break;
+                case 't': buf[n++] = '\t'; break;
+                case 'r': buf[n++] = '\r'; break;
+                case 'b': buf[n++] = '\b'; break;
+                case 'f': buf[n++] = '\f'; break;
+                case 'u': {
+                    // Paths are expected to be ASCII/UTF-8; only the BMP
+                    // code points below 0x80 are decoded, others become '?'
+                    unsigned int cp = 0;
+                    if (p + 4 < end && sscanf(p + 1, "%4x", &cp) == 1) p += 4;
+                    buf[n++] = cp < 0x80 ? (char)cp : '?';
+                    break;
+                }
+                default: buf[n++] = *p; break;
+            }
+            p++;
+        } else {
+            buf[n++] = *p++;
+        }
+    }
+    
+    if (p >= end) {
+        free(buf);
+        return NULL;
+    }
+    buf[n] = '\0';
+    *out = buf;
+    return p + 1;
+}
+
+// Skips any JSON value; only strings need care because of embedded brackets
+static const char* skip_json_value(const char *p, const char *end) {
+    int depth = 0;
+    while (p < end) {
+        if (*p == '"') {
+            char *tmp = NULL;
+            p = parse_json_string(p, end, &tmp);
+            free(tmp);
+            if (!p) return NULL;
+            continue;
+        }
+        if (*p == '{' || *p == '[') {
+            depth++;
+        } else if (*p == '}' || *p == ']') {
+            if (depth == 0) return p;
+            depth--;
+        } else if (*p == ',' && depth == 0) {
+            return p;
+        }
+        p++;
+    }
+    return p;
+}
+
+static void free_request(Request *req) {
+    free(req->dir);
+    free(req->archive);
+    for (int i = 0; i < req->file_count; i++) free(req->files[i]);
+    free(req->files);
+}
+
+static int parse_request(const char *json, size_t length, Request *req) {
+    const char *p = json, *end = json + length;
+    memset(req, 0, sizeof(*req));
+    req->recursive = 1;
+    
+    p = skip_ws(p, end);
+    if (p >= end || *p != '{') return 0;
+    p++;
+    
+    for (;;) {
+        p = skip_ws(p, end);
+        if (p < end && *p == '}') return 1;
+        
+        char *key = NULL;
+        p = parse_json_string(p, end, &key);
+        if (!p) return 0;
+        p = skip_ws(p, end);
+        if (p >= end || *p != ':') {
+            free(key);
+            return 0;
+        }
+        p = skip_ws(p + 1, end);
+        
+        if (strcmp(key, "op") == 0 || strcmp(key, "dir") == 0 || strcmp(key, "archive") == 0) {
+            char *value = NULL;
+            p = parse_json_string(p, end, &value);
+            if (p && key[0] == 'o') {
+                snprintf(req->op, sizeof(req->op), "%s", value);
+                free(value);
+            } else if (p && key[0] == 'd') {
+                free(req->dir);
+                req->dir = value;
+            } else if (p) {
+                free(req->archive);
+                req->archive = value;
+            }
+        } else if (strcmp(key, "ext") == 0) {
+            char *value = NULL;
+            p = parse_json_string(p, end, &value);
+            if (p && parseExtensionFilter(value, &req->filter) == 0) req->bad_filter = 1;
+            free(value);
+        } else if (strcmp(key, "recursive") == 0) {
+            if (end - p >= 5 && strncmp(p, "false", 5) == 0) req->recursive = 0;
+            p = skip_json_value(p, end);
+        } else if (strcmp(key, "files") == 0 && p < end && *p == '[') {
+            p = skip_ws(p + 1, end);
+            while (p && p < end && *p != ']') {
+                char *value = NULL;
+                p = parse_json_string(p, end, &value);
+                if (!p) break;
+                char **grown = realloc(req->files, sizeof(char*) * (req->file_count + 1));
+                if (!grown) {
+                    free(value);
+                    p = NULL;
+                    break;
+                }
+                req->files = grown;
+                req->files[req->file_count++] = value;
+                p = skip_ws(p, end);
+                if (p < end && *p == ',') p = skip_ws(p + 1, end);
+            }
+            if (p && p < end) p++;
+        } else {
+            p = skip_json_value(p, end);
+        }
+        free(key);
+        if (!p) return 0;
+        
+        p = skip_ws(p, end);
+        if (p < end && *p == ',') {
+            p++;
+            continue;
+        }
+        if (p < end && *p == '}') return 1;
+        return 0;
+    }
+}
+
+// ------------------------------------------------------------- requests --
+
+static void begin_analysis(Daemon *daemon) {
+    pthread_mutex_lock(&daemon->gate_lock);
+    while (daemon->resetting) pthread_cond_wait(&daemon->gate_changed, &daemon->gate_lock);
+    daemon->analyzing++;
+    pthread_mutex_unlock(&daemon->gate_lock);
+}
+
+// The first request to finish with the table over the limit closes the
+// gate, waits for the others and resets it. Cached artifacts are compared
+// through hashes of spellings, never IDs, so they stay valid; the
+// function cache is keyed by symbol IDs and goes too.
+static void end_analysis(Daemon *daemon) {
+    pthread_mutex_lock(&daemon->gate_lock);
+    daemon->analyzing--;
+    if (!daemon->resetting && symbol_count() > DAEMON_SYMBOL_LIMIT) {
+        daemon->resetting = 1;
+        while (daemon->analyzing > 0) pthread_cond_wait(&daemon->gate_changed, &daemon->gate_lock);
+        LOG_INFO(LOG_MAIN, "Resetting %d interned symbols\n", symbol_count());
+        symbol_reset();
+        function_cache_clear();
+        daemon->resetting = 0;
+    }
+    pthread_cond_broadcast(&daemon->gate_changed);
+    pthread_mutex_unlock(&daemon->gate_lock);
+}
+
+// One cache entry per requested file, left NULL if it cannot be read or
+// analyzed
+typedef struct {
+    ArtifactCache *cache;
+    const FileList *list;
+    const Archive *archive;
+    CacheEntry **entries;
+} DaemonBuildJob;
+
+static void daemon_build_chunk(void *ctx, int begin, int end, int worker) {
+    DaemonBuildJob *job = (DaemonBuildJob*)ctx;
+    (void)worker;
+    if (job->archive) {
+        for (int i = begin; i < end; i++) {
+            job->entries[i] = cache_acquire(job->cache, job->archive->data[i],
+                                            job->archive->lengths[i]);
+        }
+        return;
+    }
+    for (int first = begin; first < end; first += VIEW_BATCH) {
+        FileView views[VIEW_BATCH];
+        int batch = min_int(VIEW_BATCH, end - first);
+        openFileViews((const char *const *)job->list->paths + first, batch, views);
+        for (int i = 0; i < batch; i++) {
+            if (!views[i].data) continue;
+            job->entries[first + i] = cache_acquire(job->cache, views[i].data, views[i].length);
+            releaseFileView(&views[i]);
+        }
+    }
+}
+
+typedef struct {
+    CacheEntry **entries;
+    const FilePair *pairs;
+    PlagiarismResult *results;
+} DaemonPairJob;
+
+static void daemon_pair_chunk(void *ctx, int begin, int end, int worker) {
+    DaemonPairJob *job = (DaemonPairJob*)ctx;
+    (void)worker;
+    for (int k = begin; k < end; k++) {
+        job->results[k] = compare_artifacts(job->entries[job->pairs[k].first]->artifact,
+                                            job->entries[job->pairs[k].second]->artifact);
+    }
+}
+
+static void error_response(FILE *out, const char *message) {
+    fputs("{\"ok\":false,\"error\":", out);
+    report_json_string(out, message);
+    fputc('}', out);
+}
+
+static void handle_analyze(Daemon *daemon, Request *req, FILE *out) {
+    FileList *list = NULL;
+    Archive *archive = NULL;
+    if (req->archive && strcmp(req->archive, "-") == 0) {
+        error_response(out, "The daemon cannot read an archive from stdin");
+        return;
+    }
+    if (req->bad_filter) {
+        error_response(out, "No usable extensions in ext");
+        return;
+    }
+    if (req->archive) {
+        archive = archive_open(req->archive, &req->filter, daemon->thread_count);
+        if (archive) list = archive->members;
+    } else if (req->dir) {
+        list = scanDirectoryFiltered(req->dir, &req->filter, req->recursive);
+    } else {
+        list = createFileList();
+        for (int i = 0; list && i < req->file_count; i++) appendFilePath(list, req->files[i]);
+    }
+    if (!list) {
+        error_response(out, "Cannot read the requested files");
+        return;
+    }
+    
+    // Built on every thread; readable files only are kept, in list order,
+    // and every pair among them is compared
+    int slots = list->count > 0 ? list->count : 1;
+    CacheEntry **entries = calloc(slots, sizeof(CacheEntry*));
+    const char **paths = calloc(slots, sizeof(char*));
+    int n = 0;
+    if (entries && paths) {
+        int chunk_count = 0;
+        TaskChunk *chunks = split_into_chunks(NULL, list->count, daemon->thread_count * 8,
+                                              &chunk_count);
+        DaemonBuildJob build = {&daemon->cache, list, archive, entries};
+        run_work_stealing(chunks, chunk_count, daemon->thread_count, daemon_build_chunk, &build);
+        free(chunks);
+        for (int i = 0; i < list->count; i++) {
+            if (!entries[i]) continue;
+            entries[n] = entries[i];
+            paths[n++] = list->paths[i];
+        }
+    }
+    
+    long long total_pairs = (long long)n * (n - 1) / 2;
+    int block_capacity = total_pairs < PAIR_BLOCK ? (total_pairs > 0 ? (int)total_pairs : 1) : PAIR_BLOCK;
+    FilePair *block = malloc(sizeof(FilePair) * block_capacity);
+    PlagiarismResult *results = malloc(sizeof(PlagiarismResult) * block_capacity);
+    
+    // Records go to their own buffer so a reply that outgrows the message
+    // limit can still be turned into an error
+    char *records = NULL;
+    size_t records_length = 0;
+    FILE *body = open_memstream(&records, &records_length);
+    
+    if (!entries || !paths || !block || !results || !body) {
+        error_response(out, "Memory allocation failed");
+    } else if (total_pairs > DAEMON_MAX_MESSAGE / MIN_RECORD_BYTES) {
+        char message[160];
+        snprintf(message, sizeof(message), "%d files make %lld pairs, more than one reply can hold (%d)",
+                 n, total_pairs, DAEMON_MAX_MESSAGE / MIN_RECORD_BYTES);
+        error_response(out, message);
+    } else {
+        int pair_count = (int)total_pairs;
+        int high = 0, medium = 0, fits = 1;
+        PairCursor cursor = {0, 1};
+        for (int done = 0; fits && done < pair_count; ) {
+            int block_count = next_pair_block(n, &cursor, block, block_capacity);
+            int chunk_count = 0;
+            TaskChunk *chunks = split_into_chunks(NULL, block_count, daemon->thread_count * 8,
+                                                  &chunk_count);
+            DaemonPairJob job = {entries, block, results};
+            run_work_stealing(chunks, chunk_count, daemon->thread_count, daemon_pair_chunk, &job);
+            free(chunks);
+            
+            for (int k = 0; k < block_count; k++) {
+                PlagiarismResult *r = &results[k];
+                if (r->overall_score >= 0.75) high++;
+                else if (r->overall_score >= 0.50) medium++;
+                
+                if (done + k > 0) fputc(',', body);
+                report_json_record(body, paths[block[k].first], paths[block[k].second], r);
+            }
+            done += block_count;
+            fits = ftell(body) <= DAEMON_MAX_MESSAGE - 256;   // room for the envelope
+        }
+        
+        if (fclose(body) != 0 || !fits) {
+            error_response(out, fits ? "Memory allocation failed"
+                                     : "The comparisons do not fit in one reply");
+        } else {
+            fputs("{\"ok\":true,\"comparisons\":[", out);
+            fwrite(records, 1, records_length, out);
+            fprintf(out, "],\"summary\":{\"files\":%d,\"comparisons\":%d,\"high\":%d,\"medium\":%d}}",
+                    n, pair_count, high, medium);
+        }
+        body = NULL;
+    }
+    
+    if (body) fclose(body);
+    free(records);
+    for (int i = 0; entries && i < n; i++) cache_release(&daemon->cache, entries[i]);
+    free(entries);
+    free(paths);
+    free(block);
+    free(results);
+    if (archive) archive_free(archive);
+    else freeFileList(list);
+}
+
+static void handle_message(Daemon *daemon, const char *msg, size_t length, FILE *out) {
+    Request req;
+    if (!parse_request(msg, length, &req)) {
+        free_request(&req);
+        error_response(out, "Malformed request");
+        return;
+    }
+    
+    if (strcmp(req.op, "ping") == 0) {
+        pthread_mutex_lock(&daemon->cache.lock);
+        fprintf(out, "{\"ok\":true,\"op\":\"pong\",\"cached\":%d,\"hits\":%llu,\"misses\":%llu}",
+                daemon->cache.count, daemon->cache.hits, daemon->cache.misses);
+        pthread_mutex_unlock(&daemon->cache.lock);
+    } else if (strcmp(req.op, "analyze") == 0) {
+        begin_analysis(daemon);
+        handle_analyze(daemon, &req, out);
+        end_analysis(daemon);
+    } else {
+        error_response(out, "Unknown op");
+    }
+    
+    free_request(&req);
+}
+
+// ------------------------------------------------------------ transport --
+
+static int read_full(int fd, void *buf, size_t length) {
+    unsigned char *p = buf;
+    while (length > 0) {
+        ssize_t n = read(fd, p, length);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return 0;
+        p += n;
+        length -= n;
+    }
+    return 1;
+}
+
+static int write_full(int fd, const void *buf, size_t length) {
+    const unsigned char *p = buf;
+    while (length > 0) {
+        ssize_t n = write(fd, p, length);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return 0;
+        p += n;
+        length -= n;
+    }
+    return 1;
+}
+
+// Gives a connection's slot back and wakes the accept loop if it is waiting
+static void release_client(Daemon *daemon) {
+    pthread_mutex_lock(&daemon->clients_lock);
+    daemon->clients--;
+    pthread_cond_signal(&daemon->clients_free);
+    pthread_mutex_unlock(&daemon->clients_lock);
+}
+
+static void* client_main(void *arg) {
+    ClientArgs *args = (ClientArgs*)arg;
+    Daemon *daemon = args->daemon;
+    int fd = args->fd;
+    free(args);
+    
+    // One connection may carry any number of requests
+    for (;;) {
+        unsigned char prefix[4];
+        if (!read_full(fd, prefix, 4)) break;
+        uint32_t length = ((uint32_t)prefix[0] << 24) | ((uint32_t)prefix[1] << 16) |
+                          ((uint32_t)prefix[2] << 8) | prefix[3];
+        if (length == 0 || length > DAEMON_MAX_MESSAGE) break;
+        
+        char *msg = malloc(length);
+        if (!msg || !read_full(fd, msg, length)) {
+            free(msg);
+            break;
+        }
+        
+        // The reply is built in memory so its length can go first
+        char *reply = NULL;
+        size_t reply_length = 0;
+        FILE *out = open_memstream(&reply, &reply_length);
+        if (!out) {
+            free(msg);
+            break;
+        }
+        handle_message(daemon, msg, length, out);
+        free(msg);
+        int built = fclose(out) == 0;
+        
+        uint32_t out_length = (uint32_t)reply_length;
+        unsigned char out_prefix[4] = {
+            (unsigned char)(out_length >> 24), (unsigned char)(out_length >> 16),
+            (unsigned char)(out_length >> 8), (unsigned char)out_length
+        };
+        int ok = built && reply && write_full(fd, out_prefix, 4) && write_full(fd, reply, reply_length);
+        free(reply);
+        if (!ok) break;
+    }
+    
+    close(fd);
+    release_client(daemon);
+    return NULL;
+}
+
+int run_daemon(const char *socket_path, int thread_count) {
+    struct sockaddr_un addr;
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        LOG_ERROR(LOG_MAIN, "Socket path too long: %s\n", socket_path);
+        return 1;
+    }
+    
+    // A client that disconnects mid-reply must not kill the daemon
+    signal(SIGPIPE, SIG_IGN);
+    
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server < 0) {
+        LOG_ERROR(LOG_MAIN, "Cannot create socket\n");
+        return 1;
+    }
+    
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socket_path);
+    unlink(socket_path);
+    
+    if (bind(server, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(server, 64) != 0) {
+        LOG_ERROR(LOG_MAIN, "Cannot listen on: %s\n", socket_path);
+        close(server);
+        return 1;
+    }
+    
+    Daemon daemon;
+    memset(&daemon, 0, sizeof(daemon));
+    pthread_mutex_init(&daemon.cache.lock, NULL);
+    pthread_mutex_init(&daemon.clients_lock, NULL);
+    pthread_cond_init(&daemon.clients_free, NULL);
+    pthread_mutex_init(&daemon.gate_lock, NULL);
+    pthread_cond_init(&daemon.gate_changed, NULL);
+    daemon.thread_count = thread_count;
+    
+    diag_printf("[OK] Engine daemon listening on %s\n", socket_path);
+    fflush(stdout);
+    
+    for (;;) {
+        int fd = accept(server, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        
+        pthread_mutex_lock(&daemon.clients_lock);
+        while (daemon.clients >= MAX_CLIENTS) {
+            pthread_cond_wait(&daemon.clients_free, &daemon.clients_lock);
+        }
+        daemon.clients++;
+        pthread_mutex_unlock(&daemon.clients_lock);
+        
+        ClientArgs *args = malloc(sizeof(ClientArgs));
+        pthread_t thread;
+        if (!args) {
+            close(fd);
+            release_client(&daemon);
+            continue;
+        }
+        args->daemon = &daemon;
+        args->fd = fd;
+        if (pthread_create(&thread, NULL, client_main, args) != 0) {
+            free(args);
+            close(fd);
+            release_client(&daemon);
+            continue;
+        }
+        pthread_detach(thread);
+    }
+    
+    close(server);
+    unlink(socket_path);
+    return 0;
+}
+
+#endif
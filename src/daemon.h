@@ -0,0 +1,28 @@
+#ifndef DAEMON_H
+#define DAEMON_H
+
+// Long-lived engine that serves analysis requests over a Unix domain socket.
+//
+// Every message in either direction is a 4-byte big-endian length followed
+// by that many bytes of JSON. Requests:
+//   {"op":"analyze","dir":"/path"}              all pairs of files under dir
+//   {"op":"analyze","files":["/a.c","/b.c"]}    all pairs of the given files
+//   {"op":"analyze","archive":"/s.zip"}         all pairs of .c members, read
+//                                               in memory (.zip or .tar)
+//   {"op":"ping"}
+// "dir" and "archive" requests also take "ext" (".c,.h", as for --ext)
+// and "dir" takes "recursive" (false stays in the top folder).
+// Artifacts are cached by file content between requests, so a file that
+// was already analyzed (under any path) is only compared, never rebuilt.
+// A reply never passes DAEMON_MAX_MESSAGE: a request whose comparisons
+// would not fit gets {"ok":false,"error":...} instead.
+
+#define DAEMON_MAX_MESSAGE (16 * 1024 * 1024)
+#define DAEMON_CACHE_ENTRIES 4096
+// Interned spellings kept between requests; past this the symbol table is
+// reset once the requests in flight finish
+#define DAEMON_SYMBOL_LIMIT (1 << 20)
+
+int run_daemon(const char *socket_path, int thread_count);
+
+#endif
@@ -1,144 +1,236 @@
 #include "dag.h"
 #include "utils.h"
+#include "log.h"
 #include <stdlib.h>
 #include <string.h>
 
-static int dag_id = 0;
+typedef struct DAGNode {
+    int id;
+    NodeType type;
+    unsigned long hash;
+    struct DAGNode **operands;
+    int operand_count;
+    int operand_capacity;
+} DAGNode;
 
-static DAGNode* create_dag_node(NodeType type, const char *value) {
-    DAGNode *node = malloc(sizeof(DAGNode));
-    if (!node) return NULL;
-    
-    node->id = dag_id++;
-    node->type = type;
-    node->hash = string_hash(value);
-    node->operand_capacity = 8;
-    node->operands = malloc(sizeof(DAGNode*) * node->operand_capacity);
-    if (!node->operands) {
-        free(node);
-        return NULL;
-    }
-    node->operand_count = 0;
-    return node;
-}
+// Graph of one statement while it is built; only its summary is kept
+typedef struct {
+    Arena *arena;         // owns the graph, its nodes and their arrays
+    DAGNode **nodes;
+    int node_count;
+    int node_capacity;
+    int next_id;
+} DirectedAcyclicGraph;
 
-static void add_operand(DAGNode *parent, DAGNode *child) {
-    if (!parent || !child) return;
-    
-    if (parent->operand_count >= parent->operand_capacity) {
-        parent->operand_capacity *= 2;
-        DAGNode **new_operands = realloc(parent->operands,
-                                        sizeof(DAGNode*) * parent->operand_capacity);
-        if (!new_operands) return;
-        parent->operands = new_operands;
-    }
-    
-    parent->operands[parent->operand_count++] = child;
-    // Order-independent hash for commutative operations
-if (parent->type == NODE_BINOP) {
-    parent->hash ^= child->hash;  // XOR for order-independence
-} else {
-    parent->hash = parent->hash * 31 + child->hash;
-}
-}
+// Build state: the distinct nodes so far and open addressing on their
+// hash
+typedef struct {
+    DirectedAcyclicGraph *dag;
+    const FlatAST *ast;
+    DAGNode **slots;
+    int slot_mask;
+} DAGBuilder;
+
+// A tree node whose subtree is still being walked, and where its
+// children's results start on the value stack
+typedef struct {
+    int index;
+    int base;
+} DAGFrame;
 
 static void add_node_to_dag(DirectedAcyclicGraph *dag, DAGNode *node) {
     if (!dag || !node) return;
     
     if (dag->node_count >= dag->node_capacity) {
-        dag->node_capacity *= 2;
-        DAGNode **new_nodes = realloc(dag->nodes,
-                                     sizeof(DAGNode*) * dag->node_capacity);
+        int capacity = dag->node_capacity * 2;
+        DAGNode **new_nodes = arena_alloc(dag->arena, sizeof(DAGNode*) * capacity);
         if (!new_nodes) return;
+        memcpy(new_nodes, dag->nodes, sizeof(DAGNode*) * dag->node_count);
         dag->nodes = new_nodes;
+        dag->node_capacity = capacity;
     }
     
     dag->nodes[dag->node_count++] = node;
 }
 
-static DAGNode* find_node(DirectedAcyclicGraph *dag, unsigned long hash) {
-    if (!dag) return NULL;
-    
-    for (int i = 0; i < dag->node_count; i++) {
-        if (dag->nodes[i]->hash == hash) {
-            return dag->nodes[i];
-        }
+// Slot holding the node with this hash, or the empty slot it would go in
+static DAGNode** find_slot(DAGBuilder *b, unsigned long hash) {
+    int slot = (int)(hash & (unsigned long)b->slot_mask);
+    while (b->slots[slot] && b->slots[slot]->hash != hash) {
+        slot = (slot + 1) & b->slot_mask;
     }
-    return NULL;
+    return &b->slots[slot];
 }
 
-static DAGNode* ast_to_dag(ASTNode *node, DirectedAcyclicGraph *dag) {
-    if (!node || !dag) return NULL;
-    
-    DAGNode *dag_node = create_dag_node(node->type, node->value);
-    if (!dag_node) return NULL;
-    
-    for (int i = 0; i < node->child_count; i++) {
-        DAGNode *child = ast_to_dag(node->children[i], dag);
-        if (child) add_operand(dag_node, child);
+// Called once every child of index is finished; their results are the
+// child_count entries at values. The tree already carries each subtree's
+// Merkle hash, so a duplicate is found with one probe before anything is
+// allocated for it.
+static DAGNode* finish_node(DAGBuilder *b, int index, DAGNode **values, int child_count) {
+    DirectedAcyclicGraph *dag = b->dag;
+    unsigned long hash = (unsigned long)b->ast->hashes[index];
+    
+    DAGNode **slot = find_slot(b, hash);
+    if (*slot) return *slot;
+    
+    DAGNode **operands = NULL;
+    int operand_count = 0;
+    if (child_count > 0) {
+        operands = arena_alloc(dag->arena, sizeof(DAGNode*) * child_count);
+        if (!operands) return NULL;
     }
-    
-    DAGNode *existing = find_node(dag, dag_node->hash);
-    if (existing) {
-        if (dag_node->operands) free(dag_node->operands);
-        free(dag_node);
-        return existing;
+    for (int c = 0; c < child_count; c++) {
+        if (values[c]) operands[operand_count++] = values[c];
     }
     
+    DAGNode *dag_node = arena_alloc(dag->arena, sizeof(DAGNode));
+    if (!dag_node) return NULL;
+    dag_node->id = index;         // preorder number
+    dag_node->type = FLAT_TYPE(b->ast->nodes[index]);
+    dag_node->hash = hash;
+    dag_node->operands = operands;
+    dag_node->operand_count = operand_count;
+    dag_node->operand_capacity = child_count;
+    
+    *slot = dag_node;
     add_node_to_dag(dag, dag_node);
     return dag_node;
 }
 
-DirectedAcyclicGraph* build_dag(ASTNode *ast) {
-    if (!ast) return NULL;
-    
-    dag_id = 0;
+// Nodes for every distinct subtree of ast, its root included
+static DirectedAcyclicGraph* build_graph(const FlatAST *ast, Arena *arena) {
+    if (!ast || ast->count == 0) return NULL;
     
-    DirectedAcyclicGraph *dag = malloc(sizeof(DirectedAcyclicGraph));
+    DirectedAcyclicGraph *dag = arena_alloc(arena, sizeof(DirectedAcyclicGraph));
     if (!dag) return NULL;
     
-    dag->node_capacity = 100;
-    dag->nodes = malloc(sizeof(DAGNode*) * dag->node_capacity);
-    if (!dag->nodes) {
-        free(dag);
-        return NULL;
-    }
+    dag->arena = arena;
+    dag->node_capacity = 64;
+    dag->nodes = arena_alloc(arena, sizeof(DAGNode*) * dag->node_capacity);
+    if (!dag->nodes) return NULL;
     dag->node_count = 0;
-    
-    for (int i = 0; i < ast->child_count; i++) {
-        ast_to_dag(ast->children[i], dag);
+    dag->next_id = ast->count;
+    
+    // At most one node per tree node, so the table stays under half full.
+    // Table, value stack and open-node stack share the thread's walk buffer.
+    int slot_count = 16;
+    while (slot_count < ast->count * 2) slot_count *= 2;
+    DAGNode **buffer = walk_buffer(sizeof(DAGNode*) * (slot_count + ast->count) +
+                                   sizeof(DAGFrame) * ast->count);
+    if (!buffer) return NULL;
+    memset(buffer, 0, sizeof(DAGNode*) * slot_count);
+    DAGBuilder b = {dag, ast, buffer, slot_count - 1};
+    DAGNode **values = buffer + slot_count;
+    DAGFrame *open = (DAGFrame*)(values + ast->count);
+    
+    // Post-order over the preorder array: a node is finished right after
+    // the last node of its subtree, children left to right before parents
+    int top = 0, value_top = 0;
+    for (int i = 0; i < ast->count; i++) {
+        open[top++] = (DAGFrame){i, value_top};
+        while (top > 0 && open[top - 1].index + (int)ast->nodes[open[top - 1].index].size == i + 1) {
+            DAGFrame frame = open[--top];
+            DAGNode *node = finish_node(&b, frame.index, values + frame.base,
+                                        value_top - frame.base);
+            value_top = frame.base;
+            values[value_top++] = node;
+        }
     }
     
+    LOG_DEBUG(LOG_DAG, "Built DAG with %d nodes\n", dag->node_count);
     return dag;
 }
 
-void free_dag(DirectedAcyclicGraph *dag) {
-    if (!dag) return;
+int build_dag_fragment(const FlatAST *ast, Arena *arena, DAGFragment *fragment) {
+    fragment->nodes = NULL;
+    fragment->count = 0;
+    if (!ast || ast->count == 0) return 1;
+    
+    DirectedAcyclicGraph *dag = build_graph(ast, arena);
+    if (!dag) return 0;
     
+    fragment->nodes = arena_alloc(arena, sizeof(DAGSummaryNode) * (dag->node_count + 1));
+    if (!fragment->nodes) return 0;
     for (int i = 0; i < dag->node_count; i++) {
-        if (dag->nodes[i]) {
-            if (dag->nodes[i]->operands) free(dag->nodes[i]->operands);
-            free(dag->nodes[i]);
+        fragment->nodes[i].hash = dag->nodes[i]->hash;
+        fragment->nodes[i].type = dag->nodes[i]->type;
+        fragment->nodes[i].reserved = 0;
+    }
+    fragment->count = dag->node_count;
+    return 1;
+}
+
+DAGSummaryNode* join_dag_fragments(const DAGFragment *fragments, int count,
+                                   Arena *arena, int *node_count) {
+    *node_count = 0;
+    int total = 0;
+    for (int k = 0; k < count; k++) total += fragments[k].count;
+    
+    DAGSummaryNode *nodes = arena_alloc(arena, sizeof(DAGSummaryNode) * (total + 1));
+    if (!nodes) return NULL;
+    
+    // Open addressing on hash over what is kept so far; a slot holds the
+    // kept node's position plus one
+    int slot_count = 16;
+    while (slot_count < total * 2) slot_count *= 2;
+    int *slots = walk_buffer(sizeof(int) * slot_count);
+    if (!slots) return NULL;
+    memset(slots, 0, sizeof(int) * slot_count);
+    int mask = slot_count - 1;
+    
+    int kept = 0;
+    for (int k = 0; k < count; k++) {
+        for (int i = 0; i < fragments[k].count; i++) {
+            DAGSummaryNode node = fragments[k].nodes[i];
+            int slot = (int)(node.hash & (unsigned long long)mask);
+            while (slots[slot] && nodes[slots[slot] - 1].hash != node.hash) {
+                slot = (slot + 1) & mask;
+            }
+            if (slots[slot]) continue;
+            nodes[kept++] = node;
+            slots[slot] = kept;
         }
     }
     
-    if (dag->nodes) free(dag->nodes);
-    free(dag);
+    *node_count = kept;
+    return nodes;
+}
+
+static int compare_summary_hashes(const void *a, const void *b) {
+    unsigned long long x = *(const unsigned long long*)a;
+    unsigned long long y = *(const unsigned long long*)b;
+    return (x > y) - (x < y);
 }
 
-double compare_dag(DirectedAcyclicGraph *dag1, DirectedAcyclicGraph *dag2) {
-    if (!dag1 || !dag2 || dag1->node_count == 0 || dag2->node_count == 0) {
+// Shared subtrees count from both sides, then node types by position
+double compare_dag_summary(const DAGSummaryNode *n1, int count1,
+                           const DAGSummaryNode *n2, int count2) {
+    if (!n1 || !n2 || count1 == 0 || count2 == 0) {
         return 0.0;
     }
     
     int hash_matches = 0;
-    int total = dag1->node_count + dag2->node_count;
-    
-    for (int i = 0; i < dag1->node_count; i++) {
-        for (int j = 0; j < dag2->node_count; j++) {
-            if (dag1->nodes[i]->hash == dag2->nodes[j]->hash) {
+    int total = count1 + count2;
+    
+    // Membership in the second graph through its sorted hashes, so one
+    // huge function does not cost count1 * count2 probes
+    unsigned long long *sorted = malloc(sizeof(unsigned long long) * count2);
+    if (sorted) {
+        for (int j = 0; j < count2; j++) sorted[j] = n2[j].hash;
+        qsort(sorted, count2, sizeof(unsigned long long), compare_summary_hashes);
+        for (int i = 0; i < count1; i++) {
+            if (bsearch(&n1[i].hash, sorted, count2, sizeof(unsigned long long), compare_summary_hashes)) {
                 hash_matches += 2;
-                break;
+            }
+        }
+        free(sorted);
+    } else {
+        for (int i = 0; i < count1; i++) {
+            for (int j = 0; j < count2; j++) {
+                if (n1[i].hash == n2[j].hash) {
+                    hash_matches += 2;
+                    break;
+                }
             }
         }
     }
@@ -146,15 +238,15 @@ double compare_dag(DirectedAcyclicGraph *dag1, DirectedAcyclicGraph *dag2) {
     double hash_sim = (total > 0) ? (double)hash_matches / total : 0.0;
     
     int type_matches = 0;
-    int min_count = min_int(dag1->node_count, dag2->node_count);
+    int min_count = min_int(count1, count2);
     
     for (int i = 0; i < min_count; i++) {
-        if (dag1->nodes[i]->type == dag2->nodes[i]->type) {
+        if (n1[i].type == n2[i].type) {
             type_matches++;
         }
     }
     
-    double type_sim = (double)type_matches / max_int(dag1->node_count, dag2->node_count);
+    double type_sim = (double)type_matches / max_int(count1, count2);
     
     return 0.7 * hash_sim + 0.3 * type_sim;
 }
\ No newline at end of file
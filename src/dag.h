@@ -3,23 +3,30 @@
 
 #include "ast.h"
 
-typedef struct DAGNode {
-    int id;
-    NodeType type;
-    unsigned long hash;
-    struct DAGNode **operands;
-    int operand_count;
-    int operand_capacity;
-} DAGNode;
+// The parts of a DAG node compare_dag_summary looks at, flat for on-disk
+// storage
+typedef struct {
+    unsigned long long hash;
+    int type;
+    int reserved;
+} DAGSummaryNode;
 
+// DAG of one top-level statement in summary form, its own root included,
+// each distinct subtree once in post-order
 typedef struct {
-    DAGNode **nodes;
-    int node_count;
-    int node_capacity;
-} DirectedAcyclicGraph;
+    DAGSummaryNode *nodes;
+    int count;
+} DAGFragment;
+
+// Fragment of the statement at the root of ast; the graph and the
+// summaries go to arena. Returns 0 if allocation failed.
+int build_dag_fragment(const FlatAST *ast, Arena *arena, DAGFragment *fragment);
 
-DirectedAcyclicGraph* build_dag(ASTNode *ast);
-void free_dag(DirectedAcyclicGraph *dag);
-double compare_dag(DirectedAcyclicGraph *dag1, DirectedAcyclicGraph *dag2);
+// Summaries of the DAG of a program made of these statements in order: a node whose hash an earlier one already has is
+// shared, so only the first is kept
+DAGSummaryNode* join_dag_fragments(const DAGFragment *fragments, int count,
+                                   Arena *arena, int *node_count);
+double compare_dag_summary(const DAGSummaryNode *n1, int count1,
+                           const DAGSummaryNode *n2, int count2);
 
 #endif
\ No newline at end of file
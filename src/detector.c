@@ -5,61 +5,95 @@
 #include "cfg.h"
 #include "dag.h"
 #include "utils.h"
+#include "log.h"
+#include "profile.h"
+#include "symbol.h"
+#include "function_cache.h"
+#include "thread_pool.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 
-static void print_ast_debug(ASTNode *node, int depth) {
-    if (!node) {
-        for (int i = 0; i < depth; i++) printf("  ");
-        printf("NULL\n");
-        return;
-    }
-    
-    for (int i = 0; i < depth; i++) printf("  ");
-    
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_TRACE
+// Only called when detector TRACE logging is on; one line per node
+static void print_ast_debug(const FlatAST *ast) {
     const char *type_names[] = {
         "PROGRAM", "IF", "WHILE", "FOR", "DO_WHILE", "SWITCH", "CASE",
         "ASSIGN", "BINOP", "VAR", "LITERAL", "ARRAY_ACCESS", "RETURN",
-        "BREAK", "CONTINUE", "BLOCK"
+        "BREAK", "CONTINUE", "BLOCK", "UNOP", "TERNARY", "CALL", "FUNCTION"
     };
     
-    printf("[%s] value='%s' children=%d\n", 
-           type_names[node->type], node->value, node->child_count);
-    
-    for (int i = 0; i < node->child_count; i++) {
-        print_ast_debug(node->children[i], depth + 1);
+    // Ends of the subtrees enclosing the current node; their count is
+    // its depth
+    int *ends = walk_buffer(sizeof(int) * ast->count);
+    if (!ends) return;
+    
+    int depth = 0;
+    for (int i = 0; i < ast->count; i++) {
+        while (depth > 0 && ends[depth - 1] <= i) depth--;
+        FlatNode node = ast->nodes[i];
+        LOG_TRACE(LOG_DETECTOR, "%*s[%s] value='%s' children=%d\n", depth * 2, "",
+                  type_names[FLAT_TYPE(node)], symbol_text(FLAT_SYMBOL(node)),
+                  flat_child_count(ast, i));
+        ends[depth++] = i + (int)node.size;
     }
 }
+#endif
 
-static int tree_edit_distance(ASTNode *t1, ASTNode *t2) {
-    if (!t1 && !t2) return 0;
-    if (!t1) return count_nodes(t2);
-    if (!t2) return count_nodes(t1);
-    
-    int cost = (t1->type == t2->type) ? 0 : 1;
-    
-    if (t1->child_count == 0 && t2->child_count == 0) {
-        return cost;
-    }
-    
-    int total_cost = cost;
-    int max_children = max_int(t1->child_count, t2->child_count);
-    
-    for (int i = 0; i < max_children; i++) {
-        ASTNode *child1 = (i < t1->child_count) ? t1->children[i] : NULL;
-        ASTNode *child2 = (i < t2->child_count) ? t2->children[i] : NULL;
-        total_cost += tree_edit_distance(child1, child2);
+// Subtrees paired up by position; -1 stands for a missing side
+typedef struct {
+    int i;
+    int j;
+} NodePair;
+
+// The distance is a sum over positionally paired nodes, so pairs can be
+// taken from a stack in any order. A missing side costs the whole size of
+// the other, and subtrees with equal hashes match without being walked.
+static int tree_edit_distance(const FlatAST *a1, const FlatAST *a2) {
+    const FlatNode *t1 = a1->nodes, *t2 = a2->nodes;
+    
+    // Every pending pair holds a node no other pair holds
+    NodePair *stack = walk_buffer(sizeof(NodePair) * (a1->count + a2->count));
+    if (!stack) return max_int(a1->count, a2->count);
+    
+    int top = 0;
+    int total_cost = 0;
+    stack[top++] = (NodePair){0, 0};
+    
+    while (top > 0) {
+        NodePair pair = stack[--top];
+        int i = pair.i, j = pair.j;
+        if (i < 0) {
+            total_cost += t2[j].size;
+            continue;
+        }
+        if (j < 0) {
+            total_cost += t1[i].size;
+            continue;
+        }
+        if (a1->hashes[i] == a2->hashes[j]) continue;
+        
+        total_cost += (FLAT_TYPE(t1[i]) == FLAT_TYPE(t2[j])) ? 0 : 1;
+        
+        int c1 = i + 1, end1 = i + (int)t1[i].size;
+        int c2 = j + 1, end2 = j + (int)t2[j].size;
+        while (c1 < end1 || c2 < end2) {
+            int more1 = c1 < end1, more2 = c2 < end2;
+            stack[top++] = (NodePair){more1 ? c1 : -1, more2 ? c2 : -1};
+            if (more1) c1 += t1[c1].size;
+            if (more2) c2 += t2[c2].size;
+        }
     }
     
     return total_cost;
 }
 
-static double calculate_ast_similarity(ASTNode *t1, ASTNode *t2) {
-    if (!t1 || !t2) return 0.0;
+double calculate_ast_similarity(const FlatAST *t1, const FlatAST *t2) {
+    if (!t1 || !t2 || t1->count == 0 || t2->count == 0) return 0.0;
     
     int distance = tree_edit_distance(t1, t2);
-    int max_size = max_int(count_nodes(t1), count_nodes(t2));
+    int max_size = max_int(t1->count, t2->count);
     
     if (max_size == 0) return 1.0;
     
@@ -84,187 +118,473 @@ static void determine_verdict(PlagiarismResult *result) {
     }
 }
 
-PlagiarismResult detect_plagiarism(const char *code1, const char *code2) {
-    PlagiarismResult result = {0};
-    strcpy(result.verdict, "Unable to analyze");
+// Token fingerprints take a fixed share of the score: they survive
+// reordered functions and statements, which the tree metrics mostly do
+// not. The tree metrics split the rest by file size.
+#define WINNOW_WEIGHT 0.20
+
+void finalize_result(PlagiarismResult *result) {
+    if (!result) return;
     
-    if (!code1 || !code2) {
-        printf("[DEBUG] NULL input\n");  // ADD
-        strcpy(result.verdict, "NULL input");
-        return result;
-    }
+    int avg_nodes = (result->total_nodes_1 + result->total_nodes_2) / 2;
+    double w_ast, w_cfg, w_dag;
     
-    if (strlen(code1) == 0 || strlen(code2) == 0) {
-        strcpy(result.verdict, "Empty code");
-        return result;
+    if (avg_nodes < 10) {
+        w_ast = 0.50;
+        w_cfg = 0.30;
+        w_dag = 0.20;
+    } else if (avg_nodes < 30) {
+        w_ast = 0.35;
+        w_cfg = 0.35;
+        w_dag = 0.30;
+    } else {
+        w_ast = 0.25;
+        w_cfg = 0.40;
+        w_dag = 0.35;
     }
     
-    if (strcmp(code1, code2) == 0) {
-        result.overall_score = 1.0;
-        result.ast_similarity = 1.0;
-        result.cfg_similarity = 1.0;
-        result.dag_similarity = 1.0;
-        strcpy(result.verdict, "EXACT COPY - 100% identical");
-        return result;
+    double tree_score = (w_ast * result->ast_similarity) +
+                        (w_cfg * result->cfg_similarity) +
+                        (w_dag * result->dag_similarity);
+    result->overall_score = (1.0 - WINNOW_WEIGHT) * tree_score +
+                            WINNOW_WEIGHT * result->winnow_similarity;
+    
+    double min_score = min_double(result->ast_similarity,
+                                  min_double(result->cfg_similarity, result->dag_similarity));
+    double max_score = max_double(result->ast_similarity,
+                                  max_double(result->cfg_similarity, result->dag_similarity));
+    
+    double variance = max_score - min_score;
+    
+    if (variance < 0.15 && result->overall_score > 0.6) {
+        result->overall_score = min_double(1.0, result->overall_score * 1.08);
+    } else if (variance > 0.35) {
+        result->overall_score *= 0.92;
     }
     
-    printf("[DEBUG] Tokenizing...\n");  // ADD
-    TokenList *tokens1 = tokenize(code1);
-    TokenList *tokens2 = tokenize(code2);
+    double size_ratio = (double)min_int(result->total_nodes_1, result->total_nodes_2) /
+                        (double)max_int(result->total_nodes_1, result->total_nodes_2);
     
-    if (!tokens1 || !tokens2 || tokens1->count < 5 || tokens2->count < 5) {
-        if (tokens1) free_tokens(tokens1);
-        if (tokens2) free_tokens(tokens2);
-        strcpy(result.verdict, "Code too small (less than 5 tokens)");
-        return result;
+    if (size_ratio < 0.4) {
+        result->overall_score *= 0.75;
+    } else if (size_ratio < 0.6) {
+        result->overall_score *= 0.90;
     }
     
-    printf("[DEBUG] Parsing...\n");
-ASTNode *ast1 = parse(tokens1);
-ASTNode *ast2 = parse(tokens2);
+    if (result->overall_score < 0.0) result->overall_score = 0.0;
+    if (result->overall_score > 1.0) result->overall_score = 1.0;
+    
+    determine_verdict(result);
+}
 
-// ADD THESE DEBUG LINES:
-printf("[DEBUG PARSER] AST1 root type: %d, children: %d\n", 
-       ast1 ? ast1->type : -1, ast1 ? ast1->child_count : 0);
-if (ast1 && ast1->child_count > 0) {
-    for (int i = 0; i < ast1->child_count; i++) {
-        printf("[DEBUG PARSER] AST1 child[%d] type: %d\n", i, 
-               ast1->children[i] ? ast1->children[i]->type : -1);
-    }
+// The parse tree and normalizer temporaries only live until the artifact
+// is built, so each thread keeps one scratch arena and resets it per file
+static pthread_key_t scratch_key;
+static pthread_once_t scratch_once = PTHREAD_ONCE_INIT;
+
+static void release_scratch(void *scratch) {
+    arena_release((Arena*)scratch);
+    free(scratch);
 }
-    
-    if (!ast1 || !ast2) {
-        if (ast1) free_ast(ast1);
-        if (ast2) free_ast(ast2);
-        free_tokens(tokens1);
-        free_tokens(tokens2);
-        strcpy(result.verdict, "Failed to parse - syntax errors");
-        return result;
+
+static void create_scratch_key(void) {
+    pthread_key_create(&scratch_key, release_scratch);
+}
+
+static Arena* thread_scratch(void) {
+    pthread_once(&scratch_once, create_scratch_key);
+    Arena *scratch = pthread_getspecific(scratch_key);
+    if (!scratch) {
+        scratch = calloc(1, sizeof(Arena));
+        if (scratch && pthread_setspecific(scratch_key, scratch) != 0) {
+            free(scratch);
+            scratch = NULL;
+        }
     }
-    
-    result.total_nodes_1 = count_nodes(ast1);
-    result.total_nodes_2 = count_nodes(ast2);
+    return scratch;
+}
 
-if (result.total_nodes_1 < 3 || result.total_nodes_2 < 3) {
-    free_ast(ast1);
-    free_ast(ast2);
-    free_tokens(tokens1);
-    free_tokens(tokens2);
-    strcpy(result.verdict, "Code too simple (less than 3 nodes)");
-    return result;
+static int max_nesting_depth = PARSE_DEFAULT_MAX_DEPTH;
+
+void set_max_nesting_depth(int depth) {
+    if (depth < 1) depth = 1;
+    if (depth > PARSE_MAX_DEPTH_LIMIT) depth = PARSE_MAX_DEPTH_LIMIT;
+    max_nesting_depth = depth;
 }
 
-printf("[DEBUG] Normalizing...\n");
-printf("[DEBUG] AST1 before normalization: %d nodes\n", result.total_nodes_1);
-printf("[DEBUG] AST2 before normalization: %d nodes\n", result.total_nodes_2);
+// One top-level statement, analyzed apart from the rest of the file: a
+// function definition, or a declaration outside any function
+typedef struct {
+    ASTNode *node;
+    int node_count;
+    uint64_t key;             // hash of a function's tokens, else 0
+    int token_count;
+    int analyzed;
+    FunctionAnalysis analysis;
+} AnalysisUnit;
 
-ASTNode *norm1 = normalize_ast(ast1);
-ASTNode *norm2 = normalize_ast(ast2);
+typedef struct {
+    AnalysisUnit *units;
+    const int *pending;       // units still to analyze
+    Arena *scratch;           // the caller's, holding the parse tree
+    Arena *arenas;            // results of workers other than the caller
+    int arena_count;
+} UnitJob;
 
-if (!norm1 || !norm2) {
-    if (norm1) free_ast(norm1);
-    if (norm2) free_ast(norm2);
-    free_ast(ast1);
-    free_ast(ast2);
-    free_tokens(tokens1);
-    free_tokens(tokens2);
-    strcpy(result.verdict, "Normalization failed");
-    return result;
+static int analyze_unit(AnalysisUnit *unit, Arena *arena, Arena *scratch) {
+    ProfileSpan span;
+    FunctionAnalysis *analysis = &unit->analysis;
+    
+    profile_begin(&span, PROF_NORMALIZE);
+    FlatAST *normalized = normalize_ast(unit->node, arena, scratch);
+    profile_end(&span);
+    if (!normalized) return 0;
+    analysis->normalized = *normalized;
+    
+    profile_begin(&span, PROF_BUILD_CFG);
+    int built = build_cfg_fragment(normalized, arena, &analysis->cfg);
+    profile_end(&span);
+    
+    profile_begin(&span, PROF_BUILD_DAG);
+    built = built && build_dag_fragment(normalized, arena, &analysis->dag);
+    profile_end(&span);
+    return built;
 }
 
-// UPDATE node counts AFTER normalization
-int norm_nodes_1 = count_nodes(norm1);
-int norm_nodes_2 = count_nodes(norm2);
-printf("[DEBUG] AST1 after normalization: %d nodes\n", norm_nodes_1);
-printf("[DEBUG] AST2 after normalization: %d nodes\n", norm_nodes_2);
+// Worker 0 is the calling thread and adds to its scratch arena. Any other
+// worker keeps results in its own arena of the job and resets its thread
+// scratch between units.
+static void analyze_unit_chunk(void *ctx, int begin, int end, int worker) {
+    UnitJob *job = (UnitJob*)ctx;
+    Arena *arena = worker == 0 ? job->scratch : &job->arenas[worker];
+    Arena *scratch = worker == 0 ? job->scratch : thread_scratch();
+    
+    for (int k = begin; k < end; k++) {
+        AnalysisUnit *unit = &job->units[job->pending[k]];
+        if (worker != 0 && scratch) arena_reset(scratch);
+        unit->analyzed = scratch && analyze_unit(unit, arena, scratch);
+    }
+}
+
+// Splits the parse tree into units and finds the functions already in
+// the cache; NULL if allocation failed
+static AnalysisUnit* collect_units(ASTNode *ast, const TokenList *tokens, Arena *scratch,
+                                   int *total_nodes) {
+    AnalysisUnit *units = arena_alloc(scratch, sizeof(AnalysisUnit) * (ast->child_count + 1));
+    if (!units) return NULL;
+    
+    *total_nodes = 1;
+    for (int u = 0; u < ast->child_count; u++) {
+        AnalysisUnit *unit = &units[u];
+        memset(unit, 0, sizeof(AnalysisUnit));
+        unit->node = ast->children[u];
+        unit->node_count = count_nodes(unit->node);
+        *total_nodes += unit->node_count;
+        
+        const FunctionSpan *span = unit->node->span;
+        if (unit->node->type != NODE_FUNCTION || !span) continue;
+        LOG_TRACE(LOG_DETECTOR, "Function %s/%d at bytes %d-%d\n", symbol_text(unit->node->symbol),
+                  span->arity, span->offset, span->offset + span->length);
+        
+        // Token symbols spell the function exactly, so equal keys mean an
+        // equal analysis
+        unit->key = content_hash64((const char*)(tokens->symbols + span->first_token),
+                                   sizeof(int) * (size_t)span->token_count);
+        unit->token_count = span->token_count;
+        unit->analyzed = function_cache_get(unit->key, unit->token_count, &unit->analysis, scratch);
+    }
+    return units;
+}
 
-// ✅ ADD THESE LINES:
-printf("\n[AST DEBUG] Printing AST1 structure:\n");
-print_ast_debug(norm1, 0);
-printf("\n[AST DEBUG] Printing AST2 structure:\n");
-print_ast_debug(norm2, 0);
-printf("\n");
+// Analyzes every unit the cache did not have and caches the functions.
+// Results of other workers stay in job->arenas until the caller is done
+// with them.
+static void analyze_units(UnitJob *job, int unit_count, int thread_count) {
+    AnalysisUnit *units = job->units;
+    int *pending = arena_alloc(job->scratch, sizeof(int) * (unit_count + 1));
+    double *costs = arena_alloc(job->scratch, sizeof(double) * (unit_count + 1));
+    if (!pending || !costs) return;
+    job->pending = pending;
+    
+    int pending_count = 0;
+    int pending_nodes = 0;
+    for (int u = 0; u < unit_count; u++) {
+        if (units[u].analyzed) continue;
+        costs[pending_count] = units[u].node_count;
+        pending[pending_count++] = u;
+        pending_nodes += units[u].node_count;
+    }
+    if (pending_count == 0) return;
+    
+    // Starting threads costs more than a small file takes
+    if (pending_nodes < PARALLEL_MIN_NODES) thread_count = 1;
+    if (thread_count > pending_count) thread_count = pending_count;
+    if (thread_count > 1) {
+        job->arenas = calloc(thread_count, sizeof(Arena));
+        if (!job->arenas) thread_count = 1;
+        job->arena_count = job->arenas ? thread_count : 0;
+    }
     
-    result.ast_similarity = calculate_ast_similarity(norm1, norm2);
+    LOG_DEBUG(LOG_DETECTOR, "%d of %d top-level statements cached, analyzing %d on %d threads\n",
+              unit_count - pending_count, unit_count, pending_count, thread_count);
     
-    printf("[DEBUG] Building CFG...\n");  // ADD
-    ControlFlowGraph *cfg1 = build_cfg(norm1);
-    ControlFlowGraph *cfg2 = build_cfg(norm2);
+    int chunk_count = 0;
+    TaskChunk *chunks = split_into_chunks(costs, pending_count, thread_count * 4, &chunk_count);
+    if (!chunks) return;
+    run_work_stealing(chunks, chunk_count, thread_count, analyze_unit_chunk, job);
+    free(chunks);
     
-    if (cfg1 && cfg2 && cfg1->node_count > 2 && cfg2->node_count > 2) {
-        result.cfg_similarity = compare_cfg(cfg1, cfg2);
-    } else {
-        result.cfg_similarity = result.ast_similarity * 0.9;
+    for (int k = 0; k < pending_count; k++) {
+        AnalysisUnit *unit = &units[pending[k]];
+        if (unit->analyzed && unit->key != 0) {
+            function_cache_put(unit->key, unit->token_count, &unit->analysis);
+        }
+    }
+}
+
+// Builds the artifact's tree, CFG and DAG from the analyzed units
+static int join_units(FileArtifact *artifact, AnalysisUnit *units, int unit_count,
+                      Arena *scratch) {
+    FlatAST **trees = arena_alloc(scratch, sizeof(FlatAST*) * (unit_count + 1));
+    CFGFragment *cfgs = arena_alloc(scratch, sizeof(CFGFragment) * (unit_count + 1));
+    DAGFragment *dags = arena_alloc(scratch, sizeof(DAGFragment) * (unit_count + 1));
+    if (!trees || !cfgs || !dags) return 0;
+    
+    for (int u = 0; u < unit_count; u++) {
+        if (!units[u].analyzed) return 0;
+        trees[u] = &units[u].analysis.normalized;
+        cfgs[u] = units[u].analysis.cfg;
+        dags[u] = units[u].analysis.dag;
     }
     
-    printf("[DEBUG] Building DAG...\n");  // ADD
-    DirectedAcyclicGraph *dag1 = build_dag(norm1);
-    DirectedAcyclicGraph *dag2 = build_dag(norm2);
+    artifact->normalized = join_flat_asts(NODE_PROGRAM, SYM_LABEL_PROGRAM, trees, unit_count,
+                                          &artifact->arena);
+    artifact->cfg = join_cfg_fragments(cfgs, unit_count, &artifact->arena, &artifact->cfg_count);
+    artifact->dag = join_dag_fragments(dags, unit_count, &artifact->arena, &artifact->dag_count);
+    return artifact->normalized && artifact->cfg && artifact->dag;
+}
+
+FileArtifact* build_artifact(const char *code, size_t length) {
+    return build_artifact_parallel(code, length, 1);
+}
+
+FileArtifact* build_artifact_parallel(const char *code, size_t length, int thread_count) {
+    FileArtifact *artifact = calloc(1, sizeof(FileArtifact));
+    if (!artifact) return NULL;
     
-    if (dag1 && dag2 && dag1->node_count > 0 && dag2->node_count > 0) {
-        result.dag_similarity = compare_dag(dag1, dag2);
-    } else {
-        result.dag_similarity = result.ast_similarity * 0.85;
+    if (!code || length == 0) {
+        artifact->status = ARTIFACT_EMPTY;
+        return artifact;
     }
     
-    int avg_nodes = (result.total_nodes_1 + result.total_nodes_2) / 2;
-    double w_ast, w_cfg, w_dag;
+    Arena *scratch = thread_scratch();
+    artifact->code_length = length;
+    artifact->code = arena_alloc(&artifact->arena, artifact->code_length + 1);
+    if (!artifact->code || !scratch) {
+        arena_release(&artifact->arena);
+        free(artifact);
+        return NULL;
+    }
+    memcpy(artifact->code, code, artifact->code_length + 1);
+    artifact->code_hash = string_hash(code);
     
-    if (avg_nodes < 10) {
-        w_ast = 0.50;
-        w_cfg = 0.30;
-        w_dag = 0.20;
-    } else if (avg_nodes < 30) {
-        w_ast = 0.35;
-        w_cfg = 0.35;
-        w_dag = 0.30;
-    } else {
-        w_ast = 0.25;
-        w_cfg = 0.40;
-        w_dag = 0.35;
+    ProfileSpan span;
+    
+    LOG_DEBUG(LOG_DETECTOR, "Tokenizing...\n");
+    profile_begin(&span, PROF_TOKENIZE);
+    TokenList *tokens = tokenize(code, length);
+    profile_end(&span);
+    
+    if (!tokens) {
+        artifact->status = ARTIFACT_TOKENIZE_FAILED;
+        return artifact;
+    }
+    if (tokens->count < 5) {
+        free_tokens(tokens);
+        artifact->status = ARTIFACT_TOO_SMALL;
+        return artifact;
     }
     
-    result.overall_score = (w_ast * result.ast_similarity) +
-                          (w_cfg * result.cfg_similarity) +
-                          (w_dag * result.dag_similarity);
+    profile_begin(&span, PROF_WINNOW);
+    artifact->fingerprints = winnow_tokens(tokens);
+    profile_end(&span);
+    
+    LOG_DEBUG(LOG_DETECTOR, "Parsing...\n");
+    profile_begin(&span, PROF_PARSE);
+    arena_reset(scratch);
+    int too_deep = 0;
+    ASTNode *ast = parse(tokens, scratch, max_nesting_depth, &too_deep);
+    profile_end(&span);
+    
+    LOG_DEBUG(LOG_PARSER, "AST root type: %d, children: %d\n", 
+              ast ? (int)ast->type : -1, ast ? ast->child_count : 0);
+    if (ast && LOG_ENABLED(LOG_LEVEL_TRACE, LOG_PARSER)) {
+        for (int i = 0; i < ast->child_count; i++) {
+            LOG_TRACE(LOG_PARSER, "AST child[%d] type: %d\n", i, 
+                      ast->children[i] ? (int)ast->children[i]->type : -1);
+        }
+    }
     
-    double min_score = min_double(result.ast_similarity,
-                                  min_double(result.cfg_similarity, result.dag_similarity));
-    double max_score = max_double(result.ast_similarity,
-                                  max_double(result.cfg_similarity, result.dag_similarity));
+    if (too_deep) {
+        free_tokens(tokens);
+        artifact->status = ARTIFACT_TOO_DEEP;
+        return artifact;
+    }
+    if (!ast) {
+        free_tokens(tokens);
+        artifact->status = ARTIFACT_PARSE_FAILED;
+        return artifact;
+    }
     
-    double variance = max_score - min_score;
+    AnalysisUnit *units = collect_units(ast, tokens, scratch, &artifact->total_nodes);
+    free_tokens(tokens);
+    if (!units) {
+        artifact->status = ARTIFACT_NORMALIZE_FAILED;
+        return artifact;
+    }
+    if (artifact->total_nodes < 3) {
+        artifact->status = ARTIFACT_TOO_SIMPLE;
+        return artifact;
+    }
     
-    if (variance < 0.15 && result.overall_score > 0.6) {
-        result.overall_score = min_double(1.0, result.overall_score * 1.08);
-    } else if (variance > 0.35) {
-        result.overall_score *= 0.92;
+    LOG_DEBUG(LOG_DETECTOR, "Analyzing %d top-level statements, %d nodes\n",
+              ast->child_count, artifact->total_nodes);
+    
+    UnitJob job = {units, NULL, scratch, NULL, 0};
+    analyze_units(&job, ast->child_count, thread_count);
+    int joined = join_units(artifact, units, ast->child_count, scratch);
+    for (int w = 0; w < job.arena_count; w++) {
+        arena_release(&job.arenas[w]);
     }
+    free(job.arenas);
     
-    double size_ratio = (double)min_int(result.total_nodes_1, result.total_nodes_2) /
-                        (double)max_int(result.total_nodes_1, result.total_nodes_2);
+    if (!joined) {
+        artifact->status = ARTIFACT_NORMALIZE_FAILED;
+        return artifact;
+    }
     
-    if (size_ratio < 0.4) {
-        result.overall_score *= 0.75;
-    } else if (size_ratio < 0.6) {
-        result.overall_score *= 0.90;
+    LOG_DEBUG(LOG_DETECTOR, "AST after normalization: %d nodes, CFG %d nodes, DAG %d nodes\n",
+              artifact->normalized->count, artifact->cfg_count, artifact->dag_count);
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_TRACE
+    if (LOG_ENABLED(LOG_LEVEL_TRACE, LOG_DETECTOR)) {
+        print_ast_debug(artifact->normalized);
     }
+#endif
     
-    if (result.overall_score < 0.0) result.overall_score = 0.0;
-    if (result.overall_score > 1.0) result.overall_score = 1.0;
+    artifact->status = ARTIFACT_OK;
+    return artifact;
+}
+
+void free_artifact(FileArtifact *artifact) {
+    if (!artifact) return;
     
-    determine_verdict(&result);
+    // Code, normalized AST, CFG and DAG all live in the artifact's arena
+    arena_release(&artifact->arena);
+    if (artifact->fingerprints) free_fingerprints(artifact->fingerprints);
+    free(artifact);
+}
+
+const char* artifact_status_verdict(ArtifactStatus status) {
+    switch (status) {
+        case ARTIFACT_EMPTY:            return "Empty code";
+        case ARTIFACT_TOKENIZE_FAILED:  return "Failed to tokenize - out of memory or symbols";
+        case ARTIFACT_TOO_SMALL:        return "Code too small (less than 5 tokens)";
+        case ARTIFACT_PARSE_FAILED:     return "Failed to parse - syntax errors";
+        case ARTIFACT_TOO_DEEP:         return "Code nested too deeply to analyze";
+        case ARTIFACT_TOO_SIMPLE:       return "Code too simple (less than 3 nodes)";
+        case ARTIFACT_NORMALIZE_FAILED: return "Normalization failed";
+        default:                        return "Unable to analyze";
+    }
+}
+
+PlagiarismResult compare_artifacts(const FileArtifact *a1, const FileArtifact *a2) {
+    PlagiarismResult result = {0};
+    strcpy(result.verdict, "Unable to analyze");
     
-    free_tokens(tokens1);
-    free_tokens(tokens2);
-    free_ast(ast1);
-    free_ast(ast2);
-    free_ast(norm1);
-    free_ast(norm2);
-    if (cfg1) free_cfg(cfg1);
-    if (cfg2) free_cfg(cfg2);
-    if (dag1) free_dag(dag1);
-    if (dag2) free_dag(dag2);
+    if (!a1 || !a2) {
+        strcpy(result.verdict, "NULL input");
+        return result;
+    }
+    
+    if (a1->status == ARTIFACT_EMPTY || a2->status == ARTIFACT_EMPTY) {
+        strcpy(result.verdict, artifact_status_verdict(ARTIFACT_EMPTY));
+        return result;
+    }
+    
+    if (a1->code_hash == a2->code_hash && a1->code_length == a2->code_length &&
+        strcmp(a1->code, a2->code) == 0) {
+        result.overall_score = 1.0;
+        result.ast_similarity = 1.0;
+        result.cfg_similarity = 1.0;
+        result.dag_similarity = 1.0;
+        result.winnow_similarity = 1.0;
+        strcpy(result.verdict, "EXACT COPY - 100% identical");
+        return result;
+    }
+    
+    // Report the earliest stage that failed on either side
+    if (a1->status != ARTIFACT_OK || a2->status != ARTIFACT_OK) {
+        ArtifactStatus status = a1->status;
+        if (status == ARTIFACT_OK || (a2->status != ARTIFACT_OK && a2->status < status)) {
+            status = a2->status;
+        }
+        if (status >= ARTIFACT_TOO_SIMPLE) {
+            result.total_nodes_1 = a1->total_nodes;
+            result.total_nodes_2 = a2->total_nodes;
+        }
+        strcpy(result.verdict, artifact_status_verdict(status));
+        return result;
+    }
+    
+    result.total_nodes_1 = a1->total_nodes;
+    result.total_nodes_2 = a2->total_nodes;
+    
+    ProfileSpan span;
+    
+    profile_begin(&span, PROF_AST_SIMILARITY);
+    result.ast_similarity = calculate_ast_similarity(a1->normalized, a2->normalized);
+    profile_end(&span);
+    
+    profile_begin(&span, PROF_WINNOW_SIMILARITY);
+    result.winnow_similarity = compare_fingerprints(a1->fingerprints, a2->fingerprints);
+    profile_end(&span);
+    
+    if (a1->cfg_count > 2 && a2->cfg_count > 2) {
+        profile_begin(&span, PROF_CFG_SIMILARITY);
+        result.cfg_similarity = compare_cfg_summary(a1->cfg, a1->cfg_count, a2->cfg, a2->cfg_count);
+        profile_end(&span);
+    } else {
+        result.cfg_similarity = result.ast_similarity * 0.9;
+    }
+    
+    if (a1->dag_count > 0 && a2->dag_count > 0) {
+        profile_begin(&span, PROF_DAG_SIMILARITY);
+        result.dag_similarity = compare_dag_summary(a1->dag, a1->dag_count, a2->dag, a2->dag_count);
+        profile_end(&span);
+    } else {
+        result.dag_similarity = result.ast_similarity * 0.85;
+    }
+    
+    finalize_result(&result);
     
     return result;
-}
\ No newline at end of file
+}
+
+PlagiarismResult detect_plagiarism(const char *code1, const char *code2) {
+    if (!code1 || !code2) {
+        PlagiarismResult result = {0};
+        LOG_DEBUG(LOG_DETECTOR, "NULL input\n");
+        strcpy(result.verdict, "NULL input");
+        return result;
+    }
+    
+    FileArtifact *a1 = build_artifact(code1, strlen(code1));
+    FileArtifact *a2 = build_artifact(code2, strlen(code2));
+    
+    PlagiarismResult result = compare_artifacts(a1, a2);
+    
+    free_artifact(a1);
+    free_artifact(a2);
+    
+    return result;
+}
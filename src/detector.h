@@ -1,16 +1,79 @@
 #ifndef DETECTOR_H
 #define DETECTOR_H
 
+#include <stddef.h>
+#include "ast.h"
+#include "cfg.h"
+#include "dag.h"
+#include "winnow.h"
+
+// Bump whenever a change alters what build_artifact produces, so
+// persisted corpus entries from older engines get rebuilt
+#define ENGINE_VERSION 9
+
+// Files that parse to fewer nodes than this analyze their functions on
+// the calling thread even when more threads are offered
+#define PARALLEL_MIN_NODES 4096
+
 typedef struct {
     double overall_score;
     double ast_similarity;
     double cfg_similarity;
     double dag_similarity;
+    double winnow_similarity;
     int total_nodes_1;
     int total_nodes_2;
     char verdict[256];
 } PlagiarismResult;
 
+// Pipeline stage that rejected a file, in the order the stages run
+typedef enum {
+    ARTIFACT_OK,
+    ARTIFACT_EMPTY,
+    ARTIFACT_TOKENIZE_FAILED,
+    ARTIFACT_TOO_SMALL,
+    ARTIFACT_PARSE_FAILED,
+    ARTIFACT_TOO_DEEP,
+    ARTIFACT_TOO_SIMPLE,
+    ARTIFACT_NORMALIZE_FAILED
+} ArtifactStatus;
+
+// Everything the comparison needs from one file, built once per file.
+// Each top-level statement (in practice each function) is analyzed on
+// its own and the results joined, so the CFG and DAG are kept in the
+// summary form a corpus record stores.
+typedef struct {
+    ArtifactStatus status;
+    char *code;
+    size_t code_length;
+    unsigned long code_hash;
+    int total_nodes;
+    FlatAST *normalized;
+    CFGSummaryNode *cfg;
+    int cfg_count;
+    DAGSummaryNode *dag;
+    int dag_count;
+    Fingerprints *fingerprints;
+    Arena arena;          // owns code, normalized, cfg and dag
+} FileArtifact;
+
+// code[length] must be readable and '\0' (a FileView or a C string)
+FileArtifact* build_artifact(const char *code, size_t length);
+// Same, analyzing the functions of a large file on up to thread_count
+// threads; for callers that build one file at a time
+FileArtifact* build_artifact_parallel(const char *code, size_t length, int thread_count);
+void free_artifact(FileArtifact *artifact);
+// Statement and bracket nesting deeper than depth is rejected as
+// ARTIFACT_TOO_DEEP; set before building artifacts
+void set_max_nesting_depth(int depth);
+PlagiarismResult compare_artifacts(const FileArtifact *a1, const FileArtifact *a2);
+
+// Combines the per-metric similarities and node counts already in
+// result into overall_score and verdict
+void finalize_result(PlagiarismResult *result);
+const char* artifact_status_verdict(ArtifactStatus status);
+double calculate_ast_similarity(const FlatAST *t1, const FlatAST *t2);
+
 PlagiarismResult detect_plagiarism(const char *code1, const char *code2);
 
-#endif
\ No newline at end of file
+#endif
@@ -1,3 +1,7 @@
+#ifndef _WIN32
+    #define _DEFAULT_SOURCE
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -6,9 +10,14 @@
     #include <windows.h>
 #else
     #include <dirent.h>
+    #include <sys/stat.h>
 #endif
 
 #include "directory_handler.h"
+#include "utils.h"
+#include "log.h"
+
+#define PATH_BLOCK_SIZE 65536
 
 int endsWithC(const char* filename) {
     int len = strlen(filename);
@@ -23,120 +32,354 @@ int endsWithC(const char* filename) {
     return 0;
 }
 
-#ifdef _WIN32
+int parseExtensionFilter(const char* spec, ExtensionFilter* filter) {
+    if (spec == NULL || filter == NULL) {
+        return 0;
+    }
+    
+    filter->count = 0;
+    const char* p = spec;
+    while (*p != '\0' && filter->count < MAX_EXTENSIONS) {
+        const char* comma = strchr(p, ',');
+        int len = comma ? (int)(comma - p) : (int)strlen(p);
+        
+        if (len > 0 && len < MAX_EXTENSION_LENGTH - 1) {
+            char* ext = filter->extensions[filter->count];
+            int n = 0;
+            if (p[0] != '.') ext[n++] = '.';
+            memcpy(ext + n, p, len);
+            ext[n + len] = '\0';
+            filter->count++;
+        }
+        
+        if (!comma) break;
+        p = comma + 1;
+    }
+    
+    return filter->count;
+}
 
-FileList* scanDirectory(const char* directoryPath) {
-    FileList* list = (FileList*)malloc(sizeof(FileList));
+int matchesExtension(const char* filename, const ExtensionFilter* filter) {
+    if (filter == NULL || filter->count == 0) {
+        return endsWithC(filename);
+    }
+    
+    size_t len = strlen(filename);
+    for (int i = 0; i < filter->count; i++) {
+        size_t ext_len = strlen(filter->extensions[i]);
+        if (len > ext_len && strcmp(filename + len - ext_len, filter->extensions[i]) == 0) {
+            return 1;
+        }
+    }
+    
+    return 0;
+}
+
+FileList* createFileList(void) {
+    FileList* list = (FileList*)calloc(1, sizeof(FileList));
     if (list == NULL) {
-        printf("[ERROR] Memory allocation failed\n");
-        return NULL;
+        LOG_ERROR(LOG_IO, "Memory allocation failed\n");
     }
+    return list;
+}
+
+static char* storePath(FileList* list, const char* path) {
+    int len = strlen(path) + 1;
+    PathBlock* block = list->blocks;
     
-    list->count = 0;
+    if (block == NULL || block->size - block->used < len) {
+        int size = len > PATH_BLOCK_SIZE ? len : PATH_BLOCK_SIZE;
+        PathBlock* fresh = (PathBlock*)malloc(sizeof(PathBlock) + size);
+        if (fresh == NULL) {
+            return NULL;
+        }
+        fresh->next = list->blocks;
+        fresh->used = 0;
+        fresh->size = size;
+        list->blocks = fresh;
+        block = fresh;
+    }
     
-    char searchPath[MAX_PATH_LENGTH];
-    snprintf(searchPath, MAX_PATH_LENGTH, "%s\\*.c", directoryPath);
+    char* stored = block->data + block->used;
+    memcpy(stored, path, len);
+    block->used += len;
+    return stored;
+}
+
+int appendFilePath(FileList* list, const char* path) {
+    if (list == NULL || path == NULL) {
+        return 0;
+    }
     
-    WIN32_FIND_DATA findData;
-    HANDLE hFind = FindFirstFile(searchPath, &findData);
+    if (list->count >= list->capacity) {
+        int capacity = list->capacity ? list->capacity * 2 : 64;
+        char** paths = (char**)realloc(list->paths, sizeof(char*) * capacity);
+        if (paths == NULL) {
+            LOG_ERROR(LOG_IO, "Memory allocation failed\n");
+            return 0;
+        }
+        list->paths = paths;
+        list->capacity = capacity;
+    }
     
-    if (hFind == INVALID_HANDLE_VALUE) {
-        printf("[ERROR] Cannot open directory: %s\n", directoryPath);
-        free(list);
-        return NULL;
+    char* stored = storePath(list, path);
+    if (stored == NULL) {
+        LOG_ERROR(LOG_IO, "Memory allocation failed\n");
+        return 0;
     }
     
-    do {
-        if (!(findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
-            if (endsWithC(findData.cFileName)) {
-                snprintf(list->paths[list->count], MAX_PATH_LENGTH, 
-                         "%s\\%s", directoryPath, findData.cFileName);
-                list->count++;
-                
-                if (list->count >= MAX_FILES) {
-                    break;
-                }
-            }
+    list->paths[list->count++] = stored;
+    return 1;
+}
+
+// Directories still to be visited; an explicit stack keeps deep trees off
+// the call stack
+typedef struct {
+    char** items;
+    int count;
+    int capacity;
+} DirStack;
+
+static int pushDir(DirStack* stack, const char* path) {
+    if (stack->count >= stack->capacity) {
+        int capacity = stack->capacity ? stack->capacity * 2 : 32;
+        char** items = (char**)realloc(stack->items, sizeof(char*) * capacity);
+        if (items == NULL) {
+            return 0;
         }
-    } while (FindNextFile(hFind, &findData) != 0);
+        stack->items = items;
+        stack->capacity = capacity;
+    }
+    
+    char* copy = (char*)malloc(strlen(path) + 1);
+    if (copy == NULL) {
+        return 0;
+    }
+    strcpy(copy, path);
+    stack->items[stack->count++] = copy;
+    return 1;
+}
+
+static void freeDirStack(DirStack* stack) {
+    for (int i = 0; i < stack->count; i++) {
+        free(stack->items[i]);
+    }
+    free(stack->items);
+}
+
+#ifdef _WIN32
+
+int walkDirectory(const char* directoryPath, const ExtensionFilter* filter,
+                  int recursive, FileVisitor visit, void* user) {
+    DirStack stack = {NULL, 0, 0};
+    int found = 0;
+    int stop = 0;
+    int first = 1;
     
-    FindClose(hFind);
+    if (!pushDir(&stack, directoryPath)) {
+        LOG_ERROR(LOG_IO, "Memory allocation failed\n");
+        return -1;
+    }
     
-    printf("[OK] Found %d .c files\n", list->count);
-    return list;
+    while (stack.count > 0 && !stop) {
+        char* dirPath = stack.items[--stack.count];
+        
+        char searchPath[MAX_PATH_LENGTH];
+        snprintf(searchPath, MAX_PATH_LENGTH, "%s\\*", dirPath);
+        
+        WIN32_FIND_DATA findData;
+        HANDLE hFind = FindFirstFile(searchPath, &findData);
+        
+        if (hFind == INVALID_HANDLE_VALUE) {
+            LOG_ERROR(LOG_IO, "Cannot open directory: %s\n", dirPath);
+            free(dirPath);
+            if (first) {
+                freeDirStack(&stack);
+                return -1;
+            }
+            continue;
+        }
+        first = 0;
+        
+        do {
+            const char* name = findData.cFileName;
+            if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+                continue;
+            }
+            
+            char fullPath[MAX_PATH_LENGTH];
+            snprintf(fullPath, MAX_PATH_LENGTH, "%s\\%s", dirPath, name);
+            
+            if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+                // Junctions and symlinks could loop back on themselves
+                if (recursive && !(findData.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)) {
+                    pushDir(&stack, fullPath);
+                }
+            } else if (matchesExtension(name, filter)) {
+                found++;
+                if (visit(fullPath, user) != 0) {
+                    stop = 1;
+                }
+            }
+        } while (!stop && FindNextFile(hFind, &findData) != 0);
+        
+        FindClose(hFind);
+        free(dirPath);
+    }
+    
+    freeDirStack(&stack);
+    return found;
 }
 
 #else
 
-FileList* scanDirectory(const char* directoryPath) {
-    FileList* list = (FileList*)malloc(sizeof(FileList));
-    if (list == NULL) {
-        printf("[ERROR] Memory allocation failed\n");
-        return NULL;
+int walkDirectory(const char* directoryPath, const ExtensionFilter* filter,
+                  int recursive, FileVisitor visit, void* user) {
+    DirStack stack = {NULL, 0, 0};
+    int found = 0;
+    int stop = 0;
+    int first = 1;
+    
+    if (!pushDir(&stack, directoryPath)) {
+        LOG_ERROR(LOG_IO, "Memory allocation failed\n");
+        return -1;
     }
     
-    list->count = 0;
+    while (stack.count > 0 && !stop) {
+        char* dirPath = stack.items[--stack.count];
+        
+        DIR* dir = opendir(dirPath);
+        if (dir == NULL) {
+            LOG_ERROR(LOG_IO, "Cannot open directory: %s\n", dirPath);
+            free(dirPath);
+            if (first) {
+                freeDirStack(&stack);
+                return -1;
+            }
+            continue;
+        }
+        first = 0;
+        
+        size_t dirLen = strlen(dirPath);
+        struct dirent* entry;
+        while (!stop && (entry = readdir(dir)) != NULL) {
+            const char* name = entry->d_name;
+            if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+                continue;
+            }
+            
+            size_t nameLen = strlen(name);
+            if (dirLen + nameLen + 2 > MAX_PATH_LENGTH) {
+                LOG_WARN(LOG_IO, "Path too long, skipping: %s/%s\n", dirPath, name);
+                continue;
+            }
+            
+            char fullPath[MAX_PATH_LENGTH];
+            memcpy(fullPath, dirPath, dirLen);
+            fullPath[dirLen] = '/';
+            memcpy(fullPath + dirLen + 1, name, nameLen + 1);
+            
+            // d_type saves a stat per entry on filesystems that fill it in.
+            // Symlinked directories are not followed so links cannot loop.
+            int isDir = 0;
+            int isFile = 0;
+            if (entry->d_type == DT_DIR) {
+                isDir = 1;
+            } else if (entry->d_type == DT_REG) {
+                isFile = 1;
+            } else if (entry->d_type == DT_UNKNOWN || entry->d_type == DT_LNK) {
+                struct stat st;
+                if (lstat(fullPath, &st) == 0 && S_ISDIR(st.st_mode)) {
+                    isDir = 1;
+                } else if (stat(fullPath, &st) == 0 && S_ISREG(st.st_mode)) {
+                    isFile = 1;
+                }
+            }
+            
+            if (isDir) {
+                if (recursive) {
+                    pushDir(&stack, fullPath);
+                }
+            } else if (isFile && matchesExtension(name, filter)) {
+                found++;
+                if (visit(fullPath, user) != 0) {
+                    stop = 1;
+                }
+            }
+        }
+        
+        closedir(dir);
+        free(dirPath);
+    }
     
-    DIR* dir = opendir(directoryPath);
-    if (dir == NULL) {
-        printf("[ERROR] Cannot open directory: %s\n", directoryPath);
-        free(list);
+    freeDirStack(&stack);
+    return found;
+}
+
+#endif
+
+static int collectPath(const char* path, void* user) {
+    return appendFilePath((FileList*)user, path) ? 0 : 1;
+}
+
+FileList* scanDirectoryFiltered(const char* directoryPath, const ExtensionFilter* filter,
+                                int recursive) {
+    FileList* list = createFileList();
+    if (list == NULL) {
         return NULL;
     }
     
-    struct dirent* entry;
-    while ((entry = readdir(dir)) != NULL && list->count < MAX_FILES) {
-        if (endsWithC(entry->d_name)) {
-            snprintf(list->paths[list->count], MAX_PATH_LENGTH, 
-                     "%s/%s", directoryPath, entry->d_name);
-            list->count++;
-        }
+    if (walkDirectory(directoryPath, filter, recursive, collectPath, list) < 0) {
+        freeFileList(list);
+        return NULL;
     }
     
-    closedir(dir);
-    
-    printf("[OK] Found %d .c files\n", list->count);
+    LOG_INFO(LOG_IO, "Found %d source files\n", list->count);
     return list;
 }
 
-#endif
+FileList* scanDirectory(const char* directoryPath) {
+    return scanDirectoryFiltered(directoryPath, NULL, 1);
+}
 
 void printFileList(FileList* list) {
     if (list == NULL) {
-        printf("[ERROR] File list is NULL\n");
+        LOG_ERROR(LOG_IO, "File list is NULL\n");
         return;
     }
     
-    printf("\n========================================\n");
-    printf("DETECTED C FILES: %d\n", list->count);
-    printf("========================================\n");
+    diag_printf("\n========================================\n");
+    diag_printf("DETECTED C FILES: %d\n", list->count);
+    diag_printf("========================================\n");
     
     for (int i = 0; i < list->count; i++) {
-        printf("[%d] %s\n", i + 1, list->paths[i]);
+        diag_printf("[%d] %s\n", i + 1, list->paths[i]);
     }
     
-    printf("========================================\n\n");
+    diag_printf("========================================\n\n");
 }
 
 void freeFileList(FileList* list) {
     if (list != NULL) {
+        cleanup_file_list(list);
         free(list);
     }
 }
-// ADD THESE AT THE END OF directory_handler.c
 
 void traverse_directory(const char *path, FileList *files) {
-    FileList* result = scanDirectory(path);
-    if (result) {
-        files->count = result->count;
-        for (int i = 0; i < result->count; i++) {
-            strcpy(files->paths[i], result->paths[i]);
-        }
-        freeFileList(result);
-    }
+    walkDirectory(path, NULL, 1, collectPath, files);
 }
 
 void cleanup_file_list(FileList *files) {
-    // Nothing to free since paths is static array
+    PathBlock* block = files->blocks;
+    while (block != NULL) {
+        PathBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+    free(files->paths);
+    files->paths = NULL;
+    files->blocks = NULL;
     files->count = 0;
-}
\ No newline at end of file
+    files->capacity = 0;
+}
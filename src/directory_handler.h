@@ -1,20 +1,50 @@
 #ifndef DIRECTORY_HANDLER_H
 #define DIRECTORY_HANDLER_H
 
-#define MAX_FILES 100
-#define MAX_PATH_LENGTH 512
+#define MAX_PATH_LENGTH 4096
+#define MAX_EXTENSIONS 16
+#define MAX_EXTENSION_LENGTH 16
+
+// Path strings live in a chain of blocks owned by the list
+typedef struct PathBlock {
+    struct PathBlock *next;
+    int used;
+    int size;
+    char data[];
+} PathBlock;
 
 typedef struct {
-    char paths[MAX_FILES][MAX_PATH_LENGTH];
+    char **paths;
     int count;
+    int capacity;
+    PathBlock *blocks;
 } FileList;
 
+typedef struct {
+    char extensions[MAX_EXTENSIONS][MAX_EXTENSION_LENGTH];
+    int count;
+} ExtensionFilter;
+
+// Called for every matching file as soon as it is found.
+// Return non-zero to stop the walk early.
+typedef int (*FileVisitor)(const char *path, void *user);
+
 void traverse_directory(const char *path, FileList *files);
 void cleanup_file_list(FileList *files);
 
+FileList* createFileList(void);
+int appendFilePath(FileList* list, const char* path);
+
+int parseExtensionFilter(const char* spec, ExtensionFilter* filter);
+int matchesExtension(const char* filename, const ExtensionFilter* filter);
+int walkDirectory(const char* directoryPath, const ExtensionFilter* filter,
+                  int recursive, FileVisitor visit, void* user);
+
 FileList* scanDirectory(const char* directoryPath);
+FileList* scanDirectoryFiltered(const char* directoryPath, const ExtensionFilter* filter,
+                                int recursive);
 void freeFileList(FileList* list);
 void printFileList(FileList* list);
 int endsWithC(const char* filename);
 
-#endif
\ No newline at end of file
+#endif
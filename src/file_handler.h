@@ -1,9 +1,34 @@
 #ifndef FILE_HANDLER_H
 #define FILE_HANDLER_H
 
-char* read_file(const char *filename);
-int fileExists(const char* filename);
-long getFileSize(const char* filename);
-char* readFile(const char* filename);
+#include <stddef.h>
 
-#endif
\ No newline at end of file
+// Read-only view of one file's bytes. Large files are mapped, small ones
+// are read into a buffer; either way data[length] is a readable '\0', so
+// the lexer can scan the view in place. length is the file's size, so a
+// '\0' inside the file does not end the text. Release every opened view.
+typedef struct {
+    const char *data;
+    size_t length;
+    void *base;           // mapping or buffer backing data
+    size_t mapped_size;   // 0 when base is a malloc copy
+} FileView;
+
+// One open + fstat + mmap (or read); returns 1 on success
+int openFileView(const char *filename, FileView *view);
+void releaseFileView(FileView *view);
+
+// Files per openFileViews call in the ingestion loops: enough to keep
+// readahead busy, few enough that the open views stay small
+#define VIEW_BATCH 64
+
+// Opens count files, first asking the kernel to read them all ahead so
+// later views fault in from the page cache. Failed entries get data NULL.
+// Returns the number opened.
+int openFileViews(const char *const *filenames, int count, FileView *views);
+
+// 1 when both paths name the same file (device and inode, or the full
+// path on Windows), however they are spelled
+int sameFile(const char *a, const char *b);
+
+#endif
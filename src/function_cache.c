@@ -0,0 +1,110 @@
+#include "function_cache.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+// One function in a single block: the header, then the tree's hashes,
+// the DAG summaries, the tree's nodes and the CFG summaries, each section
+// a multiple of 8 bytes so the next one stays aligned
+typedef struct {
+    uint64_t key;
+    int token_count;
+    int node_count;
+    int cfg_count;
+    int cfg_exit;
+    int dag_count;
+    int reserved;
+} CachedFunction;
+
+static CachedFunction *slots[FUNCTION_CACHE_SLOTS];
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static CachedFunction** slot_for(uint64_t key) {
+    return &slots[(key ^ (key >> 32)) % FUNCTION_CACHE_SLOTS];
+}
+
+static uint64_t* section_hashes(CachedFunction *entry) {
+    return (uint64_t*)(entry + 1);
+}
+
+static DAGSummaryNode* section_dag(CachedFunction *entry) {
+    return (DAGSummaryNode*)(section_hashes(entry) + entry->node_count);
+}
+
+static FlatNode* section_nodes(CachedFunction *entry) {
+    return (FlatNode*)(section_dag(entry) + entry->dag_count);
+}
+
+static CFGSummaryNode* section_cfg(CachedFunction *entry) {
+    return (CFGSummaryNode*)(section_nodes(entry) + entry->node_count);
+}
+
+int function_cache_get(uint64_t key, int token_count, FunctionAnalysis *analysis,
+                       Arena *arena) {
+    pthread_mutex_lock(&cache_lock);
+    CachedFunction *entry = *slot_for(key);
+    if (!entry || entry->key != key || entry->token_count != token_count) {
+        pthread_mutex_unlock(&cache_lock);
+        return 0;
+    }
+
+    // Copied under the lock, since a put may replace the entry right after
+    FlatAST *tree = &analysis->normalized;
+    tree->count = entry->node_count;
+    tree->nodes = arena_alloc(arena, sizeof(FlatNode) * entry->node_count);
+    tree->hashes = arena_alloc(arena, sizeof(uint64_t) * entry->node_count);
+    analysis->cfg.count = entry->cfg_count;
+    analysis->cfg.exit = entry->cfg_exit;
+    analysis->cfg.nodes = arena_alloc(arena, sizeof(CFGSummaryNode) * (entry->cfg_count + 1));
+    analysis->dag.count = entry->dag_count;
+    analysis->dag.nodes = arena_alloc(arena, sizeof(DAGSummaryNode) * (entry->dag_count + 1));
+    int found = tree->nodes && tree->hashes && analysis->cfg.nodes && analysis->dag.nodes;
+    if (found) {
+        memcpy(tree->nodes, section_nodes(entry), sizeof(FlatNode) * entry->node_count);
+        memcpy(tree->hashes, section_hashes(entry), sizeof(uint64_t) * entry->node_count);
+        memcpy(analysis->cfg.nodes, section_cfg(entry), sizeof(CFGSummaryNode) * entry->cfg_count);
+        memcpy(analysis->dag.nodes, section_dag(entry), sizeof(DAGSummaryNode) * entry->dag_count);
+    }
+    pthread_mutex_unlock(&cache_lock);
+    return found;
+}
+
+void function_cache_put(uint64_t key, int token_count, const FunctionAnalysis *analysis) {
+    const FlatAST *tree = &analysis->normalized;
+    size_t bytes = sizeof(CachedFunction) +
+                   (sizeof(uint64_t) + sizeof(FlatNode)) * tree->count +
+                   sizeof(DAGSummaryNode) * analysis->dag.count +
+                   sizeof(CFGSummaryNode) * analysis->cfg.count;
+    CachedFunction *entry = malloc(bytes);
+    if (!entry) return;
+    
+    entry->key = key;
+    entry->token_count = token_count;
+    entry->node_count = tree->count;
+    entry->cfg_count = analysis->cfg.count;
+    entry->cfg_exit = analysis->cfg.exit;
+    entry->dag_count = analysis->dag.count;
+    entry->reserved = 0;
+    memcpy(section_hashes(entry), tree->hashes, sizeof(uint64_t) * tree->count);
+    memcpy(section_dag(entry), analysis->dag.nodes, sizeof(DAGSummaryNode) * analysis->dag.count);
+    memcpy(section_nodes(entry), tree->nodes, sizeof(FlatNode) * tree->count);
+    if (analysis->cfg.count > 0) {
+        memcpy(section_cfg(entry), analysis->cfg.nodes, sizeof(CFGSummaryNode) * analysis->cfg.count);
+    }
+    
+    pthread_mutex_lock(&cache_lock);
+    CachedFunction **slot = slot_for(key);
+    CachedFunction *old = *slot;
+    *slot = entry;
+    pthread_mutex_unlock(&cache_lock);
+    free(old);
+}
+
+void function_cache_clear(void) {
+    pthread_mutex_lock(&cache_lock);
+    for (int i = 0; i < FUNCTION_CACHE_SLOTS; i++) {
+        free(slots[i]);
+        slots[i] = NULL;
+    }
+    pthread_mutex_unlock(&cache_lock);
+}
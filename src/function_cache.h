@@ -0,0 +1,36 @@
+#ifndef FUNCTION_CACHE_H
+#define FUNCTION_CACHE_H
+
+#include <stdint.h>
+#include "ast.h"
+#include "cfg.h"
+#include "dag.h"
+
+// Process-wide cache of analyzed function definitions, keyed by their
+// token sequence. A function is analyzed on its own, so a file that
+// shares functions with one seen before (a resubmission, a common
+// template) only analyzes the functions that changed. Slots are mapped
+// directly: a new function whose key lands on a taken slot replaces it.
+
+#define FUNCTION_CACHE_SLOTS 4096
+
+// What an artifact keeps of one function
+typedef struct {
+    FlatAST normalized;
+    CFGFragment cfg;
+    DAGFragment dag;
+} FunctionAnalysis;
+
+// Copies the analysis stored for key into arena. token_count is checked
+// too, as a guard against two sequences sharing a key. 0 on a miss.
+int function_cache_get(uint64_t key, int token_count, FunctionAnalysis *analysis,
+                       Arena *arena);
+
+// Stores a copy of analysis; safe to call from any thread
+void function_cache_put(uint64_t key, int token_count, const FunctionAnalysis *analysis);
+
+// Drops every entry; keys are built from symbol IDs, so this goes with
+// symbol_reset
+void function_cache_clear(void);
+
+#endif
@@ -0,0 +1,725 @@
+#ifndef _WIN32
+    #define _DEFAULT_SOURCE
+#endif
+
+#include "ingest.h"
+#include "file_handler.h"
+#include "thread_pool.h"
+#include "utils.h"
+#include "log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+
+#ifdef __linux__
+    #define INGEST_URING 1
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <errno.h>
+    #include <sys/mman.h>
+    #include <sys/syscall.h>
+    #include <linux/io_uring.h>
+    #include <linux/stat.h>
+#endif
+
+typedef struct {
+    int files_read;
+    int files_failed;
+    long long bytes;
+} WorkerCounts;
+
+#ifdef INGEST_URING
+// Raw io_uring: one submission and one completion ring per worker, mapped
+// from the kernel. Only this worker writes the SQ tail and CQ head.
+typedef struct {
+    int fd;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_map, *cq_map;
+    size_t sq_map_size, cq_map_size, sqes_size;
+    unsigned sq_entries;
+    unsigned unsubmitted;
+} Ring;
+
+enum { RING_UNTRIED, RING_READY, RING_UNAVAILABLE, RING_BROKEN };
+
+// user_data packs the slot and which request completed
+enum { OP_OPEN, OP_STATX, OP_READ };
+#define USER_DATA(slot, op) ((unsigned long long)(slot) * 4 + (op))
+
+typedef struct {
+    int index;          // -1 when the slot is free
+    const char *path;
+    int fd;
+    int outstanding;    // requests still in the ring
+    int reading;        // 0 while opening and sizing, 1 while reading
+    int failed;
+    struct statx stx;
+    char *buffer;
+    size_t size;
+    size_t got;
+    int last_read;
+} Slot;
+
+static void ring_destroy(Ring *ring) {
+    if (ring->sqes) munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_map && ring->cq_map != ring->sq_map) munmap(ring->cq_map, ring->cq_map_size);
+    if (ring->sq_map) munmap(ring->sq_map, ring->sq_map_size);
+    if (ring->fd >= 0) close(ring->fd);
+    memset(ring, 0, sizeof(Ring));
+    ring->fd = -1;
+}
+
+// Every opcode used here arrived in 5.6; older kernels accept the ring but
+// fail the requests, so ask first
+static int ring_supports_ops(int fd) {
+    size_t size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = calloc(1, size);
+    if (!probe) return 0;
+
+    int ok = syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256) >= 0 &&
+             probe->last_op >= IORING_OP_READ &&
+             (probe->ops[IORING_OP_OPENAT].flags & IO_URING_OP_SUPPORTED) &&
+             (probe->ops[IORING_OP_STATX].flags & IO_URING_OP_SUPPORTED) &&
+             (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED);
+    free(probe);
+    return ok;
+}
+
+static int ring_setup(Ring *ring, unsigned depth) {
+    memset(ring, 0, sizeof(Ring));
+    ring->fd = -1;
+
+    // Opening a file takes two requests (openat and statx)
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = (int)syscall(__NR_io_uring_setup, depth * 2, &params);
+    if (fd < 0) return 0;
+    ring->fd = fd;
+    if (!ring_supports_ops(fd)) {
+        ring_destroy(ring);
+        return 0;
+    }
+
+    ring->sq_entries = params.sq_entries;
+    ring->sq_map_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    int single_map = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_map && ring->cq_map_size > ring->sq_map_size) ring->sq_map_size = ring->cq_map_size;
+
+    ring->sq_map = mmap(NULL, ring->sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                        IORING_OFF_SQ_RING);
+    if (ring->sq_map == MAP_FAILED) {
+        ring->sq_map = NULL;
+        ring_destroy(ring);
+        return 0;
+    }
+    if (single_map) {
+        ring->cq_map = ring->sq_map;
+    } else {
+        ring->cq_map = mmap(NULL, ring->cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                            IORING_OFF_CQ_RING);
+        if (ring->cq_map == MAP_FAILED) {
+            ring->cq_map = NULL;
+            ring_destroy(ring);
+            return 0;
+        }
+    }
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = NULL;
+        ring_destroy(ring);
+        return 0;
+    }
+
+    char *sq = ring->sq_map;
+    char *cq = ring->cq_map;
+    ring->sq_head = (unsigned*)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned*)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned*)(sq + params.sq_off.array);
+    ring->cq_head = (unsigned*)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+    return 1;
+}
+
+// Copies a request into the submission ring; 0 if the ring is full
+static int ring_push(Ring *ring, const struct io_uring_sqe *sqe) {
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    unsigned tail = *ring->sq_tail;
+    if (tail - head >= ring->sq_entries) return 0;
+
+    unsigned at = tail & *ring->sq_mask;
+    ring->sqes[at] = *sqe;
+    ring->sq_array[at] = at;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ring->unsubmitted++;
+    return 1;
+}
+
+static int ring_submit_and_wait(Ring *ring, unsigned wait_for) {
+    for (;;) {
+        int n = (int)syscall(__NR_io_uring_enter, ring->fd, ring->unsubmitted, wait_for,
+                             IORING_ENTER_GETEVENTS, NULL, 0);
+        if (n >= 0) {
+            ring->unsubmitted -= (unsigned)n;
+            return 1;
+        }
+        if (errno != EINTR) return 0;
+    }
+}
+
+// Makes room for count requests, submitting the queued ones if the ring is
+// full; 0 if the kernel has not taken enough of them
+static int ring_reserve(Ring *ring, unsigned count) {
+    unsigned used = *ring->sq_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if (ring->sq_entries - used >= count) return 1;
+    if (ring->unsubmitted == 0 || !ring_submit_and_wait(ring, 0)) return 0;
+    used = *ring->sq_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    return ring->sq_entries - used >= count;
+}
+
+// Both requests go in or neither does; 0 if the ring has no room
+static int push_open(Ring *ring, Slot *slots, int s) {
+    const char *path = slots[s].path;
+    if (!ring_reserve(ring, 2)) return 0;
+
+    struct io_uring_sqe sqe;
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = IORING_OP_OPENAT;
+    sqe.fd = AT_FDCWD;
+    sqe.addr = (unsigned long long)(uintptr_t)path;
+    sqe.open_flags = O_RDONLY;
+    sqe.user_data = USER_DATA(s, OP_OPEN);
+    ring_push(ring, &sqe);
+
+    // Sized by path alongside the open rather than after it, so a slow
+    // (network) metadata lookup overlaps the open
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = IORING_OP_STATX;
+    sqe.fd = AT_FDCWD;
+    sqe.addr = (unsigned long long)(uintptr_t)path;
+    sqe.len = STATX_SIZE;
+    sqe.off = (unsigned long long)(uintptr_t)&slots[s].stx;
+    sqe.user_data = USER_DATA(s, OP_STATX);
+    ring_push(ring, &sqe);
+    slots[s].outstanding = 2;
+    return 1;
+}
+
+static int push_read(Ring *ring, Slot *slot, int s) {
+    if (!ring_reserve(ring, 1)) return 0;
+
+    struct io_uring_sqe sqe;
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = IORING_OP_READ;
+    sqe.fd = slot->fd;
+    sqe.addr = (unsigned long long)(uintptr_t)(slot->buffer + slot->got);
+    sqe.len = (unsigned)(slot->size - slot->got);
+    sqe.off = slot->got;
+    sqe.user_data = USER_DATA(s, OP_READ);
+    ring_push(ring, &sqe);
+    slot->outstanding = 1;
+    slot->reading = 1;
+    return 1;
+}
+
+#endif
+
+// Paths the directory walk has found, in the order it found them. The
+// walk appends; readers take the next one. Nothing is dropped until the
+// walk is over, so the index of a path is its position plus first.
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t queued;     // a path came in, the walk ended or the gate opened
+    pthread_cond_t idle;       // the last delivery finished behind a closed gate
+    const char **paths;
+    int count;
+    int capacity;
+    int next;
+    int first;
+    int closed;
+    int delivering;            // fn calls running
+    int growing;               // the walk waits to call reserve; no new fn calls
+} PathQueue;
+
+// Where a worker gets its files: a slice of the caller's array, or the
+// directory walk's queue
+typedef struct {
+    const char *const *paths;
+    int next;
+    int end;
+    PathQueue *queue;
+} IngestSource;
+
+typedef struct {
+    const char *const *paths;  // ingest_files' array, split into chunks
+    IngestFn fn;
+    void *ctx;
+    int depth;
+    WorkerCounts *counts;
+    PathQueue *queue;          // set while a directory is walked
+#ifdef INGEST_URING
+    Ring *rings;
+    unsigned char *ring_state;
+#endif
+} IngestJob;
+
+// 1 with the next file, 0 if none is ready yet (only when not waiting),
+// -1 once no more will come
+static int next_file(IngestSource *source, int wait, int *index, const char **path) {
+    PathQueue *queue = source->queue;
+    if (!queue) {
+        if (source->next >= source->end) return -1;
+        *index = source->next;
+        *path = source->paths[source->next++];
+        return 1;
+    }
+
+    pthread_mutex_lock(&queue->lock);
+    while (wait && queue->next == queue->count && !queue->closed) {
+        pthread_cond_wait(&queue->queued, &queue->lock);
+    }
+    int got = queue->next < queue->count ? 1 : queue->closed ? -1 : 0;
+    if (got > 0) {
+        *index = queue->first + queue->next;
+        *path = queue->paths[queue->next++];
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return got;
+}
+
+// Hands a buffer to fn. While a directory is walked, fn's context may be
+// grown between calls, so calls wait at the gate while it is closed.
+static void deliver(IngestJob *job, int index, const char *data, size_t length, int worker) {
+    PathQueue *queue = job->queue;
+    if (queue) {
+        pthread_mutex_lock(&queue->lock);
+        while (queue->growing) pthread_cond_wait(&queue->queued, &queue->lock);
+        queue->delivering++;
+        pthread_mutex_unlock(&queue->lock);
+    }
+
+    job->fn(job->ctx, index, data, length, worker);
+
+    if (queue) {
+        pthread_mutex_lock(&queue->lock);
+        if (--queue->delivering == 0 && queue->growing) pthread_cond_signal(&queue->idle);
+        pthread_mutex_unlock(&queue->lock);
+    }
+}
+
+#ifdef INGEST_URING
+static void finish_slot(IngestJob *job, Slot *slot, int worker) {
+    WorkerCounts *counts = &job->counts[worker];
+    if (slot->fd >= 0) close(slot->fd);
+
+    if (!slot->failed && slot->got > 0) {
+        slot->buffer[slot->got] = '\0';
+        // Every byte read counts, as with FileView
+        deliver(job, slot->index, slot->buffer, slot->got, worker);
+        counts->files_read++;
+        counts->bytes += (long long)slot->got;
+    } else {
+        counts->files_failed++;
+    }
+    free(slot->buffer);
+    memset(slot, 0, sizeof(Slot));
+    slot->index = -1;
+    slot->fd = -1;
+}
+
+// Handles one completion; returns 1 when the slot's file is done
+static int complete(Ring *ring, Slot *slot, int s, int op, int res) {
+    slot->outstanding--;
+
+    if (op == OP_OPEN) {
+        if (res < 0) {
+            LOG_ERROR(LOG_IO, "File not found: %s\n", slot->path);
+            slot->failed = 1;
+        } else {
+            slot->fd = res;
+        }
+    } else if (op == OP_STATX) {
+        if (res < 0) slot->failed = 1;
+        else slot->size = (size_t)slot->stx.stx_size;
+    } else {
+        if (res < 0) slot->failed = 1;
+        else slot->got += (size_t)res;
+        slot->last_read = res;
+    }
+    if (slot->outstanding > 0) return 0;
+    if (slot->failed) return 1;
+
+    // Short reads happen on network filesystems; ask for the rest
+    int read_more = !slot->reading || (slot->got < slot->size && slot->last_read > 0);
+    if (!read_more) return 1;
+
+    if (!slot->reading) {
+        if (slot->size == 0) {
+            LOG_ERROR(LOG_IO, "Invalid file size\n");
+            slot->failed = 1;
+            return 1;
+        }
+        slot->buffer = malloc(slot->size + 1);
+        if (!slot->buffer) {
+            LOG_ERROR(LOG_IO, "Memory allocation failed\n");
+            slot->failed = 1;
+            return 1;
+        }
+    }
+    if (!push_read(ring, slot, s)) {
+        LOG_ERROR(LOG_IO, "io_uring queue full, cannot read: %s\n", slot->path);
+        slot->failed = 1;
+        return 1;
+    }
+    return 0;
+}
+
+// Reads files from source until it runs dry, keeping up to depth of them
+// in flight. Returns 0 if the ring broke, in which case the caller reads
+// the rest another way.
+static int ingest_uring(IngestJob *job, Ring *ring, IngestSource *source, int worker) {
+    int depth = job->depth;
+    Slot *slots = malloc(sizeof(Slot) * depth);
+    if (!slots) return 0;
+    for (int s = 0; s < depth; s++) {
+        memset(&slots[s], 0, sizeof(Slot));
+        slots[s].index = -1;
+        slots[s].fd = -1;
+    }
+
+    int more = 1;
+    int active = 0;
+    while (more || active > 0) {
+        // Wait for a path only with nothing in flight; an empty queue
+        // must not hold up completions
+        for (int s = 0; s < depth && more; s++) {
+            if (slots[s].index >= 0) continue;
+            int got = next_file(source, active == 0, &slots[s].index, &slots[s].path);
+            if (got < 0) more = 0;
+            if (got <= 0) {
+                slots[s].index = -1;
+                break;
+            }
+            if (!push_open(ring, slots, s)) {
+                LOG_ERROR(LOG_IO, "io_uring queue full, cannot open: %s\n", slots[s].path);
+                slots[s].failed = 1;
+                finish_slot(job, &slots[s], worker);
+                continue;
+            }
+            active++;
+        }
+        if (active == 0) continue;
+
+        if (!ring_submit_and_wait(ring, 1)) {
+            LOG_ERROR(LOG_IO, "io_uring_enter failed: %s\n", strerror(errno));
+            // The kernel may still write into these slots, so they are
+            // leaked rather than freed; their files count as failed
+            job->counts[worker].files_failed += active;
+            return 0;
+        }
+
+        unsigned head = *ring->cq_head;
+        unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++) {
+            struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+            int s = (int)(cqe->user_data / 4);
+            int op = (int)(cqe->user_data % 4);
+            if (complete(ring, &slots[s], s, op, cqe->res)) {
+                finish_slot(job, &slots[s], worker);
+                active--;
+            }
+        }
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    free(slots);
+    return 1;
+}
+#endif
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void ingest_views(IngestJob *job, IngestSource *source, int worker) {
+    WorkerCounts *counts = &job->counts[worker];
+    for (;;) {
+        // Waits for the first path of a batch only
+        const char *paths[VIEW_BATCH];
+        int indexes[VIEW_BATCH];
+        int batch = 0;
+        while (batch < VIEW_BATCH && next_file(source, batch == 0, &indexes[batch], &paths[batch]) > 0) {
+            batch++;
+        }
+        if (batch == 0) return;
+
+        FileView views[VIEW_BATCH];
+        openFileViews(paths, batch, views);
+        for (int v = 0; v < batch; v++) {
+            if (!views[v].data) {
+                counts->files_failed++;
+                continue;
+            }
+            deliver(job, indexes[v], views[v].data, views[v].length, worker);
+            counts->files_read++;
+            counts->bytes += (long long)views[v].length;
+            releaseFileView(&views[v]);
+        }
+    }
+}
+
+// Reads everything source gives this worker. The worker's ring is set up
+// the first time it is needed and kept until the job is finished.
+static void ingest_from(IngestJob *job, IngestSource *source, int worker) {
+#ifdef INGEST_URING
+    if (job->depth > 0) {
+        if (job->ring_state[worker] == RING_UNTRIED) {
+            job->ring_state[worker] = ring_setup(&job->rings[worker], (unsigned)job->depth)
+                                    ? RING_READY : RING_UNAVAILABLE;
+            if (job->ring_state[worker] == RING_UNAVAILABLE) {
+                LOG_INFO(LOG_IO, "io_uring unavailable on worker %d, reading on the thread pool\n", worker);
+            }
+        }
+        if (job->ring_state[worker] == RING_READY) {
+            if (ingest_uring(job, &job->rings[worker], source, worker)) return;
+            job->ring_state[worker] = RING_BROKEN;
+        }
+    }
+#endif
+    ingest_views(job, source, worker);
+}
+
+static void ingest_chunk(void *ctx, int begin, int end, int worker) {
+    IngestJob *job = (IngestJob*)ctx;
+    IngestSource source = {job->paths, begin, end, NULL};
+    ingest_from(job, &source, worker);
+}
+
+static int start_job(IngestJob *job, int worker_count, int queue_depth, IngestFn fn, void *ctx) {
+    memset(job, 0, sizeof(*job));
+    job->fn = fn;
+    job->ctx = ctx;
+    job->depth = queue_depth;
+    job->counts = calloc(worker_count, sizeof(WorkerCounts));
+#ifdef INGEST_URING
+    job->rings = calloc(worker_count, sizeof(Ring));
+    job->ring_state = calloc(worker_count, 1);
+    if (!job->rings || !job->ring_state) job->depth = 0;
+#endif
+    if (!job->counts) {
+        LOG_ERROR(LOG_IO, "Memory allocation failed\n");
+        return 0;
+    }
+    return 1;
+}
+
+// Adds up the workers' counts and closes their rings
+static void finish_job(IngestJob *job, int worker_count, IngestStats *stats) {
+    for (int w = 0; job->counts && w < worker_count; w++) {
+        stats->files_read += job->counts[w].files_read;
+        stats->files_failed += job->counts[w].files_failed;
+        stats->bytes += job->counts[w].bytes;
+#ifdef INGEST_URING
+        if (job->ring_state && job->ring_state[w] == RING_READY) {
+            stats->backend = "io_uring";
+            ring_destroy(&job->rings[w]);
+        }
+#endif
+    }
+#ifdef INGEST_URING
+    free(job->rings);
+    free(job->ring_state);
+#endif
+    free(job->counts);
+}
+
+IngestStats ingest_files(const char *const *paths, int count, int queue_depth,
+                         int thread_count, IngestFn fn, void *ctx) {
+    IngestStats stats = {0, 0, 0, 0.0, "threads"};
+    if (count <= 0) return stats;
+    if (thread_count < 1) thread_count = 1;
+
+    double start = now_seconds();
+    IngestJob job;
+    if (!start_job(&job, thread_count, queue_depth, fn, ctx)) {
+        finish_job(&job, thread_count, &stats);
+        stats.files_failed = count;
+        return stats;
+    }
+    job.paths = paths;
+
+    int chunk_count = 0;
+    TaskChunk *chunks = split_into_chunks(NULL, count, thread_count * 4, &chunk_count);
+    run_work_stealing(chunks, chunk_count, thread_count, ingest_chunk, &job);
+    free(chunks);
+    finish_job(&job, thread_count, &stats);
+
+    stats.seconds = now_seconds() - start;
+    LOG_INFO(LOG_IO, "Ingested %d files (%lld bytes) in %.3f s via %s, depth %d\n",
+             stats.files_read, stats.bytes, stats.seconds, stats.backend, queue_depth);
+    return stats;
+}
+
+typedef struct {
+    const char *dir;
+    const ExtensionFilter *filter;
+    int recursive;
+    FileList *list;
+    IngestReserveFn reserve;
+    int reserved;              // list indexes reserve has made room for
+    int walked;
+    int failed;
+    PathQueue queue;
+    IngestJob job;
+} DirectoryIngest;
+
+// Closes the gate, waits for the fn calls in progress and lets reserve
+// grow the caller's context to count files
+static int reserve_files(DirectoryIngest *ingest, int count) {
+    PathQueue *queue = &ingest->queue;
+    pthread_mutex_lock(&queue->lock);
+    queue->growing = 1;
+    while (queue->delivering > 0) pthread_cond_wait(&queue->idle, &queue->lock);
+    pthread_mutex_unlock(&queue->lock);
+
+    int ok = ingest->reserve(ingest->job.ctx, count);
+
+    pthread_mutex_lock(&queue->lock);
+    queue->growing = 0;
+    pthread_cond_broadcast(&queue->queued);
+    pthread_mutex_unlock(&queue->lock);
+    return ok;
+}
+
+static int queue_push(PathQueue *queue, const char *path) {
+    pthread_mutex_lock(&queue->lock);
+    if (queue->count == queue->capacity) {
+        int capacity = queue->capacity ? queue->capacity * 2 : INGEST_DISCOVERY_BATCH;
+        const char **paths = realloc(queue->paths, sizeof(char*) * capacity);
+        if (!paths) {
+            pthread_mutex_unlock(&queue->lock);
+            LOG_ERROR(LOG_IO, "Memory allocation failed\n");
+            return 0;
+        }
+        queue->paths = paths;
+        queue->capacity = capacity;
+    }
+    queue->paths[queue->count++] = path;
+    pthread_cond_signal(&queue->queued);
+    pthread_mutex_unlock(&queue->lock);
+    return 1;
+}
+
+static int discover_file(const char *path, void *user) {
+    DirectoryIngest *ingest = (DirectoryIngest*)user;
+    FileList *list = ingest->list;
+    if (!appendFilePath(list, path)) {
+        ingest->failed = 1;
+        return 1;
+    }
+
+    // Room is made for twice as many files each time, so the gate closes
+    // only a few times however large the tree
+    if (list->count > ingest->reserved) {
+        int count = ingest->reserved ? ingest->reserved * 2 : INGEST_DISCOVERY_BATCH;
+        while (count < list->count) count *= 2;
+        if (!reserve_files(ingest, count)) {
+            ingest->failed = 1;
+            return 1;
+        }
+        ingest->reserved = count;
+    }
+
+    if (!queue_push(&ingest->queue, list->paths[list->count - 1])) {
+        ingest->failed = 1;
+        return 1;
+    }
+    return 0;
+}
+
+// Chunk 0 walks the tree; every other chunk is one reader that takes
+// paths from the queue until the walk is over and the queue is empty
+static void directory_chunk(void *ctx, int begin, int end, int worker) {
+    DirectoryIngest *ingest = (DirectoryIngest*)ctx;
+    (void)end;
+    (void)worker;
+
+    if (begin > 0) {
+        IngestSource source = {NULL, 0, 0, &ingest->queue};
+        ingest_from(&ingest->job, &source, begin - 1);
+        return;
+    }
+
+    ingest->walked = walkDirectory(ingest->dir, ingest->filter, ingest->recursive,
+                                   discover_file, ingest);
+    pthread_mutex_lock(&ingest->queue.lock);
+    ingest->queue.closed = 1;
+    pthread_cond_broadcast(&ingest->queue.queued);
+    pthread_mutex_unlock(&ingest->queue.lock);
+}
+
+int ingest_directory(const char *dir, const ExtensionFilter *filter, int recursive,
+                     FileList *list, int queue_depth, int thread_count,
+                     IngestReserveFn reserve, IngestFn fn, void *ctx, IngestStats *stats) {
+    IngestStats totals = {0, 0, 0, 0.0, "threads"};
+    *stats = totals;
+    if (thread_count < 1) thread_count = 1;
+
+    double start = now_seconds();
+    DirectoryIngest ingest;
+    memset(&ingest, 0, sizeof(ingest));
+    ingest.dir = dir;
+    ingest.filter = filter;
+    ingest.recursive = recursive;
+    ingest.list = list;
+    ingest.reserve = reserve;
+    ingest.reserved = 0;
+    ingest.queue.first = list->count;
+    if (!start_job(&ingest.job, thread_count, queue_depth, fn, ctx)) {
+        finish_job(&ingest.job, thread_count, stats);
+        return 0;
+    }
+    ingest.job.queue = &ingest.queue;
+    pthread_mutex_init(&ingest.queue.lock, NULL);
+    pthread_cond_init(&ingest.queue.queued, NULL);
+    pthread_cond_init(&ingest.queue.idle, NULL);
+
+    // One more worker than readers: it walks while the readers, each with
+    // its ring for the whole walk, read what it has found so far
+    TaskChunk *chunks = malloc(sizeof(TaskChunk) * (thread_count + 1));
+    if (chunks) {
+        for (int c = 0; c <= thread_count; c++) {
+            chunks[c].begin = c;
+            chunks[c].end = c + 1;
+        }
+        run_work_stealing(chunks, thread_count + 1, thread_count + 1, directory_chunk, &ingest);
+        free(chunks);
+    } else {
+        LOG_ERROR(LOG_IO, "Memory allocation failed\n");
+        ingest.failed = 1;
+    }
+
+    finish_job(&ingest.job, thread_count, stats);
+    pthread_cond_destroy(&ingest.queue.idle);
+    pthread_cond_destroy(&ingest.queue.queued);
+    pthread_mutex_destroy(&ingest.queue.lock);
+    free(ingest.queue.paths);
+
+    stats->seconds = now_seconds() - start;
+    LOG_INFO(LOG_IO, "Found %d source files\n", list->count);
+    LOG_INFO(LOG_IO, "Ingested %d files (%lld bytes) in %.3f s via %s, depth %d\n",
+             stats->files_read, stats->bytes, stats->seconds, stats->backend, queue_depth);
+    return ingest.walked >= 0 && !ingest.failed;
+}
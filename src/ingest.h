@@ -0,0 +1,50 @@
+#ifndef INGEST_H
+#define INGEST_H
+
+#include <stddef.h>
+#include "directory_handler.h"
+
+// Bulk source loading for directory-sized inputs. Each worker keeps up to
+// queue_depth files in flight and hands every completed buffer straight to
+// the caller (normally to build an artifact) while the rest are still
+// being read. On Linux the opens, size lookups and reads are submitted in
+// batches through io_uring; elsewhere, or when the kernel refuses a ring,
+// workers read batches of FileViews with readahead instead.
+
+#define INGEST_DEFAULT_DEPTH 32
+// Files ingest_directory first asks reserve to make room for; each later
+// call asks for twice as many
+#define INGEST_DISCOVERY_BATCH 512
+
+// Called once per readable file, on a worker thread. data[length] is '\0'
+// and the buffer is released when the call returns.
+typedef void (*IngestFn)(void *ctx, int index, const char *data, size_t length, int worker);
+
+typedef struct {
+    int files_read;
+    int files_failed;
+    long long bytes;
+    double seconds;
+    const char *backend;   // "io_uring" or "threads"
+} IngestStats;
+
+// Reads paths[0..count) on thread_count workers. queue_depth <= 0 skips
+// io_uring and uses the thread-pool reader.
+IngestStats ingest_files(const char *const *paths, int count, int queue_depth,
+                         int thread_count, IngestFn fn, void *ctx);
+
+// Called on the walking thread, while no fn call is running, with the
+// number of files fn's indexes must fit under, so ctx can grow whatever fn
+// fills by index. Return 0 to stop.
+typedef int (*IngestReserveFn)(void *ctx, int count);
+
+// Walks dir as walkDirectory does on one more thread and queues what it
+// finds for thread_count readers, started once with their rings kept for
+// the whole walk, so reads and analysis overlap the listing. Paths are
+// appended to list and fn's index is a position in list. Returns 0 if dir
+// cannot be walked or reserve fails.
+int ingest_directory(const char *dir, const ExtensionFilter *filter, int recursive,
+                     FileList *list, int queue_depth, int thread_count,
+                     IngestReserveFn reserve, IngestFn fn, void *ctx, IngestStats *stats);
+
+#endif
@@ -0,0 +1,277 @@
+#include "inverted_index.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+typedef struct {
+    unsigned long long key;
+    int *ids;                    // raw ids while building
+    int count;
+    int capacity;
+    unsigned char *packed;       // delta + varint ids once sealed
+    int packed_length;
+} PostingList;
+
+struct IndexShard {
+    pthread_mutex_t lock;
+    PostingList *slots;          // open addressing on key
+    int slot_count;
+    int used;
+};
+
+static int compare_hashes(const void *a, const void *b) {
+    unsigned long long x = *(const unsigned long long*)a;
+    unsigned long long y = *(const unsigned long long*)b;
+    return (x > y) - (x < y);
+}
+
+unsigned long long* collect_subtree_hashes(const FlatAST *normalized, int *count) {
+    *count = 0;
+    if (!normalized || normalized->count == 0) return NULL;
+    
+    // Every subtree's hash was computed when the tree was flattened
+    unsigned long long *hashes = malloc(sizeof(unsigned long long) * normalized->count);
+    if (!hashes) return NULL;
+    int found = 0;
+    for (int i = 0; i < normalized->count; i++) {
+        if (normalized->nodes[i].size >= MIN_FINGERPRINT_SUBTREE) {
+            hashes[found++] = normalized->hashes[i];
+        }
+    }
+    if (found == 0) return hashes;
+    
+    qsort(hashes, found, sizeof(unsigned long long), compare_hashes);
+    int unique = 0;
+    for (int i = 0; i < found; i++) {
+        if (unique == 0 || hashes[unique - 1] != hashes[i]) {
+            hashes[unique++] = hashes[i];
+        }
+    }
+    
+    *count = unique;
+    return hashes;
+}
+
+InvertedIndex* create_inverted_index(int file_capacity) {
+    InvertedIndex *index = calloc(1, sizeof(InvertedIndex));
+    if (!index) return NULL;
+    
+    index->file_capacity = file_capacity;
+    index->fingerprint_counts = calloc(file_capacity > 0 ? file_capacity : 1, sizeof(int));
+    index->shards = calloc(INDEX_SHARDS, sizeof(IndexShard));
+    if (!index->fingerprint_counts || !index->shards) {
+        free(index->fingerprint_counts);
+        free(index->shards);
+        free(index);
+        return NULL;
+    }
+    
+    for (int s = 0; s < INDEX_SHARDS; s++) {
+        pthread_mutex_init(&index->shards[s].lock, NULL);
+    }
+    return index;
+}
+
+void free_inverted_index(InvertedIndex *index) {
+    if (!index) return;
+    
+    for (int s = 0; s < INDEX_SHARDS; s++) {
+        IndexShard *shard = &index->shards[s];
+        for (int i = 0; i < shard->slot_count; i++) {
+            free(shard->slots[i].ids);
+            free(shard->slots[i].packed);
+        }
+        free(shard->slots);
+        pthread_mutex_destroy(&shard->lock);
+    }
+    
+    free(index->shards);
+    free(index->fingerprint_counts);
+    free(index);
+}
+
+// Shard by the top bits, probe by the low bits, so the two stay independent
+static int shard_of(unsigned long long key) {
+    return (int)(key >> 58) % INDEX_SHARDS;
+}
+
+static PostingList* find_slot(IndexShard *shard, unsigned long long key) {
+    if (shard->slot_count == 0) return NULL;
+    
+    int mask = shard->slot_count - 1;
+    int slot = (int)(key & (unsigned long long)mask);
+    while (shard->slots[slot].count > 0 || shard->slots[slot].packed) {
+        if (shard->slots[slot].key == key) return &shard->slots[slot];
+        slot = (slot + 1) & mask;
+    }
+    return &shard->slots[slot];
+}
+
+static int grow_shard(IndexShard *shard) {
+    int slot_count = shard->slot_count ? shard->slot_count * 2 : 1024;
+    PostingList *old = shard->slots;
+    int old_count = shard->slot_count;
+    
+    shard->slots = calloc(slot_count, sizeof(PostingList));
+    if (!shard->slots) {
+        shard->slots = old;
+        return 0;
+    }
+    shard->slot_count = slot_count;
+    
+    for (int i = 0; i < old_count; i++) {
+        if (old[i].count > 0) {
+            *find_slot(shard, old[i].key) = old[i];
+        }
+    }
+    free(old);
+    return 1;
+}
+
+static void append_posting(IndexShard *shard, unsigned long long key, int file_id) {
+    if ((shard->used + 1) * 2 > shard->slot_count && !grow_shard(shard)) return;
+    
+    PostingList *list = find_slot(shard, key);
+    if (list->count == 0) {
+        list->key = key;
+        shard->used++;
+    }
+    
+    if (list->count >= list->capacity) {
+        int capacity = list->capacity ? list->capacity * 2 : 4;
+        int *grown = realloc(list->ids, sizeof(int) * capacity);
+        if (!grown) return;
+        list->ids = grown;
+        list->capacity = capacity;
+    }
+    list->ids[list->count++] = file_id;
+}
+
+void index_insert(InvertedIndex *index, int file_id,
+                  const unsigned long long *hashes, int count) {
+    if (!index || index->sealed || file_id < 0 || file_id >= index->file_capacity) return;
+    
+    index->fingerprint_counts[file_id] = count;
+    
+    // Group the hashes by shard so each shard lock is taken once per file
+    int *order = malloc(sizeof(int) * (count > 0 ? count : 1));
+    int starts[INDEX_SHARDS + 1] = {0};
+    if (!order) return;
+    
+    for (int i = 0; i < count; i++) starts[shard_of(hashes[i]) + 1]++;
+    for (int s = 0; s < INDEX_SHARDS; s++) starts[s + 1] += starts[s];
+    int fill[INDEX_SHARDS];
+    memcpy(fill, starts, sizeof(fill));
+    for (int i = 0; i < count; i++) order[fill[shard_of(hashes[i])]++] = i;
+    
+    for (int s = 0; s < INDEX_SHARDS; s++) {
+        if (starts[s] == starts[s + 1]) continue;
+        IndexShard *shard = &index->shards[s];
+        pthread_mutex_lock(&shard->lock);
+        for (int k = starts[s]; k < starts[s + 1]; k++) {
+            append_posting(shard, hashes[order[k]], file_id);
+        }
+        pthread_mutex_unlock(&shard->lock);
+    }
+    
+    free(order);
+}
+
+static int compare_ints(const void *a, const void *b) {
+    return *(const int*)a - *(const int*)b;
+}
+
+static void pack_posting(PostingList *list) {
+    qsort(list->ids, list->count, sizeof(int), compare_ints);
+    
+    // At most 5 varint bytes per id
+    unsigned char *packed = malloc(list->count * 5);
+    if (!packed) return;
+    
+    int length = 0, prev = 0;
+    for (int i = 0; i < list->count; i++) {
+        unsigned int delta = (unsigned int)(list->ids[i] - prev);
+        prev = list->ids[i];
+        while (delta >= 0x80) {
+            packed[length++] = (unsigned char)(delta | 0x80);
+            delta >>= 7;
+        }
+        packed[length++] = (unsigned char)delta;
+    }
+    
+    unsigned char *shrunk = realloc(packed, length);
+    list->packed = shrunk ? shrunk : packed;
+    list->packed_length = length;
+    free(list->ids);
+    list->ids = NULL;
+    list->capacity = 0;
+}
+
+void index_seal(InvertedIndex *index) {
+    if (!index || index->sealed) return;
+    
+    for (int s = 0; s < INDEX_SHARDS; s++) {
+        IndexShard *shard = &index->shards[s];
+        for (int i = 0; i < shard->slot_count; i++) {
+            if (shard->slots[i].count > 0) pack_posting(&shard->slots[i]);
+        }
+    }
+    index->sealed = 1;
+}
+
+static int compare_hits(const IndexHit *a, const IndexHit *b) {
+    if (a->shared != b->shared) return a->shared > b->shared ? -1 : 1;
+    return a->file_id - b->file_id;
+}
+
+int index_query_top_k(InvertedIndex *index, const unsigned long long *hashes,
+                      int count, int k, IndexHit *hits) {
+    if (!index || !hits || k <= 0) return 0;
+    if (!index->sealed) index_seal(index);
+    
+    int *scores = calloc(index->file_capacity > 0 ? index->file_capacity : 1, sizeof(int));
+    if (!scores) return 0;
+    
+    // Accumulate one hit per shared fingerprint, touching only the
+    // posting lists of the query's own fingerprints
+    for (int i = 0; i < count; i++) {
+        PostingList *list = find_slot(&index->shards[shard_of(hashes[i])], hashes[i]);
+        if (!list || !list->packed) continue;
+        
+        int pos = 0, id = 0;
+        while (pos < list->packed_length) {
+            unsigned int delta = 0;
+            int shift = 0;
+            unsigned char byte;
+            do {
+                byte = list->packed[pos++];
+                delta |= (unsigned int)(byte & 0x7F) << shift;
+                shift += 7;
+            } while (byte & 0x80);
+            id += (int)delta;
+            scores[id]++;
+        }
+    }
+    
+    // Keep the k best in hits[], sorted, by insertion
+    int found = 0;
+    for (int f = 0; f < index->file_capacity; f++) {
+        if (scores[f] == 0) continue;
+        IndexHit hit = {f, scores[f], 0.0};
+        int total = count + index->fingerprint_counts[f] - scores[f];
+        hit.overlap = total > 0 ? (double)scores[f] / total : 0.0;
+        
+        if (found == k && compare_hits(&hit, &hits[k - 1]) >= 0) continue;
+        int pos = found < k ? found++ : k - 1;
+        while (pos > 0 && compare_hits(&hit, &hits[pos - 1]) < 0) {
+            hits[pos] = hits[pos - 1];
+            pos--;
+        }
+        hits[pos] = hit;
+    }
+    
+    free(scores);
+    return found;
+}
@@ -0,0 +1,45 @@
+#ifndef INVERTED_INDEX_H
+#define INVERTED_INDEX_H
+
+#include "ast.h"
+
+// Subtrees smaller than this are too common to say anything about a file
+#define MIN_FINGERPRINT_SUBTREE 3
+#define INDEX_SHARDS 64
+
+typedef struct IndexShard IndexShard;
+
+// Maps structural fingerprint hashes to the files that contain them.
+// Posting lists are appended to under a per-shard lock, so several
+// ingestion threads can insert at once. index_seal then sorts every
+// list and delta/varint-compresses it for querying.
+typedef struct {
+    IndexShard *shards;
+    int *fingerprint_counts;     // per file id, for overlap normalization
+    int file_capacity;
+    int sealed;
+} InvertedIndex;
+
+typedef struct {
+    int file_id;
+    int shared;                  // fingerprints in common with the query
+    double overlap;              // shared / |query U file|
+} IndexHit;
+
+// Sorted, de-duplicated hashes of every normalized subtree with at least
+// MIN_FINGERPRINT_SUBTREE nodes. Caller frees.
+unsigned long long* collect_subtree_hashes(const FlatAST *normalized, int *count);
+
+InvertedIndex* create_inverted_index(int file_capacity);
+void free_inverted_index(InvertedIndex *index);
+
+// Thread-safe while the index is unsealed; each file id is inserted once
+void index_insert(InvertedIndex *index, int file_id,
+                  const unsigned long long *hashes, int count);
+void index_seal(InvertedIndex *index);
+
+// Fills up to k hits, best first; returns how many were found
+int index_query_top_k(InvertedIndex *index, const unsigned long long *hashes,
+                      int count, int k, IndexHit *hits);
+
+#endif
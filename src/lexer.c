@@ -1,136 +1,282 @@
 #include "lexer.h"
 #include "utils.h"
+#include "log.h"
+#include "symbol.h"
+#include "scan.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <ctype.h>
 
-static void add_token(TokenList *list, TokenType type, const char *value, int line) {
-    if (!list || !value) return;
+static int grow_tokens(TokenList *list, int capacity) {
+    unsigned char *types = realloc(list->types, sizeof(unsigned char) * capacity);
+    if (types) list->types = types;
+    int *offsets = realloc(list->offsets, sizeof(int) * capacity);
+    if (offsets) list->offsets = offsets;
+    unsigned short *lengths = realloc(list->lengths, sizeof(unsigned short) * capacity);
+    if (lengths) list->lengths = lengths;
+    int *symbols = realloc(list->symbols, sizeof(int) * capacity);
+    if (symbols) list->symbols = symbols;
     
-    if (list->count >= list->capacity) {
-        list->capacity *= 2;
-        list->tokens = realloc(list->tokens, sizeof(Token) * list->capacity);
-        if (!list->tokens) {
-            fprintf(stderr, "Memory allocation failed\n");
-            exit(1);
-        }
+    if (!types || !offsets || !lengths || !symbols) return 0;
+    list->capacity = capacity;
+    return 1;
+}
+
+// Spans are clipped to what a token length can hold; the symbol still
+// covers the whole spelling
+static int token_length(size_t span) {
+    return span > 0xFFFF ? 0xFFFF : (int)span;
+}
+
+// 0 when the list cannot grow or symbol is a failed intern (-1)
+static int add_token(TokenList *list, TokenType type, const char *start, int length, int symbol) {
+    if (symbol < 0) return 0;
+    if (list->count >= list->capacity && !grow_tokens(list, list->capacity * 2)) return 0;
+    
+    int i = list->count++;
+    list->types[i] = (unsigned char)type;
+    list->offsets[i] = (int)(start - list->source);
+    list->lengths[i] = (unsigned short)length;
+    list->symbols[i] = symbol;
+    return 1;
+}
+
+// Operators and punctuation are all pre-seeded, so they map straight to
+// their IDs without touching the shared table. Takes the longest match
+// (">>=" before ">>" before ">") and sets *length; SYM_NONE for a byte
+// that starts no token. A byte past the first is only read when the one
+// before it matched, so the '\0' at code[size] stops every lookahead.
+static int operator_symbol(const char *op, int *length) {
+    *length = 2;
+    switch (op[0]) {
+        case '+':
+            if (op[1] == '+') return SYM_INC;
+            if (op[1] == '=') return SYM_ADD_ASSIGN;
+            break;
+        case '-':
+            if (op[1] == '-') return SYM_DEC;
+            if (op[1] == '=') return SYM_SUB_ASSIGN;
+            if (op[1] == '>') return SYM_ARROW;
+            break;
+        case '*': if (op[1] == '=') return SYM_MUL_ASSIGN; break;
+        case '/': if (op[1] == '=') return SYM_DIV_ASSIGN; break;
+        case '%': if (op[1] == '=') return SYM_MOD_ASSIGN; break;
+        case '^': if (op[1] == '=') return SYM_XOR_ASSIGN; break;
+        case '=': if (op[1] == '=') return SYM_EQ; break;
+        case '!': if (op[1] == '=') return SYM_NE; break;
+        case '&':
+            if (op[1] == '&') return SYM_AND;
+            if (op[1] == '=') return SYM_AND_ASSIGN;
+            break;
+        case '|':
+            if (op[1] == '|') return SYM_OR;
+            if (op[1] == '=') return SYM_OR_ASSIGN;
+            break;
+        case '<':
+            if (op[1] == '=') return SYM_LE;
+            if (op[1] == '<') {
+                if (op[2] == '=') {
+                    *length = 3;
+                    return SYM_SHL_ASSIGN;
+                }
+                return SYM_SHL;
+            }
+            break;
+        case '>':
+            if (op[1] == '=') return SYM_GE;
+            if (op[1] == '>') {
+                if (op[2] == '=') {
+                    *length = 3;
+                    return SYM_SHR_ASSIGN;
+                }
+                return SYM_SHR;
+            }
+            break;
     }
     
-    list->tokens[list->count].type = type;
-    strncpy(list->tokens[list->count].value, value, 127);
-    list->tokens[list->count].value[127] = '\0';
-    list->tokens[list->count].line = line;
-    list->count++;
+    *length = 1;
+    switch (op[0]) {
+        case '+': return SYM_PLUS;
+        case '-': return SYM_MINUS;
+        case '*': return SYM_STAR;
+        case '/': return SYM_SLASH;
+        case '%': return SYM_PERCENT;
+        case '<': return SYM_LT;
+        case '>': return SYM_GT;
+        case '!': return SYM_NOT;
+        case '&': return SYM_AMP;
+        case '|': return SYM_PIPE;
+        case '^': return SYM_CARET;
+        case '~': return SYM_TILDE;
+        case '?': return SYM_QUESTION;
+        case '.': return SYM_DOT;
+        case '=': return SYM_ASSIGN;
+        case ';': return SYM_SEMICOLON;
+        case ',': return SYM_COMMA;
+        case '(': return SYM_LPAREN;
+        case ')': return SYM_RPAREN;
+        case '{': return SYM_LBRACE;
+        case '}': return SYM_RBRACE;
+        case '[': return SYM_LBRACKET;
+        case ']': return SYM_RBRACKET;
+        case ':': return SYM_COLON;
+    }
+    return SYM_NONE;
+}
+
+static TokenType operator_type(int symbol) {
+    switch (symbol) {
+        case SYM_ASSIGN:
+        case SYM_ADD_ASSIGN:
+        case SYM_SUB_ASSIGN:
+        case SYM_MUL_ASSIGN:
+        case SYM_DIV_ASSIGN:
+        case SYM_MOD_ASSIGN:
+        case SYM_AND_ASSIGN:
+        case SYM_OR_ASSIGN:
+        case SYM_XOR_ASSIGN:
+        case SYM_SHL_ASSIGN:
+        case SYM_SHR_ASSIGN:
+            return TOK_ASSIGN;
+        case SYM_SEMICOLON: return TOK_SEMICOLON;
+        case SYM_COMMA:     return TOK_COMMA;
+        case SYM_LPAREN:    return TOK_LPAREN;
+        case SYM_RPAREN:    return TOK_RPAREN;
+        case SYM_LBRACE:    return TOK_LBRACE;
+        case SYM_RBRACE:    return TOK_RBRACE;
+        case SYM_LBRACKET:  return TOK_LBRACKET;
+        case SYM_RBRACKET:  return TOK_RBRACKET;
+        case SYM_COLON:     return TOK_COLON;
+        default:            return TOK_OPERATOR;
+    }
 }
 
-TokenList* tokenize(const char *code) {
+// Longest character constant kept by spelling, room for '\x7fff' or a
+// four-character constant with escapes
+#define CHAR_LITERAL_MAX 16
+
+// End of the string or character literal opened by the quote at p: past
+// the closing quote, or at the end of the line if it is unterminated
+static const char* literal_end(const char *p, const char *end) {
+    char quote = *p++;
+    while (p < end && *p != quote && *p != '\n') {
+        if (*p == '\\' && p + 1 < end) p++;
+        p++;
+    }
+    return (p < end && *p == quote) ? p + 1 : p;
+}
+
+TokenList* tokenize(const char *code, size_t size) {
     if (!code) return NULL;
     
-    TokenList *list = malloc(sizeof(TokenList));
+    TokenList *list = calloc(1, sizeof(TokenList));
     if (!list) return NULL;
     
-    list->capacity = 1000;
-    list->count = 0;
-    list->tokens = malloc(sizeof(Token) * list->capacity);
-    if (!list->tokens) {
-        free(list);
+    // Roughly one token per four source bytes; grows if that is short
+    list->source = code;
+    if (!grow_tokens(list, (int)(size / 4) + 16)) {
+        free_tokens(list);
         return NULL;
     }
 
+    // Keyword and operator IDs are emitted without interning
+    symbol_init();
+    scan_init();
     const char *ptr = code;
+    const char *end = code + size;
     int line = 1;
+    int ok = 1;
 
-    while (*ptr != '\0') {
-        if (isspace(*ptr)) {
+    while (ok && ptr < end) {
+        if (SCAN_IS(*ptr, SCAN_SPACE)) {
+            // Single separators are the common case; only runs (indentation,
+            // blank lines) are worth a block scan
             if (*ptr == '\n') line++;
             ptr++;
+            if (ptr < end && SCAN_IS(*ptr, SCAN_SPACE)) ptr = scan_skip_space(ptr, end, &line);
             continue;
         }
 
         if (*ptr == '/' && *(ptr+1) == '/') {
-            while (*ptr && *ptr != '\n') ptr++;
+            ptr = scan_line_end(ptr, end);
             continue;
         }
         
         if (*ptr == '/' && *(ptr+1) == '*') {
-            ptr += 2;
-            while (*ptr && !(*ptr == '*' && *(ptr+1) == '/')) {
-                if (*ptr == '\n') line++;
-                ptr++;
-            }
-            if (*ptr) ptr += 2;
+            ptr = scan_comment_end(ptr + 2, end, &line);
+            if (ptr < end) ptr += 2;
             continue;
         }
 
         if (*ptr == '#') {
-            while (*ptr && *ptr != '\n') ptr++;
+            ptr = scan_line_end(ptr, end);
             continue;
         }
 
+        // Spellings are interned whole, so names that only differ late
+        // stay distinct
         if (isalpha(*ptr) || *ptr == '_') {
-            char buffer[128];
-            int i = 0;
-            while ((isalnum(*ptr) || *ptr == '_') && i < 127) {
-                buffer[i++] = *ptr++;
+            const char *start = ptr;
+            while (SCAN_IS(*ptr, SCAN_IDENT)) ptr++;
+            size_t span = (size_t)(ptr - start);
+            int symbol = symbol_keyword(start, span);
+            if (symbol != SYM_NONE) {
+                ok = add_token(list, TOK_KEYWORD, start, (int)span, symbol);
+                continue;
             }
-            buffer[i] = '\0';
-            TokenType type = is_keyword(buffer) ? TOK_KEYWORD : TOK_IDENTIFIER;
-            add_token(list, type, buffer, line);
+            ok = add_token(list, TOK_IDENTIFIER, start, token_length(span), symbol_intern(start, span));
             continue;
         }
 
         if (isdigit(*ptr)) {
-            char buffer[128];
-            int i = 0;
-            while ((isdigit(*ptr) || *ptr == '.') && i < 127) {
-                buffer[i++] = *ptr++;
-            }
-            buffer[i] = '\0';
-            add_token(list, TOK_NUMBER, buffer, line);
+            const char *start = ptr;
+            while (isdigit(*ptr) || *ptr == '.') ptr++;
+            size_t span = (size_t)(ptr - start);
+            ok = add_token(list, TOK_NUMBER, start, token_length(span), symbol_intern(start, span));
             continue;
         }
 
-        char current[3] = {*ptr, '\0', '\0'};
-        
-        if (*(ptr+1) && strchr("=!<>&|+-", *ptr)) {
-            if (((*ptr == '=' || *ptr == '!' || *ptr == '<' || *ptr == '>') && *(ptr+1) == '=') ||
-                (*ptr == '&' && *(ptr+1) == '&') ||
-                (*ptr == '|' && *(ptr+1) == '|') ||
-                (*ptr == '+' && *(ptr+1) == '+') ||
-                (*ptr == '-' && *(ptr+1) == '-')) {
-                current[1] = *(ptr+1);
-                ptr++;
+        if (*ptr == '"' || *ptr == '\'') {
+            const char *start = ptr;
+            ptr = literal_end(ptr, end);
+            // String contents never reach a comparison, so every string
+            // shares one symbol and none is interned. Character constants
+            // keep their spelling like numbers unless they are too long
+            // to be one.
+            int symbol = SYM_LABEL_STRING;
+            if (*start == '\'' && ptr - start <= CHAR_LITERAL_MAX) {
+                symbol = symbol_intern(start, (size_t)(ptr - start));
             }
+            ok = add_token(list, TOK_STRING, start, token_length((size_t)(ptr - start)), symbol);
+            continue;
         }
 
-        TokenType type = TOK_UNKNOWN;
-        
-        if (strchr("+-*/%<>!&|", current[0])) type = TOK_OPERATOR;
-        else if (current[0] == '=') type = TOK_ASSIGN;
-        else if (current[0] == ';') type = TOK_SEMICOLON;
-        else if (current[0] == ',') type = TOK_COMMA;
-        else if (current[0] == '(') type = TOK_LPAREN;
-        else if (current[0] == ')') type = TOK_RPAREN;
-        else if (current[0] == '{') type = TOK_LBRACE;
-        else if (current[0] == '}') type = TOK_RBRACE;
-        else if (current[0] == '[') type = TOK_LBRACKET;
-        else if (current[0] == ']') type = TOK_RBRACKET;
-        else if (current[0] == ':') type = TOK_COLON;
-        
-        if (type != TOK_UNKNOWN) {
-            add_token(list, type, current, line);
+        int length;
+        int symbol = operator_symbol(ptr, &length);
+        if (symbol != SYM_NONE) {
+            ok = add_token(list, operator_type(symbol), ptr, length, symbol);
         }
-        
-        ptr++;
+        ptr += length;
     }
 
-    add_token(list, TOK_EOF, "", line);
+    // Out of memory, or the symbol table is full: the caller reports the
+    // file as not tokenized instead of the process exiting
+    if (!ok || !add_token(list, TOK_EOF, ptr, 0, SYM_NONE)) {
+        LOG_WARN(LOG_LEXER, "Cannot tokenize past line %d: out of memory or symbols\n", line);
+        free_tokens(list);
+        return NULL;
+    }
+    LOG_DEBUG(LOG_LEXER, "Tokenized %d tokens over %d lines (%s scan)\n", list->count, line,
+              scan_implementation());
     return list;
 }
 
 void free_tokens(TokenList *list) {
     if (list) {
-        if (list->tokens) free(list->tokens);
+        free(list->types);
+        free(list->offsets);
+        free(list->lengths);
+        free(list->symbols);
         free(list);
     }
 }
\ No newline at end of file
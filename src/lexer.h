@@ -1,6 +1,8 @@
 #ifndef LEXER_H
 #define LEXER_H
 
+#include <stddef.h>
+
 typedef enum {
     TOK_KEYWORD,
     TOK_IDENTIFIER,
@@ -16,23 +18,29 @@ typedef enum {
     TOK_LBRACKET,
     TOK_RBRACKET,
     TOK_COLON,
+    TOK_STRING,         // string or character literal, quotes included
     TOK_EOF,
     TOK_UNKNOWN
 } TokenType;
 
+// Token stream as parallel arrays. A token is its type, its span in the
+// source buffer and the interned ID of its spelling (see symbol.h), about
+// 11 bytes instead of a copied lexeme; string literals all carry
+// SYM_LABEL_STRING instead. The source is not copied, so it must outlive
+// the list.
 typedef struct {
-    TokenType type;
-    char value[128];
-    int line;
-} Token;
-
-typedef struct {
-    Token *tokens;
+    const char *source;
+    unsigned char *types;      // TokenType
+    int *offsets;
+    unsigned short *lengths;
+    int *symbols;
     int count;
     int capacity;
 } TokenList;
 
-TokenList* tokenize(const char *code);
+// Scans code[0..size); code[size] must be readable and '\0' (a FileView
+// or a C string both qualify). NULL when memory or symbol IDs run out.
+TokenList* tokenize(const char *code, size_t size);
 void free_tokens(TokenList *list);
 
 #endif
\ No newline at end of file
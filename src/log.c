@@ -0,0 +1,75 @@
+#include "log.h"
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+int log_runtime_level = LOG_LEVEL_WARN;
+unsigned int log_module_mask = (1u << LOG_MODULE_COUNT) - 1;
+
+static const char *level_names[] = {"error", "warn", "info", "debug", "trace"};
+static const char *level_tags[] = {"ERROR", "WARN", "INFO", "DEBUG", "TRACE"};
+static const char *module_names[LOG_MODULE_COUNT] = {
+    "lexer", "parser", "normalizer", "cfg", "dag", "detector", "io", "main"
+};
+
+int log_parse_level(const char *name, int *level) {
+    if (!name || !level) return 0;
+    for (int i = LOG_LEVEL_ERROR; i <= LOG_LEVEL_TRACE; i++) {
+        if (strcmp(name, level_names[i]) == 0) {
+            *level = i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void log_set_level(int level) {
+    log_runtime_level = level;
+}
+
+int log_set_modules(const char *list) {
+    if (!list) return 0;
+    if (strcmp(list, "all") == 0) {
+        log_module_mask = (1u << LOG_MODULE_COUNT) - 1;
+        return 1;
+    }
+    
+    unsigned int mask = 0;
+    const char *p = list;
+    while (*p) {
+        const char *end = strchr(p, ',');
+        size_t length = end ? (size_t)(end - p) : strlen(p);
+        int found = 0;
+        for (int m = 0; m < LOG_MODULE_COUNT; m++) {
+            if (strlen(module_names[m]) == length && strncmp(p, module_names[m], length) == 0) {
+                mask |= 1u << m;
+                found = 1;
+                break;
+            }
+        }
+        if (!found && length > 0) return 0;
+        if (!end) break;
+        p = end + 1;
+    }
+    
+    log_module_mask = mask;
+    return 1;
+}
+
+void log_write(int level, LogModule module, const char *format, ...) {
+    // Build the whole line first so lines from worker threads never interleave
+    char line[1024];
+    int used;
+    if (level <= LOG_LEVEL_WARN) {
+        used = snprintf(line, sizeof(line), "[%s] ", level_tags[level]);
+    } else {
+        used = snprintf(line, sizeof(line), "[%s %s] ", level_tags[level], module_names[module]);
+    }
+    
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line + used, sizeof(line) - used, format, args);
+    va_end(args);
+    
+    fputs(line, stderr);
+}
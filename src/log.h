@@ -0,0 +1,75 @@
+#ifndef LOG_H
+#define LOG_H
+
+// Levelled, per-module logging to stderr.
+//
+// Every call site goes through a LOG_* macro. Levels above LOG_COMPILE_LEVEL
+// expand to nothing, so their arguments are never evaluated; release builds
+// (-DNDEBUG) keep INFO and below unless LOG_COMPILE_LEVEL is set explicitly.
+// What survives compilation is still filtered at runtime by log_set_level
+// and log_set_modules (default: WARN, all modules).
+
+#define LOG_LEVEL_ERROR 0
+#define LOG_LEVEL_WARN  1
+#define LOG_LEVEL_INFO  2
+#define LOG_LEVEL_DEBUG 3
+#define LOG_LEVEL_TRACE 4
+
+#ifndef LOG_COMPILE_LEVEL
+    #ifdef NDEBUG
+        #define LOG_COMPILE_LEVEL LOG_LEVEL_INFO
+    #else
+        #define LOG_COMPILE_LEVEL LOG_LEVEL_TRACE
+    #endif
+#endif
+
+typedef enum {
+    LOG_LEXER,
+    LOG_PARSER,
+    LOG_NORMALIZER,
+    LOG_CFG,
+    LOG_DAG,
+    LOG_DETECTOR,
+    LOG_IO,
+    LOG_MAIN,
+    LOG_MODULE_COUNT
+} LogModule;
+
+extern int log_runtime_level;
+extern unsigned int log_module_mask;
+
+int log_parse_level(const char *name, int *level);
+void log_set_level(int level);
+// Comma separated module names, or "all"; returns 0 on an unknown name
+int log_set_modules(const char *list);
+void log_write(int level, LogModule module, const char *format, ...);
+
+#define LOG_ENABLED(level, module) \
+    ((level) <= LOG_COMPILE_LEVEL && (level) <= log_runtime_level && \
+     (log_module_mask & (1u << (module))))
+
+#define LOG_AT(level, module, ...) \
+    do { if (LOG_ENABLED(level, module)) log_write(level, module, __VA_ARGS__); } while (0)
+
+#define LOG_ERROR(module, ...) LOG_AT(LOG_LEVEL_ERROR, module, __VA_ARGS__)
+#define LOG_WARN(module, ...)  LOG_AT(LOG_LEVEL_WARN, module, __VA_ARGS__)
+
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_INFO
+    #define LOG_INFO(module, ...) LOG_AT(LOG_LEVEL_INFO, module, __VA_ARGS__)
+#else
+    #define LOG_INFO(module, ...) ((void)0)
+#endif
+
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_DEBUG
+    #define LOG_DEBUG(module, ...) LOG_AT(LOG_LEVEL_DEBUG, module, __VA_ARGS__)
+#else
+    #define LOG_DEBUG(module, ...) ((void)0)
+#endif
+
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_TRACE
+    #define LOG_TRACE(module, ...) LOG_AT(LOG_LEVEL_TRACE, module, __VA_ARGS__)
+#else
+    #define LOG_TRACE(module, ...) ((void)0)
+#endif
+
+#endif
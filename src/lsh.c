@@ -0,0 +1,175 @@
+#include "lsh.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    unsigned long long key;
+    int file;
+} BandEntry;
+
+static unsigned long long mix64(unsigned long long x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+int parse_lsh_params(const char *spec, LSHParams *params) {
+    if (!spec || !params) return 0;
+    
+    int bands = 0, rows = 0;
+    if (sscanf(spec, "%dx%d", &bands, &rows) != 2 || bands < 1 || rows < 1) {
+        return 0;
+    }
+    
+    params->bands = bands;
+    params->rows = rows;
+    return 1;
+}
+
+double lsh_threshold(LSHParams params) {
+    // Solve t^rows = 1/bands by bisection
+    double target = 1.0 / params.bands;
+    double lo = 0.0, hi = 1.0;
+    for (int it = 0; it < 60; it++) {
+        double mid = (lo + hi) / 2;
+        double p = 1.0;
+        for (int k = 0; k < params.rows; k++) p *= mid;
+        if (p < target) lo = mid; else hi = mid;
+    }
+    return lo;
+}
+
+unsigned long long* compute_minhash(const FlatAST *normalized, LSHParams params) {
+    // The flat tree is already the preorder type sequence to shingle
+    if (!normalized || normalized->count == 0) return NULL;
+    const FlatNode *nodes = normalized->nodes;
+    int count = normalized->count;
+    
+    int num_hashes = params.bands * params.rows;
+    unsigned long long *signature = malloc(sizeof(unsigned long long) * num_hashes);
+    if (!signature) return NULL;
+    for (int h = 0; h < num_hashes; h++) signature[h] = ~0ULL;
+    
+    // Trees shorter than one shingle still get a single (shorter) shingle
+    int shingles = count >= SHINGLE_SIZE ? count - SHINGLE_SIZE + 1 : 1;
+    int width = count >= SHINGLE_SIZE ? SHINGLE_SIZE : count;
+    
+    for (int s = 0; s < shingles; s++) {
+        unsigned long long shingle = 0;
+        for (int k = 0; k < width; k++) {
+            shingle = mix64(shingle ^ (unsigned long long)FLAT_TYPE(nodes[s + k]));
+        }
+        
+        // Hash family h_i(x) = mix(x ^ seed_i)
+        for (int h = 0; h < num_hashes; h++) {
+            unsigned long long v = mix64(shingle ^ mix64((unsigned long long)h + 1));
+            if (v < signature[h]) signature[h] = v;
+        }
+    }
+    
+    return signature;
+}
+
+static int compare_band_entries(const void *a, const void *b) {
+    const BandEntry *x = a, *y = b;
+    if (x->key != y->key) return x->key < y->key ? -1 : 1;
+    return x->file - y->file;
+}
+
+static int compare_pairs(const void *a, const void *b) {
+    const FilePair *x = a, *y = b;
+    if (x->first != y->first) return x->first - y->first;
+    return x->second - y->second;
+}
+
+static int push_pair(FilePair **pairs, int *count, int *capacity, int first, int second) {
+    if (*count >= *capacity) {
+        int grown_capacity = *capacity ? *capacity * 2 : 1024;
+        FilePair *grown = realloc(*pairs, sizeof(FilePair) * grown_capacity);
+        if (!grown) return 0;
+        *pairs = grown;
+        *capacity = grown_capacity;
+    }
+    (*pairs)[*count].first = first;
+    (*pairs)[*count].second = second;
+    (*count)++;
+    return 1;
+}
+
+FilePair* lsh_candidate_pairs(unsigned long long **signatures, int file_count,
+                              LSHParams params, int *pair_count) {
+    *pair_count = 0;
+    BandEntry *entries = malloc(sizeof(BandEntry) * (file_count > 0 ? file_count : 1));
+    if (!entries) return NULL;
+    
+    FilePair *pairs = NULL;
+    int count = 0, capacity = 0;
+    
+    for (int b = 0; b < params.bands; b++) {
+        int n = 0;
+        for (int f = 0; f < file_count; f++) {
+            if (!signatures[f]) continue;
+            unsigned long long key = mix64((unsigned long long)b);
+            for (int r = 0; r < params.rows; r++) {
+                key = mix64(key ^ signatures[f][b * params.rows + r]);
+            }
+            entries[n].key = key;
+            entries[n].file = f;
+            n++;
+        }
+        
+        // Files sharing a bucket are adjacent after sorting by key
+        qsort(entries, n, sizeof(BandEntry), compare_band_entries);
+        
+        int start = 0;
+        while (start < n) {
+            int end = start + 1;
+            while (end < n && entries[end].key == entries[start].key) end++;
+            for (int x = start; x < end; x++) {
+                for (int y = x + 1; y < end; y++) {
+                    if (!push_pair(&pairs, &count, &capacity, entries[x].file, entries[y].file)) {
+                        free(entries);
+                        free(pairs);
+                        return NULL;
+                    }
+                }
+            }
+            start = end;
+        }
+    }
+    free(entries);
+    
+    // No collisions is a valid answer, told apart from running out of memory
+    if (!pairs) {
+        pairs = malloc(sizeof(FilePair));
+        if (!pairs) return NULL;
+    }
+    
+    // The same pair can collide in several bands
+    qsort(pairs, count, sizeof(FilePair), compare_pairs);
+    int unique = 0;
+    for (int k = 0; k < count; k++) {
+        if (unique == 0 || compare_pairs(&pairs[unique - 1], &pairs[k]) != 0) {
+            pairs[unique++] = pairs[k];
+        }
+    }
+    
+    *pair_count = unique;
+    return pairs;
+}
+
+int next_pair_block(int file_count, PairCursor *cursor, FilePair *block, int capacity) {
+    int count = 0;
+    while (count < capacity && cursor->j < file_count) {
+        block[count].first = cursor->i;
+        block[count].second = cursor->j;
+        count++;
+        if (++cursor->j >= file_count) {
+            cursor->i++;
+            cursor->j = cursor->i + 1;
+        }
+    }
+    return count;
+}
@@ -0,0 +1,45 @@
+#ifndef LSH_H
+#define LSH_H
+
+#include "ast.h"
+
+// Node-type n-gram length used for structural shingles
+#define SHINGLE_SIZE 4
+
+typedef struct {
+    int first;
+    int second;
+} FilePair;
+
+// Position of the next (i, j) pair, i < j, in nested-loop order; starts
+// at {0, 1}
+typedef struct {
+    int i;
+    int j;
+} PairCursor;
+
+// Fills block with up to capacity pairs of file_count files from cursor,
+// so every pair can be walked a block at a time; returns how many
+int next_pair_block(int file_count, PairCursor *cursor, FilePair *block, int capacity);
+
+// bands * rows MinHash values per file. More bands (fewer rows) raise
+// recall; more rows per band raise precision. Pairs with Jaccard
+// similarity around (1/bands)^(1/rows) collide with probability ~1/2.
+typedef struct {
+    int bands;
+    int rows;
+} LSHParams;
+
+int parse_lsh_params(const char *spec, LSHParams *params);
+double lsh_threshold(LSHParams params);
+
+// Returns bands * rows values, or NULL when the tree has no nodes
+unsigned long long* compute_minhash(const FlatAST *normalized, LSHParams params);
+
+// Pairs (i < j, sorted) whose signatures agree on at least one band.
+// Files with a NULL signature never become candidates. Returns an empty,
+// non-NULL array when nothing collides and NULL only when memory runs out.
+FilePair* lsh_candidate_pairs(unsigned long long **signatures, int file_count,
+                              LSHParams params, int *pair_count);
+
+#endif
@@ -1,127 +1,793 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include "directory_handler.h"
 #include "file_handler.h"
 #include "detector.h"
+#include "thread_pool.h"
+#include "lsh.h"
+#include "inverted_index.h"
+#include "corpus.h"
+#include "daemon.h"
+#include "utils.h"
+#include "log.h"
+#include "profile.h"
+#include "report.h"
+#include "ingest.h"
+#include "archive.h"
+#include "parser.h"
 
 void print_separator() {
-    printf("================================================================\n");
+    diag_printf("================================================================\n");
 }
 
 void print_result(const char *file1, const char *file2, PlagiarismResult result) {
     print_separator();
-    printf("Comparing:\n");
-    printf("  File 1: %s (%d nodes)\n", file1, result.total_nodes_1);
-    printf("  File 2: %s (%d nodes)\n", file2, result.total_nodes_2);
-    printf("\n");
-    printf("Similarity Metrics:\n");
-    printf("  AST Similarity:   %.2f%%\n", result.ast_similarity * 100);
-    printf("  CFG Similarity:   %.2f%%\n", result.cfg_similarity * 100);
-    printf("  DAG Similarity:   %.2f%%\n", result.dag_similarity * 100);
-    printf("\n");
-    printf("OVERALL SCORE:    %.2f%%\n", result.overall_score * 100);
-    printf("VERDICT: %s\n", result.verdict);
+    diag_printf("Comparing:\n");
+    diag_printf("  File 1: %s (%d nodes)\n", file1, result.total_nodes_1);
+    diag_printf("  File 2: %s (%d nodes)\n", file2, result.total_nodes_2);
+    diag_printf("\n");
+    diag_printf("Similarity Metrics:\n");
+    diag_printf("  AST Similarity:   %.2f%%\n", result.ast_similarity * 100);
+    diag_printf("  CFG Similarity:   %.2f%%\n", result.cfg_similarity * 100);
+    diag_printf("  DAG Similarity:   %.2f%%\n", result.dag_similarity * 100);
+    diag_printf("  Token Winnowing:  %.2f%%\n", result.winnow_similarity * 100);
+    diag_printf("\n");
+    diag_printf("OVERALL SCORE:    %.2f%%\n", result.overall_score * 100);
+    diag_printf("VERDICT: %s\n", result.verdict);
     print_separator();
-    printf("\n");
+    diag_printf("\n");
+}
+
+static OutputFormat output_format = FORMAT_TEXT;
+static const char *profile_trace_path = NULL;
+static int io_depth = INGEST_DEFAULT_DEPTH;
+
+// Registered with atexit so every mode's exit path reports the profile
+static void finish_profile(void) {
+    profile_print_report(stderr);
+    if (profile_trace_path && !profile_write_trace(profile_trace_path)) {
+        LOG_ERROR(LOG_MAIN, "Cannot write trace: %s\n", profile_trace_path);
+    }
+}
+
+// Text mode keeps the human report; other formats write one record per pair
+static void emit_result(const char *file1, const char *file2, PlagiarismResult result) {
+    if (output_format == FORMAT_TEXT) {
+        print_result(file1, file2, result);
+    } else {
+        report_record(stdout, output_format, file1, file2, &result);
+    }
+}
+
+// Per-worker counters, padded to a cache line so workers never share one
+typedef struct {
+    int comparisons;
+    int high_plagiarism;
+    int medium_similarity;
+    char padding[64 - 3 * sizeof(int)];
+} WorkerTally;
+
+typedef struct {
+    FileArtifact **artifacts;
+    const FilePair *pairs;
+    PlagiarismResult *results;
+    unsigned char *compared;
+    WorkerTally *tallies;
+} PairJob;
+
+static void compare_pair_chunk(void *ctx, int begin, int end, int worker) {
+    PairJob *job = (PairJob*)ctx;
+    WorkerTally *tally = &job->tallies[worker];
+
+    for (int k = begin; k < end; k++) {
+        const FileArtifact *a1 = job->artifacts[job->pairs[k].first];
+        const FileArtifact *a2 = job->artifacts[job->pairs[k].second];
+        if (!a1 || !a2) continue;
+
+        job->results[k] = compare_artifacts(a1, a2);
+        job->compared[k] = 1;
+
+        tally->comparisons++;
+        if (job->results[k].overall_score >= 0.75)
+            tally->high_plagiarism++;
+        else if (job->results[k].overall_score >= 0.50)
+            tally->medium_similarity++;
+    }
+}
+
+// Directory mode holds at most this many pairs, with their results, at once
+#define PAIR_BLOCK 65536
+
+// Compares one block of pairs on every thread, then reports it in order
+static void compare_pair_block(FileArtifact **artifacts, const FileList *list,
+                               const FilePair *pairs, int pair_count, double *costs,
+                               PlagiarismResult *results, unsigned char *compared,
+                               WorkerTally *tallies, int thread_count) {
+    for (int k = 0; k < pair_count; k++) {
+        const FileArtifact *a1 = artifacts[pairs[k].first];
+        const FileArtifact *a2 = artifacts[pairs[k].second];
+        int n1 = a1 ? a1->total_nodes : 0;
+        int n2 = a2 ? a2->total_nodes : 0;
+        costs[k] = (double)(n1 > 0 ? n1 : 1) * (double)(n2 > 0 ? n2 : 1);
+    }
+    memset(compared, 0, pair_count);
+
+    int chunk_count = 0;
+    TaskChunk *chunks = split_into_chunks(costs, pair_count, thread_count * 8, &chunk_count);
+    PairJob job = {artifacts, pairs, results, compared, tallies};
+    run_work_stealing(chunks, chunk_count, thread_count, compare_pair_chunk, &job);
+    free(chunks);
+
+    for (int k = 0; k < pair_count; k++) {
+        int i = pairs[k].first;
+        int j = pairs[k].second;
+        if (!compared[k]) {
+            LOG_WARN(LOG_MAIN, "Could not read file(s): %s or %s\n", list->paths[i], list->paths[j]);
+            continue;
+        }
+        emit_result(list->paths[i], list->paths[j], results[k]);
+    }
+}
+
+typedef struct {
+    FileArtifact **artifacts;
+    int capacity;
+} DirectoryJob;
+
+// Grows the artifact slots before each batch of discovered files is read
+static int reserve_artifacts(void *ctx, int count) {
+    DirectoryJob *job = (DirectoryJob*)ctx;
+    if (count <= job->capacity) return 1;
+    int capacity = job->capacity ? job->capacity : INGEST_DISCOVERY_BATCH;
+    while (capacity < count) capacity *= 2;
+    FileArtifact **artifacts = realloc(job->artifacts, sizeof(FileArtifact*) * capacity);
+    if (!artifacts) {
+        LOG_ERROR(LOG_MAIN, "Memory allocation failed\n");
+        return 0;
+    }
+    memset(artifacts + job->capacity, 0, sizeof(FileArtifact*) * (capacity - job->capacity));
+    job->artifacts = artifacts;
+    job->capacity = capacity;
+    return 1;
+}
+
+// Buffers arrive from ingest_directory as their reads complete, on any worker
+static void build_file_artifact(void *ctx, int index, const char *data, size_t length, int worker) {
+    DirectoryJob *job = (DirectoryJob*)ctx;
+    (void)worker;
+    job->artifacts[index] = build_artifact(data, length);
+}
+
+typedef struct {
+    const Archive *archive;
+    FileArtifact **artifacts;
+} ArchiveJob;
+
+// Members are already in memory, so artifacts are built straight from the
+// arena buffers
+static void build_member_artifacts(void *ctx, int begin, int end, int worker) {
+    ArchiveJob *job = (ArchiveJob*)ctx;
+    (void)worker;
+    for (int i = begin; i < end; i++) {
+        job->artifacts[i] = build_artifact(job->archive->data[i], job->archive->lengths[i]);
+    }
+}
+
+static void report_ingest(IngestStats stats) {
+    double megabytes = stats.bytes / (1024.0 * 1024.0);
+    diag_printf("[OK] Ingested %d files (%.2f MB) in %.3f s, %.1f MB/s via %s\n", stats.files_read,
+                megabytes, stats.seconds, stats.seconds > 0 ? megabytes / stats.seconds : 0.0,
+                stats.backend);
+}
+
+typedef struct {
+    FileArtifact **artifacts;
+    InvertedIndex *index;
+    int query_id;         // the query's own entry in the list, or -1
+} IndexJob;
+
+static void index_file(void *ctx, int i, const char *data, size_t length, int worker) {
+    IndexJob *job = (IndexJob*)ctx;
+    (void)worker;
+
+    if (i == job->query_id) return;
+    job->artifacts[i] = build_artifact(data, length);
+    if (job->artifacts[i] && job->artifacts[i]->status == ARTIFACT_OK) {
+        int count = 0;
+        unsigned long long *hashes = collect_subtree_hashes(job->artifacts[i]->normalized, &count);
+        index_insert(job->index, i, hashes, count);
+        free(hashes);
+    }
+}
+
+// MODE 3: rank a directory by structural overlap with one submission,
+// then run the full comparison on the best K only
+static int run_top_k(const char *query_path, const char *dir_path, int k,
+                     const ExtensionFilter *filter, int recursive, int thread_count) {
+    diag_printf("Mode: Top-%d matches for %s\n\n", k, query_path);
+
+    FileView query_view;
+    if (!openFileView(query_path, &query_view)) {
+        LOG_ERROR(LOG_MAIN, "Could not read file: %s\n", query_path);
+        return 1;
+    }
+    FileArtifact *query = build_artifact_parallel(query_view.data, query_view.length, thread_count);
+    releaseFileView(&query_view);
+    if (!query || query->status != ARTIFACT_OK) {
+        LOG_ERROR(LOG_MAIN, "Could not analyze file: %s\n", query_path);
+        free_artifact(query);
+        return 1;
+    }
+
+    FileList *list = scanDirectoryFiltered(dir_path, filter, recursive);
+    if (list == NULL || list->count == 0) {
+        diag_printf("No C files found in: %s\n", dir_path);
+        free_artifact(query);
+        freeFileList(list);
+        return 1;
+    }
+
+    int status = 0;
+    FileArtifact **artifacts = calloc(list->count, sizeof(FileArtifact*));
+    InvertedIndex *index = create_inverted_index(list->count);
+    IndexHit *hits = malloc(sizeof(IndexHit) * k);
+    if (!artifacts || !index || !hits) {
+        LOG_ERROR(LOG_MAIN, "Memory allocation failed\n");
+        status = 1;
+        goto cleanup;
+    }
+
+    // A query inside the indexed directory would be its own best hit
+    int query_id = -1;
+    for (int i = 0; i < list->count && query_id < 0; i++) {
+        if (sameFile(list->paths[i], query_path)) query_id = i;
+    }
+
+    IndexJob job = {artifacts, index, query_id};
+    report_ingest(ingest_files((const char *const *)list->paths, list->count, io_depth,
+                               thread_count, index_file, &job));
+    index_seal(index);
+
+    int query_count = 0;
+    unsigned long long *query_hashes = collect_subtree_hashes(query->normalized, &query_count);
+    int found = index_query_top_k(index, query_hashes, query_count, k, hits);
+    free(query_hashes);
+
+    print_separator();
+    diag_printf("TOP %d OF %d FILES\n", found, list->count - (query_id >= 0));
+    for (int h = 0; h < found; h++) {
+        diag_printf("  [%d] %s  (%d shared subtrees, %.2f%% overlap)\n", h + 1,
+               list->paths[hits[h].file_id], hits[h].shared, hits[h].overlap * 100);
+    }
+    print_separator();
+    diag_printf("\n");
+
+    for (int h = 0; h < found; h++) {
+        PlagiarismResult result = compare_artifacts(query, artifacts[hits[h].file_id]);
+        emit_result(query_path, list->paths[hits[h].file_id], result);
+    }
+
+cleanup:
+    for (int i = 0; artifacts && i < list->count; i++) {
+        free_artifact(artifacts[i]);
+    }
+    free(artifacts);
+    free(hits);
+    free_inverted_index(index);
+    free_artifact(query);
+    freeFileList(list);
+    return status;
+}
+
+typedef struct {
+    const CorpusRecord *query;
+    const CorpusRecord **targets;
+    PlagiarismResult *results;
+} CorpusJob;
+
+static void corpus_compare_chunk(void *ctx, int begin, int end, int worker) {
+    CorpusJob *job = (CorpusJob*)ctx;
+    (void)worker;
+
+    // Older entry first, matching the i < j order of directory mode
+    for (int t = begin; t < end; t++) {
+        job->results[t] = corpus_compare(job->targets[t], job->query);
+    }
+}
+
+static int push_record(CorpusRecord ***records, int *count, int *capacity, CorpusRecord *record) {
+    if (*count >= *capacity) {
+        int grown_capacity = *capacity ? *capacity * 2 : 64;
+        CorpusRecord **grown = realloc(*records, sizeof(CorpusRecord*) * grown_capacity);
+        if (!grown) return 0;
+        *records = grown;
+        *capacity = grown_capacity;
+    }
+    (*records)[(*count)++] = record;
+    return 1;
+}
+
+// MODE 4: compare new submissions against a persistent corpus, then add them.
+// Entries written by an older engine are rebuilt from their source first.
+static int run_corpus(const char *db_path, const char *dir_path,
+                      const ExtensionFilter *filter, int recursive, int thread_count) {
+    diag_printf("Mode: Corpus %s\n\n", db_path);
+
+    Corpus *corpus = corpus_open(db_path);
+    if (!corpus) return 1;
+
+    CorpusRecord **pending = NULL;
+    int pending_count = 0, pending_capacity = 0;
+    int rebuilt = 0, unreadable = 0;
+
+    for (int i = 0; i < corpus->record_count; i++) {
+        const CorpusRecord *record = corpus_record(corpus, i);
+        if ((record->flags & RECORD_SUPERSEDED) || !corpus_record_is_stale(record)) continue;
+
+        const char *path = corpus_record_path(record);
+        FileView view;
+        if (!openFileView(path, &view)) {
+            unreadable++;
+            continue;
+        }
+        FileArtifact *artifact = build_artifact_parallel(view.data, view.length, thread_count);
+        releaseFileView(&view);
+        CorpusRecord *fresh = corpus_encode_artifact(artifact, path);
+        free_artifact(artifact);
+        if (fresh && push_record(&pending, &pending_count, &pending_capacity, fresh)) {
+            corpus_mark_superseded(corpus, i);
+            rebuilt++;
+        }
+    }
+    if (rebuilt > 0 || unreadable > 0) {
+        diag_printf("[OK] Rebuilt %d stale corpus entries (%d sources missing)\n", rebuilt, unreadable);
+    }
+
+    // Rebuilt entries are appended below even if the directory is gone
+    FileList *list = scanDirectoryFiltered(dir_path, filter, recursive);
+    int comparisons = 0;
+    int high_plagiarism = 0;
+    int medium_similarity = 0;
+    int skipped = 0;
+    int failed = list == NULL;
+
+    for (int f = 0; !failed && f < list->count; f++) {
+        const char *path = list->paths[f];
+        FileView view;
+        if (!openFileView(path, &view)) {
+            LOG_WARN(LOG_MAIN, "Could not read file: %s\n", path);
+            continue;
+        }
+        size_t length = view.length;
+        uint64_t content_hash = content_hash64(view.data, length);
+
+        // Same path, same content: this file was already ingested (or was
+        // just rebuilt above)
+        int existing = corpus_find_path(corpus, path);
+        int seen = 0;
+        if (existing >= 0) {
+            const CorpusRecord *old = corpus_record(corpus, existing);
+            seen = old->content_hash == content_hash && old->code_length == length;
+        }
+        for (int i = 0; i < pending_count && !seen; i++) {
+            seen = pending[i]->content_hash == content_hash && pending[i]->code_length == length &&
+                   strcmp(corpus_record_path(pending[i]), path) == 0;
+        }
+        if (seen) {
+            releaseFileView(&view);
+            skipped++;
+            continue;
+        }
+
+        FileArtifact *artifact = build_artifact_parallel(view.data, length, thread_count);
+        releaseFileView(&view);
+        CorpusRecord *record = corpus_encode_artifact(artifact, path);
+        free_artifact(artifact);
+        if (!record) {
+            LOG_WARN(LOG_MAIN, "Could not analyze file: %s\n", path);
+            continue;
+        }
+
+        // Targets: every live mapped entry except the one this replaces,
+        // plus everything queued earlier in this run
+        const CorpusRecord **targets = malloc(sizeof(CorpusRecord*) * (corpus->record_count + pending_count + 1));
+        PlagiarismResult *results = malloc(sizeof(PlagiarismResult) * (corpus->record_count + pending_count + 1));
+        if (!targets || !results) {
+            // Entries already superseded on disk still need their
+            // replacements appended, so stop here and save what is done
+            LOG_ERROR(LOG_MAIN, "Memory allocation failed\n");
+            free(targets);
+            free(results);
+            free(record);
+            failed = 1;
+            break;
+        }
+        int target_count = 0;
+        for (int i = 0; i < corpus->record_count; i++) {
+            const CorpusRecord *r = corpus_record(corpus, i);
+            if (i != existing && corpus_record_is_live(r)) targets[target_count++] = r;
+        }
+        for (int i = 0; i < pending_count; i++) {
+            targets[target_count++] = pending[i];
+        }
+
+        int chunk_count = 0;
+        TaskChunk *chunks = split_into_chunks(NULL, target_count, thread_count * 8, &chunk_count);
+        CorpusJob job = {record, targets, results};
+        run_work_stealing(chunks, chunk_count, thread_count, corpus_compare_chunk, &job);
+        free(chunks);
+
+        for (int t = 0; t < target_count; t++) {
+            emit_result(corpus_record_path(targets[t]), path, results[t]);
+            comparisons++;
+            if (results[t].overall_score >= 0.75)
+                high_plagiarism++;
+            else if (results[t].overall_score >= 0.50)
+                medium_similarity++;
+        }
+        free(targets);
+        free(results);
+
+        if (existing >= 0) corpus_mark_superseded(corpus, existing);
+        push_record(&pending, &pending_count, &pending_capacity, record);
+    }
+
+    int ok = corpus_append(corpus, pending, pending_count);
+    for (int i = 0; i < pending_count; i++) free(pending[i]);
+    free(pending);
+    corpus_close(corpus);
+    freeFileList(list);
+
+    print_separator();
+    diag_printf("SUMMARY\n");
+    diag_printf("  Added to corpus:    %d\n", ok ? pending_count - rebuilt : 0);
+    diag_printf("  Already in corpus:  %d\n", skipped);
+    diag_printf("  Total comparisons:  %d\n", comparisons);
+    diag_printf("  High plagiarism:    %d\n", high_plagiarism);
+    diag_printf("  Medium similarity:  %d\n", medium_similarity);
+    diag_printf("  Low/No similarity:  %d\n", comparisons - high_plagiarism - medium_similarity);
+    print_separator();
+    return ok && !failed ? 0 : 1;
+}
+
+static void print_usage(const char *prog) {
+    diag_printf("Usage: %s [options] <directory_path>\n", prog);
+    diag_printf("   or: %s [options] <submissions.zip|submissions.tar|->\n", prog);
+    diag_printf("   or: %s <file1.c> <file2.c>\n", prog);
+    diag_printf("   or: %s --top-k K <file.c> <directory_path>\n", prog);
+    diag_printf("   or: %s --corpus <corpus.db> <directory_path>\n", prog);
+    diag_printf("   or: %s --compact <corpus.db>\n", prog);
+    diag_printf("   or: %s --daemon <socket_path>\n", prog);
+    diag_printf("\nOptions:\n");
+    diag_printf("  --threads N         compare pairs on N threads; a file analyzed alone spreads its functions over them\n");
+    diag_printf("  --io-depth N        reads in flight per thread (default %d, 0 = no io_uring)\n",
+                INGEST_DEFAULT_DEPTH);
+    diag_printf("  --max-depth N       reject code nested deeper than N (default %d, at most %d)\n",
+                PARSE_DEFAULT_MAX_DEPTH, PARSE_MAX_DEPTH_LIMIT);
+    diag_printf("  --ext .c,.h,.cpp    file extensions to scan (default .c)\n");
+    diag_printf("  --no-recurse        do not descend into subdirectories\n");
+    diag_printf("  --lsh BANDSxROWS    only compare MinHash/LSH candidate pairs (e.g. 20x5)\n");
+    diag_printf("  --format FORMAT     text (default), jsonl, csv or bin; non-text is quiet\n");
+    diag_printf("  --profile           per-stage time and hardware counters on stderr\n");
+    diag_printf("  --profile-trace F   also write a Chrome trace-event JSON to F\n");
+    diag_printf("  --log-level LEVEL   error, warn (default), info, debug or trace, on stderr\n");
+    diag_printf("  --log-modules LIST  lexer,parser,normalizer,cfg,dag,detector,io,main or all\n");
 }
 
 int main(int argc, char *argv[]) {
-    printf("\n");
+    int thread_count = 1;
+    int recursive = 1;
+    int use_lsh = 0;
+    int top_k = 0;
+    const char *corpus_path = NULL;
+    int compact = 0;
+    const char *socket_path = NULL;
+    int profile = 0;
+    LSHParams lsh_params = {20, 5};
+    ExtensionFilter filter = {{{0}}, 0};
+    const char *positional[2];
+    int positional_count = 0;
+
+    for (int a = 1; a < argc; a++) {
+        if (strcmp(argv[a], "--threads") == 0 && a + 1 < argc) {
+            thread_count = atoi(argv[++a]);
+            if (thread_count < 1) thread_count = 1;
+        } else if (strcmp(argv[a], "--io-depth") == 0 && a + 1 < argc) {
+            io_depth = atoi(argv[++a]);
+            if (io_depth < 0) io_depth = 0;
+            if (io_depth > 4096) io_depth = 4096;
+        } else if (strcmp(argv[a], "--max-depth") == 0 && a + 1 < argc) {
+            set_max_nesting_depth(atoi(argv[++a]));
+        } else if (strcmp(argv[a], "--ext") == 0 && a + 1 < argc) {
+            if (parseExtensionFilter(argv[++a], &filter) == 0) {
+                LOG_ERROR(LOG_MAIN, "No usable extensions in: %s\n", argv[a]);
+                return 1;
+            }
+        } else if (strcmp(argv[a], "--lsh") == 0 && a + 1 < argc) {
+            if (!parse_lsh_params(argv[++a], &lsh_params)) {
+                LOG_ERROR(LOG_MAIN, "Expected BANDSxROWS, got: %s\n", argv[a]);
+                return 1;
+            }
+            use_lsh = 1;
+        } else if (strcmp(argv[a], "--top-k") == 0 && a + 1 < argc) {
+            top_k = atoi(argv[++a]);
+            if (top_k < 1) {
+                LOG_ERROR(LOG_MAIN, "--top-k needs a positive count\n");
+                return 1;
+            }
+        } else if (strcmp(argv[a], "--corpus") == 0 && a + 1 < argc) {
+            corpus_path = argv[++a];
+        } else if (strcmp(argv[a], "--compact") == 0 && a + 1 < argc) {
+            corpus_path = argv[++a];
+            compact = 1;
+        } else if (strcmp(argv[a], "--daemon") == 0 && a + 1 < argc) {
+            socket_path = argv[++a];
+        } else if (strcmp(argv[a], "--format") == 0 && a + 1 < argc) {
+            if (!parse_output_format(argv[++a], &output_format)) {
+                LOG_ERROR(LOG_MAIN, "Unknown format: %s\n", argv[a]);
+                return 1;
+            }
+        } else if (strcmp(argv[a], "--profile") == 0) {
+            profile = 1;
+        } else if (strcmp(argv[a], "--profile-trace") == 0 && a + 1 < argc) {
+            profile_trace_path = argv[++a];
+            profile = 1;
+        } else if (strcmp(argv[a], "--log-level") == 0 && a + 1 < argc) {
+            int level;
+            if (!log_parse_level(argv[++a], &level)) {
+                LOG_ERROR(LOG_MAIN, "Unknown log level: %s\n", argv[a]);
+                return 1;
+            }
+            log_set_level(level);
+        } else if (strcmp(argv[a], "--log-modules") == 0 && a + 1 < argc) {
+            if (!log_set_modules(argv[++a])) {
+                LOG_ERROR(LOG_MAIN, "Unknown log module in: %s\n", argv[a]);
+                return 1;
+            }
+        } else if (strcmp(argv[a], "--no-recurse") == 0) {
+            recursive = 0;
+        } else if (argv[a][0] == '-' && argv[a][1] == '-') {
+            LOG_ERROR(LOG_MAIN, "Unknown option: %s\n", argv[a]);
+            print_usage(argv[0]);
+            return 1;
+        } else if (positional_count < 2) {
+            positional[positional_count++] = argv[a];
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (profile) {
+        profile_enable(profile_trace_path != NULL);
+        atexit(finish_profile);
+    }
+
+    // Machine-readable output owns stdout: no banners, modes or debug lines
+    if (output_format != FORMAT_TEXT) {
+        set_diagnostics(0);
+    }
+
+    diag_printf("\n");
     print_separator();
-    printf("       CODE PLAGIARISM DETECTOR\n");
-    printf("       AST + CFG + DAG Analysis\n");
+    diag_printf("       CODE PLAGIARISM DETECTOR\n");
+    diag_printf("       AST + CFG + DAG Analysis\n");
     print_separator();
-    printf("\n");
-    
-    if (argc < 2) {
-        printf("Usage: %s <directory_path>\n", argv[0]);
-        printf("   or: %s <file1.c> <file2.c>\n", argv[0]);
+    diag_printf("\n");
+
+    if (socket_path) {
+        return run_daemon(socket_path, thread_count);
+    }
+
+    if (compact) {
+        return corpus_compact(corpus_path) ? 0 : 1;
+    }
+
+    report_begin(stdout, output_format);
+
+    if (positional_count == 0) {
+        print_usage(argv[0]);
         return 1;
     }
 
+    if (corpus_path) {
+        if (positional_count != 1) {
+            print_usage(argv[0]);
+            return 1;
+        }
+        return run_corpus(corpus_path, positional[0], &filter, recursive, thread_count);
+    }
+
+    if (top_k > 0) {
+        if (positional_count != 2) {
+            print_usage(argv[0]);
+            return 1;
+        }
+        return run_top_k(positional[0], positional[1], top_k, &filter, recursive, thread_count);
+    }
+
     // MODE 1: Direct two-file comparison
-    if (argc == 3) {
-        printf("Mode: Comparing two files\n\n");
+    if (positional_count == 2) {
+        diag_printf("Mode: Comparing two files\n\n");
         
-        char *code1 = readFile(argv[1]);
-        char *code2 = readFile(argv[2]);
+        FileView view1, view2;
+        int read1 = openFileView(positional[0], &view1);
+        int read2 = openFileView(positional[1], &view2);
         
-        if (!code1 || !code2) {
-            printf("[ERROR] Could not read one or both files.\n");
-            if (code1) free(code1);
-            if (code2) free(code2);
+        if (!read1 || !read2) {
+            LOG_ERROR(LOG_MAIN, "Could not read one or both files.\n");
+            releaseFileView(&view1);
+            releaseFileView(&view2);
             return 1;
         }
         
-        PlagiarismResult result = detect_plagiarism(code1, code2);
-        print_result(argv[1], argv[2], result);
+        // One file at a time, each on every thread
+        FileArtifact *a1 = build_artifact_parallel(view1.data, view1.length, thread_count);
+        FileArtifact *a2 = build_artifact_parallel(view2.data, view2.length, thread_count);
+        PlagiarismResult result = compare_artifacts(a1, a2);
+        emit_result(positional[0], positional[1], result);
         
-        free(code1);
-        free(code2);
+        free_artifact(a1);
+        free_artifact(a2);
+        releaseFileView(&view1);
+        releaseFileView(&view2);
         return 0;
     }
 
-    // MODE 2: Directory comparison mode
-    printf("Mode: Scanning directory\n\n");
-
-    FileList* list = scanDirectory(argv[1]);  // ✅ uses your directory_handler.c
+    // MODE 2: Directory comparison mode, or the members of one archive
+    // ("-" reads it from stdin)
+    // Reads overlap with discovery and analysis; report in file order
+    // afterwards
+    Archive *archive = NULL;
+    FileList* list = NULL;
+    DirectoryJob job = {NULL, 0};
+    IngestStats io;
+    if (archive_detect(positional[0])) {
+        diag_printf("Mode: Reading archive\n\n");
+        archive = archive_open(positional[0], &filter, thread_count);
+        if (archive) {
+            list = archive->members;
+            if (!reserve_artifacts(&job, list->count)) return 1;
+            int chunk_count = 0;
+            TaskChunk *chunks = split_into_chunks(NULL, list->count, thread_count * 8, &chunk_count);
+            ArchiveJob archive_job = {archive, job.artifacts};
+            run_work_stealing(chunks, chunk_count, thread_count, build_member_artifacts, &archive_job);
+            free(chunks);
+            IngestStats stats = {list->count, archive->skipped, archive->bytes, archive->seconds,
+                                 archive->format};
+            io = stats;
+        }
+    } else {
+        diag_printf("Mode: Scanning directory\n\n");
+        list = createFileList();
+        if (list && !ingest_directory(positional[0], &filter, recursive, list, io_depth,
+                                      thread_count, reserve_artifacts, build_file_artifact,
+                                      &job, &io)) {
+            for (int i = 0; i < list->count && i < job.capacity; i++) free_artifact(job.artifacts[i]);
+            free(job.artifacts);
+            freeFileList(list);
+            list = NULL;
+        }
+    }
     if (list == NULL || list->count == 0) {
-        printf("No C files found in: %s\n", argv[1]);
+        diag_printf("No C files found in: %s\n", positional[0]);
         return 1;
     }
+    FileArtifact **artifacts = job.artifacts;
+    for (int i = 0; i < list->count; i++) {
+        if (!artifacts[i]) {
+            LOG_WARN(LOG_MAIN, "Could not read file: %s\n", list->paths[i]);
+            continue;
+        }
+        diag_printf("\nAnalyzing file %d: %s (%zu bytes)\n", i + 1, list->paths[i],
+                    artifacts[i]->code_length);
+    }
+    diag_printf("\n");
+    report_ingest(io);
 
     printFileList(list);
 
-    int comparisons = 0;
-    int high_plagiarism = 0;
-    int medium_similarity = 0;
+    long long total_pairs = (long long)list->count * (list->count - 1) / 2;
+    if (total_pairs > INT_MAX) {
+        LOG_ERROR(LOG_MAIN, "%d files make %lld pairs, more than one run can compare (%d)\n",
+                  list->count, total_pairs, INT_MAX);
+        return 1;
+    }
+    int pair_count = 0;
+    FilePair *pairs = NULL;
 
-    for (int i = 0; i < list->count; i++) {
-        for (int j = i + 1; j < list->count; j++) {
-            printf("\nComparing files %d and %d...\n", i+1, j+1);  // ADD
-            char *code1 = readFile(list->paths[i]);
-            char *code2 = readFile(list->paths[j]);
-
-            if (!code1 || !code2) {
-                printf("[WARN] Could not read file(s): %s or %s\n", list->paths[i], list->paths[j]);
-                if (code1) free(code1);
-                if (code2) free(code2);
-                continue;
+    if (use_lsh) {
+        // Candidate generation: only pairs that share an LSH bucket go on
+        // to the full AST/CFG/DAG comparison
+        unsigned long long **signatures = calloc(list->count, sizeof(unsigned long long*));
+        if (!signatures) {
+            LOG_ERROR(LOG_MAIN, "Memory allocation failed\n");
+            return 1;
+        }
+        for (int i = 0; i < list->count; i++) {
+            if (artifacts[i] && artifacts[i]->status == ARTIFACT_OK) {
+                signatures[i] = compute_minhash(artifacts[i]->normalized, lsh_params);
             }
-        
-            printf("\nComparing:\n  %s\n  %s\n", list->paths[i], list->paths[j]);
-            printf("------------------------------------------------------------\n");
+        }
+        pairs = lsh_candidate_pairs(signatures, list->count, lsh_params, &pair_count);
+        for (int i = 0; i < list->count; i++) free(signatures[i]);
+        free(signatures);
+        if (!pairs) {
+            LOG_ERROR(LOG_MAIN, "Memory allocation failed\n");
+            return 1;
+        }
 
-            
-            printf("File 1 size: %zu bytes\n", strlen(code1));
-            printf("File 2 size: %zu bytes\n", strlen(code2));
+        diag_printf("LSH: %d bands x %d rows (threshold ~%.2f Jaccard)\n",
+               lsh_params.bands, lsh_params.rows, lsh_threshold(lsh_params));
+        diag_printf("LSH: %d candidate pairs of %lld, pruned %lld (%.1f%%)\n\n",
+               pair_count, total_pairs, total_pairs - pair_count,
+               total_pairs > 0 ? 100.0 * (total_pairs - pair_count) / total_pairs : 0.0);
+    } else {
+        pair_count = (int)total_pairs;
+    }
 
-            PlagiarismResult result = detect_plagiarism(code1, code2);
+    // Pairs are compared and reported one block at a time, so memory stays
+    // flat however many files there are. Without LSH the block is filled
+    // in the i < j order of the old nested loop, so output is identical
+    // whatever the thread count.
+    int block_capacity = pair_count < PAIR_BLOCK ? (pair_count > 0 ? pair_count : 1) : PAIR_BLOCK;
+    FilePair *block = use_lsh ? NULL : malloc(sizeof(FilePair) * block_capacity);
+    double *costs = malloc(sizeof(double) * block_capacity);
+    PlagiarismResult *results = malloc(sizeof(PlagiarismResult) * block_capacity);
+    unsigned char *compared = malloc(block_capacity);
+    WorkerTally *tallies = calloc(thread_count, sizeof(WorkerTally));
+    if ((!use_lsh && !block) || !costs || !results || !compared || !tallies) {
+        LOG_ERROR(LOG_MAIN, "Memory allocation failed\n");
+        return 1;
+    }
 
-            printf("Detection complete!\n");
-            print_result(list->paths[i], list->paths[j], result);
-            // ✅ NO MORE PRINTS AFTER THIS
+    PairCursor cursor = {0, 1};
+    for (int done = 0; done < pair_count; ) {
+        int block_count;
+        const FilePair *block_pairs;
+        if (use_lsh) {
+            block_pairs = pairs + done;
+            block_count = pair_count - done < block_capacity ? pair_count - done : block_capacity;
+        } else {
+            block_count = next_pair_block(list->count, &cursor, block, block_capacity);
+            block_pairs = block;
+        }
+        compare_pair_block(artifacts, list, block_pairs, block_count, costs, results, compared,
+                           tallies, thread_count);
+        done += block_count;
+    }
 
-            comparisons++;
-            if (result.overall_score >= 0.75)
-                high_plagiarism++;
-            else if (result.overall_score >= 0.50)
-                medium_similarity++;
+    int comparisons = 0;
+    int high_plagiarism = 0;
+    int medium_similarity = 0;
+    for (int w = 0; w < thread_count; w++) {
+        comparisons += tallies[w].comparisons;
+        high_plagiarism += tallies[w].high_plagiarism;
+        medium_similarity += tallies[w].medium_similarity;
+    }
 
-            free(code1);
-            free(code2);
-        }
+    free(pairs);
+    free(block);
+    free(costs);
+    free(results);
+    free(compared);
+    free(tallies);
+    for (int i = 0; i < list->count; i++) {
+        free_artifact(artifacts[i]);
     }
+    free(artifacts);
 
     print_separator();
-    printf("SUMMARY\n");
-    printf("  Total comparisons:  %d\n", comparisons);
-    printf("  High plagiarism:    %d\n", high_plagiarism);
-    printf("  Medium similarity:  %d\n", medium_similarity);
-    printf("  Low/No similarity:  %d\n", comparisons - high_plagiarism - medium_similarity);
+    diag_printf("SUMMARY\n");
+    diag_printf("  Total comparisons:  %d\n", comparisons);
+    diag_printf("  High plagiarism:    %d\n", high_plagiarism);
+    diag_printf("  Medium similarity:  %d\n", medium_similarity);
+    diag_printf("  Low/No similarity:  %d\n", comparisons - high_plagiarism - medium_similarity);
     print_separator();
 
-    freeFileList(list); // ✅ correct cleanup for your version
+    if (archive) archive_free(archive);
+    else freeFileList(list);
     return 0;
 }
@@ -1,11 +1,13 @@
 #include "normalizer.h"
+#include "log.h"
+#include "symbol.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 typedef struct {
-    char original[128];
-    char normalized[128];
+    int original;
+    int normalized;
 } VarMapping;
 
 typedef struct {
@@ -14,65 +16,75 @@ typedef struct {
     int capacity;
 } VarTable;
 
-static VarTable* create_var_table() {
-    VarTable *table = malloc(sizeof(VarTable));
-    if (!table) return NULL;
-    table->capacity = 100;
-    table->count = 0;
-    table->mappings = malloc(sizeof(VarMapping) * table->capacity);
-    if (!table->mappings) {
-        free(table);
-        return NULL;
-    }
-    return table;
-}
+// One node being copied by normalize_tree, with the next child to visit
+typedef struct {
+    ASTNode *node;
+    ASTNode *copy;
+    int next_child;
+} NormalizeFrame;
 
-static void free_var_table(VarTable *table) {
-    if (table) {
-        if (table->mappings) free(table->mappings);
-        free(table);
-    }
-}
+// The output tree, the variable table and the frame stack are built in
+// scratch; only the flattened result goes to the caller's arena
+typedef struct {
+    VarTable table;
+    NormalizeFrame *frames;
+    int frame_count;
+    int frame_capacity;
+    Arena *scratch;
+} Normalizer;
 
-static char* get_normalized_name(VarTable *table, const char *original) {
-    if (!table || !original) return NULL;
+// Symbol of the canonical name for a variable, or -1
+static int get_normalized_name(Normalizer *n, int original) {
+    VarTable *table = &n->table;
     
     for (int i = 0; i < table->count; i++) {
-        if (strcmp(table->mappings[i].original, original) == 0) {
+        if (table->mappings[i].original == original) {
             return table->mappings[i].normalized;
         }
     }
     
     if (table->count >= table->capacity) {
-        table->capacity *= 2;
-        VarMapping *new_mappings = realloc(table->mappings, 
-                                          sizeof(VarMapping) * table->capacity);
-        if (!new_mappings) return NULL;
+        int capacity = table->capacity ? table->capacity * 2 : 100;
+        VarMapping *new_mappings = arena_alloc(n->scratch, sizeof(VarMapping) * capacity);
+        if (!new_mappings) return -1;
+        if (table->count > 0) memcpy(new_mappings, table->mappings, sizeof(VarMapping) * table->count);
         table->mappings = new_mappings;
+        table->capacity = capacity;
     }
     
-    VarMapping *map = &table->mappings[table->count];
-    strncpy(map->original, original, 127);
-    map->original[127] = '\0';
-    sprintf(map->normalized, "var_%d", table->count);
-    table->count++;
+    char name[32];
+    int length = snprintf(name, sizeof(name), "var_%d", table->count);
+    int normalized = symbol_intern(name, (size_t)length);
+    if (normalized < 0) return -1;
     
-    return map->normalized;
+    VarMapping *map = &table->mappings[table->count++];
+    map->original = original;
+    map->normalized = normalized;
+    return normalized;
 }
 
-static ASTNode* switch_to_if_else(ASTNode *switch_node, VarTable *table);
+static int push_frame(Normalizer *n, ASTNode *node, ASTNode *copy) {
+    if (n->frame_count >= n->frame_capacity) {
+        int capacity = n->frame_capacity ? n->frame_capacity * 2 : 64;
+        NormalizeFrame *frames = arena_alloc(n->scratch, sizeof(NormalizeFrame) * capacity);
+        if (!frames) return 0;
+        if (n->frame_count > 0) memcpy(frames, n->frames, sizeof(NormalizeFrame) * n->frame_count);
+        n->frames = frames;
+        n->frame_capacity = capacity;
+    }
+    n->frames[n->frame_count++] = (NormalizeFrame){node, copy, 0};
+    return 1;
+}
 
-static ASTNode* normalize_recursive(ASTNode *node, VarTable *table) {
-    if (!node || !table) return NULL;
-    
-    // DEBUG print
-    // printf("[NORMALIZER] Processing node type=%d, value='%s', children=%d\n", 
-    //        node->type, node->value, node->child_count);
-    
+static ASTNode* switch_to_if_else(ASTNode *switch_node, Normalizer *n);
+static ASTNode* normalize_tree(ASTNode *root, Normalizer *n);
 
+static ASTNode* normalize_recursive(ASTNode *node, Normalizer *n) {
+    if (!node || !n) return NULL;
+    
     // Switch ko if-else mein convert karo
     if (node->type == NODE_SWITCH) {
-        return switch_to_if_else(node, table);
+        return switch_to_if_else(node, n);
     }
     
     // FOR loop ko WHILE mein convert karo (PROPER STRUCTURE CHANGE)
@@ -87,97 +99,143 @@ if (node->type == NODE_FOR) {
     if (node->child_count > 3) body = node->children[3];
 
     // Step 1: create while(cond)
-    ASTNode *while_node = create_node(NODE_WHILE, "loop");
+    ASTNode *while_node = create_node(n->scratch, NODE_WHILE, SYM_LABEL_LOOP);
     if (cond) {
-        ASTNode *cond_n = normalize_recursive(cond, table);
-        if (cond_n) add_child(while_node, cond_n);
+        ASTNode *cond_n = normalize_recursive(cond, n);
+        if (cond_n) add_child(n->scratch, while_node, cond_n);
     } else {
-        add_child(while_node, create_node(NODE_LITERAL, "1"));
+        add_child(n->scratch, while_node, create_node(n->scratch, NODE_LITERAL, SYM_LABEL_ONE));
     }
 
     // Step 2: create while body block { body; inc; }
-    ASTNode *while_body = create_node(NODE_BLOCK, "block");
+    ASTNode *while_body = create_node(n->scratch, NODE_BLOCK, SYM_LABEL_BLOCK);
 
     if (body) {
-        ASTNode *b = normalize_recursive(body, table);
+        ASTNode *b = normalize_recursive(body, n);
         if (b) {
             if (b->type == NODE_BLOCK) {
                 for (int i = 0; i < b->child_count; i++)
-                    add_child(while_body, b->children[i]);
-            } else add_child(while_body, b);
+                    add_child(n->scratch, while_body, b->children[i]);
+            } else add_child(n->scratch, while_body, b);
         }
     }
 
     if (inc) {
-        ASTNode *i = normalize_recursive(inc, table);
-        if (i) add_child(while_body, i);
+        ASTNode *i = normalize_recursive(inc, n);
+        if (i) add_child(n->scratch, while_body, i);
     }
 
-    add_child(while_node, while_body);
+    add_child(n->scratch, while_node, while_body);
 
     // Step 3: Create final outer block { init; while(...) {...} }
-    ASTNode *final_block = create_node(NODE_BLOCK, "block");
+    ASTNode *final_block = create_node(n->scratch, NODE_BLOCK, SYM_LABEL_BLOCK);
     if (init) {
-        ASTNode *init_n = normalize_recursive(init, table);
-        if (init_n) add_child(final_block, init_n);
+        ASTNode *init_n = normalize_recursive(init, n);
+        if (init_n) add_child(n->scratch, final_block, init_n);
     }
-    add_child(final_block, while_node);
+    add_child(n->scratch, final_block, while_node);
 
     
     return final_block;
 }
 
+    return normalize_tree(node, n);
+}
 
-
+// Copy of one node with its own label normalized; children are added by
+// the caller
+static ASTNode* normalize_node(ASTNode *node, Normalizer *n) {
+    LOG_TRACE(LOG_NORMALIZER, "Processing node type=%d, value='%s', children=%d\n", 
+              node->type, symbol_text(node->symbol), node->child_count);
     
-    // Normal node processing
-    ASTNode *new_node = create_node(node->type, node->value);
+    ASTNode *new_node = create_node(n->scratch, node->type, node->symbol);
     if (!new_node) return NULL;
     
     // Variable names normalize karo
-    if (node->type == NODE_VAR || node->type == NODE_ARRAY_ACCESS) {
-        if (strcmp(node->value, "long") == 0 || 
-            strcmp(node->value, "short") == 0 ||
-            strcmp(node->value, "unsigned") == 0 ||
-            strcmp(node->value, "signed") == 0) {
-            strcpy(new_node->value, "int");
+    // An index into anything but a plain name is labelled '[' instead
+    if (node->type == NODE_VAR ||
+        (node->type == NODE_ARRAY_ACCESS && node->symbol != SYM_LBRACKET)) {
+        if (node->symbol == SYM_LONG || 
+            node->symbol == SYM_SHORT ||
+            node->symbol == SYM_UNSIGNED ||
+            node->symbol == SYM_SIGNED) {
+            new_node->symbol = SYM_INT;
         }
-        else if (strcmp(node->value, "double") == 0) {
-            strcpy(new_node->value, "float");
+        else if (node->symbol == SYM_DOUBLE) {
+            new_node->symbol = SYM_FLOAT;
         }
         else {
-            char *normalized = get_normalized_name(table, node->value);
-            if (normalized) {
-                strncpy(new_node->value, normalized, 127);
-                new_node->value[127] = '\0';
+            int normalized = get_normalized_name(n, node->symbol);
+            if (normalized >= 0) {
+                new_node->symbol = normalized;
             }
         }
     }
     
+    // Renaming a function must not hide a copied body
+    if (node->type == NODE_FUNCTION) {
+        new_node->symbol = SYM_LABEL_FUNCTION;
+    }
+    
     // WHILE loop normalize karo
     if (node->type == NODE_WHILE) {
-        strcpy(new_node->value, "loop");
+        new_node->symbol = SYM_LABEL_LOOP;
     }
     
     // ✅ Unify FOR, WHILE, DO loops as "loop" for similarity comparison
 if (node->type == NODE_FOR || node->type == NODE_WHILE) {
-    strcpy(new_node->value, "loop");
+    new_node->symbol = SYM_LABEL_LOOP;
 }
 
 
-    // Recursively process ALL children
-    for (int i = 0; i < node->child_count; i++) {
-        ASTNode *child = normalize_recursive(node->children[i], table);
-        if (child) add_child(new_node, child);
-    }
-    
-    
     return new_node;
 }
 
+// Copies root and every node below it that keeps its shape, in the same
+// preorder the variable names are numbered in. An operator chain parses to
+// a tree as deep as the chain is long, so this walks an explicit stack;
+// only switches and for loops, which the parser's nesting limit bounds,
+// go back through normalize_recursive.
+static ASTNode* normalize_tree(ASTNode *root, Normalizer *n) {
+    ASTNode *copy = normalize_node(root, n);
+    if (!copy) return NULL;
+    
+    int base = n->frame_count;
+    if (!push_frame(n, root, copy)) return NULL;
+    while (n->frame_count > base) {
+        NormalizeFrame *frame = &n->frames[n->frame_count - 1];
+        if (frame->next_child >= frame->node->child_count) {
+            n->frame_count--;
+            continue;
+        }
+        ASTNode *child = frame->node->children[frame->next_child++];
+        ASTNode *parent = frame->copy;
+        if (!child) continue;
+        
+        if (child->type == NODE_SWITCH || child->type == NODE_FOR) {
+            ASTNode *restructured = normalize_recursive(child, n);
+            if (restructured) add_child(n->scratch, parent, restructured);
+            continue;
+        }
+        
+        ASTNode *child_copy = normalize_node(child, n);
+        if (!child_copy) continue;
+        add_child(n->scratch, parent, child_copy);
+        if (child->child_count > 0 && !push_frame(n, child, child_copy)) {
+            n->frame_count = base;
+            return NULL;
+        }
+    }
+    return copy;
+}
+
 
-static ASTNode* switch_to_if_else(ASTNode *switch_node, VarTable *table) {
-    if (!switch_node || switch_node->child_count < 2) return switch_node;
+// Builds the normalized if-chain directly, one case per step, so a long
+// switch does not become an equally deep recursion
+static ASTNode* switch_to_if_else(ASTNode *switch_node, Normalizer *n) {
+    if (!switch_node) return NULL;
+    // Nothing to convert: flattening copies the node out of the input
+    if (switch_node->child_count < 2) return switch_node;
     
     ASTNode *switch_expr = switch_node->children[0];
     ASTNode *if_chain = NULL;
@@ -188,62 +246,54 @@ static ASTNode* switch_to_if_else(ASTNode *switch_node, VarTable *table) {
         
         if (case_node->type != NODE_CASE || case_node->child_count < 2) continue;
         
-        ASTNode *case_value = case_node->children[0];
-        ASTNode *case_body = case_node->children[1];
-        
-        ASTNode *if_node = create_node(NODE_IF, "if");
+        ASTNode *if_node = create_node(n->scratch, NODE_IF, SYM_IF);
         if (!if_node) continue;
         
-        ASTNode *condition = create_node(NODE_BINOP, "==");
+        ASTNode *condition = create_node(n->scratch, NODE_BINOP, SYM_EQ);
         if (condition) {
-            ASTNode *expr_clone = clone_ast(switch_expr);
-            ASTNode *val_clone = clone_ast(case_value);
-            if (expr_clone) add_child(condition, expr_clone);
-            if (val_clone) add_child(condition, val_clone);
-            add_child(if_node, condition);
+            ASTNode *left = normalize_recursive(switch_expr, n);
+            if (left) add_child(n->scratch, condition, left);
+            ASTNode *right = normalize_recursive(case_node->children[0], n);
+            if (right) add_child(n->scratch, condition, right);
+            add_child(n->scratch, if_node, condition);
         }
         
-        ASTNode *body_clone = clone_ast(case_body);
-        if (body_clone) add_child(if_node, body_clone);
+        ASTNode *body = normalize_recursive(case_node->children[1], n);
+        if (body) add_child(n->scratch, if_node, body);
         
         if (!if_chain) {
             if_chain = if_node;
-            current_if = if_node;
         } else {
-            if (current_if) add_child(current_if, if_node);
-            current_if = if_node;
+            add_child(n->scratch, current_if, if_node);
         }
+        current_if = if_node;
     }
     
-    return if_chain ? normalize_recursive(if_chain, table) : switch_node;
+    return if_chain ? if_chain : switch_node;
 }
 
-ASTNode* normalize_ast(ASTNode *ast) {
+FlatAST* normalize_ast(ASTNode *ast, Arena *arena, Arena *scratch) {
     if (!ast) return NULL;
-    printf("[DEBUG] Running FOR→WHILE normalization...\n");
-
-    // ADD THESE DEBUG LINES:
-    printf("[NORMALIZER DEBUG] Starting normalization\n");
-    printf("[NORMALIZER DEBUG] Root type: %d, children: %d\n", 
-           ast->type, ast->child_count);
-    
-    for (int i = 0; i < ast->child_count; i++) {
-        if (ast->children[i]) {
-            printf("[NORMALIZER DEBUG] Child[%d]: type=%d, value='%s', children=%d\n", 
-                   i, ast->children[i]->type, ast->children[i]->value, 
-                   ast->children[i]->child_count);
-        } else {
-            printf("[NORMALIZER DEBUG] Child[%d]: NULL\n", i);
+    LOG_DEBUG(LOG_NORMALIZER, "Starting normalization: root type %d, children %d\n", 
+              ast->type, ast->child_count);
+    
+    if (LOG_ENABLED(LOG_LEVEL_TRACE, LOG_NORMALIZER)) {
+        for (int i = 0; i < ast->child_count; i++) {
+            if (ast->children[i]) {
+                LOG_TRACE(LOG_NORMALIZER, "Child[%d]: type=%d, value='%s', children=%d\n", 
+                          i, ast->children[i]->type, symbol_text(ast->children[i]->symbol), 
+                          ast->children[i]->child_count);
+            } else {
+                LOG_TRACE(LOG_NORMALIZER, "Child[%d]: NULL\n", i);
+            }
         }
     }
     
-    VarTable *table = create_var_table();
-    if (!table) return NULL;
-    
-    ASTNode *normalized = normalize_recursive(ast, table);
-    printf("[DEBUG] AST normalized successfully: %d nodes\n", count_nodes(normalized));
+    Normalizer n = {{NULL, 0, 0}, NULL, 0, 0, scratch};
+    FlatAST *normalized = flatten_ast(normalize_recursive(ast, &n), arena);
+    LOG_DEBUG(LOG_NORMALIZER, "AST normalized successfully: %d nodes\n",
+              normalized ? normalized->count : 0);
 
-    free_var_table(table);
     
     return normalized;
 }
\ No newline at end of file
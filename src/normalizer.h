@@ -3,6 +3,9 @@
 
 #include "ast.h"
 
-ASTNode* normalize_ast(ASTNode *ast);
+// Returns the normalized tree flattened into arena, sharing nothing with
+// ast; the working tree goes to scratch, which the caller may reset
+// afterwards
+FlatAST* normalize_ast(ASTNode *ast, Arena *arena, Arena *scratch);
 
 #endif
\ No newline at end of file
@@ -1,25 +1,38 @@
 #include "parser.h"
+#include "log.h"
+#include "symbol.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 typedef struct {
-    Token *tokens;
+    const unsigned char *types;
+    const int *symbols;
+    const int *offsets;
+    const unsigned short *lengths;
     int pos;
     int count;
+    Arena *arena;
+    int depth;
+    int max_depth;
+    int too_deep;
 } Parser;
 
 static ASTNode* parse_statement(Parser *p);
 static ASTNode* parse_expression(Parser *p);
-static ASTNode* parse_comparison(Parser *p);
-static ASTNode* parse_additive(Parser *p);
-static ASTNode* parse_multiplicative(Parser *p);
-static ASTNode* parse_primary(Parser *p);
+static ASTNode* parse_binary(Parser *p, int min_power);
 static ASTNode* parse_block(Parser *p);
 
-static Token* current_token(Parser *p) {
-    if (p->pos < p->count) return &p->tokens[p->pos];
-    return &p->tokens[p->count - 1];
+static int current_index(Parser *p) {
+    return p->pos < p->count ? p->pos : p->count - 1;
+}
+
+static TokenType current_type(Parser *p) {
+    return (TokenType)p->types[current_index(p)];
+}
+
+static int current_symbol(Parser *p) {
+    return p->symbols[current_index(p)];
 }
 
 static void advance(Parser *p) {
@@ -27,133 +40,324 @@ static void advance(Parser *p) {
 }
 
 static int match(Parser *p, TokenType type) {
-    return current_token(p)->type == type;
+    return current_type(p) == type;
 }
 
-static int match_keyword(Parser *p, const char *keyword) {
-    Token *tok = current_token(p);
-    return tok->type == TOK_KEYWORD && strcmp(tok->value, keyword) == 0;
+// Keyword IDs are only ever assigned to keyword tokens
+static int match_keyword(Parser *p, SymbolId keyword) {
+    return current_symbol(p) == (int)keyword;
 }
 
-static ASTNode* parse_primary(Parser *p) {
-    Token *tok = current_token(p);
-    
-    if (match(p, TOK_LPAREN)) {
-        advance(p);
-        ASTNode *expr = parse_comparison(p);
-        if (match(p, TOK_RPAREN)) advance(p);
-        return expr;
+// Every nested statement and every operand the expression parser
+// descends into is one level. Past max_depth the parser jumps to the
+// final TOK_EOF, so every loop ends and the recursion unwinds without
+// reading further.
+static int enter(Parser *p) {
+    if (++p->depth > p->max_depth && !p->too_deep) {
+        p->too_deep = 1;
+        p->pos = p->count - 1;
     }
-    
-    if (match(p, TOK_NUMBER)) {
-        ASTNode *node = create_node(NODE_LITERAL, tok->value);
-        advance(p);
-        return node;
+    return !p->too_deep;
+}
+
+static void leave(Parser *p) {
+    p->depth--;
+}
+
+// Binding power of every C binary operator, indexed by symbol ID; 0 for
+// anything that does not continue an expression. Higher binds tighter.
+// The comma operator is left out so argument lists and declarations
+// stop at it.
+enum {
+    POWER_NONE,
+    POWER_ASSIGN,       // right associative
+    POWER_TERNARY,      // right associative
+    POWER_OR,
+    POWER_AND,
+    POWER_BIT_OR,
+    POWER_BIT_XOR,
+    POWER_BIT_AND,
+    POWER_EQUALITY,
+    POWER_RELATIONAL,
+    POWER_SHIFT,
+    POWER_ADDITIVE,
+    POWER_MULTIPLICATIVE,
+    POWER_PREFIX        // operand of a unary operator or cast
+};
+
+static const unsigned char infix_power[SYM_PRESEEDED_COUNT] = {
+    [SYM_ASSIGN] = POWER_ASSIGN,
+    [SYM_ADD_ASSIGN] = POWER_ASSIGN,
+    [SYM_SUB_ASSIGN] = POWER_ASSIGN,
+    [SYM_MUL_ASSIGN] = POWER_ASSIGN,
+    [SYM_DIV_ASSIGN] = POWER_ASSIGN,
+    [SYM_MOD_ASSIGN] = POWER_ASSIGN,
+    [SYM_AND_ASSIGN] = POWER_ASSIGN,
+    [SYM_OR_ASSIGN] = POWER_ASSIGN,
+    [SYM_XOR_ASSIGN] = POWER_ASSIGN,
+    [SYM_SHL_ASSIGN] = POWER_ASSIGN,
+    [SYM_SHR_ASSIGN] = POWER_ASSIGN,
+    [SYM_QUESTION] = POWER_TERNARY,
+    [SYM_OR] = POWER_OR,
+    [SYM_AND] = POWER_AND,
+    [SYM_PIPE] = POWER_BIT_OR,
+    [SYM_CARET] = POWER_BIT_XOR,
+    [SYM_AMP] = POWER_BIT_AND,
+    [SYM_EQ] = POWER_EQUALITY,
+    [SYM_NE] = POWER_EQUALITY,
+    [SYM_LT] = POWER_RELATIONAL,
+    [SYM_GT] = POWER_RELATIONAL,
+    [SYM_LE] = POWER_RELATIONAL,
+    [SYM_GE] = POWER_RELATIONAL,
+    [SYM_SHL] = POWER_SHIFT,
+    [SYM_SHR] = POWER_SHIFT,
+    [SYM_PLUS] = POWER_ADDITIVE,
+    [SYM_MINUS] = POWER_ADDITIVE,
+    [SYM_STAR] = POWER_MULTIPLICATIVE,
+    [SYM_SLASH] = POWER_MULTIPLICATIVE,
+    [SYM_PERCENT] = POWER_MULTIPLICATIVE
+};
+
+// Identifiers and literals get IDs past the table and never bind
+static int binding_power(int symbol) {
+    return (unsigned)symbol < SYM_PRESEEDED_COUNT ? infix_power[symbol] : POWER_NONE;
+}
+
+static int is_prefix_operator(int symbol) {
+    switch (symbol) {
+        case SYM_MINUS:
+        case SYM_PLUS:
+        case SYM_NOT:
+        case SYM_TILDE:
+        case SYM_STAR:
+        case SYM_AMP:
+        case SYM_INC:
+        case SYM_DEC:
+            return 1;
+        default:
+            return 0;
     }
-    
-    if (match(p, TOK_IDENTIFIER)) {
-        char var_name[128];
-        strncpy(var_name, tok->value, 127);
-        var_name[127] = '\0';
-        advance(p);
-        
-        if (match(p, TOK_LBRACKET)) {
-            advance(p);
-            ASTNode *arr_node = create_node(NODE_ARRAY_ACCESS, var_name);
-            ASTNode *index = parse_comparison(p);
-            if (index) add_child(arr_node, index);
-            if (match(p, TOK_RBRACKET)) advance(p);
-            return arr_node;
-        }
-        
-        return create_node(NODE_VAR, var_name);
+}
+
+// Keywords that can start a type name, which is what tells a cast or
+// sizeof(type) from a parenthesized expression
+static int is_type_keyword(int symbol) {
+    switch (symbol) {
+        case SYM_INT:
+        case SYM_FLOAT:
+        case SYM_CHAR:
+        case SYM_DOUBLE:
+        case SYM_VOID:
+        case SYM_LONG:
+        case SYM_SHORT:
+        case SYM_UNSIGNED:
+        case SYM_SIGNED:
+        case SYM_STRUCT:
+        case SYM_UNION:
+        case SYM_ENUM:
+        case SYM_CONST:
+        case SYM_VOLATILE:
+        case SYM_BOOL:
+            return 1;
+        default:
+            return 0;
     }
-    
-    return NULL;
 }
 
-static ASTNode* parse_multiplicative(Parser *p) {
-    ASTNode *left = parse_primary(p);
-    if (!left) return NULL;
-    
-    while (match(p, TOK_OPERATOR)) {
-        Token *op = current_token(p);
-        if (strcmp(op->value, "*") != 0 && 
-            strcmp(op->value, "/") != 0 && 
-            strcmp(op->value, "%") != 0) {
-            break;
-        }
-        
+static int next_is_type(Parser *p) {
+    int next = p->pos + 1;
+    return next < p->count && p->types[next] == TOK_KEYWORD &&
+           is_type_keyword(p->symbols[next]);
+}
+
+// Skips "(type name)" with the '(' current and returns the first type
+// keyword, which stands for the whole type in the tree
+static int skip_type_name(Parser *p) {
+    advance(p);
+    int symbol = current_symbol(p);
+    while (!match(p, TOK_RPAREN) && current_type(p) != TOK_EOF) {
         advance(p);
-        ASTNode *right = parse_primary(p);
-        if (!right) break;
-        
-        ASTNode *binop = create_node(NODE_BINOP, op->value);
-        if (binop) {
-            add_child(binop, left);
-            add_child(binop, right);
-            left = binop;
+    }
+    if (match(p, TOK_RPAREN)) advance(p);
+    return symbol;
+}
+
+static ASTNode* unary_node(Parser *p, int op, ASTNode *operand) {
+    ASTNode *node = create_node(p->arena, NODE_UNOP, op);
+    if (node && operand) add_child(p->arena, node, operand);
+    return node;
+}
+
+// Indexing, calls, member access and postfix ++/--. A plain name that is
+// indexed or called keeps its name as the node's value, as before;
+// anything else becomes the first child.
+static ASTNode* parse_postfix(Parser *p, ASTNode *left) {
+    for (;;) {
+        switch (current_type(p)) {
+            case TOK_LBRACKET: {
+                advance(p);
+                ASTNode *index = parse_expression(p);
+                if (match(p, TOK_RBRACKET)) advance(p);
+                
+                ASTNode *access = left;
+                if (left->type == NODE_VAR) {
+                    left->type = NODE_ARRAY_ACCESS;
+                } else {
+                    access = create_node(p->arena, NODE_ARRAY_ACCESS, SYM_LBRACKET);
+                    if (!access) return left;
+                    add_child(p->arena, access, left);
+                }
+                if (index) add_child(p->arena, access, index);
+                left = access;
+                break;
+            }
+            
+            case TOK_LPAREN: {
+                advance(p);
+                ASTNode *call = left;
+                if (left->type == NODE_VAR) {
+                    left->type = NODE_CALL;
+                } else {
+                    call = create_node(p->arena, NODE_CALL, SYM_LPAREN);
+                    if (!call) return left;
+                    add_child(p->arena, call, left);
+                }
+                while (!match(p, TOK_RPAREN) && current_type(p) != TOK_EOF) {
+                    ASTNode *arg = parse_binary(p, POWER_ASSIGN);
+                    if (arg) add_child(p->arena, call, arg);
+                    if (match(p, TOK_COMMA)) {
+                        advance(p);
+                    } else if (!arg) {
+                        advance(p);
+                    } else if (!match(p, TOK_RPAREN)) {
+                        break;
+                    }
+                }
+                if (match(p, TOK_RPAREN)) advance(p);
+                left = call;
+                break;
+            }
+            
+            case TOK_OPERATOR: {
+                int op = current_symbol(p);
+                if (op == SYM_DOT || op == SYM_ARROW) {
+                    advance(p);
+                    if (!match(p, TOK_IDENTIFIER)) return left;
+                    ASTNode *member = create_node(p->arena, NODE_BINOP, op);
+                    ASTNode *field = create_node(p->arena, NODE_VAR, current_symbol(p));
+                    advance(p);
+                    if (!member || !field) return left;
+                    add_child(p->arena, member, left);
+                    add_child(p->arena, member, field);
+                    left = member;
+                } else if (op == SYM_INC || op == SYM_DEC) {
+                    ASTNode *step = unary_node(p, op, left);
+                    advance(p);
+                    if (!step) return left;
+                    left = step;
+                } else {
+                    return left;
+                }
+                break;
+            }
+            
+            default:
+                return left;
         }
     }
-    
-    return left;
 }
 
-static ASTNode* parse_additive(Parser *p) {
-    ASTNode *left = parse_multiplicative(p);
-    if (!left) return NULL;
+static ASTNode* parse_unary(Parser *p) {
+    int symbol = current_symbol(p);
     
-    while (match(p, TOK_OPERATOR)) {
-        Token *op = current_token(p);
-        if (strcmp(op->value, "+") != 0 && strcmp(op->value, "-") != 0) {
-            break;
+    switch (current_type(p)) {
+        case TOK_OPERATOR:
+            if (!is_prefix_operator(symbol)) return NULL;
+            advance(p);
+            return unary_node(p, symbol, parse_binary(p, POWER_PREFIX));
+        
+        case TOK_KEYWORD:
+            if (symbol != SYM_SIZEOF) return NULL;
+            advance(p);
+            if (match(p, TOK_LPAREN) && next_is_type(p)) {
+                int type = skip_type_name(p);
+                return unary_node(p, SYM_SIZEOF, create_node(p->arena, NODE_LITERAL, type));
+            }
+            return unary_node(p, SYM_SIZEOF, parse_binary(p, POWER_PREFIX));
+        
+        case TOK_LPAREN: {
+            if (next_is_type(p)) {
+                int type = skip_type_name(p);
+                return unary_node(p, type, parse_binary(p, POWER_PREFIX));
+            }
+            advance(p);
+            ASTNode *expr = parse_expression(p);
+            if (match(p, TOK_RPAREN)) advance(p);
+            return expr ? parse_postfix(p, expr) : NULL;
         }
         
-        advance(p);
-        ASTNode *right = parse_multiplicative(p);
-        if (!right) break;
+        case TOK_NUMBER:
+        case TOK_STRING: {
+            ASTNode *node = create_node(p->arena, NODE_LITERAL, symbol);
+            advance(p);
+            return node;
+        }
         
-        ASTNode *binop = create_node(NODE_BINOP, op->value);
-        if (binop) {
-            add_child(binop, left);
-            add_child(binop, right);
-            left = binop;
+        case TOK_IDENTIFIER: {
+            ASTNode *node = create_node(p->arena, NODE_VAR, symbol);
+            advance(p);
+            return node ? parse_postfix(p, node) : NULL;
         }
+        
+        default:
+            return NULL;
     }
-    
-    return left;
 }
 
-static ASTNode* parse_comparison(Parser *p) {
-    ASTNode *left = parse_additive(p);
-    if (!left) return NULL;
-    
-    while (match(p, TOK_OPERATOR)) {
-        Token *op = current_token(p);
-        if (strcmp(op->value, "<") != 0 && strcmp(op->value, ">") != 0 &&
-            strcmp(op->value, "<=") != 0 && strcmp(op->value, ">=") != 0 &&
-            strcmp(op->value, "==") != 0 && strcmp(op->value, "!=") != 0 &&
-            strcmp(op->value, "&&") != 0 && strcmp(op->value, "||") != 0) {
-            break;
-        }
-        
+// Precedence climbing: one loop over the operator table instead of a
+// function per level. Each binary operator takes a right operand that
+// binds tighter than itself, or as tight for the right associative ones.
+static ASTNode* parse_binary(Parser *p, int min_power) {
+    ASTNode *left = enter(p) ? parse_unary(p) : NULL;
+    
+    while (left) {
+        int op = current_symbol(p);
+        int power = binding_power(op);
+        if (power == POWER_NONE || power < min_power) break;
         advance(p);
-        ASTNode *right = parse_additive(p);
-        if (!right) break;
         
-        ASTNode *binop = create_node(NODE_BINOP, op->value);
-        if (binop) {
-            add_child(binop, left);
-            add_child(binop, right);
-            left = binop;
+        ASTNode *node;
+        if (op == SYM_QUESTION) {
+            // cond ? a : b, the middle is parsed as if parenthesized
+            ASTNode *then_value = parse_expression(p);
+            if (match(p, TOK_COLON)) advance(p);
+            ASTNode *else_value = parse_binary(p, POWER_TERNARY);
+            if (!then_value || !else_value) break;
+            
+            node = create_node(p->arena, NODE_TERNARY, SYM_QUESTION);
+            if (!node) break;
+            add_child(p->arena, node, left);
+            add_child(p->arena, node, then_value);
+            add_child(p->arena, node, else_value);
+        } else {
+            int right_power = power == POWER_ASSIGN ? power : power + 1;
+            ASTNode *right = parse_binary(p, right_power);
+            if (!right) break;
+            
+            node = create_node(p->arena, power == POWER_ASSIGN ? NODE_ASSIGN : NODE_BINOP, op);
+            if (!node) break;
+            add_child(p->arena, node, left);
+            add_child(p->arena, node, right);
         }
+        left = node;
     }
     
+    leave(p);
     return left;
 }
 
 static ASTNode* parse_expression(Parser *p) {
-    return parse_comparison(p);
+    return parse_binary(p, POWER_ASSIGN);
 }
 
 static ASTNode* parse_block(Parser *p) {
@@ -162,15 +366,16 @@ static ASTNode* parse_block(Parser *p) {
     }
     
     advance(p);
-    ASTNode *block = create_node(NODE_BLOCK, "block");
+    ASTNode *block = create_node(p->arena, NODE_BLOCK, SYM_LABEL_BLOCK);
     if (!block) return NULL;
     
-    while (!match(p, TOK_RBRACE) && current_token(p)->type != TOK_EOF) {
+    while (!match(p, TOK_RBRACE) && current_type(p) != TOK_EOF) {
+    int start = p->pos;
     ASTNode *stmt = parse_statement(p);
     if (stmt) {
-        add_child(block, stmt);
-    } else {
-        // If statement parsing fails, skip this token to avoid infinite loop
+        add_child(p->arena, block, stmt);
+    } else if (p->pos == start) {
+        // If nothing could be parsed, skip this token to avoid infinite loop
         advance(p);
     }
 }
@@ -179,52 +384,94 @@ static ASTNode* parse_block(Parser *p) {
     return block;
 }
 
-static ASTNode* parse_statement(Parser *p) {
-    Token *tok = current_token(p);
-    
-    if (match_keyword(p, "int") || match_keyword(p, "float") || 
-    match_keyword(p, "char") || match_keyword(p, "double") ||
-    match_keyword(p, "long") || match_keyword(p, "short") ||
-    match_keyword(p, "unsigned") || match_keyword(p, "signed") ||
-    match_keyword(p, "void")) {  // ← void bhi add karo
+// "long long int", "unsigned short" and friends after the first specifier
+static int is_integer_modifier(int symbol) {
+    switch (symbol) {
+        case SYM_INT:
+        case SYM_LONG:
+        case SYM_SHORT:
+        case SYM_UNSIGNED:
+        case SYM_SIGNED:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+// Skips a parameter list, the '(' being current, and returns how many
+// parameters it declares; "()" and "(void)" declare none
+static int skip_parameters(Parser *p) {
+    advance(p);
+    if (match(p, TOK_RPAREN)) {
+        advance(p);
+        return 0;
+    }
+    if (match_keyword(p, SYM_VOID) && p->pos + 1 < p->count &&
+        p->types[p->pos + 1] == TOK_RPAREN) {
+        advance(p);
+        advance(p);
+        return 0;
+    }
     
+    // Commas inside nested parentheses belong to function pointer types
+    int arity = 1, depth = 1;
+    while (current_type(p) != TOK_EOF) {
+        if (match(p, TOK_LPAREN)) depth++;
+        if (match(p, TOK_RPAREN) && --depth == 0) break;
+        if (match(p, TOK_COMMA) && depth == 1) arity++;
+        advance(p);
+    }
+    if (match(p, TOK_RPAREN)) advance(p);
+    return arity;
+}
+
+// The body is current; first is the token the definition starts at
+static ASTNode* parse_function(Parser *p, int name, int arity, int first) {
+    ASTNode *function = create_node(p->arena, NODE_FUNCTION, name);
+    FunctionSpan *span = arena_alloc(p->arena, sizeof(FunctionSpan));
+    ASTNode *body = parse_block(p);
+    if (!function || !span) return body;
+    
+    // The closing brace is the last token consumed
+    int last = p->pos > first ? p->pos - 1 : first;
+    span->arity = arity;
+    span->first_token = first;
+    span->token_count = last - first + 1;
+    span->offset = p->offsets[first];
+    span->length = p->offsets[last] + p->lengths[last] - span->offset;
+    function->span = span;
+    if (body) add_child(p->arena, function, body);
+    return function;
+}
+
+// Declaration or function definition; the type keyword (or typedef
+// name) is current
+static ASTNode* parse_declaration(Parser *p) {
+    int first = p->pos;
     advance(p);
     
-    while (match_keyword(p, "int") || match_keyword(p, "long") ||
-           match_keyword(p, "short") || match_keyword(p, "unsigned") ||
-           match_keyword(p, "signed")) {
+    while (match(p, TOK_KEYWORD) && is_integer_modifier(current_symbol(p))) {
+        advance(p);
+    }
+    while (match(p, TOK_OPERATOR) && current_symbol(p) == SYM_STAR) {
         advance(p);
     }
     
     if (!match(p, TOK_IDENTIFIER)) return NULL;
-    Token *var_name = current_token(p);
+    int var_symbol = current_symbol(p);
     advance(p);
     
-    // ✅ CHECK IF THIS IS A FUNCTION
     if (match(p, TOK_LPAREN)) {
-        // This is a function declaration/definition
-        advance(p);  // skip '('
-        
-        // Skip parameters (simplified - just skip until ')')
-        while (!match(p, TOK_RPAREN) && current_token(p)->type != TOK_EOF) {
-            advance(p);
-        }
-        
-        if (match(p, TOK_RPAREN)) advance(p);  // skip ')'
-        
-        // Check if function has body
+        int arity = skip_parameters(p);
         if (match(p, TOK_LBRACE)) {
-            // Parse function body as a block
-            ASTNode *func_body = parse_block(p);
-            return func_body;  // Return the function body as top-level
+            return parse_function(p, var_symbol, arity, first);
         }
         
-        // Function declaration only (no body)
+        // Prototype only
         if (match(p, TOK_SEMICOLON)) advance(p);
         return NULL;
     }
     
-    // ✅ Rest of variable declaration code (array, assignment, etc.)
     if (match(p, TOK_LBRACKET)) {
         advance(p);
         if (match(p, TOK_NUMBER)) advance(p);
@@ -233,13 +480,13 @@ static ASTNode* parse_statement(Parser *p) {
     
     if (match(p, TOK_ASSIGN)) {
         advance(p);
-        ASTNode *assign = create_node(NODE_ASSIGN, "=");
-        ASTNode *var = create_node(NODE_VAR, var_name->value);
+        ASTNode *assign = create_node(p->arena, NODE_ASSIGN, SYM_ASSIGN);
+        ASTNode *var = create_node(p->arena, NODE_VAR, var_symbol);
         ASTNode *expr = parse_expression(p);
         
         if (assign && var) {
-            add_child(assign, var);
-            if (expr) add_child(assign, expr);
+            add_child(p->arena, assign, var);
+            if (expr) add_child(p->arena, assign, expr);
         }
         
         if (match(p, TOK_SEMICOLON)) advance(p);
@@ -249,107 +496,93 @@ static ASTNode* parse_statement(Parser *p) {
     if (match(p, TOK_SEMICOLON)) advance(p);
     return NULL;
 }
+
+// struct, union or enum: the tag and any member list are skipped, and
+// what follows is read like any other declaration
+static ASTNode* parse_tagged_declaration(Parser *p) {
+    advance(p);
+    if (match(p, TOK_IDENTIFIER)) advance(p);
     
-    if (match(p, TOK_IDENTIFIER)) {
-        Token *var_name = tok;
-        advance(p);
-        
-        if (match(p, TOK_LBRACKET)) {
-            advance(p);
-            ASTNode *index = parse_expression(p);
-            if (match(p, TOK_RBRACKET)) advance(p);
-            
-            if (match(p, TOK_ASSIGN)) {
-                advance(p);
-                ASTNode *assign = create_node(NODE_ASSIGN, "=");
-                ASTNode *arr_access = create_node(NODE_ARRAY_ACCESS, var_name->value);
-                if (index) add_child(arr_access, index);
-                ASTNode *expr = parse_expression(p);
-                
-                if (assign && arr_access) {
-                    add_child(assign, arr_access);
-                    if (expr) add_child(assign, expr);
-                }
-                
-                if (match(p, TOK_SEMICOLON)) advance(p);
-                return assign;
-            }
-        }
-        
-        if (match(p, TOK_ASSIGN)) {
+    if (match(p, TOK_LBRACE)) {
+        int depth = 0;
+        do {
+            if (match(p, TOK_LBRACE)) depth++;
+            if (match(p, TOK_RBRACE)) depth--;
             advance(p);
-            ASTNode *assign = create_node(NODE_ASSIGN, "=");
-            ASTNode *var = create_node(NODE_VAR, var_name->value);
-            ASTNode *expr = parse_expression(p);
-            
-            if (assign && var) {
-                add_child(assign, var);
-                if (expr) add_child(assign, expr);
-            }
-            
-            if (match(p, TOK_SEMICOLON)) advance(p);
-            return assign;
-        }
-        
-        if (match(p, TOK_OPERATOR)) {
-            Token *op = current_token(p);
-            if (strcmp(op->value, "++") == 0 || strcmp(op->value, "--") == 0) {
-                advance(p);
-                if (match(p, TOK_SEMICOLON)) advance(p);
-            }
-        }
-        
-        return NULL;
+        } while (depth > 0 && current_type(p) != TOK_EOF);
     }
     
-    if (match_keyword(p, "if")) {
+    if (match(p, TOK_SEMICOLON)) {
         advance(p);
-        if (!match(p, TOK_LPAREN)) return NULL;
-        advance(p);
-        
-        ASTNode *if_node = create_node(NODE_IF, "if");
-        ASTNode *cond = parse_expression(p);
-        if (cond) add_child(if_node, cond);
-        
-        if (!match(p, TOK_RPAREN)) return NULL;
-        advance(p);
-        
-        ASTNode *then_body = parse_block(p);
-        if (then_body) add_child(if_node, then_body);
-        
-        if (match_keyword(p, "else")) {
-            advance(p);
-            ASTNode *else_body = parse_block(p);
-            if (else_body) add_child(if_node, else_body);
-        }
-        
-        return if_node;
+        return NULL;
+    }
+    // Back onto the last token of the type so parse_declaration skips it
+    p->pos--;
+    return parse_declaration(p);
+}
+
+// Assignments, calls, increments and any other expression used as a
+// statement. Two names in a row start a declaration whose type is a
+// typedef ("size_t n = 0;").
+static ASTNode* parse_expression_statement(Parser *p) {
+    if (match(p, TOK_IDENTIFIER) && p->pos + 1 < p->count &&
+        p->types[p->pos + 1] == TOK_IDENTIFIER) {
+        return parse_declaration(p);
     }
     
-    if (match_keyword(p, "while")) {
-        advance(p);
-        if (!match(p, TOK_LPAREN)) return NULL;
-        advance(p);
-        
-        ASTNode *while_node = create_node(NODE_WHILE, "while");
-        ASTNode *cond = parse_expression(p);
-        if (cond) add_child(while_node, cond);
-        
-        if (!match(p, TOK_RPAREN)) return NULL;
+    ASTNode *expr = parse_expression(p);
+    if (expr && match(p, TOK_SEMICOLON)) advance(p);
+    return expr;
+}
+
+static ASTNode* parse_if(Parser *p) {
+    advance(p);
+    if (!match(p, TOK_LPAREN)) return NULL;
+    advance(p);
+    
+    ASTNode *if_node = create_node(p->arena, NODE_IF, SYM_IF);
+    ASTNode *cond = parse_expression(p);
+    if (cond) add_child(p->arena, if_node, cond);
+    
+    if (!match(p, TOK_RPAREN)) return NULL;
+    advance(p);
+    
+    ASTNode *then_body = parse_block(p);
+    if (then_body) add_child(p->arena, if_node, then_body);
+    
+    if (match_keyword(p, SYM_ELSE)) {
         advance(p);
-        
-        ASTNode *body = parse_block(p);
-        if (body) add_child(while_node, body);
-        
-        return while_node;
+        ASTNode *else_body = parse_block(p);
+        if (else_body) add_child(p->arena, if_node, else_body);
     }
     
-    if (match_keyword(p, "for")) {
+    return if_node;
+}
+
+static ASTNode* parse_while(Parser *p) {
+    advance(p);
+    if (!match(p, TOK_LPAREN)) return NULL;
+    advance(p);
+    
+    ASTNode *while_node = create_node(p->arena, NODE_WHILE, SYM_WHILE);
+    ASTNode *cond = parse_expression(p);
+    if (cond) add_child(p->arena, while_node, cond);
+    
+    if (!match(p, TOK_RPAREN)) return NULL;
+    advance(p);
+    
+    ASTNode *body = parse_block(p);
+    if (body) add_child(p->arena, while_node, body);
+    
+    return while_node;
+}
+
+static ASTNode* parse_for(Parser *p) {
     advance(p);
     if (!match(p, TOK_LPAREN)) return NULL;
     advance(p);
 
-    ASTNode *for_node = create_node(NODE_FOR, "for");
+    ASTNode *for_node = create_node(p->arena, NODE_FOR, SYM_FOR);
     if (!for_node) return NULL;
 
     // Parse initialization (can be declaration or assignment)
@@ -376,156 +609,197 @@ static ASTNode* parse_statement(Parser *p) {
     // Parse loop body
     ASTNode *body = parse_block(p);
 
-    if (init) add_child(for_node, init);
-    else add_child(for_node, create_node(NODE_LITERAL, "NULL"));
+    if (init) add_child(p->arena, for_node, init);
+    else add_child(p->arena, for_node, create_node(p->arena, NODE_LITERAL, SYM_LABEL_NULL));
 
-    if (cond) add_child(for_node, cond);
-    else add_child(for_node, create_node(NODE_LITERAL, "1"));
+    if (cond) add_child(p->arena, for_node, cond);
+    else add_child(p->arena, for_node, create_node(p->arena, NODE_LITERAL, SYM_LABEL_ONE));
 
-    if (inc) add_child(for_node, inc);
-    else add_child(for_node, create_node(NODE_LITERAL, "NULL"));
+    if (inc) add_child(p->arena, for_node, inc);
+    else add_child(p->arena, for_node, create_node(p->arena, NODE_LITERAL, SYM_LABEL_NULL));
 
-    if (body) add_child(for_node, body);
-    else add_child(for_node, create_node(NODE_BLOCK, "empty"));
+    if (body) add_child(p->arena, for_node, body);
+    else add_child(p->arena, for_node, create_node(p->arena, NODE_BLOCK, SYM_LABEL_EMPTY));
 
     return for_node;
 }
 
+static ASTNode* parse_do(Parser *p) {
+    advance(p);
     
-    if (match_keyword(p, "do")) {
-        advance(p);
-        
-        ASTNode *do_while = create_node(NODE_WHILE, "loop");
-        ASTNode *body = parse_block(p);
-        
-        if (match_keyword(p, "while")) {
-            advance(p);
-            if (match(p, TOK_LPAREN)) advance(p);
-            
-            ASTNode *cond = parse_expression(p);
-            if (cond) add_child(do_while, cond);
-            
-            if (match(p, TOK_RPAREN)) advance(p);
-        }
-        
-        if (body) add_child(do_while, body);
-        if (match(p, TOK_SEMICOLON)) advance(p);
-        
-        return do_while;
-    }
+    ASTNode *do_while = create_node(p->arena, NODE_WHILE, SYM_LABEL_LOOP);
+    ASTNode *body = parse_block(p);
     
-    if (match_keyword(p, "switch")) {
-        advance(p);
-        if (!match(p, TOK_LPAREN)) return NULL;
+    if (match_keyword(p, SYM_WHILE)) {
         advance(p);
+        if (match(p, TOK_LPAREN)) advance(p);
         
-        ASTNode *switch_node = create_node(NODE_SWITCH, "switch");
-        ASTNode *expr = parse_expression(p);
-        if (expr) add_child(switch_node, expr);
-        
-        if (!match(p, TOK_RPAREN)) return NULL;
-        advance(p);
-        if (!match(p, TOK_LBRACE)) return NULL;
-        advance(p);
+        ASTNode *cond = parse_expression(p);
+        if (cond) add_child(p->arena, do_while, cond);
         
-        while (!match(p, TOK_RBRACE) && current_token(p)->type != TOK_EOF) {
-            if (match_keyword(p, "case")) {
-                advance(p);
-                ASTNode *case_node = create_node(NODE_CASE, "case");
-                ASTNode *case_val = parse_expression(p);
-                if (case_val) add_child(case_node, case_val);
-                
-                if (match(p, TOK_COLON)) advance(p);
-                
-                ASTNode *case_body = create_node(NODE_BLOCK, "case_body");
-            while (!match_keyword(p, "case") && !match_keyword(p, "default") &&
-            !match(p, TOK_RBRACE) && current_token(p)->type != TOK_EOF) {
-            if (match_keyword(p, "break")) {
-                advance(p);
-            if (match(p, TOK_SEMICOLON)) advance(p);
-                break;
-            }
-    ASTNode *stmt = parse_statement(p);
-    if (stmt) {
-        add_child(case_body, stmt);
-    } else {
-        // Skip unrecognized tokens in case body
-        advance(p);
+        if (match(p, TOK_RPAREN)) advance(p);
     }
-}
-                
-                if (case_body) add_child(case_node, case_body);
-                if (case_node) add_child(switch_node, case_node);
-                
-            } else if (match_keyword(p, "default")) {
-                advance(p);
-                if (match(p, TOK_COLON)) advance(p);
     
-            while (!match(p, TOK_RBRACE) && current_token(p)->type != TOK_EOF) {
-                if (match_keyword(p, "break")) {
-                    advance(p);
-                if (match(p, TOK_SEMICOLON)) advance(p);
-                break;
-            }
+    if (body) add_child(p->arena, do_while, body);
+    if (match(p, TOK_SEMICOLON)) advance(p);
+    
+    return do_while;
+}
+
+// Statements up to the next label, the closing brace or a break, added
+// to body unless it is NULL
+static void parse_case_body(Parser *p, ASTNode *body) {
+    while (!match_keyword(p, SYM_CASE) && !match_keyword(p, SYM_DEFAULT) &&
+           !match(p, TOK_RBRACE) && current_type(p) != TOK_EOF) {
+        if (match_keyword(p, SYM_BREAK)) {
+            advance(p);
+            if (match(p, TOK_SEMICOLON)) advance(p);
+            break;
         }
-            ASTNode *stmt = parse_statement(p);
-            if (!stmt) {
-                // Skip unrecognized tokens in default case
-                advance(p);
-            }
+        int start = p->pos;
+        ASTNode *stmt = parse_statement(p);
+        if (stmt) {
+            if (body) add_child(p->arena, body, stmt);
+        } else if (p->pos == start) {
+            // Skip unrecognized tokens in case body
+            advance(p);
         }
     }
-        
-        if (match(p, TOK_RBRACE)) advance(p);
-        return switch_node;
-    }
+}
+
+static ASTNode* parse_switch(Parser *p) {
+    advance(p);
+    if (!match(p, TOK_LPAREN)) return NULL;
+    advance(p);
     
-    if (match_keyword(p, "return")) {
-        advance(p);
-        ASTNode *ret = create_node(NODE_RETURN, "return");
-        
-        if (!match(p, TOK_SEMICOLON)) {
-            ASTNode *expr = parse_expression(p);
-            if (expr) add_child(ret, expr);
+    ASTNode *switch_node = create_node(p->arena, NODE_SWITCH, SYM_SWITCH);
+    ASTNode *expr = parse_expression(p);
+    if (expr) add_child(p->arena, switch_node, expr);
+    
+    if (!match(p, TOK_RPAREN)) return NULL;
+    advance(p);
+    if (!match(p, TOK_LBRACE)) return NULL;
+    advance(p);
+    
+    while (!match(p, TOK_RBRACE) && current_type(p) != TOK_EOF) {
+        if (match_keyword(p, SYM_CASE)) {
+            advance(p);
+            ASTNode *case_node = create_node(p->arena, NODE_CASE, SYM_CASE);
+            ASTNode *case_val = parse_expression(p);
+            if (case_val) add_child(p->arena, case_node, case_val);
+            
+            if (match(p, TOK_COLON)) advance(p);
+            
+            ASTNode *case_body = create_node(p->arena, NODE_BLOCK, SYM_LABEL_CASE_BODY);
+            parse_case_body(p, case_body);
+            
+            if (case_body) add_child(p->arena, case_node, case_body);
+            if (case_node) add_child(p->arena, switch_node, case_node);
+        } else if (match_keyword(p, SYM_DEFAULT)) {
+            advance(p);
+            if (match(p, TOK_COLON)) advance(p);
+            // The default body is read past but not kept
+            parse_case_body(p, NULL);
+        } else {
+            // Statements before the first label are unreachable
+            int start = p->pos;
+            if (!parse_statement(p) && p->pos == start) advance(p);
         }
-        
-        if (match(p, TOK_SEMICOLON)) advance(p);
-        return ret;
     }
     
-    if (match_keyword(p, "break")) {
-        advance(p);
-        if (match(p, TOK_SEMICOLON)) advance(p);
-        return create_node(NODE_BREAK, "break");
-    }
+    if (match(p, TOK_RBRACE)) advance(p);
+    return switch_node;
+}
+
+static ASTNode* parse_return(Parser *p) {
+    advance(p);
+    ASTNode *ret = create_node(p->arena, NODE_RETURN, SYM_RETURN);
     
-    if (match_keyword(p, "continue")) {
-        advance(p);
-        if (match(p, TOK_SEMICOLON)) advance(p);
-        return create_node(NODE_CONTINUE, "continue");
+    if (!match(p, TOK_SEMICOLON)) {
+        ASTNode *expr = parse_expression(p);
+        if (expr) add_child(p->arena, ret, expr);
     }
     
-    if (match(p, TOK_LBRACE)) {
-        return parse_block(p);
+    if (match(p, TOK_SEMICOLON)) advance(p);
+    return ret;
+}
+
+static ASTNode* parse_statement_kind(Parser *p) {
+    if (match(p, TOK_LBRACE)) return parse_block(p);
+    if (!match(p, TOK_KEYWORD) || match_keyword(p, SYM_SIZEOF)) {
+        return parse_expression_statement(p);
     }
     
-    return NULL;
+    // Keyword tokens carry their ID, so one switch picks the statement
+    switch (current_symbol(p)) {
+        case SYM_INT:
+        case SYM_FLOAT:
+        case SYM_CHAR:
+        case SYM_DOUBLE:
+        case SYM_LONG:
+        case SYM_SHORT:
+        case SYM_UNSIGNED:
+        case SYM_SIGNED:
+        case SYM_VOID:
+            return parse_declaration(p);
+        case SYM_STRUCT:
+        case SYM_UNION:
+        case SYM_ENUM:
+            return parse_tagged_declaration(p);
+        case SYM_IF:
+            return parse_if(p);
+        case SYM_WHILE:
+            return parse_while(p);
+        case SYM_FOR:
+            return parse_for(p);
+        case SYM_DO:
+            return parse_do(p);
+        case SYM_SWITCH:
+            return parse_switch(p);
+        case SYM_RETURN:
+            return parse_return(p);
+        case SYM_BREAK:
+            advance(p);
+            if (match(p, TOK_SEMICOLON)) advance(p);
+            return create_node(p->arena, NODE_BREAK, SYM_BREAK);
+        case SYM_CONTINUE:
+            advance(p);
+            if (match(p, TOK_SEMICOLON)) advance(p);
+            return create_node(p->arena, NODE_CONTINUE, SYM_CONTINUE);
+        default:
+            return NULL;
     }
+}
+
+static ASTNode* parse_statement(Parser *p) {
+    ASTNode *stmt = enter(p) ? parse_statement_kind(p) : NULL;
+    leave(p);
+    return stmt;
+}
 
-ASTNode* parse(TokenList *tokens) {
+ASTNode* parse(TokenList *tokens, Arena *arena, int max_depth, int *too_deep) {
+    *too_deep = 0;
  if (!tokens || tokens->count == 0) return NULL;
     
-    Parser p = {tokens->tokens, 0, tokens->count};
-    ASTNode *root = create_node(NODE_PROGRAM, "program");
+    Parser p = {tokens->types, tokens->symbols, tokens->offsets, tokens->lengths, 0, tokens->count,
+                arena, 0, max_depth, 0};
+    ASTNode *root = create_node(arena, NODE_PROGRAM, SYM_LABEL_PROGRAM);
     if (!root) return NULL;
     
-    while (current_token(&p)->type != TOK_EOF) {
+    while (current_type(&p) != TOK_EOF) {
+        int start = p.pos;
         ASTNode *stmt = parse_statement(&p);
         if (stmt) {
-            add_child(root, stmt);
-        } else {
+            add_child(arena, root, stmt);
+        } else if (p.pos == start) {
             advance(&p);
         }
     }
+    if (p.too_deep) {
+        LOG_DEBUG(LOG_PARSER, "Nesting deeper than %d levels\n", max_depth);
+        *too_deep = 1;
+        return NULL;
+    }
+    LOG_DEBUG(LOG_PARSER, "Parsed %d top-level statements\n", root->child_count);
     return root;
 }
\ No newline at end of file
@@ -4,6 +4,14 @@
 #include "lexer.h"
 #include "ast.h"
 
-ASTNode* parse(TokenList *tokens);
+// Nesting levels (statements plus parenthesized or indexed expressions)
+// a file may use before parse gives up on it. Each level costs a few
+// hundred bytes of stack, so this stays far below a thread's stack size.
+#define PARSE_DEFAULT_MAX_DEPTH 256
+#define PARSE_MAX_DEPTH_LIMIT 10000
+
+// Nodes are allocated in arena, which owns the returned tree. Returns NULL
+// with *too_deep set when nesting goes past max_depth.
+ASTNode* parse(TokenList *tokens, Arena *arena, int max_depth, int *too_deep);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,333 @@
+#ifdef __linux__
+    #define _GNU_SOURCE
+#endif
+
+#include "profile.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <time.h>
+#endif
+
+#ifdef __linux__
+    #include <unistd.h>
+    #include <sys/syscall.h>
+    #include <sys/ioctl.h>
+    #include <linux/perf_event.h>
+#endif
+
+// Spans beyond this per thread are still counted but not traced
+#define MAX_TRACE_EVENTS_PER_THREAD (1 << 20)
+
+typedef struct {
+    int stage;
+    double start_ns;
+    double duration_ns;
+} TraceEvent;
+
+typedef struct {
+    double wall_ns[PROF_STAGE_COUNT];
+    long long calls[PROF_STAGE_COUNT];
+    unsigned long long counters[PROF_STAGE_COUNT][PROFILE_COUNTERS];
+    int counter_fds[PROFILE_COUNTERS];   // [0] leads the perf group; -1 when closed
+    int counters_ok;
+    TraceEvent *events;
+    int event_count;
+    int event_capacity;
+} ProfileSlot;
+
+static const char *stage_names[PROF_STAGE_COUNT] = {
+    "tokenize", "winnow", "parse", "normalize", "build_cfg", "build_dag",
+    "ast_similarity", "winnow_similarity", "cfg_similarity", "dag_similarity"
+};
+
+static const char *counter_names[PROFILE_COUNTERS] = {"cycles", "cache_misses", "branch_misses"};
+
+static int enabled = 0;
+static int tracing = 0;
+static double origin_ns = 0.0;
+
+static pthread_key_t slot_key;
+static pthread_mutex_t slots_lock = PTHREAD_MUTEX_INITIALIZER;
+static ProfileSlot **slots = NULL;
+static int slot_count = 0;
+static int slot_capacity = 0;
+// Totals of threads that have exited, and how many threads ever profiled
+static ProfileSlot retired;
+static int threads_seen = 0;
+
+static double now_ns(void) {
+#ifdef _WIN32
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart * 1e9 / (double)frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+#endif
+}
+
+#ifdef __linux__
+static int open_counter(unsigned long long config, int group_fd) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    attr.disabled = group_fd == -1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+static void close_counters(ProfileSlot *slot) {
+    for (int c = PROFILE_COUNTERS - 1; c >= 0; c--) {
+        if (slot->counter_fds[c] >= 0) close(slot->counter_fds[c]);
+        slot->counter_fds[c] = -1;
+    }
+}
+
+static void open_counters(ProfileSlot *slot) {
+    static const unsigned long long configs[PROFILE_COUNTERS] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+    };
+    
+    for (int c = 0; c < PROFILE_COUNTERS; c++) {
+        slot->counter_fds[c] = open_counter(configs[c], c == 0 ? -1 : slot->counter_fds[0]);
+        if (slot->counter_fds[c] < 0) {
+            close_counters(slot);
+            return;
+        }
+    }
+    ioctl(slot->counter_fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    slot->counters_ok = 1;
+}
+
+static void read_counters(ProfileSlot *slot, unsigned long long *values) {
+    // PERF_FORMAT_GROUP: nr followed by one value per counter
+    unsigned long long buffer[1 + PROFILE_COUNTERS];
+    if (!slot->counters_ok ||
+        read(slot->counter_fds[0], buffer, sizeof(buffer)) != (ssize_t)sizeof(buffer)) {
+        memset(values, 0, sizeof(unsigned long long) * PROFILE_COUNTERS);
+        return;
+    }
+    memcpy(values, buffer + 1, sizeof(unsigned long long) * PROFILE_COUNTERS);
+}
+#else
+static void close_counters(ProfileSlot *slot) {
+    (void)slot;
+}
+
+static void open_counters(ProfileSlot *slot) {
+    (void)slot;
+}
+
+static void read_counters(ProfileSlot *slot, unsigned long long *values) {
+    (void)slot;
+    memset(values, 0, sizeof(unsigned long long) * PROFILE_COUNTERS);
+}
+#endif
+
+// Adds one slot's per-stage totals into another; caller holds slots_lock
+static void add_totals(ProfileSlot *into, const ProfileSlot *from) {
+    into->counters_ok |= from->counters_ok;
+    for (int s = 0; s < PROF_STAGE_COUNT; s++) {
+        into->wall_ns[s] += from->wall_ns[s];
+        into->calls[s] += from->calls[s];
+        for (int c = 0; c < PROFILE_COUNTERS; c++) {
+            into->counters[s][c] += from->counters[s][c];
+        }
+    }
+}
+
+// Key destructor, run as each profiled thread exits: its counters are
+// closed and its totals folded into retired. A slot holding trace events
+// stays registered, emptied, until the trace is written at exit.
+static void retire_slot(void *arg) {
+    ProfileSlot *slot = (ProfileSlot*)arg;
+    close_counters(slot);
+    
+    pthread_mutex_lock(&slots_lock);
+    add_totals(&retired, slot);
+    memset(slot->wall_ns, 0, sizeof(slot->wall_ns));
+    memset(slot->calls, 0, sizeof(slot->calls));
+    memset(slot->counters, 0, sizeof(slot->counters));
+    int keep = slot->event_count > 0;
+    if (!keep) {
+        for (int t = 0; t < slot_count; t++) {
+            if (slots[t] != slot) continue;
+            memmove(&slots[t], &slots[t + 1], sizeof(ProfileSlot*) * (slot_count - t - 1));
+            slot_count--;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&slots_lock);
+    
+    if (!keep) {
+        free(slot->events);
+        free(slot);
+    }
+}
+
+static ProfileSlot* current_slot(void) {
+    ProfileSlot *slot = pthread_getspecific(slot_key);
+    if (slot) return slot;
+    
+    slot = calloc(1, sizeof(ProfileSlot));
+    if (!slot) return NULL;
+    for (int c = 0; c < PROFILE_COUNTERS; c++) slot->counter_fds[c] = -1;
+    open_counters(slot);
+    
+    pthread_mutex_lock(&slots_lock);
+    if (slot_count >= slot_capacity) {
+        int capacity = slot_capacity ? slot_capacity * 2 : 16;
+        ProfileSlot **grown = realloc(slots, sizeof(ProfileSlot*) * capacity);
+        if (!grown) {
+            pthread_mutex_unlock(&slots_lock);
+            close_counters(slot);
+            free(slot);
+            return NULL;
+        }
+        slots = grown;
+        slot_capacity = capacity;
+    }
+    slots[slot_count++] = slot;
+    threads_seen++;
+    pthread_mutex_unlock(&slots_lock);
+    
+    pthread_setspecific(slot_key, slot);
+    return slot;
+}
+
+void profile_enable(int trace) {
+    if (enabled) return;
+    pthread_key_create(&slot_key, retire_slot);
+    origin_ns = now_ns();
+    tracing = trace;
+    enabled = 1;
+}
+
+int profile_enabled(void) {
+    return enabled;
+}
+
+void profile_begin(ProfileSpan *span, ProfileStage stage) {
+    span->active = 0;
+    if (!enabled) return;
+    
+    ProfileSlot *slot = current_slot();
+    if (!slot) return;
+    
+    span->stage = stage;
+    span->active = 1;
+    read_counters(slot, span->counters);
+    span->start_ns = now_ns();
+}
+
+void profile_end(ProfileSpan *span) {
+    if (!span->active) return;
+    
+    double end_ns = now_ns();
+    ProfileSlot *slot = current_slot();
+    if (!slot) return;
+    
+    unsigned long long counters[PROFILE_COUNTERS];
+    read_counters(slot, counters);
+    
+    int stage = span->stage;
+    slot->wall_ns[stage] += end_ns - span->start_ns;
+    slot->calls[stage]++;
+    for (int c = 0; c < PROFILE_COUNTERS; c++) {
+        slot->counters[stage][c] += counters[c] - span->counters[c];
+    }
+    
+    if (tracing && slot->event_count < MAX_TRACE_EVENTS_PER_THREAD) {
+        if (slot->event_count >= slot->event_capacity) {
+            int capacity = slot->event_capacity ? slot->event_capacity * 2 : 1024;
+            TraceEvent *grown = realloc(slot->events, sizeof(TraceEvent) * capacity);
+            if (!grown) return;
+            slot->events = grown;
+            slot->event_capacity = capacity;
+        }
+        TraceEvent *event = &slot->events[slot->event_count++];
+        event->stage = stage;
+        event->start_ns = span->start_ns - origin_ns;
+        event->duration_ns = end_ns - span->start_ns;
+    }
+    span->active = 0;
+}
+
+void profile_print_report(FILE *out) {
+    if (!enabled) return;
+    
+    // Threads still running (at least the caller) plus those retired
+    ProfileSlot sum = retired;
+    pthread_mutex_lock(&slots_lock);
+    for (int t = 0; t < slot_count; t++) add_totals(&sum, slots[t]);
+    int threads = threads_seen;
+    pthread_mutex_unlock(&slots_lock);
+    
+    const double *wall = sum.wall_ns;
+    const long long *calls = sum.calls;
+    unsigned long long (*counters)[PROFILE_COUNTERS] = sum.counters;
+    int counters_ok = sum.counters_ok;
+    double total = 0.0;
+    for (int s = 0; s < PROF_STAGE_COUNT; s++) total += wall[s];
+    
+    fprintf(out, "\nPROFILE (%d thread%s, %.2f ms run, %.2f ms in stages)\n", threads,
+            threads == 1 ? "" : "s", (now_ns() - origin_ns) / 1e6, total / 1e6);
+    fprintf(out, "  %-18s %10s %12s %7s %10s", "stage", "calls", "total_ms", "share", "avg_us");
+    if (counters_ok) {
+        fprintf(out, " %14s %12s %12s", counter_names[0], counter_names[1], counter_names[2]);
+    }
+    fprintf(out, "\n");
+    
+    for (int s = 0; s < PROF_STAGE_COUNT; s++) {
+        if (calls[s] == 0) continue;
+        fprintf(out, "  %-18s %10lld %12.3f %6.1f%% %10.2f", stage_names[s], calls[s],
+                wall[s] / 1e6, total > 0 ? 100.0 * wall[s] / total : 0.0,
+                wall[s] / 1e3 / calls[s]);
+        if (counters_ok) {
+            fprintf(out, " %14llu %12llu %12llu", counters[s][0], counters[s][1], counters[s][2]);
+        }
+        fprintf(out, "\n");
+    }
+    if (!counters_ok) {
+        fprintf(out, "  (hardware counters unavailable)\n");
+    }
+}
+
+int profile_write_trace(const char *path) {
+    if (!enabled || !tracing || !path) return 0;
+    
+    FILE *out = fopen(path, "w");
+    if (!out) return 0;
+    
+    fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    int first = 1;
+    pthread_mutex_lock(&slots_lock);
+    for (int t = 0; t < slot_count; t++) {
+        fprintf(out, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                     "\"args\":{\"name\":\"worker %d\"}}", first ? "" : ",", t, t);
+        first = 0;
+        for (int e = 0; e < slots[t]->event_count; e++) {
+            const TraceEvent *event = &slots[t]->events[e];
+            fprintf(out, ",\n{\"name\":\"%s\",\"cat\":\"pipeline\",\"ph\":\"X\",\"pid\":1,"
+                         "\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                    stage_names[event->stage], t, event->start_ns / 1e3, event->duration_ns / 1e3);
+        }
+    }
+    pthread_mutex_unlock(&slots_lock);
+    fprintf(out, "\n]}\n");
+    
+    int ok = !ferror(out);
+    fclose(out);
+    return ok;
+}
@@ -0,0 +1,48 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdio.h>
+
+// Per-stage timing for --profile. Stages are bracketed with
+// profile_begin/profile_end; when profiling is off both return at once.
+// Each thread accumulates into its own slot, so workers never contend;
+// a thread's slot is folded into a shared total when the thread exits.
+// On Linux, cycles, cache misses and branch misses are read from
+// perf_event_open counters when the kernel allows it.
+
+typedef enum {
+    PROF_TOKENIZE,
+    PROF_WINNOW,
+    PROF_PARSE,
+    PROF_NORMALIZE,
+    PROF_BUILD_CFG,
+    PROF_BUILD_DAG,
+    PROF_AST_SIMILARITY,
+    PROF_WINNOW_SIMILARITY,
+    PROF_CFG_SIMILARITY,
+    PROF_DAG_SIMILARITY,
+    PROF_STAGE_COUNT
+} ProfileStage;
+
+#define PROFILE_COUNTERS 3
+
+typedef struct {
+    int stage;
+    int active;
+    double start_ns;
+    unsigned long long counters[PROFILE_COUNTERS];
+} ProfileSpan;
+
+// trace != 0 also records every span for profile_write_trace
+void profile_enable(int trace);
+int profile_enabled(void);
+
+void profile_begin(ProfileSpan *span, ProfileStage stage);
+void profile_end(ProfileSpan *span);
+
+// Totals over all threads: wall time, calls and counters per stage
+void profile_print_report(FILE *out);
+// Chrome trace-event JSON (chrome://tracing, Perfetto); 0 on failure
+int profile_write_trace(const char *path);
+
+#endif
@@ -0,0 +1,166 @@
+#include "report.h"
+#include <stdint.h>
+#include <string.h>
+
+#ifdef _WIN32
+    #include <io.h>
+    #include <fcntl.h>
+#endif
+
+#define REPORT_BUFFER_SIZE (1 << 20)
+
+static char report_buffer[REPORT_BUFFER_SIZE];
+
+int parse_output_format(const char *name, OutputFormat *format) {
+    if (!name || !format) return 0;
+    
+    if (strcmp(name, "text") == 0) *format = FORMAT_TEXT;
+    else if (strcmp(name, "jsonl") == 0) *format = FORMAT_JSONL;
+    else if (strcmp(name, "csv") == 0) *format = FORMAT_CSV;
+    else if (strcmp(name, "bin") == 0) *format = FORMAT_BIN;
+    else return 0;
+    
+    return 1;
+}
+
+void report_begin(FILE *out, OutputFormat format) {
+    if (format == FORMAT_TEXT) return;
+    
+    setvbuf(out, report_buffer, _IOFBF, REPORT_BUFFER_SIZE);
+    
+    if (format == FORMAT_CSV) {
+        fputs("file1,file2,overall,ast,cfg,dag,winnow,nodes1,nodes2,verdict\n", out);
+    } else if (format == FORMAT_BIN) {
+#ifdef _WIN32
+        _setmode(_fileno(out), _O_BINARY);
+#endif
+        fwrite("PDRES001", 1, 8, out);
+    }
+}
+
+void report_json_string(FILE *out, const char *text) {
+    fputc('"', out);
+    for (const unsigned char *p = (const unsigned char*)text; *p; p++) {
+        if (*p == '"' || *p == '\\') {
+            fputc('\\', out);
+            fputc(*p, out);
+        } else if (*p < 0x20) {
+            fprintf(out, "\\u%04x", *p);
+        } else {
+            fputc(*p, out);
+        }
+    }
+    fputc('"', out);
+}
+
+void report_json_record(FILE *out, const char *file1, const char *file2,
+                        const PlagiarismResult *r) {
+    fputs("{\"file1\":", out);
+    report_json_string(out, file1);
+    fputs(",\"file2\":", out);
+    report_json_string(out, file2);
+    fprintf(out, ",\"overall\":%.4f,\"ast\":%.4f,\"cfg\":%.4f,\"dag\":%.4f,"
+                 "\"winnow\":%.4f,\"nodes1\":%d,\"nodes2\":%d,\"verdict\":",
+            r->overall_score, r->ast_similarity, r->cfg_similarity,
+            r->dag_similarity, r->winnow_similarity,
+            r->total_nodes_1, r->total_nodes_2);
+    report_json_string(out, r->verdict);
+    fputc('}', out);
+}
+
+static void write_csv_field(FILE *out, const char *text) {
+    if (strpbrk(text, ",\"\n\r") == NULL) {
+        fputs(text, out);
+        return;
+    }
+    fputc('"', out);
+    for (const char *p = text; *p; p++) {
+        if (*p == '"') fputc('"', out);
+        fputc(*p, out);
+    }
+    fputc('"', out);
+}
+
+static size_t put_u16(unsigned char *buf, size_t pos, uint16_t v) {
+    buf[pos] = (unsigned char)v;
+    buf[pos + 1] = (unsigned char)(v >> 8);
+    return pos + 2;
+}
+
+static size_t put_u32(unsigned char *buf, size_t pos, uint32_t v) {
+    for (int i = 0; i < 4; i++) buf[pos + i] = (unsigned char)(v >> (8 * i));
+    return pos + 4;
+}
+
+static size_t put_f64(unsigned char *buf, size_t pos, double d) {
+    uint64_t v;
+    memcpy(&v, &d, sizeof(v));
+    for (int i = 0; i < 8; i++) buf[pos + i] = (unsigned char)(v >> (8 * i));
+    return pos + 8;
+}
+
+static size_t put_string(unsigned char *buf, size_t pos, const char *text, size_t length) {
+    pos = put_u16(buf, pos, (uint16_t)length);
+    memcpy(buf + pos, text, length);
+    return pos + length;
+}
+
+static void write_bin_record(FILE *out, const char *file1, const char *file2,
+                             const PlagiarismResult *r) {
+    size_t len1 = strlen(file1), len2 = strlen(file2), len3 = strlen(r->verdict);
+    if (len1 > 0xFFFF) len1 = 0xFFFF;
+    if (len2 > 0xFFFF) len2 = 0xFFFF;
+    
+    unsigned char fixed[4 + 2 + 2 + 5 * 8 + 2 * 4 + 2 + 256];
+    size_t body = 2 + len1 + 2 + len2 + 5 * 8 + 2 * 4 + 2 + len3;
+    
+    // Length prefix and path strings are written around the fixed part so
+    // long paths never need a temporary buffer
+    put_u32(fixed, 0, (uint32_t)body);
+    put_u16(fixed, 4, (uint16_t)len1);
+    fwrite(fixed, 1, 6, out);
+    fwrite(file1, 1, len1, out);
+    put_u16(fixed, 0, (uint16_t)len2);
+    fwrite(fixed, 1, 2, out);
+    fwrite(file2, 1, len2, out);
+    
+    size_t pos = 0;
+    pos = put_f64(fixed, pos, r->overall_score);
+    pos = put_f64(fixed, pos, r->ast_similarity);
+    pos = put_f64(fixed, pos, r->cfg_similarity);
+    pos = put_f64(fixed, pos, r->dag_similarity);
+    pos = put_f64(fixed, pos, r->winnow_similarity);
+    pos = put_u32(fixed, pos, (uint32_t)r->total_nodes_1);
+    pos = put_u32(fixed, pos, (uint32_t)r->total_nodes_2);
+    pos = put_string(fixed, pos, r->verdict, len3);
+    fwrite(fixed, 1, pos, out);
+}
+
+void report_record(FILE *out, OutputFormat format, const char *file1,
+                   const char *file2, const PlagiarismResult *r) {
+    switch (format) {
+        case FORMAT_JSONL:
+            report_json_record(out, file1, file2, r);
+            fputc('\n', out);
+            break;
+        
+        case FORMAT_CSV:
+            write_csv_field(out, file1);
+            fputc(',', out);
+            write_csv_field(out, file2);
+            fprintf(out, ",%.4f,%.4f,%.4f,%.4f,%.4f,%d,%d,",
+                    r->overall_score, r->ast_similarity, r->cfg_similarity,
+                    r->dag_similarity, r->winnow_similarity,
+                    r->total_nodes_1, r->total_nodes_2);
+            write_csv_field(out, r->verdict);
+            fputc('\n', out);
+            break;
+        
+        case FORMAT_BIN:
+            write_bin_record(out, file1, file2, r);
+            break;
+        
+        default:
+            break;
+    }
+}
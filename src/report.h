@@ -0,0 +1,36 @@
+#ifndef REPORT_H
+#define REPORT_H
+
+#include <stdio.h>
+#include "detector.h"
+
+// Machine-readable result records, one per compared pair.
+//
+// jsonl: one JSON object per line
+// csv:   header line, then one row per pair
+// bin:   "PDRES001" once, then per pair a little-endian uint32 byte length
+//        followed by: u16 len + file1, u16 len + file2, f64 overall, ast,
+//        cfg, dag, winnow, i32 nodes1, nodes2, u16 len + verdict
+
+typedef enum {
+    FORMAT_TEXT,
+    FORMAT_JSONL,
+    FORMAT_CSV,
+    FORMAT_BIN
+} OutputFormat;
+
+int parse_output_format(const char *name, OutputFormat *format);
+
+// Switches out to a large fully buffered stream and writes any preamble;
+// the buffer is flushed by exit() or an explicit fflush()
+void report_begin(FILE *out, OutputFormat format);
+void report_record(FILE *out, OutputFormat format, const char *file1,
+                   const char *file2, const PlagiarismResult *result);
+
+// One pair as a JSON object with no trailing newline: the jsonl line body,
+// also used for the comparisons in daemon replies
+void report_json_record(FILE *out, const char *file1, const char *file2,
+                        const PlagiarismResult *result);
+void report_json_string(FILE *out, const char *text);
+
+#endif
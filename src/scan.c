@@ -0,0 +1,245 @@
+#include "scan.h"
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+    #define SCAN_X86 1
+    #include <immintrin.h>
+#endif
+
+#define BLOCK 32
+
+// Per-ISA block classifiers: one bit per byte of a 32-byte block
+typedef struct {
+    uint32_t (*space)(const char *p, uint32_t *newlines);
+    uint32_t (*newline)(const char *p);
+    uint32_t (*comment_close)(const char *p, uint32_t *newlines, uint32_t *stars);
+    const char *name;
+} ScanImpl;
+
+// C-locale classes for ASCII; bytes >= 0x80 are in no class
+const unsigned char scan_class[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 0, 0, 0, 0, 0, 0,
+    0, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+    2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 0, 0, 0, 0, 2,
+    0, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+    2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 0, 0, 0, 0, 0,
+};
+
+static int popcount32(uint32_t x) {
+#ifdef __GNUC__
+    return __builtin_popcount(x);
+#else
+    int n = 0;
+    while (x) {
+        x &= x - 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+static int lowest_bit(uint32_t x) {
+#ifdef __GNUC__
+    return __builtin_ctz(x);
+#else
+    int n = 0;
+    while (!(x & 1u)) {
+        x >>= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+static uint32_t space_scalar(const char *p, uint32_t *newlines) {
+    uint32_t space = 0, nl = 0;
+    for (int i = 0; i < BLOCK; i++) {
+        unsigned char c = (unsigned char)p[i];
+        if (scan_class[c] & SCAN_SPACE) space |= 1u << i;
+        if (c == '\n') nl |= 1u << i;
+    }
+    *newlines = nl;
+    return space;
+}
+
+static uint32_t newline_scalar(const char *p) {
+    uint32_t nl = 0;
+    for (int i = 0; i < BLOCK; i++) {
+        if (p[i] == '\n') nl |= 1u << i;
+    }
+    return nl;
+}
+
+static uint32_t comment_close_scalar(const char *p, uint32_t *newlines, uint32_t *stars) {
+    uint32_t star = 0, slash = 0, nl = 0;
+    for (int i = 0; i < BLOCK; i++) {
+        if (p[i] == '*') star |= 1u << i;
+        if (p[i] == '/') slash |= 1u << i;
+        if (p[i] == '\n') nl |= 1u << i;
+    }
+    *newlines = nl;
+    *stars = star;
+    return star & (slash >> 1);
+}
+
+#ifdef SCAN_X86
+__attribute__((target("sse2")))
+static uint32_t movemask_pair_sse2(__m128i lo, __m128i hi) {
+    return (uint32_t)_mm_movemask_epi8(lo) | ((uint32_t)_mm_movemask_epi8(hi) << 16);
+}
+
+// ' ' or '\t'..'\r': (c - '\t') <= 4 unsigned, via saturating subtract
+__attribute__((target("sse2")))
+static __m128i space_bytes_sse2(__m128i v) {
+    __m128i ctrl = _mm_cmpeq_epi8(_mm_subs_epu8(_mm_sub_epi8(v, _mm_set1_epi8('\t')), _mm_set1_epi8(4)),
+                                  _mm_setzero_si128());
+    return _mm_or_si128(ctrl, _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+}
+
+__attribute__((target("sse2")))
+static uint32_t space_sse2(const char *p, uint32_t *newlines) {
+    __m128i lo = _mm_loadu_si128((const __m128i*)p);
+    __m128i hi = _mm_loadu_si128((const __m128i*)(p + 16));
+    __m128i nl = _mm_set1_epi8('\n');
+    *newlines = movemask_pair_sse2(_mm_cmpeq_epi8(lo, nl), _mm_cmpeq_epi8(hi, nl));
+    return movemask_pair_sse2(space_bytes_sse2(lo), space_bytes_sse2(hi));
+}
+
+__attribute__((target("sse2")))
+static uint32_t newline_sse2(const char *p) {
+    __m128i nl = _mm_set1_epi8('\n');
+    return movemask_pair_sse2(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)p), nl),
+                              _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + 16)), nl));
+}
+
+__attribute__((target("sse2")))
+static uint32_t comment_close_sse2(const char *p, uint32_t *newlines, uint32_t *stars) {
+    __m128i lo = _mm_loadu_si128((const __m128i*)p);
+    __m128i hi = _mm_loadu_si128((const __m128i*)(p + 16));
+    __m128i star = _mm_set1_epi8('*'), slash = _mm_set1_epi8('/'), nl = _mm_set1_epi8('\n');
+    uint32_t star_mask = movemask_pair_sse2(_mm_cmpeq_epi8(lo, star), _mm_cmpeq_epi8(hi, star));
+    uint32_t slash_mask = movemask_pair_sse2(_mm_cmpeq_epi8(lo, slash), _mm_cmpeq_epi8(hi, slash));
+    *newlines = movemask_pair_sse2(_mm_cmpeq_epi8(lo, nl), _mm_cmpeq_epi8(hi, nl));
+    *stars = star_mask;
+    return star_mask & (slash_mask >> 1);
+}
+
+__attribute__((target("avx2")))
+static uint32_t space_avx2(const char *p, uint32_t *newlines) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)p);
+    __m256i ctrl = _mm256_cmpeq_epi8(_mm256_subs_epu8(_mm256_sub_epi8(v, _mm256_set1_epi8('\t')),
+                                                      _mm256_set1_epi8(4)), _mm256_setzero_si256());
+    __m256i space = _mm256_or_si256(ctrl, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')));
+    *newlines = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+    return (uint32_t)_mm256_movemask_epi8(space);
+}
+
+__attribute__((target("avx2")))
+static uint32_t newline_avx2(const char *p) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)p);
+    return (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+}
+
+__attribute__((target("avx2")))
+static uint32_t comment_close_avx2(const char *p, uint32_t *newlines, uint32_t *stars) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)p);
+    uint32_t star_mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('*')));
+    uint32_t slash_mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('/')));
+    *newlines = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+    *stars = star_mask;
+    return star_mask & (slash_mask >> 1);
+}
+#endif
+
+static ScanImpl impl = {space_scalar, newline_scalar, comment_close_scalar, "scalar"};
+static pthread_once_t init_once = PTHREAD_ONCE_INIT;
+
+static void pick_implementation(void) {
+#ifdef SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        ScanImpl avx2 = {space_avx2, newline_avx2, comment_close_avx2, "avx2"};
+        impl = avx2;
+    } else if (__builtin_cpu_supports("sse2")) {
+        ScanImpl sse2 = {space_sse2, newline_sse2, comment_close_sse2, "sse2"};
+        impl = sse2;
+    }
+#endif
+}
+
+void scan_init(void) {
+    pthread_once(&init_once, pick_implementation);
+}
+
+// Full blocks are classified in place; a short tail is copied into a
+// zero-padded buffer first. NUL is in no class, so runs stop at end.
+static const char* tail_block(const char *p, const char *end, char *buffer) {
+    memset(buffer, 0, BLOCK);
+    memcpy(buffer, p, (size_t)(end - p));
+    return buffer;
+}
+
+static uint32_t below(int bit) {
+    return bit >= 32 ? 0xFFFFFFFFu : (1u << bit) - 1u;
+}
+
+const char* scan_skip_space(const char *p, const char *end, int *lines) {
+    char buffer[BLOCK];
+    while (p < end) {
+        int n = end - p >= BLOCK ? BLOCK : (int)(end - p);
+        uint32_t newlines;
+        uint32_t space = impl.space(n == BLOCK ? p : tail_block(p, end, buffer), &newlines);
+        uint32_t stop = ~space & below(n);
+        if (stop) {
+            int at = lowest_bit(stop);
+            *lines += popcount32(newlines & below(at));
+            return p + at;
+        }
+        *lines += popcount32(newlines & below(n));
+        p += n;
+    }
+    return end;
+}
+
+const char* scan_line_end(const char *p, const char *end) {
+    char buffer[BLOCK];
+    while (p < end) {
+        int n = end - p >= BLOCK ? BLOCK : (int)(end - p);
+        uint32_t hit = impl.newline(n == BLOCK ? p : tail_block(p, end, buffer)) & below(n);
+        if (hit) return p + lowest_bit(hit);
+        p += n;
+    }
+    return end;
+}
+
+const char* scan_comment_end(const char *p, const char *end, int *lines) {
+    char buffer[BLOCK];
+    int star_carry = 0;   // last byte of the previous block was '*'
+    while (p < end) {
+        int n = end - p >= BLOCK ? BLOCK : (int)(end - p);
+        const char *block = n == BLOCK ? p : tail_block(p, end, buffer);
+        if (star_carry && block[0] == '/') return p - 1;
+        
+        uint32_t newlines, stars;
+        uint32_t hit = impl.comment_close(block, &newlines, &stars) & below(n);
+        if (hit) {
+            int at = lowest_bit(hit);
+            *lines += popcount32(newlines & below(at));
+            return p + at;
+        }
+        *lines += popcount32(newlines & below(n));
+        star_carry = (stars >> (n - 1)) & 1u;
+        p += n;
+    }
+    return end;
+}
+
+const char* scan_implementation(void) {
+    scan_init();
+    return impl.name;
+}
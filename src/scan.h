@@ -0,0 +1,33 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+// Bulk byte scanning for the lexer. Whitespace runs, comment bodies and
+// preprocessor lines are classified 32 bytes at a time (AVX2 or two SSE2
+// halves, picked once at runtime from the CPU, scalar elsewhere) and the
+// scan jumps to the first byte that ends the run. Every function stops at
+// end and never reads past it. Call scan_init once before scanning.
+
+void scan_init(void);
+
+// Byte classes for the byte-at-a-time paths. Tokens are short, so the
+// lexer tests these inline and leaves block scans to long runs.
+#define SCAN_SPACE 1   // C-locale isspace
+#define SCAN_IDENT 2   // [A-Za-z0-9_]
+extern const unsigned char scan_class[256];
+#define SCAN_IS(c, cls) (scan_class[(unsigned char)(c)] & (cls))
+
+// First byte in [p, end) that is not C-locale whitespace; newlines skipped
+// are added to *lines
+const char* scan_skip_space(const char *p, const char *end, int *lines);
+
+// First '\n' in [p, end), or end (line comments and # lines)
+const char* scan_line_end(const char *p, const char *end);
+
+// Position of the "*/" closing a block comment whose body starts at p, or
+// end if unterminated; newlines in the body are added to *lines
+const char* scan_comment_end(const char *p, const char *end, int *lines);
+
+// "avx2", "sse2" or "scalar"
+const char* scan_implementation(void);
+
+#endif
@@ -0,0 +1,282 @@
+#include "symbol.h"
+#include "utils.h"
+#include "log.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+// Entries live in fixed-size pages that never move, so symbol_text can
+// read them without the lock; only the page table is ever written.
+#define PAGE_BITS 12
+#define PAGE_SIZE (1 << PAGE_BITS)
+#define MAX_PAGES (SYMBOL_MAX_ID >> PAGE_BITS)
+#define TEXT_BLOCK_SIZE 65536
+
+typedef struct {
+    const char *text;
+    size_t length;
+    unsigned long hash;
+} SymbolEntry;
+
+typedef struct TextBlock {
+    struct TextBlock *next;
+    size_t used;
+    size_t size;
+    char data[];
+} TextBlock;
+
+static const char *preseeded[SYM_PRESEEDED_COUNT] = {
+    "",
+    "if", "else", "while", "for", "do", "switch", "case", "default",
+    "break", "continue", "return",
+    "int", "float", "char", "double", "void",
+    "long", "short", "unsigned", "signed",
+    "struct", "union", "enum", "typedef",
+    "const", "static", "extern", "auto", "register",
+    "sizeof", "goto",
+    "inline", "restrict", "volatile",
+    "_Bool", "_Complex", "_Imaginary", "_Alignas", "_Alignof", "_Atomic",
+    "_Generic", "_Noreturn", "_Static_assert", "_Thread_local",
+    "+", "-", "*", "/", "%", "<", ">", "!", "&", "|",
+    "<=", ">=", "==", "!=", "&&", "||", "++", "--",
+    "=", ";", ",", "(", ")", "{", "}", "[", "]", ":",
+    "^", "~", "?", ".", "->", "<<", ">>",
+    "+=", "-=", "*=", "/=", "%=", "&=", "|=", "^=", "<<=", ">>=",
+    "program", "block", "loop", "empty", "case_body", "NULL", "1", "string",
+    "function"
+};
+
+static pthread_mutex_t table_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t seed_once = PTHREAD_ONCE_INIT;
+
+static SymbolEntry *pages[MAX_PAGES];
+static int entry_count = 0;
+
+// Open addressing over IDs; 0 marks an empty slot because SYM_NONE ("")
+// is found by the length check before the table is probed
+static int *slots = NULL;
+static int slot_capacity = 0;
+
+static TextBlock *text_blocks = NULL;
+
+static SymbolEntry* entry_at(int id) {
+    return &pages[id >> PAGE_BITS][id & (PAGE_SIZE - 1)];
+}
+
+static unsigned long hash_span(const char *text, size_t length) {
+    // Same function as string_hash so symbol_hash(id) == string_hash(text)
+    unsigned long hash = 5381;
+    for (size_t i = 0; i < length; i++) {
+        hash = ((hash << 5) + hash) + text[i];
+    }
+    return hash;
+}
+
+static const char* store_text(const char *text, size_t length) {
+    if (!text_blocks || text_blocks->used + length + 1 > text_blocks->size) {
+        size_t size = length + 1 > TEXT_BLOCK_SIZE ? length + 1 : TEXT_BLOCK_SIZE;
+        TextBlock *block = malloc(sizeof(TextBlock) + size);
+        if (!block) return NULL;
+        block->next = text_blocks;
+        block->used = 0;
+        block->size = size;
+        text_blocks = block;
+    }
+    char *copy = text_blocks->data + text_blocks->used;
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+    text_blocks->used += length + 1;
+    return copy;
+}
+
+static int grow_slots(void) {
+    int capacity = slot_capacity ? slot_capacity * 2 : 4096;
+    int *grown = calloc(capacity, sizeof(int));
+    if (!grown) return 0;
+    
+    for (int id = 1; id < entry_count; id++) {
+        int slot = (int)(entry_at(id)->hash & (unsigned long)(capacity - 1));
+        while (grown[slot]) slot = (slot + 1) & (capacity - 1);
+        grown[slot] = id;
+    }
+    free(slots);
+    slots = grown;
+    slot_capacity = capacity;
+    return 1;
+}
+
+// Caller holds table_lock
+static int insert_locked(const char *text, size_t length, unsigned long hash) {
+    if (slot_capacity == 0 || (entry_count + 1) * 2 > slot_capacity) {
+        if (!grow_slots()) return -1;
+    }
+    
+    int slot = (int)(hash & (unsigned long)(slot_capacity - 1));
+    while (slots[slot]) {
+        SymbolEntry *e = entry_at(slots[slot]);
+        if (e->hash == hash && e->length == length && memcmp(e->text, text, length) == 0) {
+            return slots[slot];
+        }
+        slot = (slot + 1) & (slot_capacity - 1);
+    }
+    
+    int id = entry_count;
+    if ((id >> PAGE_BITS) >= MAX_PAGES) {
+        LOG_ERROR(LOG_LEXER, "Symbol table full\n");
+        return -1;
+    }
+    if (!pages[id >> PAGE_BITS]) {
+        pages[id >> PAGE_BITS] = malloc(sizeof(SymbolEntry) * PAGE_SIZE);
+        if (!pages[id >> PAGE_BITS]) return -1;
+    }
+    
+    // Pre-seeded spellings are string literals and need no copy, so a
+    // reset can free every text block
+    const char *copy = id < SYM_PRESEEDED_COUNT ? text : store_text(text, length);
+    if (!copy) return -1;
+    
+    SymbolEntry *e = entry_at(id);
+    e->text = copy;
+    e->length = length;
+    e->hash = hash;
+    entry_count++;
+    if (id != SYM_NONE) slots[slot] = id;
+    return id;
+}
+
+static void seed_table(void) {
+    for (int id = 0; id < SYM_PRESEEDED_COUNT; id++) {
+        const char *text = preseeded[id];
+        insert_locked(text, strlen(text), hash_span(text, strlen(text)));
+    }
+}
+
+void symbol_init(void) {
+    pthread_once(&seed_once, seed_table);
+}
+
+void symbol_reset(void) {
+    pthread_once(&seed_once, seed_table);
+    pthread_mutex_lock(&table_lock);
+    
+    // The pre-seeded entries all sit in page 0
+    for (int page = 1; page < MAX_PAGES && pages[page]; page++) {
+        free(pages[page]);
+        pages[page] = NULL;
+    }
+    while (text_blocks) {
+        TextBlock *next = text_blocks->next;
+        free(text_blocks);
+        text_blocks = next;
+    }
+    entry_count = SYM_PRESEEDED_COUNT;
+    
+    // Rebuilt from the pre-seeded entries; on failure the next intern
+    // tries again
+    free(slots);
+    slots = NULL;
+    slot_capacity = 0;
+    grow_slots();
+    
+    pthread_mutex_unlock(&table_lock);
+}
+
+int symbol_intern(const char *text, size_t length) {
+    pthread_once(&seed_once, seed_table);
+    if (length == 0) return SYM_NONE;
+    
+    unsigned long hash = hash_span(text, length);
+    pthread_mutex_lock(&table_lock);
+    int id = insert_locked(text, length, hash);
+    pthread_mutex_unlock(&table_lock);
+    return id;
+}
+
+// Perfect hash over the C11 keywords: the multipliers were searched so that
+// all 44 land in distinct slots. Re-run the search if a keyword is added.
+#define KEYWORD_HASH(text, length) \
+    (((length) + (unsigned char)(text)[0] + 9u * (unsigned char)(text)[1] + \
+      12u * (unsigned char)(text)[(length) - 1]) & 127u)
+
+static const unsigned char keyword_slots[128] = {
+    [0] = SYM_UNION,
+    [1] = SYM_DO,
+    [4] = SYM_TYPEDEF,
+    [6] = SYM_GOTO,
+    [8] = SYM_SWITCH,
+    [9] = SYM_INLINE,
+    [10] = SYM_GENERIC,
+    [11] = SYM_UNSIGNED,
+    [12] = SYM_CASE,
+    [13] = SYM_DOUBLE,
+    [14] = SYM_CONTINUE,
+    [16] = SYM_SHORT,
+    [17] = SYM_VOID,
+    [20] = SYM_ALIGNAS,
+    [33] = SYM_VOLATILE,
+    [38] = SYM_IMAGINARY,
+    [39] = SYM_FLOAT,
+    [40] = SYM_FOR,
+    [43] = SYM_LONG,
+    [45] = SYM_RETURN,
+    [49] = SYM_STATIC,
+    [54] = SYM_AUTO,
+    [58] = SYM_INT,
+    [63] = SYM_CONST,
+    [70] = SYM_BOOL,
+    [72] = SYM_STATIC_ASSERT,
+    [73] = SYM_IF,
+    [75] = SYM_EXTERN,
+    [78] = SYM_NORETURN,
+    [83] = SYM_ATOMIC,
+    [90] = SYM_SIGNED,
+    [95] = SYM_REGISTER,
+    [96] = SYM_WHILE,
+    [98] = SYM_COMPLEX,
+    [99] = SYM_ENUM,
+    [103] = SYM_CHAR,
+    [104] = SYM_DEFAULT,
+    [109] = SYM_BREAK,
+    [112] = SYM_THREAD_LOCAL,
+    [113] = SYM_ELSE,
+    [114] = SYM_SIZEOF,
+    [119] = SYM_RESTRICT,
+    [120] = SYM_ALIGNOF,
+    [125] = SYM_STRUCT,
+};
+
+int symbol_keyword(const char *text, size_t length) {
+    if (length < 2 || length > 14) return SYM_NONE;
+    
+    int id = keyword_slots[KEYWORD_HASH(text, length)];
+    if (id == SYM_NONE) return SYM_NONE;
+    const char *word = preseeded[id];
+    if (strlen(word) != length || memcmp(text, word, length) != 0) return SYM_NONE;
+    return id;
+}
+
+// IDs only come from symbol_intern, and an entry is complete before its ID
+// is returned, so readers never need the lock
+static int valid_id(int id) {
+    return id >= 0 && id < MAX_PAGES * PAGE_SIZE && pages[id >> PAGE_BITS] != NULL;
+}
+
+const char* symbol_text(int id) {
+    return valid_id(id) ? entry_at(id)->text : "";
+}
+
+size_t symbol_length(int id) {
+    return valid_id(id) ? entry_at(id)->length : 0;
+}
+
+unsigned long symbol_hash(int id) {
+    return valid_id(id) ? entry_at(id)->hash : string_hash("");
+}
+
+int symbol_count(void) {
+    pthread_once(&seed_once, seed_table);
+    pthread_mutex_lock(&table_lock);
+    int count = entry_count;
+    pthread_mutex_unlock(&table_lock);
+    return count;
+}
@@ -0,0 +1,156 @@
+#ifndef SYMBOL_H
+#define SYMBOL_H
+
+#include <stddef.h>
+
+// Process-wide symbol table. Every identifier, keyword, number and operator
+// spelling is interned once and referred to by a small integer ID, so
+// tokens and AST node values can be compared with == instead of strcmp.
+// Keywords, operators and the parser's node labels are pre-seeded at the
+// fixed IDs below; everything else gets the next free
+// ID on first sight. IDs are stable for the life of the process but not
+// across runs, so anything persisted must hash symbol_text, not the ID.
+// Interning is thread-safe; symbol_text pointers stay valid until exit.
+// IDs stay below SYMBOL_MAX_ID, so they fit the 24 bits a flat AST node
+// keeps for its value.
+
+#define SYMBOL_MAX_ID (1 << 24)
+
+typedef enum {
+    SYM_NONE,           // empty spelling (TOK_EOF)
+
+    // Keywords (all of C11): every ID below SYM_KEYWORD_END
+    SYM_IF,
+    SYM_ELSE,
+    SYM_WHILE,
+    SYM_FOR,
+    SYM_DO,
+    SYM_SWITCH,
+    SYM_CASE,
+    SYM_DEFAULT,
+    SYM_BREAK,
+    SYM_CONTINUE,
+    SYM_RETURN,
+    SYM_INT,
+    SYM_FLOAT,
+    SYM_CHAR,
+    SYM_DOUBLE,
+    SYM_VOID,
+    SYM_LONG,
+    SYM_SHORT,
+    SYM_UNSIGNED,
+    SYM_SIGNED,
+    SYM_STRUCT,
+    SYM_UNION,
+    SYM_ENUM,
+    SYM_TYPEDEF,
+    SYM_CONST,
+    SYM_STATIC,
+    SYM_EXTERN,
+    SYM_AUTO,
+    SYM_REGISTER,
+    SYM_SIZEOF,
+    SYM_GOTO,
+    SYM_INLINE,
+    SYM_RESTRICT,
+    SYM_VOLATILE,
+    SYM_BOOL,
+    SYM_COMPLEX,
+    SYM_IMAGINARY,
+    SYM_ALIGNAS,
+    SYM_ALIGNOF,
+    SYM_ATOMIC,
+    SYM_GENERIC,
+    SYM_NORETURN,
+    SYM_STATIC_ASSERT,
+    SYM_THREAD_LOCAL,
+    SYM_KEYWORD_END,
+
+    // Operators and punctuation
+    SYM_PLUS = SYM_KEYWORD_END,
+    SYM_MINUS,
+    SYM_STAR,
+    SYM_SLASH,
+    SYM_PERCENT,
+    SYM_LT,
+    SYM_GT,
+    SYM_NOT,
+    SYM_AMP,
+    SYM_PIPE,
+    SYM_LE,
+    SYM_GE,
+    SYM_EQ,
+    SYM_NE,
+    SYM_AND,
+    SYM_OR,
+    SYM_INC,
+    SYM_DEC,
+    SYM_ASSIGN,
+    SYM_SEMICOLON,
+    SYM_COMMA,
+    SYM_LPAREN,
+    SYM_RPAREN,
+    SYM_LBRACE,
+    SYM_RBRACE,
+    SYM_LBRACKET,
+    SYM_RBRACKET,
+    SYM_COLON,
+    SYM_CARET,
+    SYM_TILDE,
+    SYM_QUESTION,
+    SYM_DOT,
+    SYM_ARROW,
+    SYM_SHL,
+    SYM_SHR,
+    SYM_ADD_ASSIGN,
+    SYM_SUB_ASSIGN,
+    SYM_MUL_ASSIGN,
+    SYM_DIV_ASSIGN,
+    SYM_MOD_ASSIGN,
+    SYM_AND_ASSIGN,
+    SYM_OR_ASSIGN,
+    SYM_XOR_ASSIGN,
+    SYM_SHL_ASSIGN,
+    SYM_SHR_ASSIGN,
+
+    // Fixed values of AST nodes that do not come from a source token
+    SYM_LABEL_PROGRAM,
+    SYM_LABEL_BLOCK,
+    SYM_LABEL_LOOP,
+    SYM_LABEL_EMPTY,
+    SYM_LABEL_CASE_BODY,
+    SYM_LABEL_NULL,
+    SYM_LABEL_ONE,
+    SYM_LABEL_STRING,
+    SYM_LABEL_FUNCTION,
+
+    SYM_PRESEEDED_COUNT
+} SymbolId;
+
+// Seeds the keyword and operator IDs; call before handing out fixed IDs
+// that did not come from symbol_intern
+void symbol_init(void);
+
+// Returns the ID for text[0..length), interning it if new; -1 on failure
+int symbol_intern(const char *text, size_t length);
+
+// Keyword ID for text[0..length), or SYM_NONE if it is not a C11 keyword.
+// One perfect-hash probe and one memcmp; takes no lock, so the lexer only
+// interns real identifiers.
+int symbol_keyword(const char *text, size_t length);
+
+// NUL terminated spelling; "" for an unknown ID
+const char* symbol_text(int id);
+size_t symbol_length(int id);
+// string_hash of the spelling, computed once at intern time
+unsigned long symbol_hash(int id);
+
+int symbol_count(void);
+
+// Drops every spelling but the pre-seeded ones and frees their memory, so
+// a long-lived process can bound the table. IDs handed out before are
+// reused afterwards: the caller must make sure no thread is lexing,
+// parsing or normalizing, and must drop anything keyed by those IDs.
+void symbol_reset(void);
+
+#endif
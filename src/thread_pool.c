@@ -0,0 +1,175 @@
+#include "thread_pool.h"
+#include "log.h"
+#include <stdlib.h>
+#include <pthread.h>
+
+typedef struct {
+    pthread_mutex_t lock;
+    int *items;
+    int head;
+    int tail;
+} ChunkDeque;
+
+typedef struct {
+    const TaskChunk *chunks;
+    ChunkDeque *deques;
+    int thread_count;
+    ChunkFn fn;
+    void *ctx;
+} WorkStealingPool;
+
+typedef struct {
+    WorkStealingPool *pool;
+    int worker;
+} WorkerArgs;
+
+TaskChunk* split_into_chunks(const double *costs, int task_count,
+                             int target_chunks, int *chunk_count) {
+    *chunk_count = 0;
+    if (task_count <= 0) return NULL;
+    if (target_chunks < 1) target_chunks = 1;
+    if (target_chunks > task_count) target_chunks = task_count;
+    
+    double total = 0.0;
+    for (int i = 0; i < task_count; i++) {
+        total += costs ? costs[i] : 1.0;
+    }
+    double per_chunk = total / target_chunks;
+    
+    TaskChunk *chunks = malloc(sizeof(TaskChunk) * task_count);
+    if (!chunks) return NULL;
+    
+    int begin = 0;
+    double acc = 0.0;
+    for (int i = 0; i < task_count; i++) {
+        acc += costs ? costs[i] : 1.0;
+        if (acc >= per_chunk || i == task_count - 1) {
+            chunks[*chunk_count].begin = begin;
+            chunks[*chunk_count].end = i + 1;
+            (*chunk_count)++;
+            begin = i + 1;
+            acc = 0.0;
+        }
+    }
+    
+    return chunks;
+}
+
+// The owner takes work from the tail, thieves from the head
+static int pop_own(ChunkDeque *dq, int *chunk) {
+    int found = 0;
+    pthread_mutex_lock(&dq->lock);
+    if (dq->head < dq->tail) {
+        *chunk = dq->items[--dq->tail];
+        found = 1;
+    }
+    pthread_mutex_unlock(&dq->lock);
+    return found;
+}
+
+static int steal(ChunkDeque *dq, int *chunk) {
+    int found = 0;
+    pthread_mutex_lock(&dq->lock);
+    if (dq->head < dq->tail) {
+        *chunk = dq->items[dq->head++];
+        found = 1;
+    }
+    pthread_mutex_unlock(&dq->lock);
+    return found;
+}
+
+static void* worker_main(void *arg) {
+    WorkerArgs *args = (WorkerArgs*)arg;
+    WorkStealingPool *pool = args->pool;
+    int self = args->worker;
+    int chunk;
+    
+    for (;;) {
+        if (pop_own(&pool->deques[self], &chunk)) {
+            pool->fn(pool->ctx, pool->chunks[chunk].begin, pool->chunks[chunk].end, self);
+            continue;
+        }
+        
+        // Chunks are never re-queued, so one empty sweep means we are done
+        int stolen = 0;
+        for (int k = 1; k < pool->thread_count && !stolen; k++) {
+            int victim = (self + k) % pool->thread_count;
+            stolen = steal(&pool->deques[victim], &chunk);
+        }
+        if (!stolen) break;
+        
+        pool->fn(pool->ctx, pool->chunks[chunk].begin, pool->chunks[chunk].end, self);
+    }
+    
+    return NULL;
+}
+
+void run_work_stealing(const TaskChunk *chunks, int chunk_count,
+                       int thread_count, ChunkFn fn, void *ctx) {
+    if (!chunks || chunk_count <= 0 || !fn) return;
+    
+    if (thread_count <= 1) {
+        for (int c = 0; c < chunk_count; c++) {
+            fn(ctx, chunks[c].begin, chunks[c].end, 0);
+        }
+        return;
+    }
+    
+    WorkStealingPool pool = {chunks, NULL, thread_count, fn, ctx};
+    pool.deques = calloc(thread_count, sizeof(ChunkDeque));
+    pthread_t *threads = malloc(sizeof(pthread_t) * thread_count);
+    WorkerArgs *args = malloc(sizeof(WorkerArgs) * thread_count);
+    if (!pool.deques || !threads || !args) {
+        LOG_ERROR(LOG_MAIN, "Memory allocation failed\n");
+        free(pool.deques);
+        free(threads);
+        free(args);
+        run_work_stealing(chunks, chunk_count, 1, fn, ctx);
+        return;
+    }
+    
+    // Deal chunks round-robin so every worker starts with a similar share
+    int per_worker = chunk_count / thread_count + 1;
+    int *items = malloc(sizeof(int) * per_worker * thread_count);
+    if (!items) {
+        LOG_ERROR(LOG_MAIN, "Memory allocation failed\n");
+        free(pool.deques);
+        free(threads);
+        free(args);
+        run_work_stealing(chunks, chunk_count, 1, fn, ctx);
+        return;
+    }
+    for (int w = 0; w < thread_count; w++) {
+        pthread_mutex_init(&pool.deques[w].lock, NULL);
+        pool.deques[w].items = items + w * per_worker;
+    }
+    for (int c = 0; c < chunk_count; c++) {
+        ChunkDeque *dq = &pool.deques[c % thread_count];
+        dq->items[dq->tail++] = c;
+    }
+    
+    int started = 0;
+    for (int w = 0; w < thread_count; w++) {
+        args[w].pool = &pool;
+        args[w].worker = w;
+        if (w == 0) continue;
+        if (pthread_create(&threads[w], NULL, worker_main, &args[w]) != 0) break;
+        started = w;
+    }
+    
+    // The calling thread is worker 0; any worker that failed to start is
+    // covered by stealing
+    worker_main(&args[0]);
+    
+    for (int w = 1; w <= started; w++) {
+        pthread_join(threads[w], NULL);
+    }
+    
+    for (int w = 0; w < thread_count; w++) {
+        pthread_mutex_destroy(&pool.deques[w].lock);
+    }
+    free(items);
+    free(pool.deques);
+    free(threads);
+    free(args);
+}
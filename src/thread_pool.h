@@ -0,0 +1,24 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+// A contiguous slice of task indices [begin, end) handed to a worker as one unit
+typedef struct {
+    int begin;
+    int end;
+} TaskChunk;
+
+// Runs tasks [begin, end) of a chunk; worker is in [0, thread_count)
+typedef void (*ChunkFn)(void *ctx, int begin, int end, int worker);
+
+// Splits task_count tasks into chunks of roughly equal total cost.
+// costs may be NULL (every task costs 1). Caller frees the returned array.
+TaskChunk* split_into_chunks(const double *costs, int task_count,
+                             int target_chunks, int *chunk_count);
+
+// Runs every chunk exactly once on thread_count workers. Each worker owns a
+// deque of chunks and steals from the others once its own deque runs dry.
+// With thread_count <= 1 all chunks run on the calling thread.
+void run_work_stealing(const TaskChunk *chunks, int chunk_count,
+                       int thread_count, ChunkFn fn, void *ctx);
+
+#endif
@@ -1,4 +1,9 @@
 #include "utils.h"
+#include "symbol.h"
+#include <stdio.h>
+#include <stdarg.h>
+
+static int diagnostics_enabled = 1;
 
 char* trim_whitespace(char *str) {
     if (!str) return NULL;
@@ -13,24 +18,7 @@ char* trim_whitespace(char *str) {
 
 int is_keyword(const char *str) {
     if (!str) return 0;
-    
-    const char *keywords[] = {
-        "if", "else", "while", "for", "do", "switch", "case", "default",
-        "break", "continue", "return",
-        "int", "float", "char", "double", "void",
-        "long", "short", "unsigned", "signed",
-        "struct", "union", "enum", "typedef",
-        "const", "static", "extern", "auto", "register",
-        "sizeof", "goto", NULL
-    };
-    
-    for (int i = 0; keywords[i] != NULL; i++) {
-        if (strcmp(str, keywords[i]) == 0) {
-            return 1;
-        }
-    }
-    
-    return 0;
+    return symbol_keyword(str, strlen(str)) != SYM_NONE;
 }
 
 unsigned long string_hash(const char *str) {
@@ -43,6 +31,16 @@ unsigned long string_hash(const char *str) {
     return hash;
 }
 
+// FNV-1a; 64 bits on every platform, so it is safe to persist
+unsigned long long content_hash64(const char *data, size_t length) {
+    unsigned long long hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
 int min_int(int a, int b) { 
     return a < b ? a : b; 
 }
@@ -63,3 +61,14 @@ double max_double(double a, double b) {
     return a > b ? a : b;
 }
 
+void set_diagnostics(int enabled) {
+    diagnostics_enabled = enabled;
+}
+
+void diag_printf(const char *format, ...) {
+    if (!diagnostics_enabled) return;
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+}
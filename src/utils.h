@@ -8,6 +8,7 @@
 char* trim_whitespace(char *str);
 int is_keyword(const char *word);
 unsigned long string_hash(const char *str);
+unsigned long long content_hash64(const char *data, size_t length);
 int min_int(int a, int b);
 int min3_int(int a, int b, int c);
 int max_int(int a, int b);
@@ -15,4 +16,9 @@ double min_double(double a, double b);
 double max_double(double a, double b);
 int is_keyword(const char *str);
 
+// Banners, progress and debug lines go through diag_printf so that
+// structured output modes can switch them all off
+void set_diagnostics(int enabled);
+void diag_printf(const char *format, ...);
+
 #endif
\ No newline at end of file
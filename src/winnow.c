@@ -0,0 +1,167 @@
+#include "winnow.h"
+#include "utils.h"
+#include "symbol.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define KGRAM_BASE 1000003ULL
+
+// Identifier symbol -> var_N, numbered by first appearance like
+// normalize_ast. Keyed by symbol ID, so no string compares.
+typedef struct {
+    int *symbols;
+    int *ids;
+    int capacity;
+    int count;
+} IdentTable;
+
+static int ident_table_init(IdentTable *table, int capacity) {
+    table->capacity = capacity;
+    table->count = 0;
+    table->symbols = malloc(sizeof(int) * capacity);
+    table->ids = malloc(sizeof(int) * capacity);
+    if (!table->symbols || !table->ids) return 0;
+    for (int i = 0; i < capacity; i++) table->symbols[i] = -1;
+    return 1;
+}
+
+static void ident_table_free(IdentTable *table) {
+    free(table->symbols);
+    free(table->ids);
+}
+
+static int canonical_id(IdentTable *table, int symbol) {
+    int slot = (int)((unsigned int)symbol * 2654435761u % (unsigned int)table->capacity);
+    
+    while (table->symbols[slot] >= 0) {
+        if (table->symbols[slot] == symbol) {
+            return table->ids[slot];
+        }
+        slot = (slot + 1) % table->capacity;
+    }
+    
+    table->symbols[slot] = symbol;
+    table->ids[slot] = table->count++;
+    return table->ids[slot];
+}
+
+// Hashes the spelling, never the symbol ID, so fingerprints are the same
+// in every run and can be persisted in the corpus
+static unsigned long long token_hash(const TokenList *tokens, int i, IdentTable *idents) {
+    unsigned long long h;
+    if (tokens->types[i] == TOK_IDENTIFIER) {
+        char canonical[32];
+        snprintf(canonical, sizeof(canonical), "var_%d", canonical_id(idents, tokens->symbols[i]));
+        h = string_hash(canonical);
+    } else {
+        h = symbol_hash(tokens->symbols[i]);
+    }
+    return h * 31 + (unsigned long long)tokens->types[i];
+}
+
+static int compare_hashes(const void *a, const void *b) {
+    unsigned long long x = *(const unsigned long long*)a;
+    unsigned long long y = *(const unsigned long long*)b;
+    return (x > y) - (x < y);
+}
+
+Fingerprints* winnow_tokens(TokenList *tokens) {
+    if (!tokens) return NULL;
+    
+    Fingerprints *fp = calloc(1, sizeof(Fingerprints));
+    if (!fp) return NULL;
+    
+    int n = tokens->count - 1;  // drop TOK_EOF
+    int kgrams = n - WINNOW_K + 1;
+    if (kgrams <= 0) return fp;
+    
+    IdentTable idents;
+    unsigned long long *token_hashes = malloc(sizeof(unsigned long long) * n);
+    unsigned long long *kgram_hashes = malloc(sizeof(unsigned long long) * kgrams);
+    int *window = malloc(sizeof(int) * kgrams);
+    fp->hashes = malloc(sizeof(unsigned long long) * kgrams);
+    if (!ident_table_init(&idents, 2 * n + 1) || !token_hashes || !kgram_hashes ||
+        !window || !fp->hashes) {
+        ident_table_free(&idents);
+        free(token_hashes);
+        free(kgram_hashes);
+        free(window);
+        free_fingerprints(fp);
+        return NULL;
+    }
+    
+    for (int i = 0; i < n; i++) {
+        token_hashes[i] = token_hash(tokens, i, &idents);
+    }
+    
+    // Karp-Rabin rolling hash over WINNOW_K consecutive tokens
+    unsigned long long top = 1;
+    for (int i = 1; i < WINNOW_K; i++) top *= KGRAM_BASE;
+    
+    unsigned long long h = 0;
+    for (int i = 0; i < WINNOW_K; i++) h = h * KGRAM_BASE + token_hashes[i];
+    kgram_hashes[0] = h;
+    for (int i = 1; i < kgrams; i++) {
+        h = (h - token_hashes[i - 1] * top) * KGRAM_BASE + token_hashes[i + WINNOW_K - 1];
+        kgram_hashes[i] = h;
+    }
+    
+    // Winnowing: keep the rightmost minimum of every window, recording it
+    // once per position. window[] is a monotonic deque of k-gram indices.
+    int head = 0, tail = 0;
+    int last_selected = -1;
+    for (int i = 0; i < kgrams; i++) {
+        while (tail > head && kgram_hashes[window[tail - 1]] >= kgram_hashes[i]) tail--;
+        window[tail++] = i;
+        if (window[head] <= i - WINNOW_WINDOW) head++;
+        
+        if (i >= WINNOW_WINDOW - 1 || i == kgrams - 1) {
+            if (window[head] != last_selected) {
+                last_selected = window[head];
+                fp->hashes[fp->count++] = kgram_hashes[last_selected];
+            }
+        }
+    }
+    
+    qsort(fp->hashes, fp->count, sizeof(unsigned long long), compare_hashes);
+    int unique = 0;
+    for (int i = 0; i < fp->count; i++) {
+        if (unique == 0 || fp->hashes[unique - 1] != fp->hashes[i]) {
+            fp->hashes[unique++] = fp->hashes[i];
+        }
+    }
+    fp->count = unique;
+    
+    ident_table_free(&idents);
+    free(token_hashes);
+    free(kgram_hashes);
+    free(window);
+    return fp;
+}
+
+void free_fingerprints(Fingerprints *fp) {
+    if (!fp) return;
+    if (fp->hashes) free(fp->hashes);
+    free(fp);
+}
+
+double compare_fingerprints(const Fingerprints *fp1, const Fingerprints *fp2) {
+    if (!fp1 || !fp2 || fp1->count == 0 || fp2->count == 0) return 0.0;
+    
+    // Both arrays are sorted, so one merge pass counts the overlap
+    int i = 0, j = 0, shared = 0;
+    while (i < fp1->count && j < fp2->count) {
+        if (fp1->hashes[i] < fp2->hashes[j]) {
+            i++;
+        } else if (fp1->hashes[i] > fp2->hashes[j]) {
+            j++;
+        } else {
+            shared++;
+            i++;
+            j++;
+        }
+    }
+    
+    return (double)shared / (fp1->count + fp2->count - shared);
+}
@@ -0,0 +1,20 @@
+#ifndef WINNOW_H
+#define WINNOW_H
+
+#include "lexer.h"
+
+// Tokens per k-gram and k-grams per winnowing window. Any match of at
+// least WINNOW_K + WINNOW_WINDOW - 1 tokens is guaranteed to be detected.
+#define WINNOW_K 5
+#define WINNOW_WINDOW 4
+
+typedef struct {
+    unsigned long long *hashes;  // sorted, no duplicates
+    int count;
+} Fingerprints;
+
+Fingerprints* winnow_tokens(TokenList *tokens);
+void free_fingerprints(Fingerprints *fp);
+double compare_fingerprints(const Fingerprints *fp1, const Fingerprints *fp2);
+
+#endif
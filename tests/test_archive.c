@@ -0,0 +1,501 @@
+/*
+ * Round-trip checks for the zip reader in archive.c:
+ *
+ *   cd tests
+ *   gcc -std=c99 -Wall -O2 -pthread -I../src -o test_archive test_archive.c \
+ *       ../src/archive.c ../src/directory_handler.c ../src/thread_pool.c \
+ *       ../src/utils.c ../src/symbol.c ../src/log.c
+ *   ./test_archive [--work-dir DIR]
+ *
+ * Archives are assembled in memory with a small deflate encoder (stored,
+ * fixed and dynamic blocks), written to <work-dir> and read back through
+ * archive_open; each member must come back byte for byte. Truncated,
+ * corrupt, overlapping and oversized archives must be refused or have the
+ * bad member skipped. Exits non-zero if any check fails.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "archive.h"
+#include "log.h"
+
+static const char *work_dir = ".";
+static int failures = 0;
+
+#define CHECK(cond, what) do { \
+    if (!(cond)) { printf("[FAIL] %s: %s\n", test_name, what); failures++; return; } \
+} while (0)
+
+// ------------------------------------------------------------- deflate --
+
+typedef struct {
+    unsigned char *data;
+    size_t length;
+    size_t capacity;
+    uint32_t bits;
+    int bit_count;
+} Writer;
+
+static void put_byte(Writer *w, unsigned char byte) {
+    if (w->length == w->capacity) {
+        w->capacity = w->capacity ? w->capacity * 2 : 4096;
+        w->data = realloc(w->data, w->capacity);
+        if (!w->data) exit(2);
+    }
+    w->data[w->length++] = byte;
+}
+
+static void put_bytes(Writer *w, const void *data, size_t length) {
+    for (size_t i = 0; i < length; i++) put_byte(w, ((const unsigned char*)data)[i]);
+}
+
+static void put16(Writer *w, unsigned value) {
+    put_byte(w, (unsigned char)value);
+    put_byte(w, (unsigned char)(value >> 8));
+}
+
+static void put32(Writer *w, uint32_t value) {
+    put16(w, value & 0xFFFFu);
+    put16(w, value >> 16);
+}
+
+// Deflate packs values from their lowest bit
+static void put_bits(Writer *w, unsigned value, int count) {
+    for (int b = 0; b < count; b++) {
+        w->bits |= ((value >> b) & 1u) << w->bit_count;
+        if (++w->bit_count == 8) {
+            put_byte(w, (unsigned char)w->bits);
+            w->bits = 0;
+            w->bit_count = 0;
+        }
+    }
+}
+
+static void flush_bits(Writer *w) {
+    if (w->bit_count > 0) put_bits(w, 0, 8 - w->bit_count);
+}
+
+// Huffman codes go out from their first (highest) bit
+static void put_code(Writer *w, unsigned code, int length) {
+    for (int b = length - 1; b >= 0; b--) put_bits(w, (code >> b) & 1u, 1);
+}
+
+// Canonical codes for the given lengths, as RFC 1951 section 3.2.2 builds them
+static void canonical_codes(const unsigned char *lengths, int n, unsigned *codes) {
+    unsigned count[16] = {0}, next[16] = {0};
+    for (int i = 0; i < n; i++) count[lengths[i]]++;
+    count[0] = 0;
+    unsigned code = 0;
+    for (int len = 1; len < 16; len++) {
+        code = (code + count[len - 1]) << 1;
+        next[len] = code;
+    }
+    for (int i = 0; i < n; i++) {
+        if (lengths[i]) codes[i] = next[lengths[i]]++;
+    }
+}
+
+static void put_stored_block(Writer *w, const char *text, size_t length, int last) {
+    put_bits(w, (unsigned)last, 1);
+    put_bits(w, 0, 2);
+    flush_bits(w);
+    put16(w, (unsigned)length);
+    put16(w, (unsigned)~length & 0xFFFFu);
+    put_bytes(w, text, length);
+}
+
+static const unsigned short length_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const unsigned char length_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const unsigned short dist_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const unsigned char dist_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+// Fixed codes; text[0..literals) goes out as literals and the rest as one
+// back-reference to the distance bytes before it
+static void put_fixed_block(Writer *w, const char *text, size_t literals, size_t length,
+                            size_t distance, int last) {
+    unsigned char lengths[288];
+    unsigned codes[288];
+    int sym = 0;
+    for (; sym < 144; sym++) lengths[sym] = 8;
+    for (; sym < 256; sym++) lengths[sym] = 9;
+    for (; sym < 280; sym++) lengths[sym] = 7;
+    for (; sym < 288; sym++) lengths[sym] = 8;
+    canonical_codes(lengths, 288, codes);
+
+    put_bits(w, (unsigned)last, 1);
+    put_bits(w, 1, 2);
+    for (size_t i = 0; i < literals; i++) {
+        unsigned char c = (unsigned char)text[i];
+        put_code(w, codes[c], lengths[c]);
+    }
+    if (length > literals) {
+        size_t match = length - literals;
+        int l = 28;
+        while (length_base[l] > match) l--;
+        put_code(w, codes[257 + l], lengths[257 + l]);
+        put_bits(w, (unsigned)(match - length_base[l]), length_extra[l]);
+        int d = 29;
+        while (dist_base[d] > distance) d--;
+        put_code(w, (unsigned)d, 5);
+        put_bits(w, (unsigned)(distance - dist_base[d]), dist_extra[d]);
+    }
+    put_code(w, codes[256], lengths[256]);
+}
+
+// Dynamic codes: literals 0..254 get 8 bits, 255 and end-of-block 9, and
+// the code lengths are themselves sent with repeat code 16
+static void put_dynamic_block(Writer *w, const char *text, size_t length, int last) {
+    static const unsigned char order[19] = {
+        16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+    };
+    unsigned char lengths[258];
+    unsigned codes[258];
+    for (int i = 0; i < 255; i++) lengths[i] = 8;
+    lengths[255] = 9;
+    lengths[256] = 9;
+    lengths[257] = 1;   // the one distance code, never used
+    canonical_codes(lengths, 257, codes);
+
+    unsigned char code_lengths[19] = {0};
+    unsigned code_codes[19];
+    code_lengths[1] = code_lengths[8] = code_lengths[9] = code_lengths[16] = 2;
+    canonical_codes(code_lengths, 19, code_codes);
+
+    put_bits(w, (unsigned)last, 1);
+    put_bits(w, 2, 2);
+    put_bits(w, 0, 5);     // 257 literal/length codes
+    put_bits(w, 0, 5);     // 1 distance code
+    put_bits(w, 14, 4);    // 18 code length codes, up to symbol 1
+    for (int i = 0; i < 18; i++) put_bits(w, code_lengths[order[i]], 3);
+
+    for (int i = 0; i < 258; ) {
+        int run = 1;
+        while (i + run < 258 && lengths[i + run] == lengths[i]) run++;
+        put_code(w, code_codes[lengths[i]], 2);
+        i++;
+        run--;
+        while (run >= 3) {
+            int repeat = run < 6 ? run : 6;
+            put_code(w, code_codes[16], 2);
+            put_bits(w, (unsigned)(repeat - 3), 2);
+            i += repeat;
+            run -= repeat;
+        }
+        while (run-- > 0) {
+            put_code(w, code_codes[lengths[i]], 2);
+            i++;
+        }
+    }
+
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = (unsigned char)text[i];
+        put_code(w, codes[c], lengths[c]);
+    }
+    put_code(w, codes[256], lengths[256]);
+}
+
+// ----------------------------------------------------------------- zip --
+
+static uint32_t crc32_of(const void *data, size_t length) {
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= ((const unsigned char*)data)[i];
+        for (int k = 0; k < 8; k++) crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+typedef struct {
+    char name[32];
+    int method;
+    const unsigned char *payload;
+    size_t compressed;
+    uint32_t size;
+    uint32_t crc;
+    int shares_local;      // >= 0: no local header, point at that member's
+    size_t local;
+} Member;
+
+static Member member(const char *name, int method, const void *payload, size_t compressed,
+                     const char *text, size_t size) {
+    Member m;
+    memset(&m, 0, sizeof(m));
+    snprintf(m.name, sizeof(m.name), "%s", name);
+    m.method = method;
+    m.payload = payload;
+    m.compressed = compressed;
+    m.size = (uint32_t)size;
+    m.crc = crc32_of(text, size);
+    m.shares_local = -1;
+    return m;
+}
+
+static Writer build_zip(Member *members, int count) {
+    Writer zip = {NULL, 0, 0, 0, 0};
+    for (int i = 0; i < count; i++) {
+        Member *m = &members[i];
+        if (m->shares_local >= 0) {
+            m->local = members[m->shares_local].local;
+            continue;
+        }
+        m->local = zip.length;
+        put32(&zip, 0x04034b50u);
+        put16(&zip, 20);
+        put16(&zip, 0);
+        put16(&zip, (unsigned)m->method);
+        put32(&zip, 0);
+        put32(&zip, m->crc);
+        put32(&zip, (uint32_t)m->compressed);
+        put32(&zip, m->size);
+        put16(&zip, (unsigned)strlen(m->name));
+        put16(&zip, 0);
+        put_bytes(&zip, m->name, strlen(m->name));
+        put_bytes(&zip, m->payload, m->compressed);
+    }
+
+    size_t directory = zip.length;
+    for (int i = 0; i < count; i++) {
+        Member *m = &members[i];
+        put32(&zip, 0x02014b50u);
+        put16(&zip, 20);
+        put16(&zip, 20);
+        put16(&zip, 0);
+        put16(&zip, (unsigned)m->method);
+        put32(&zip, 0);
+        put32(&zip, m->crc);
+        put32(&zip, (uint32_t)m->compressed);
+        put32(&zip, m->size);
+        put16(&zip, (unsigned)strlen(m->name));
+        put16(&zip, 0);
+        put16(&zip, 0);
+        put16(&zip, 0);
+        put16(&zip, 0);
+        put32(&zip, 0);
+        put32(&zip, (uint32_t)m->local);
+        put_bytes(&zip, m->name, strlen(m->name));
+    }
+
+    put32(&zip, 0x06054b50u);
+    put16(&zip, 0);
+    put16(&zip, 0);
+    put16(&zip, (unsigned)count);
+    put16(&zip, (unsigned)count);
+    put32(&zip, (uint32_t)(zip.length - directory - 4 - 2 - 2 - 2 - 2));
+    put32(&zip, (uint32_t)directory);
+    put16(&zip, 0);
+    return zip;
+}
+
+static Archive* open_bytes(const unsigned char *data, size_t length) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/test_archive.zip", work_dir);
+    FILE *out = fopen(path, "wb");
+    if (!out) {
+        printf("[ERROR] Cannot write: %s\n", path);
+        exit(2);
+    }
+    fwrite(data, 1, length, out);
+    fclose(out);
+    Archive *archive = archive_open(path, NULL, 2);
+    remove(path);
+    return archive;
+}
+
+// --------------------------------------------------------------- tests --
+
+static const char source[] =
+    "int add(int a, int b) {\n"
+    "    return a + b;\n"
+    "}\n"
+    "int add(int a, int b) {\n"
+    "    return a + b;\n"
+    "}\n";
+
+static int round_trips(const char *test_name, Writer *stream) {
+    flush_bits(stream);
+    Member m = member("sub/a.c", 8, stream->data, stream->length, source, strlen(source));
+    Writer zip = build_zip(&m, 1);
+    Archive *archive = open_bytes(zip.data, zip.length);
+    int ok = archive && archive->members->count == 1 && archive->skipped == 0 &&
+             strcmp(archive->members->paths[0], "sub/a.c") == 0 &&
+             archive->lengths[0] == strlen(source) && memcmp(archive->data[0], source, strlen(source)) == 0;
+    if (!ok) printf("[FAIL] %s: member did not round-trip\n", test_name);
+    archive_free(archive);
+    free(zip.data);
+    free(stream->data);
+    return ok;
+}
+
+static void test_stored_member(void) {
+    const char *test_name = "stored member";
+    Member members[2] = {
+        member("a.c", 0, source, strlen(source), source, strlen(source)),
+        member("notes.txt", 0, "skip", 4, "skip", 4),
+    };
+    Writer zip = build_zip(members, 2);
+    Archive *archive = open_bytes(zip.data, zip.length);
+    free(zip.data);
+    CHECK(archive, "archive refused");
+    CHECK(archive->members->count == 1, "filter should keep only a.c");
+    CHECK(strcmp(archive->data[0], source) == 0, "contents differ");
+    archive_free(archive);
+}
+
+static void test_deflate_blocks(void) {
+    size_t length = strlen(source);
+    size_t half = length / 2;
+
+    Writer stored = {NULL, 0, 0, 0, 0};
+    put_stored_block(&stored, source, half, 0);
+    put_stored_block(&stored, source + half, length - half, 1);
+    if (!round_trips("stored blocks", &stored)) failures++;
+
+    Writer fixed = {NULL, 0, 0, 0, 0};
+    put_fixed_block(&fixed, source, half, length, half, 1);
+    if (!round_trips("fixed block", &fixed)) failures++;
+
+    Writer dynamic = {NULL, 0, 0, 0, 0};
+    put_dynamic_block(&dynamic, source, length, 1);
+    if (!round_trips("dynamic block", &dynamic)) failures++;
+
+    // One member switching block types mid-stream
+    Writer mixed = {NULL, 0, 0, 0, 0};
+    put_stored_block(&mixed, source, 10, 0);
+    put_fixed_block(&mixed, source + 10, 20, 20, 0, 0);
+    put_dynamic_block(&mixed, source + 30, length - 30, 1);
+    if (!round_trips("mixed blocks", &mixed)) failures++;
+}
+
+static void test_truncated_archive(void) {
+    const char *test_name = "truncated archive";
+    Member m = member("a.c", 0, source, strlen(source), source, strlen(source));
+    Writer zip = build_zip(&m, 1);
+    Archive *archive = open_bytes(zip.data, zip.length / 2);
+    free(zip.data);
+    CHECK(!archive, "archive without its central directory was accepted");
+}
+
+static void test_corrupt_members(void) {
+    const char *test_name = "corrupt members";
+    size_t length = strlen(source);
+    Writer dynamic = {NULL, 0, 0, 0, 0};
+    put_dynamic_block(&dynamic, source, length, 1);
+    flush_bits(&dynamic);
+
+    unsigned char *flipped = malloc(dynamic.length);
+    memcpy(flipped, dynamic.data, dynamic.length);
+    flipped[dynamic.length / 2] ^= 0x5A;
+
+    Member members[4] = {
+        member("cut.c", 8, dynamic.data, dynamic.length / 2, source, length),
+        member("flipped.c", 8, flipped, dynamic.length, source, length),
+        member("crc.c", 0, source, length, "other", 5),
+        member("good.c", 8, dynamic.data, dynamic.length, source, length),
+    };
+    members[2].size = (uint32_t)length;
+    Writer zip = build_zip(members, 4);
+    Archive *archive = open_bytes(zip.data, zip.length);
+    free(zip.data);
+    free(flipped);
+    free(dynamic.data);
+    CHECK(archive, "archive refused");
+    CHECK(archive->members->count == 1 && strcmp(archive->members->paths[0], "good.c") == 0,
+          "only the intact member should be kept");
+    CHECK(archive->skipped == 3, "three members should be skipped");
+    CHECK(strcmp(archive->data[0], source) == 0, "contents differ");
+    archive_free(archive);
+}
+
+static void test_overlapping_members(void) {
+    const char *test_name = "overlapping members";
+    Member members[2] = {
+        member("a.c", 0, source, strlen(source), source, strlen(source)),
+        member("b.c", 0, source, strlen(source), source, strlen(source)),
+    };
+    members[1].shares_local = 0;
+    Writer zip = build_zip(members, 2);
+    Archive *archive = open_bytes(zip.data, zip.length);
+    free(zip.data);
+    CHECK(!archive, "members sharing a local header were accepted");
+}
+
+static void test_total_limit(void) {
+    const char *test_name = "total size limit";
+    int count = (int)(ARCHIVE_MAX_TOTAL / ARCHIVE_MAX_MEMBER) + 1;
+    Member *members = calloc(count, sizeof(Member));
+    Writer stream = {NULL, 0, 0, 0, 0};
+    put_fixed_block(&stream, "x", 1, 1, 0, 1);
+    flush_bits(&stream);
+    for (int i = 0; i < count; i++) {
+        char name[32];
+        snprintf(name, sizeof(name), "big%d.c", i);
+        members[i] = member(name, 8, stream.data, stream.length, "x", 1);
+        members[i].size = ARCHIVE_MAX_MEMBER;
+    }
+    Writer zip = build_zip(members, count);
+    Archive *archive = open_bytes(zip.data, zip.length);
+    free(zip.data);
+    free(stream.data);
+    free(members);
+    CHECK(!archive, "archive claiming more than ARCHIVE_MAX_TOTAL was accepted");
+}
+
+static void test_member_limit(void) {
+    const char *test_name = "member count limit";
+    int count = ARCHIVE_MAX_MEMBERS + 1;
+    Member *members = calloc(count, sizeof(Member));
+    for (int i = 0; i < count; i++) {
+        char name[32];
+        snprintf(name, sizeof(name), "m%05d.c", i);
+        members[i] = member(name, 0, "x", 1, "x", 1);
+    }
+    Writer zip = build_zip(members, count);
+    Archive *archive = open_bytes(zip.data, zip.length);
+    free(zip.data);
+    free(members);
+    CHECK(!archive, "archive with more than ARCHIVE_MAX_MEMBERS members was accepted");
+}
+
+int main(int argc, char *argv[]) {
+    for (int a = 1; a < argc; a++) {
+        if (strcmp(argv[a], "--work-dir") == 0 && a + 1 < argc) {
+            work_dir = argv[++a];
+        } else {
+            printf("Usage: %s [--work-dir DIR]\n", argv[0]);
+            return 1;
+        }
+    }
+    // Refused archives are expected here; keep their errors off the output
+    log_set_level(-1);
+
+    test_stored_member();
+    test_deflate_blocks();
+    test_truncated_archive();
+    test_corrupt_members();
+    test_overlapping_members();
+    test_total_limit();
+    test_member_limit();
+
+    if (failures) {
+        printf("%d archive checks failed\n", failures);
+        return 1;
+    }
+    printf("[OK] All archive checks passed\n");
+    return 0;
+}
@@ -0,0 +1,134 @@
+/*
+ * Degenerate but legal input shapes must build an artifact, or be refused
+ * as too deep, without exhausting the stack:
+ *
+ *   cd tests
+ *   gcc -std=c99 -Wall -O2 -pthread -I../src -o test_deep_input test_deep_input.c \
+ *       ../src/lexer.c ../src/symbol.c ../src/scan.c ../src/parser.c ../src/arena.c \
+ *       ../src/ast.c ../src/normalizer.c ../src/cfg.c ../src/dag.c ../src/detector.c \
+ *       ../src/winnow.c ../src/utils.c ../src/log.c ../src/profile.c \
+ *       ../src/thread_pool.c ../src/function_cache.c
+ *   ./test_deep_input [--terms N]
+ *
+ * Each shape is one statement of N repeated terms inside a function. The
+ * artifacts are built on a thread with a 1 MiB stack, well below the usual
+ * default, so a walk that recurses once per term crashes here first.
+ * Exits non-zero if any shape ends with an unexpected status.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "detector.h"
+#include "log.h"
+
+#define TEST_STACK (1u << 20)
+
+typedef struct {
+    const char *name;
+    const char *head;      // written once
+    const char *term;      // written N times
+    const char *tail;      // written once, then N times close
+    const char *close;
+    ArtifactStatus expected;
+} Shape;
+
+// Left-associative chains and postfix suffixes nest no brackets and must
+// be analyzed; right-associative and prefix chains recurse in the parser
+// and stop at its nesting limit
+static const Shape shapes[] = {
+    {"sum chain",        "x = x",  " + x",     "", "", ARTIFACT_OK},
+    {"logical chain",    "x = x",  " && x",    "", "", ARTIFACT_OK},
+    {"comparison chain", "x = x",  " < x",     "", "", ARTIFACT_OK},
+    {"comma chain",      "x = x",  ", x",      "", "", ARTIFACT_OK},
+    {"index chain",      "x = x",  "[0]",      "", "", ARTIFACT_OK},
+    {"member chain",     "x = x",  ".y",       "", "", ARTIFACT_OK},
+    {"call chain",       "x = x",  "()",       "", "", ARTIFACT_OK},
+    {"assignment chain", "x",      " = x",     " = 0", "", ARTIFACT_TOO_DEEP},
+    {"unary chain",      "x = ",   "- ",       "x", "", ARTIFACT_TOO_DEEP},
+    {"ternary chain",    "x = ",   "x ? x : ", "x", "", ARTIFACT_TOO_DEEP},
+    {"parentheses",      "x = ",   "(",        "x", ")", ARTIFACT_TOO_DEEP},
+};
+
+typedef struct {
+    const char *code;
+    size_t length;
+    ArtifactStatus status;
+    int built;
+} BuildJob;
+
+static void* build(void *arg) {
+    BuildJob *job = (BuildJob*)arg;
+    FileArtifact *artifact = build_artifact(job->code, job->length);
+    job->built = artifact != NULL;
+    if (artifact) job->status = artifact->status;
+    free_artifact(artifact);
+    return NULL;
+}
+
+static char* shape_source(const Shape *shape, int terms, size_t *length) {
+    size_t size = 64 + strlen(shape->head) + strlen(shape->tail) +
+                  (size_t)terms * (strlen(shape->term) + strlen(shape->close));
+    char *code = malloc(size);
+    if (!code) return NULL;
+    char *p = code;
+    p += sprintf(p, "int f(int x) {\n    %s", shape->head);
+    for (int i = 0; i < terms; i++) p += sprintf(p, "%s", shape->term);
+    p += sprintf(p, "%s", shape->tail);
+    for (int i = 0; i < terms; i++) p += sprintf(p, "%s", shape->close);
+    p += sprintf(p, ";\n    return x;\n}\n");
+    *length = (size_t)(p - code);
+    return code;
+}
+
+int main(int argc, char *argv[]) {
+    int terms = 200000;
+    for (int a = 1; a < argc; a++) {
+        if (strcmp(argv[a], "--terms") == 0 && a + 1 < argc) {
+            terms = atoi(argv[++a]);
+            if (terms < 1) terms = 1;
+        } else {
+            printf("Usage: %s [--terms N]\n", argv[0]);
+            return 1;
+        }
+    }
+    log_set_level(-1);
+
+    int failures = 0;
+    for (size_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++) {
+        const Shape *shape = &shapes[s];
+        BuildJob job = {NULL, 0, ARTIFACT_OK, 0};
+        job.code = shape_source(shape, terms, &job.length);
+        if (!job.code) {
+            printf("[ERROR] Memory allocation failed\n");
+            return 2;
+        }
+
+        pthread_attr_t attr;
+        pthread_t thread;
+        pthread_attr_init(&attr);
+        pthread_attr_setstacksize(&attr, TEST_STACK);
+        if (pthread_create(&thread, &attr, build, &job) != 0) {
+            printf("[ERROR] Cannot start build thread\n");
+            return 2;
+        }
+        pthread_join(thread, NULL);
+        pthread_attr_destroy(&attr);
+        free((char*)job.code);
+
+        if (!job.built || job.status != shape->expected) {
+            printf("[FAIL] %s: %s, expected \"%s\"\n", shape->name,
+                   job.built ? artifact_status_verdict(job.status) : "no artifact",
+                   artifact_status_verdict(shape->expected));
+            failures++;
+        }
+    }
+
+    if (failures) {
+        printf("%d deep input checks failed\n", failures);
+        return 1;
+    }
+    printf("[OK] All deep input checks passed (%d terms)\n", terms);
+    return 0;
+}